@@ -0,0 +1,210 @@
+/**
+ * @file
+ * @brief Memory and throughput of many concurrent denoisers, arena vs malloc.
+ *
+ * For each stream count, a child process creates that many denoisers,
+ * either one heap allocation each (denoise_core_create) or placed in a
+ * DenoiseArena, then denoises frames round robin across all of them the
+ * way a busy server does. Resident memory is read from /proc before and
+ * after, so the per-stream figure includes allocator overhead and
+ * alignment waste.
+ *
+ * Usage: arena_bench [-f frames] [-l layouts] [counts...]
+ *   -f  frames per stream (default 20)
+ *   -l  "arena", "malloc" or "both" (default)
+ *   counts  stream counts (default 1 10 100 1000 10000)
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "denoise_arena.h"
+#include "denoise_core.h"
+
+#define FRAME_SIZE DENOISE_CORE_FRAME
+#define SIGNAL_FRAMES 64           // Distinct input frames cycled through.
+
+/**
+ * @brief One measurement, sent from the child back to the parent.
+ */
+typedef struct {
+    int ok;
+    double rss_bytes;              // Resident memory added by the denoisers.
+    double frames_per_second;
+    size_t slot_bytes;             // Arena only: bytes per denoiser.
+    size_t reserved_bytes;         // Arena only: address space of its chunks.
+} Measurement;
+
+/**
+ * @brief Monotonic clock in seconds.
+ */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Resident memory of this process, in bytes.
+ */
+static double rss_bytes(void) {
+    FILE *f = fopen("/proc/self/statm", "r");
+    unsigned long size = 0, resident = 0;
+    if (f) {
+        if (fscanf(f, "%lu %lu", &size, &resident) != 2) resident = 0;
+        fclose(f);
+    }
+    return (double)resident * (double)sysconf(_SC_PAGESIZE);
+}
+
+static void measure(int arena_layout, int streams, int frames, const float *signal, Measurement *m) {
+    memset(m, 0, sizeof(*m));
+    DenoiseCore **cores = calloc((size_t)streams, sizeof(DenoiseCore *));
+    DenoiseArena *arena = arena_layout ? denoise_arena_create(NULL, 0) : NULL;
+    if (!cores || (arena_layout && !arena)) return;
+
+    double before = rss_bytes();
+    for (int i = 0; i < streams; i++) {
+        cores[i] = arena ? denoise_arena_get(arena) : denoise_core_create(NULL);
+        if (!cores[i]) return;
+    }
+
+    // Round robin, one frame per stream per pass, as a server's 10ms tick does.
+    float frame[FRAME_SIZE];
+    double start = now_seconds();
+    for (int f = 0; f < frames; f++) {
+        for (int i = 0; i < streams; i++) {
+            memcpy(frame, signal + (size_t)((f + i) % SIGNAL_FRAMES) * FRAME_SIZE, sizeof(frame));
+            denoise_core_process_frame(cores[i], frame);
+        }
+    }
+    double elapsed = now_seconds() - start;
+    m->rss_bytes = rss_bytes() - before;
+    m->frames_per_second = elapsed > 0 ? (double)streams * frames / elapsed : 0.0;
+
+    if (arena) {
+        DenoiseArenaStats stats;
+        denoise_arena_stats(arena, &stats);
+        m->slot_bytes = stats.slot_bytes;
+        m->reserved_bytes = stats.reserved_bytes;
+        for (int i = 0; i < streams; i++) denoise_arena_put(arena, cores[i]);
+        denoise_arena_destroy(arena);
+    } else {
+        for (int i = 0; i < streams; i++) denoise_core_destroy(cores[i]);
+    }
+    free(cores);
+    m->ok = 1;
+}
+
+/**
+ * @brief Run one measurement in a child process, so each starts from a clean heap.
+ */
+static int measure_in_child(int arena_layout, int streams, int frames, const float *signal, Measurement *m) {
+    int fds[2];
+    if (pipe(fds) != 0) return 0;
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return 0;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        measure(arena_layout, streams, frames, signal, m);
+        ssize_t n = write(fds[1], m, sizeof(*m));
+        _exit(n == (ssize_t)sizeof(*m) ? 0 : 1);
+    }
+    close(fds[1]);
+    ssize_t n = read(fds[0], m, sizeof(*m));
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+    return n == (ssize_t)sizeof(*m) && m->ok;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-f frames] [-l arena|malloc|both] [counts...]\n"
+            "  -f  frames per stream (default 20)\n"
+            "  -l  layouts to measure (default both)\n"
+            "  counts  stream counts (default 1 10 100 1000 10000)\n",
+            prog);
+}
+
+/**
+ * @brief Main entry point.
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return 0 on success, 1 on error.
+ */
+int main(int argc, char *argv[]) {
+    int frames = 20;
+    int layouts = 3;   // Bit 0: malloc, bit 1: arena.
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:l:h")) != -1) {
+        switch (opt) {
+            case 'f': frames = atoi(optarg); break;
+            case 'l':
+                layouts = strcmp(optarg, "malloc") == 0 ? 1 : strcmp(optarg, "arena") == 0 ? 2
+                        : strcmp(optarg, "both") == 0 ? 3 : 0;
+                break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (frames < 1 || layouts == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    static const int default_counts[] = {1, 10, 100, 1000, 10000};
+    int count_n = argc - optind;
+    int counts[64];
+    if (count_n == 0) {
+        count_n = (int)(sizeof(default_counts) / sizeof(default_counts[0]));
+        memcpy(counts, default_counts, sizeof(default_counts));
+    } else {
+        if (count_n > 64) count_n = 64;
+        for (int i = 0; i < count_n; i++) counts[i] = atoi(argv[optind + i]);
+    }
+
+    // Noise-like speech-level input, the same for both layouts.
+    static float signal[SIGNAL_FRAMES * FRAME_SIZE];
+    srand(1);
+    for (size_t i = 0; i < sizeof(signal) / sizeof(signal[0]); i++) signal[i] = (float)(rand() % 16384 - 8192);
+
+    printf("denoiser: %zu bytes (buffers and RNNoise state, cache-line aligned)\n", denoise_core_size());
+    printf("%8s  %-6s  %12s  %10s  %12s\n", "streams", "layout", "RSS/stream", "RSS MiB", "frames/s");
+    for (int c = 0; c < count_n; c++) {
+        if (counts[c] < 1) continue;
+        for (int layout = 0; layout < 2; layout++) {
+            if (!(layouts & (1 << layout))) continue;
+            Measurement m;
+            if (!measure_in_child(layout, counts[c], frames, signal, &m)) {
+                fprintf(stderr, "%d streams (%s): out of memory\n", counts[c], layout ? "arena" : "malloc");
+                return 1;
+            }
+            printf("%8d  %-6s  %12.0f  %10.1f  %12.0f\n", counts[c], layout ? "arena" : "malloc",
+                   m.rss_bytes / counts[c], m.rss_bytes / (1 << 20), m.frames_per_second);
+        }
+    }
+    return 0;
+}
@@ -24,8 +24,16 @@
 #define MINIAUDIO_IMPLEMENTATION
 #include "miniaudio.h"
 
-#include "rnnoise/include/rnnoise.h"
+#include "device_list.h"
+#include "param_rcu.h"
+#include "rnnoise_probes.h"
+#include "rt_audit.h"
+#include "rt_trace.h"
 
+#include "denoise_core.h"
+
+#include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -36,14 +44,16 @@
 
 #define SAMPLE_RATE 48000            // Sampling rate (48kHz).
 #define RNNOISE_FRAME_SIZE 480       // RNNoise frame size (480 samples for 48kHz).
+#define WARM_UP_FRAMES 50            // Synthetic frames run through the model at launch.
+#define VU_POLL_MS 50                // VU meter refresh period.
+#define TRACE_POLL_MS 200            // How often the UI writes a requested trace dump.
 
 /**
- * Biquad filter structure.
+ * Parameters read by the audio thread, published as snapshots (see param_rcu.h).
  */
 typedef struct {
-    float b0, b1, b2, a1, a2;  // Filter coefficients.
-    float x1, x2, y1, y2;      // Filter state variables.
-} BiquadFilter;
+    gboolean denoise;          // FALSE bypasses the denoiser.
+} DenoiserParams;
 
 /**
  * Application state structure containing all UI elements and audio processing state.
@@ -60,46 +70,58 @@ typedef struct {
     GtkWidget *input_combo;
     GtkWidget *output_combo;
 
-    // Audio context and devices.
-    ma_context context;
+    // Audio devices, listed in the background.
+    DeviceList *devices;
     ma_device device;
-    ma_device_info *input_devices;
-    ma_device_info *output_devices;
-    ma_uint32 input_device_count;
-    ma_uint32 output_device_count;
+
+    // Devices are opened on a worker thread, which waits for the miniaudio
+    // context and runs ma_device_init(); either can take seconds.
+    GThread *opener;                 // Set while the devices are being opened.
+    ma_device_id open_input_id;      // The selection being opened.
+    ma_device_id open_output_id;
+    const char *open_error;          // Written by the opener, NULL on success.
+    gboolean start_pending;          // Start was clicked while opening.
+    gboolean reopen;                 // The selection changed while opening.
 
     // Audio processing.
-    BiquadFilter bandpass_filter1;
-    BiquadFilter bandpass_filter2;
+    DenoiseCore *denoiser;
+    ParamRcu *params;                // Published DenoiserParams.
+    DenoiserParams ui_params;        // The UI's copy, published on every change.
+
+    // The pipeline is prepared at launch: the device runs and the denoiser
+    // keeps up with the input, but the output stays silent until Start sets
+    // live. Start then has nothing to open, allocate or warm up.
+    atomic_int live;
+    atomic_llong first_audio_us;     // When the callback first played audio after Start.
+    gint64 start_us;                 // When Start was clicked.
+    guint first_audio_timer;
+
+    // The callback stores the input level; the UI polls it, so the audio
+    // thread never allocates or queues main loop sources.
+    _Atomic float vu_level;
+    guint vu_timer;
+
+    // Gap check for dropouts: a callback much later than the previous
+    // period's length means the device ran dry (see rt_trace.h).
+    long long last_callback_ns;      // Audio thread only; 0 after the device (re)starts.
+    long long last_period_ns;
 
-    DenoiseState *rnnoise_state;
-    
     // State flags.
     gboolean is_processing;
-    gboolean filter_enabled;
     gboolean device_initialized;
+    gboolean devices_changed;        // Selection changed while processing.
 } AppState;
 
 /**
- * Structure for VU meter update data.
- */
-typedef struct {
-    GtkWidget* vu;   // VU meter widget.
-    float vol;       // Current volume level.
-} VuUpdateData;
-
-/**
- * Updates the VU meter widget.
- * @param user_data Pointer to VuUpdateData containing VU widget and volume level.
- * @return FALSE to remove the idle callback.
+ * Shows the input level the audio callback last stored.
+ * @param data Pointer to application state.
+ * @return TRUE to keep polling.
  */
-static gboolean update_vu_meter(gpointer user_data) {
-    VuUpdateData* data = (VuUpdateData*)user_data;
-    if (data->vu) {
-        gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(data->vu), data->vol);
-    }
-    g_free(data);
-    return FALSE;
+static gboolean update_vu_meter(gpointer data) {
+    AppState *state = (AppState*)data;
+    float level = atomic_load_explicit(&state->vu_level, memory_order_relaxed);
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(state->vu_meter), level);
+    return TRUE;
 }
 
 /**
@@ -117,55 +139,6 @@ static float calculate_rms_volume(const int16_t* samples, size_t frameCount) {
     return (float)(sqrt(mean) / 32768.0);  // Normalize to 0.0–1.0.
 }
 
-/**
- * Initializes a bandpass biquad filter.
- * @param f Pointer to BiquadFilter structure.
- * @param fs Sampling frequency.
- * @param f0 Center frequency.
- * @param Q Quality factor.
- */
-static void biquad_init_bandpass(BiquadFilter* f, float fs, float f0, float Q) {
-    float w0 = 2.0f * M_PI * f0 / fs;
-    float alpha = sinf(w0) / (2.0f * Q);
-    float cos_w0 = cosf(w0);
-
-    f->b0 = alpha;
-    f->b1 = 0.0f;
-    f->b2 = -alpha;
-    f->a1 = -2.0f * cos_w0;
-    f->a2 = 1.0f - alpha;
-
-    // Normalize coefficients.
-    float a0 = 1.0f + alpha;
-    f->b0 /= a0;
-    f->b1 /= a0;
-    f->b2 /= a0;
-    f->a1 /= a0;
-    f->a2 /= a0;
-
-    // Initialize state variables.
-    f->x1 = f->x2 = f->y1 = f->y2 = 0.0f;
-}
-
-/**
- * Processes a single sample through a biquad filter.
- * @param f Pointer to BiquadFilter structure.
- * @param in Input sample.
- * @return Filtered output sample.
- */
-static float biquad_process(BiquadFilter* f, float in) {
-    float out = f->b0 * in + f->b1 * f->x1 + f->b2 * f->x2
-                - f->a1 * f->y1 - f->a2 * f->y2;
-
-    // Update state variables.
-    f->x2 = f->x1;
-    f->x1 = in;
-    f->y2 = f->y1;
-    f->y1 = out;
-
-    return out;
-}
-
 /**
  * Audio duplex callback for simultaneous capture and playback.
  * @param pDevice Pointer to miniaudio device.
@@ -175,109 +148,124 @@ static float biquad_process(BiquadFilter* f, float in) {
  */
 static void duplex_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
     AppState *state = (AppState*)pDevice->pUserData;
+    RT_AUDIT_ENTER();
+    RNNOISE_PROBE1(callback_start, frameCount);
 
-    if (!state || !state->is_processing || !pInput || !pOutput) {
+    if (!state || !state->denoiser || !pInput || !pOutput) {
         memset(pOutput, 0, frameCount * 2 * sizeof(int16_t));
+        RNNOISE_PROBE1(callback_done, frameCount);
+        RT_AUDIT_LEAVE();
         return;
     }
+    long long now = rt_trace_now_ns();
+    if (state->last_callback_ns == 0) {
+        rt_trace_thread_name("audio");
+    } else if (now - state->last_callback_ns > 2 * state->last_period_ns + 2000000) {
+        // Late by more than a period: the device most likely under- or overran.
+        rt_trace_instant("xrun", (now - state->last_callback_ns) / 1000);
+        RNNOISE_PROBE2(underrun, 0, (now - state->last_callback_ns) / 1000);
+        rt_trace_request_dump("xrun");
+    }
+    state->last_callback_ns = now;
+    state->last_period_ns = (long long)frameCount * 1000000000LL / SAMPLE_RATE;
+    rt_trace_begin("callback");
+    int live = atomic_load_explicit(&state->live, memory_order_acquire);
+    const DenoiserParams *params = param_rcu_read(state->params);
 
     const int16_t *in = (const int16_t*)pInput;
     int16_t *out = (int16_t*)pOutput;
-    float float_buffer[RNNOISE_FRAME_SIZE];
-    float output_buffer[RNNOISE_FRAME_SIZE];
-    static bool first_frame = true;  // To skip the first frame.
+    int16_t mono[RNNOISE_FRAME_SIZE];
+    int16_t clean[RNNOISE_FRAME_SIZE];
+    float energy = 0.0f;
 
-    // Process in blocks of RNNOISE_FRAME_SIZE.
+    // Any period size works: denoise_core re-blocks the audio into RNNoise frames.
     for (ma_uint32 i = 0; i < frameCount; i += RNNOISE_FRAME_SIZE) {
-        //printf("Frame count: %d, frame number: %d\n", frameCount, i);
         ma_uint32 remaining = frameCount - i;
-        ma_uint32 to_process = (remaining > RNNOISE_FRAME_SIZE) ? RNNOISE_FRAME_SIZE : remaining;
+        ma_uint32 count = (remaining > RNNOISE_FRAME_SIZE) ? RNNOISE_FRAME_SIZE : remaining;
 
-        // Mix stereo to mono and convert to float.
-        for (ma_uint32 j = 0; j < to_process; j++) {
+        // Mix stereo to mono.
+        for (ma_uint32 j = 0; j < count; j++) {
             int32_t l = in[(i + j) * 2];
             int32_t r = in[(i + j) * 2 + 1];
-            float_buffer[j] = (float)(l + r / 2);  // Convert the average to float.
-        }
-
-        // Fill the remaining frame with zeros if necessary..
-        for (ma_uint32 j = to_process; j < RNNOISE_FRAME_SIZE; j++) {
-            float_buffer[j] = 0.0f;
-        }
-
-        // Calculate volumeRNNOISE_FRAME_SIZE for VU meter before any early return.
-        float volume = 0.0f;
-        for (ma_uint32 j = 0; j < to_process; j++) {
-            volume += float_buffer[j] * float_buffer[j];
-        }
-        volume = sqrtf(volume / to_process) / 32768.0f;
-
-        if (state->filter_enabled) {
-            // RNNoise processing.
-            for (ma_uint32 k = 0; k < RNNOISE_FRAME_SIZE; k++) {
-                output_buffer[k] = 0.0f;
-            }
-            rnnoise_process_frame(state->rnnoise_state, output_buffer, float_buffer);
-            //memcpy(output_buffer, float_buffer, RNNOISE_FRAME_SIZE * sizeof(float));
-
-            // Skip the first frame (RNNoise warm-up).
-            if (first_frame) {
-                first_frame = false;
-                continue;
-            }
-
-            // Convert back to int16_t and expand to stereo.
-            for (ma_uint32 j = 0; j < to_process; j++) {
-                float sample = output_buffer[j];
-                // Careful clipping.
-                if (sample > 32767.0f) sample = 32767.0f;
-                if (sample < -32768.0f) sample = -32768.0f;
-
-                int16_t sample_int = (int16_t)sample;
-                out[(i + j) * 2] = sample_int;
-                out[(i + j) * 2 + 1] = sample_int;
-            }
-        } else {
-            // Bypass if the filter is disabled: copy input to output.
-            for (ma_uint32 j = 0; j < to_process; j++) {
-                int32_t l = in[(i + j) * 2];
-                int32_t r = in[(i + j) * 2 + 1];
-                int16_t sample = (int16_t)((l + r) / 2);
-                out[(i + j) * 2] = sample;
-                out[(i + j) * 2 + 1] = sample;
-            }
+            mono[j] = (int16_t)((l + r) / 2);
+            energy += (float)mono[j] * mono[j];
         }
 
-        // Update the VU meter with the last processed block.
-        VuUpdateData* vu_data = g_malloc(sizeof(VuUpdateData));
-        if (vu_data) {
-            vu_data->vu = state->vu_meter;
-            vu_data->vol = volume;
-            g_idle_add_full(G_PRIORITY_DEFAULT, update_vu_meter, vu_data, NULL);
+        // The denoiser is fed even when bypassed or paused, so enabling it
+        // again neither plays back stale audio nor starts from a cold state.
+        rt_trace_begin("denoise");
+        denoise_core_process_s16(state->denoiser, mono, clean, count);
+        rt_trace_end("denoise");
+        const int16_t *src = params->denoise ? clean : mono;
+
+        // Expand to stereo.
+        for (ma_uint32 j = 0; j < count; j++) {
+            int16_t v = live ? src[j] : 0;
+            out[(i + j) * 2] = v;
+            out[(i + j) * 2 + 1] = v;
         }
     }
+    if (!live) {
+        rt_trace_end("callback");
+        RNNOISE_PROBE1(callback_done, frameCount);
+        RT_AUDIT_LEAVE();
+        return;
+    }
+    if (atomic_load_explicit(&state->first_audio_us, memory_order_relaxed) == 0) {
+        atomic_store_explicit(&state->first_audio_us, g_get_monotonic_time(), memory_order_relaxed);
+    }
+
+    // Input level of this period, shown by update_vu_meter().
+    float level = frameCount > 0 ? sqrtf(energy / frameCount) / 32768.0f : 0.0f;
+    atomic_store_explicit(&state->vu_level, level, memory_order_relaxed);
+    rt_trace_counter("input level", 0, (long long)(level * 1000.0f));
+    rt_trace_end("callback");
+    RNNOISE_PROBE1(callback_done, frameCount);
+    RT_AUDIT_LEAVE();
 }
 
 /**
- * Starts audio processing.
- * @param state Pointer to application state.
+ * Records device events (stops, reroutes, interruptions) in the trace.
+ * @param notification Notification from miniaudio, on one of its threads.
  */
-static void start_processing(AppState *state) {
-    GtkComboBoxText *input_cb = GTK_COMBO_BOX_TEXT(state->input_combo);
-    GtkComboBoxText *output_cb = GTK_COMBO_BOX_TEXT(state->output_combo);
-
-    int input_index = gtk_combo_box_get_active(GTK_COMBO_BOX(input_cb));
-    int output_index = gtk_combo_box_get_active(GTK_COMBO_BOX(output_cb));
+static void on_device_notification(const ma_device_notification *notification) {
+    static const char *names[] = {"device started", "device stopped", "device rerouted",
+                                  "interruption began", "interruption ended", "device unlocked"};
+    unsigned type = (unsigned)notification->type;
+    rt_trace_instant(type < sizeof(names) / sizeof(names[0]) ? names[type] : "device event", type);
+}
 
-    if (input_index < 0 || output_index < 0) {
-        gtk_label_set_text(GTK_LABEL(state->status_label), "Select input/output devices");
-        return;
+/**
+ * Writes a trace dump asked for by the audio thread (xrun) or SIGUSR2.
+ * @param data Pointer to application state.
+ * @return TRUE to keep polling.
+ */
+static gboolean poll_trace(gpointer data) {
+    AppState *state = (AppState*)data;
+    char path[4096];
+    if (rt_trace_dump_pending(path, sizeof(path))) {
+        fprintf(stderr, "Trace written to %s\n", path);
+        if (!state->is_processing) gtk_label_set_text(GTK_LABEL(state->status_label), "Trace written");
     }
+    return TRUE;
+}
 
-    state->rnnoise_state = rnnoise_create(NULL);
-    if (!state->rnnoise_state) {
-        gtk_label_set_text(GTK_LABEL(state->status_label), "Failed to init RNNoise");
-        return;
+static gboolean devices_opened(gpointer data);
+
+/**
+ * Opens the selected devices and starts them with the output muted. Runs on
+ * the opener thread and touches nothing but the device and open_error.
+ * @param data Pointer to application state.
+ * @return NULL.
+ */
+static gpointer open_devices_thread(gpointer data) {
+    AppState *state = (AppState*)data;
+    state->open_error = NULL;
+    ma_context *context = device_list_context(state->devices);
+    if (!context) {
+        state->open_error = "No audio backend";
+        g_idle_add(devices_opened, state);
+        return NULL;
     }
 
     ma_device_config config = ma_device_config_init(ma_device_type_duplex);
@@ -289,55 +277,220 @@ static void start_processing(AppState *state) {
     config.periodSizeInFrames = 480;
     config.periods = 4;
     config.dataCallback = duplex_callback;
+    config.notificationCallback = on_device_notification;
     config.pUserData = state;
+    config.capture.pDeviceID = &state->open_input_id;
+    config.playback.pDeviceID = &state->open_output_id;
 
-    config.capture.pDeviceID = &state->input_devices[input_index].id;
-    config.playback.pDeviceID = &state->output_devices[output_index].id;
+    state->last_callback_ns = 0;   // The audio thread is not running yet.
+    if (ma_device_init(context, &config, &state->device) != MA_SUCCESS) {
+        state->open_error = "Failed to init device";
+    } else if (ma_device_start(&state->device) != MA_SUCCESS) {
+        ma_device_uninit(&state->device);
+        state->open_error = "Failed to start device";
+    }
+    g_idle_add(devices_opened, state);
+    return NULL;
+}
 
-    if (ma_device_init(&state->context, &config, &state->device) != MA_SUCCESS) {
-        gtk_label_set_text(GTK_LABEL(state->status_label), "Failed to init device");
-        rnnoise_destroy(state->rnnoise_state);
-        return;
+/**
+ * Starts opening the selected devices in the background.
+ * @param state Pointer to application state.
+ * @return TRUE if the devices are open or being opened.
+ */
+static gboolean prepare_pipeline(AppState *state) {
+    if (state->device_initialized || state->opener) return TRUE;
+
+    if (!state->denoiser) {
+        state->denoiser = denoise_core_create(NULL);
+        if (!state->denoiser) {
+            gtk_label_set_text(GTK_LABEL(state->status_label), "Failed to init RNNoise");
+            return FALSE;
+        }
+        denoise_core_warm_up(state->denoiser, WARM_UP_FRAMES);
+    }
+
+    if (!device_list_selected(state->devices, FALSE, &state->open_input_id) ||
+        !device_list_selected(state->devices, TRUE, &state->open_output_id)) {
+        gtk_label_set_text(GTK_LABEL(state->status_label), "Looking for devices...");
+        return FALSE;
     }
 
-    state->device_initialized = TRUE;
+    gtk_label_set_text(GTK_LABEL(state->status_label), "Opening devices...");
+    state->opener = g_thread_new("open-devices", open_devices_thread, state);
+    return TRUE;
+}
+
+/**
+ * Waits for the opener thread and takes over the devices it opened.
+ * @param state Pointer to application state.
+ */
+static void finish_open(AppState *state) {
+    g_thread_join(state->opener);
+    state->opener = NULL;
+    state->device_initialized = state->open_error == NULL;
+}
 
-    if (ma_device_start(&state->device) != MA_SUCCESS) {
-        gtk_label_set_text(GTK_LABEL(state->status_label), "Failed to start device");
+/**
+ * Closes the devices. The denoiser is kept, reset so no audio carries over.
+ * @param state Pointer to application state.
+ */
+static void release_pipeline(AppState *state) {
+    if (state->device_initialized) {
         ma_device_uninit(&state->device);
-        rnnoise_destroy(state->rnnoise_state);
-        return;
+        state->device_initialized = FALSE;
     }
+    // No reader any more: free every replaced snapshot.
+    param_rcu_offline(state->params);
+    if (state->denoiser) denoise_core_reset(state->denoiser);
+}
+
+/**
+ * Shows how long Start took to produce audio, once the callback has played some.
+ * @param data Pointer to application state.
+ * @return TRUE to keep polling.
+ */
+static gboolean show_first_audio(gpointer data) {
+    AppState *state = (AppState*)data;
+    long long first = atomic_load_explicit(&state->first_audio_us, memory_order_relaxed);
+    if (first == 0) return TRUE;
+
+    char text[64];
+    snprintf(text, sizeof(text), "Processing (audio after %.1f ms)", (first - state->start_us) / 1000.0);
+    gtk_label_set_text(GTK_LABEL(state->status_label), text);
+    state->first_audio_timer = 0;
+    return FALSE;
+}
+
+/**
+ * Unmutes the prepared pipeline.
+ * @param state Pointer to application state.
+ */
+static void go_live(AppState *state) {
+    state->start_us = g_get_monotonic_time();
+    atomic_store_explicit(&state->first_audio_us, 0, memory_order_relaxed);
+    atomic_store_explicit(&state->live, 1, memory_order_release);
+    rt_trace_instant("start", 0);
 
     state->is_processing = TRUE;
+    device_list_remember(state->devices);
     gtk_label_set_text(GTK_LABEL(state->status_label), "Processing...");
     gtk_widget_set_sensitive(state->start_button, FALSE);
     gtk_widget_set_sensitive(state->stop_button, TRUE);
+    state->first_audio_timer = g_timeout_add(5, show_first_audio, state);
+    state->vu_timer = g_timeout_add(VU_POLL_MS, update_vu_meter, state);
+}
+
+/**
+ * Starts audio processing, once the devices are open.
+ * @param state Pointer to application state.
+ */
+static void start_processing(AppState *state) {
+    GtkComboBoxText *input_cb = GTK_COMBO_BOX_TEXT(state->input_combo);
+    GtkComboBoxText *output_cb = GTK_COMBO_BOX_TEXT(state->output_combo);
+
+    int input_index = gtk_combo_box_get_active(GTK_COMBO_BOX(input_cb));
+    int output_index = gtk_combo_box_get_active(GTK_COMBO_BOX(output_cb));
+
+    if (input_index < 0 || output_index < 0) {
+        gtk_label_set_text(GTK_LABEL(state->status_label), "Select input/output devices");
+        return;
+    }
+
+    if (state->device_initialized) {
+        go_live(state);
+        return;
+    }
+    // Normally opened at launch or when the selection changed.
+    state->start_pending = prepare_pipeline(state);
+}
+
+/**
+ * Takes over the devices once the opener is done, back on the main thread.
+ * @param data Pointer to application state.
+ * @return FALSE to remove the idle callback.
+ */
+static gboolean devices_opened(gpointer data) {
+    AppState *state = (AppState*)data;
+    if (!state->opener) return FALSE;   // Already collected by on_window_destroy.
+    finish_open(state);
+    gboolean start = state->start_pending;
+    state->start_pending = FALSE;
+    if (state->reopen) {
+        // Open the new selection instead.
+        state->reopen = FALSE;
+        release_pipeline(state);
+        state->start_pending = prepare_pipeline(state) && start;
+    } else if (state->open_error) {
+        gtk_label_set_text(GTK_LABEL(state->status_label), state->open_error);
+    } else if (start) {
+        go_live(state);
+    } else {
+        gtk_label_set_text(GTK_LABEL(state->status_label), "Ready: click Start");
+    }
+    return FALSE;
 }
 
 /**
- * Stops audio processing.
+ * Stops audio processing: mutes the output, leaving the pipeline prepared.
  * @param state Pointer to application state.
  */
 static void stop_processing(AppState *state) {
     if (state->is_processing) {
-        if (state->device_initialized) {
-            ma_device_uninit(&state->device);
-            state->device_initialized = FALSE;
+        atomic_store_explicit(&state->live, 0, memory_order_release);
+        rt_trace_instant("stop", 0);
+        if (state->first_audio_timer) {
+            g_source_remove(state->first_audio_timer);
+            state->first_audio_timer = 0;
         }
-        
-        if (state->rnnoise_state) {
-            rnnoise_destroy(state->rnnoise_state);
-            state->rnnoise_state = NULL;
+        if (state->vu_timer) {
+            g_source_remove(state->vu_timer);
+            state->vu_timer = 0;
         }
 
         state->is_processing = FALSE;
         gtk_label_set_text(GTK_LABEL(state->status_label), "Stopped");
         gtk_widget_set_sensitive(state->start_button, TRUE);
         gtk_widget_set_sensitive(state->stop_button, FALSE);
+
+        if (state->devices_changed) {
+            state->devices_changed = FALSE;
+            release_pipeline(state);
+            prepare_pipeline(state);
+        }
     }
 }
 
+/**
+ * Callback for a device combo: prepares the pipeline on the new selection.
+ * @param widget Combo box widget.
+ * @param data Pointer to application state.
+ */
+static void on_device_changed(GtkWidget *widget, gpointer data) {
+    AppState *state = (AppState*)data;
+    if (state->is_processing) {
+        state->devices_changed = TRUE;
+        return;
+    }
+    if (state->opener) {
+        state->reopen = TRUE;
+        return;
+    }
+    release_pipeline(state);
+    prepare_pipeline(state);
+}
+
+/**
+ * Prepares the pipeline once the window is up.
+ * @param data Pointer to application state.
+ * @return FALSE to remove the idle callback.
+ */
+static gboolean prepare_at_launch(gpointer data) {
+    AppState *state = (AppState*)data;
+    prepare_pipeline(state);
+    return FALSE;
+}
+
 /**
  * Callback for start button click.
  * @param widget Button widget.
@@ -365,12 +518,10 @@ static void on_stop(GtkWidget *widget, gpointer data) {
  */
 static void on_filter_toggle(GtkWidget *widget, gpointer data) {
     AppState *state = (AppState*)data;
-    state->filter_enabled = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget));
-    
-    // Reinitialize filters when toggled to avoid artifacts.
-    if (state->filter_enabled) {
-        biquad_init_bandpass(&state->bandpass_filter1, (float)SAMPLE_RATE, 500.0f, 2.0f);
-        biquad_init_bandpass(&state->bandpass_filter2, (float)SAMPLE_RATE, 2000.0f, 2.0f);
+    state->ui_params.denoise = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget));
+    rt_trace_instant("denoise toggled", state->ui_params.denoise);
+    if (!param_rcu_publish(state->params, &state->ui_params)) {
+        fprintf(stderr, "Out of memory publishing parameters\n");
     }
 }
 
@@ -382,55 +533,15 @@ static void on_filter_toggle(GtkWidget *widget, gpointer data) {
 static void on_window_destroy(GtkWidget *widget, gpointer data) {
     AppState *state = (AppState*)data;
     stop_processing(state);
-    ma_context_uninit(&state->context);
+    if (state->opener) finish_open(state);
+    release_pipeline(state);
+    denoise_core_destroy(state->denoiser);
+    state->denoiser = NULL;
+    device_list_free(state->devices);
+    param_rcu_destroy(state->params);
     gtk_main_quit();
 }
 
-/**
- * Populates device lists in the UI.
- * @param state Pointer to application state.
- */
-static void populate_device_lists(AppState *state) {
-    if (ma_context_init(NULL, 0, NULL, &state->context) != MA_SUCCESS) {
-        fprintf(stderr, "Failed to initialize context\n");
-        return;
-    }
-
-    ma_device_info *capture_devices = NULL;
-    ma_device_info *playback_devices = NULL;
-    ma_uint32 captureCount, playbackCount;
-
-    if (ma_context_get_devices(&state->context, &playback_devices, &playbackCount, &capture_devices, &captureCount) != MA_SUCCESS) {
-        fprintf(stderr, "Failed to enumerate devices\n");
-        return;
-    }
-
-    state->input_devices = capture_devices;
-    state->output_devices = playback_devices;
-    state->input_device_count = captureCount;
-    state->output_device_count = playbackCount;
-
-    // Clear old devices.
-    gtk_combo_box_text_remove_all(GTK_COMBO_BOX_TEXT(state->input_combo));
-    gtk_combo_box_text_remove_all(GTK_COMBO_BOX_TEXT(state->output_combo));
-
-    // Add input devices.
-    for (ma_uint32 i = 0; i < captureCount; ++i) {
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(state->input_combo), capture_devices[i].name);
-    }
-    if (captureCount > 0) {
-        gtk_combo_box_set_active(GTK_COMBO_BOX(state->input_combo), 0);
-    }
-
-    // Add output devices.
-    for (ma_uint32 i = 0; i < playbackCount; ++i) {
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(state->output_combo), playback_devices[i].name);
-    }
-    if (playbackCount > 0) {
-        gtk_combo_box_set_active(GTK_COMBO_BOX(state->output_combo), 0);
-    }
-}
-
 /**
  * Main function.
  * @param argc Argument count.
@@ -442,6 +553,13 @@ int main(int argc, char *argv[]) {
 
     AppState state = {0};
 
+    state.ui_params.denoise = TRUE;
+    state.params = param_rcu_create(&state.ui_params, sizeof(DenoiserParams));
+    if (!state.params) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
     state.window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
     gtk_window_set_title(GTK_WINDOW(state.window), "Noise Reduction");
     gtk_window_set_default_size(GTK_WINDOW(state.window), 400, 250);
@@ -484,7 +602,6 @@ int main(int argc, char *argv[]) {
 
     state.filter_toggle = gtk_toggle_button_new_with_label("Filter");
     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(state.filter_toggle), TRUE);
-    state.filter_enabled = TRUE;
     g_signal_connect(state.filter_toggle, "toggled", G_CALLBACK(on_filter_toggle), &state);
     gtk_box_pack_start(GTK_BOX(button_box), state.filter_toggle, FALSE, FALSE, 0);
 
@@ -499,10 +616,20 @@ int main(int argc, char *argv[]) {
     state.status_label = gtk_label_new("Select devices and click Start");
     gtk_box_pack_start(GTK_BOX(vbox), state.status_label, FALSE, FALSE, 0);
 
-    // Initialize devices and show window.
-    populate_device_lists(&state);
+    // List devices in the background, so the window shows at once.
+    state.devices = device_list_new("audio_denoiser", state.input_combo, state.output_combo);
+    g_signal_connect(state.input_combo, "changed", G_CALLBACK(on_device_changed), &state);
+    g_signal_connect(state.output_combo, "changed", G_CALLBACK(on_device_changed), &state);
     gtk_widget_show_all(state.window);
 
+    // Open the devices and warm up the model before the first Start.
+    g_idle_add(prepare_at_launch, &state);
+
+    // Trace dumps: on a dropout, or on demand with SIGUSR2.
+    rt_trace_thread_name("ui");
+    rt_trace_dump_on_signal(SIGUSR2);
+    g_timeout_add(TRACE_POLL_MS, poll_trace, &state);
+
     gtk_main();
 
     return 0;
@@ -24,6 +24,12 @@
 #define MINIAUDIO_IMPLEMENTATION
 #include "miniaudio.h"
 
+#include "device_list.h"
+#include "param_rcu.h"
+#include "rnnoise_probes.h"
+#include "rt_audit.h"
+
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -33,14 +39,32 @@
 
 #define FRAME_SIZE 480
 #define SAMPLE_RATE 48000
+#define VU_POLL_MS 50       // VU meter refresh period.
 
 /**
- * Biquad filter structure.
+ * Biquad filter coefficients.
  */
 typedef struct {
-    float b0, b1, b2, a1, a2;  // Filter coefficients.
-    float x1, x2, y1, y2;      // Filter state variables.
-} BiquadFilter;
+    float b0, b1, b2, a1, a2;
+} BiquadCoeffs;
+
+/**
+ * Biquad filter state, owned by the audio thread.
+ */
+typedef struct {
+    float x1, x2, y1, y2;
+} BiquadState;
+
+/**
+ * Parameters read by the audio thread. The UI never changes a published
+ * copy: it edits ui_params and publishes it whole (see param_rcu.h).
+ */
+typedef struct {
+    gboolean filter_enabled;
+    BiquadCoeffs bandpass1;
+    BiquadCoeffs bandpass2;
+    float gain;                // Makeup gain after the band-pass filters.
+} FilterParams;
 
 /**
  * Application state structure containing all UI elements and audio processing state.
@@ -57,44 +81,37 @@ typedef struct {
     GtkWidget *input_combo;
     GtkWidget *output_combo;
 
-    // Audio context and devices.
-    ma_context context;
+    // Audio devices, listed in the background.
+    DeviceList *devices;
     ma_device device;
-    ma_device_info *input_devices;
-    ma_device_info *output_devices;
-    ma_uint32 input_device_count;
-    ma_uint32 output_device_count;
 
     // Audio processing.
-    BiquadFilter bandpass_filter1;
-    BiquadFilter bandpass_filter2;
+    ParamRcu *params;               // Published FilterParams.
+    FilterParams ui_params;         // The UI's copy, published on every change.
+    BiquadState bandpass_state1;    // Audio thread only.
+    BiquadState bandpass_state2;
+    gboolean filtering;             // Audio thread only: filter_enabled of the last block.
+
+    // The callback stores the output level; the UI polls it, so the audio
+    // thread never allocates or queues main loop sources.
+    _Atomic float vu_level;
+    guint vu_timer;
 
     // State flags.
     gboolean is_processing;
-    gboolean filter_enabled;
     gboolean device_initialized;
 } AppState;
 
 /**
- * Structure for VU meter update data.
- */
-typedef struct {
-    GtkWidget* vu;   // VU meter widget.
-    float vol;       // Current volume level.
-} VuUpdateData;
-
-/**
- * Updates the VU meter widget.
- * @param user_data Pointer to VuUpdateData containing VU widget and volume level.
- * @return FALSE to remove the idle callback.
+ * Shows the output level the audio callback last stored.
+ * @param data Pointer to application state.
+ * @return TRUE to keep polling.
  */
-static gboolean update_vu_meter(gpointer user_data) {
-    VuUpdateData* data = (VuUpdateData*)user_data;
-    if (data->vu) {
-        gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(data->vu), data->vol);
-    }
-    g_free(data);
-    return FALSE;
+static gboolean update_vu_meter(gpointer data) {
+    AppState *state = (AppState*)data;
+    float level = atomic_load_explicit(&state->vu_level, memory_order_relaxed);
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(state->vu_meter), level);
+    return TRUE;
 }
 
 /**
@@ -113,13 +130,13 @@ static float calculate_rms_volume(const int16_t* samples, size_t frameCount) {
 }
 
 /**
- * Initializes a bandpass biquad filter.
- * @param f Pointer to BiquadFilter structure.
+ * Computes bandpass biquad filter coefficients.
+ * @param f Pointer to BiquadCoeffs structure.
  * @param fs Sampling frequency.
  * @param f0 Center frequency.
  * @param Q Quality factor.
  */
-static void biquad_init_bandpass(BiquadFilter* f, float fs, float f0, float Q) {
+static void biquad_init_bandpass(BiquadCoeffs* f, float fs, float f0, float Q) {
     float w0 = 2.0f * M_PI * f0 / fs;
     float alpha = sinf(w0) / (2.0f * Q);
     float cos_w0 = cosf(w0);
@@ -137,26 +154,24 @@ static void biquad_init_bandpass(BiquadFilter* f, float fs, float f0, float Q) {
     f->b2 /= a0;
     f->a1 /= a0;
     f->a2 /= a0;
-
-    // Initialize state variables.
-    f->x1 = f->x2 = f->y1 = f->y2 = 0.0f;
 }
 
 /**
  * Processes a single sample through a biquad filter.
- * @param f Pointer to BiquadFilter structure.
+ * @param f Pointer to the filter coefficients.
+ * @param st Pointer to the filter state.
  * @param in Input sample.
  * @return Filtered output sample.
  */
-static float biquad_process(BiquadFilter* f, float in) {
-    float out = f->b0 * in + f->b1 * f->x1 + f->b2 * f->x2
-                - f->a1 * f->y1 - f->a2 * f->y2;
+static float biquad_process(const BiquadCoeffs* f, BiquadState* st, float in) {
+    float out = f->b0 * in + f->b1 * st->x1 + f->b2 * st->x2
+                - f->a1 * st->y1 - f->a2 * st->y2;
 
     // Update state variables.
-    f->x2 = f->x1;
-    f->x1 = in;
-    f->y2 = f->y1;
-    f->y1 = out;
+    st->x2 = st->x1;
+    st->x1 = in;
+    st->y2 = st->y1;
+    st->y1 = out;
 
     return out;
 }
@@ -170,9 +185,13 @@ static float biquad_process(BiquadFilter* f, float in) {
  */
 static void duplex_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
     AppState *state = (AppState*)pDevice->pUserData;
+    RT_AUDIT_ENTER();
+    RNNOISE_PROBE1(callback_start, frameCount);
 
-    if (!state || !state->is_processing || !pInput || !pOutput) {
+    if (!state || !pInput || !pOutput) {
         memset(pOutput, 0, frameCount * 2 * sizeof(int16_t));
+        RNNOISE_PROBE1(callback_done, frameCount);
+        RT_AUDIT_LEAVE();
         return;
     }
 
@@ -181,16 +200,26 @@ static void duplex_callback(ma_device* pDevice, void* pOutput, const void* pInpu
 
     static int16_t mono_buffer[FRAME_SIZE];
 
+    // One consistent set of parameters for the whole block.
+    const FilterParams *params = param_rcu_read(state->params);
+
+    // Start from a clean filter state when the filter is switched on, to avoid artifacts.
+    if (params->filter_enabled && !state->filtering) {
+        memset(&state->bandpass_state1, 0, sizeof(BiquadState));
+        memset(&state->bandpass_state2, 0, sizeof(BiquadState));
+    }
+    state->filtering = params->filter_enabled;
+
     for (ma_uint32 i = 0; i < frameCount; i++) {
         int16_t left  = in[i * 2];
         int16_t right = in[i * 2 + 1];
         int16_t mono = (int16_t)(((int32_t)left + (int32_t)right) / 2);
 
-        if (state->filter_enabled) {
+        if (params->filter_enabled) {
             float sample = mono / 32768.0f;
-            sample = biquad_process(&state->bandpass_filter1, sample);
-            sample = biquad_process(&state->bandpass_filter2, sample);
-            sample *= 2.0f;
+            sample = biquad_process(&params->bandpass1, &state->bandpass_state1, sample);
+            sample = biquad_process(&params->bandpass2, &state->bandpass_state2, sample);
+            sample *= params->gain;
             sample = fmaxf(-1.0f, fminf(1.0f, sample));
             mono = (int16_t)(sample * 32767.0f);
         }
@@ -201,10 +230,9 @@ static void duplex_callback(ma_device* pDevice, void* pOutput, const void* pInpu
     }
 
     float volume = calculate_rms_volume(mono_buffer, frameCount);
-    VuUpdateData* vu_data = g_malloc(sizeof(VuUpdateData));
-    vu_data->vu = state->vu_meter;
-    vu_data->vol = volume;
-    g_idle_add_full(G_PRIORITY_DEFAULT, update_vu_meter, vu_data, NULL);
+    atomic_store_explicit(&state->vu_level, volume, memory_order_relaxed);
+    RNNOISE_PROBE1(callback_done, frameCount);
+    RT_AUDIT_LEAVE();
 }
 
 /**
@@ -232,10 +260,20 @@ static void start_processing(AppState *state) {
     config.dataCallback     = duplex_callback;
     config.pUserData        = state;
 
-    config.capture.pDeviceID  = &state->input_devices[input_index].id;
-    config.playback.pDeviceID = &state->output_devices[output_index].id;
+    ma_device_id input_id, output_id;
+    ma_context *context = device_list_context(state->devices);
+    if (!context || !device_list_selected(state->devices, FALSE, &input_id) ||
+        !device_list_selected(state->devices, TRUE, &output_id)) {
+        gtk_label_set_text(GTK_LABEL(state->status_label), "Devices not available yet");
+        return;
+    }
+    config.capture.pDeviceID  = &input_id;
+    config.playback.pDeviceID = &output_id;
+
+    // The audio thread is not running yet: its filter state can be reset here.
+    state->filtering = FALSE;
 
-    if (ma_device_init(&state->context, &config, &state->device) != MA_SUCCESS) {
+    if (ma_device_init(context, &config, &state->device) != MA_SUCCESS) {
         gtk_label_set_text(GTK_LABEL(state->status_label), "Failed to init device");
         return;
     }
@@ -249,14 +287,12 @@ static void start_processing(AppState *state) {
     }
 
     state->is_processing = TRUE;
-
-    // Initialize bandpass filters with lower Q for gentler filtering.
-    biquad_init_bandpass(&state->bandpass_filter1, (float)SAMPLE_RATE, 500.0f, 2.0f);
-    biquad_init_bandpass(&state->bandpass_filter2, (float)SAMPLE_RATE, 2000.0f, 2.0f);
+    device_list_remember(state->devices);
 
     gtk_label_set_text(GTK_LABEL(state->status_label), "Processing...");
     gtk_widget_set_sensitive(state->start_button, FALSE);
     gtk_widget_set_sensitive(state->stop_button, TRUE);
+    state->vu_timer = g_timeout_add(VU_POLL_MS, update_vu_meter, state);
 }
 
 /**
@@ -269,6 +305,12 @@ static void stop_processing(AppState *state) {
             ma_device_uninit(&state->device);
             state->device_initialized = FALSE;
         }
+        // No reader any more: free every replaced snapshot.
+        param_rcu_offline(state->params);
+        if (state->vu_timer) {
+            g_source_remove(state->vu_timer);
+            state->vu_timer = 0;
+        }
 
         state->is_processing = FALSE;
         gtk_label_set_text(GTK_LABEL(state->status_label), "Stopped");
@@ -304,12 +346,11 @@ static void on_stop(GtkWidget *widget, gpointer data) {
  */
 static void on_filter_toggle(GtkWidget *widget, gpointer data) {
     AppState *state = (AppState*)data;
-    state->filter_enabled = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget));
-    
-    // Reinitialize filters when toggled to avoid artifacts.
-    if (state->filter_enabled) {
-        biquad_init_bandpass(&state->bandpass_filter1, (float)SAMPLE_RATE, 500.0f, 2.0f);
-        biquad_init_bandpass(&state->bandpass_filter2, (float)SAMPLE_RATE, 2000.0f, 2.0f);
+    state->ui_params.filter_enabled = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget));
+
+    // The audio thread picks the new snapshot up at its next block.
+    if (!param_rcu_publish(state->params, &state->ui_params)) {
+        fprintf(stderr, "Out of memory publishing filter parameters\n");
     }
 }
 
@@ -321,55 +362,11 @@ static void on_filter_toggle(GtkWidget *widget, gpointer data) {
 static void on_window_destroy(GtkWidget *widget, gpointer data) {
     AppState *state = (AppState*)data;
     stop_processing(state);
-    ma_context_uninit(&state->context);
+    device_list_free(state->devices);
+    param_rcu_destroy(state->params);
     gtk_main_quit();
 }
 
-/**
- * Populates device lists in the UI.
- * @param state Pointer to application state.
- */
-static void populate_device_lists(AppState *state) {
-    if (ma_context_init(NULL, 0, NULL, &state->context) != MA_SUCCESS) {
-        fprintf(stderr, "Failed to initialize context\n");
-        return;
-    }
-
-    ma_device_info *capture_devices = NULL;
-    ma_device_info *playback_devices = NULL;
-    ma_uint32 captureCount, playbackCount;
-
-    if (ma_context_get_devices(&state->context, &playback_devices, &playbackCount, &capture_devices, &captureCount) != MA_SUCCESS) {
-        fprintf(stderr, "Failed to enumerate devices\n");
-        return;
-    }
-
-    state->input_devices = capture_devices;
-    state->output_devices = playback_devices;
-    state->input_device_count = captureCount;
-    state->output_device_count = playbackCount;
-
-    // Clear old devices.
-    gtk_combo_box_text_remove_all(GTK_COMBO_BOX_TEXT(state->input_combo));
-    gtk_combo_box_text_remove_all(GTK_COMBO_BOX_TEXT(state->output_combo));
-
-    // Add input devices.
-    for (ma_uint32 i = 0; i < captureCount; ++i) {
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(state->input_combo), capture_devices[i].name);
-    }
-    if (captureCount > 0) {
-        gtk_combo_box_set_active(GTK_COMBO_BOX(state->input_combo), 0);
-    }
-
-    // Add output devices.
-    for (ma_uint32 i = 0; i < playbackCount; ++i) {
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(state->output_combo), playback_devices[i].name);
-    }
-    if (playbackCount > 0) {
-        gtk_combo_box_set_active(GTK_COMBO_BOX(state->output_combo), 0);
-    }
-}
-
 /**
  * Main function.
  * @param argc Argument count.
@@ -381,6 +378,17 @@ int main(int argc, char *argv[]) {
 
     AppState state = {0};
 
+    // Band-pass filters with lower Q for gentler filtering.
+    state.ui_params.filter_enabled = TRUE;
+    biquad_init_bandpass(&state.ui_params.bandpass1, (float)SAMPLE_RATE, 500.0f, 2.0f);
+    biquad_init_bandpass(&state.ui_params.bandpass2, (float)SAMPLE_RATE, 2000.0f, 2.0f);
+    state.ui_params.gain = 2.0f;
+    state.params = param_rcu_create(&state.ui_params, sizeof(FilterParams));
+    if (!state.params) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
     state.window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
     gtk_window_set_title(GTK_WINDOW(state.window), "Noise Reduction");
     gtk_window_set_default_size(GTK_WINDOW(state.window), 400, 250);
@@ -423,7 +431,6 @@ int main(int argc, char *argv[]) {
 
     state.filter_toggle = gtk_toggle_button_new_with_label("Filter");
     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(state.filter_toggle), TRUE);
-    state.filter_enabled = TRUE;
     g_signal_connect(state.filter_toggle, "toggled", G_CALLBACK(on_filter_toggle), &state);
     gtk_box_pack_start(GTK_BOX(button_box), state.filter_toggle, FALSE, FALSE, 0);
 
@@ -438,8 +445,8 @@ int main(int argc, char *argv[]) {
     state.status_label = gtk_label_new("Select devices and click Start");
     gtk_box_pack_start(GTK_BOX(vbox), state.status_label, FALSE, FALSE, 0);
 
-    // Initialize devices and show window.
-    populate_device_lists(&state);
+    // List devices in the background, so the window shows at once.
+    state.devices = device_list_new("audio_filter", state.input_combo, state.output_combo);
     gtk_widget_show_all(state.window);
 
     gtk_main();
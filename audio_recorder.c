@@ -24,7 +24,12 @@
 #define MINIAUDIO_IMPLEMENTATION
 #include "miniaudio.h"
 
+#include "device_list.h"
+#include "traced_file.h"
+#include "rt_audit.h"
+
 #include <gtk/gtk.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -32,6 +37,7 @@
 #define MAX_SAMPLES (48000 * 300)  // Max: 5 minutes of mono audio at 48kHz.
 #define SAMPLE_RATE 48000
 #define CHANNELS 1
+#define LEVEL_POLL_MS 50           // Level meter refresh period.
 
 /**
  * WAV file header structure.
@@ -57,8 +63,10 @@ static size_t audio_buffer_pos = 0;
 static gboolean is_recording = FALSE;
 static gboolean is_paused = FALSE;
 
-static ma_context context;
+static DeviceList *devices;               // Devices, listed in the background.
 static ma_device device;
+static gboolean device_open = FALSE;
+static _Atomic float input_level;         // Stored by the audio callback, polled by the UI.
 
 GtkWidget *button_record, *button_pause, *button_stop, *button_save, *device_combo, *level_bar;
 
@@ -84,15 +92,13 @@ void create_wav_header(WavHeader *header, uint32_t data_size) {
 }
 
 /**
- * Updates the GTK level bar with the given audio level.
- * @param data Pointer to a double value representing the normalized RMS volume.
- * @return FALSE to remove the callback after execution.
+ * Updates the GTK level bar with the level the audio callback last stored.
+ * @param data Not used.
+ * @return TRUE to keep polling.
  */
 gboolean update_level_bar(gpointer data) {
-    double *level = (double *)data;
-    gtk_level_bar_set_value(GTK_LEVEL_BAR(level_bar), *level);
-    free(level);
-    return FALSE;
+    gtk_level_bar_set_value(GTK_LEVEL_BAR(level_bar), atomic_load_explicit(&input_level, memory_order_relaxed));
+    return TRUE;
 }
 
 /**
@@ -105,6 +111,7 @@ gboolean update_level_bar(gpointer data) {
  */
 void data_callback(ma_device *pDevice, void *pOutput, const void *pInput, ma_uint32 frameCount) {
     if (!is_recording || is_paused || pInput == NULL) return;
+    RT_AUDIT_ENTER();
 
     const int16_t *input = (const int16_t *)pInput;
     size_t samples_to_copy = frameCount * CHANNELS;
@@ -121,10 +128,34 @@ void data_callback(ma_device *pDevice, void *pOutput, const void *pInput, ma_uin
     }
     double rms = sqrt(sum / samples_to_copy) / 32768.0; // Normalize to [0,1]
 
-    // Update GTK LevelBar in main thread.
-    double *rms_ptr = malloc(sizeof(double));
-    *rms_ptr = rms;
-    g_idle_add(update_level_bar, rms_ptr);
+    // Picked up by update_level_bar() on the main thread.
+    atomic_store_explicit(&input_level, (float)rms, memory_order_relaxed);
+    RT_AUDIT_LEAVE();
+}
+
+/**
+ * Opens the selected capture device, or the default one if the device list is not ready.
+ * @return TRUE if the device is open.
+ */
+static gboolean open_device(void) {
+    if (device_open) return TRUE;
+    ma_context *context = device_list_context(devices);
+    if (!context) return FALSE;
+
+    ma_device_id id;
+    ma_device_config deviceConfig = ma_device_config_init(ma_device_type_capture);
+    deviceConfig.capture.format = ma_format_s16;
+    deviceConfig.capture.channels = CHANNELS;
+    deviceConfig.sampleRate = SAMPLE_RATE;
+    deviceConfig.dataCallback = data_callback;
+    deviceConfig.capture.pDeviceID = device_list_selected(devices, FALSE, &id) ? &id : NULL;
+
+    if (ma_device_init(context, &deviceConfig, &device) != MA_SUCCESS) {
+        fprintf(stderr, "Failed to init capture device\n");
+        return FALSE;
+    }
+    device_open = TRUE;
+    return TRUE;
 }
 
 /**
@@ -132,6 +163,8 @@ void data_callback(ma_device *pDevice, void *pOutput, const void *pInput, ma_uin
  */
 void on_record(GtkButton *btn, gpointer user_data) {
     if (!is_recording) {
+        if (!open_device()) return;
+        device_list_remember(devices);
         audio_buffer_pos = 0;
         is_paused = FALSE;
         is_recording = TRUE;
@@ -180,7 +213,7 @@ void on_save(GtkButton *btn, gpointer user_data) {
     if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
         char *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
 
-        FILE *f = fopen(filename, "wb");
+        FILE *f = traced_fopen(filename, "wb");
         if (!f) {
             GtkWidget *err = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
                                                     "Failed to open file for writing.");
@@ -195,7 +228,7 @@ void on_save(GtkButton *btn, gpointer user_data) {
         create_wav_header(&header, audio_buffer_pos * sizeof(int16_t));
         fwrite(&header, sizeof(WavHeader), 1, f);
         fwrite(audio_buffer, sizeof(int16_t), audio_buffer_pos, f);
-        fclose(f);
+        traced_fclose(f, filename);
 
         GtkWidget *msg = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_INFO, GTK_BUTTONS_OK,
                                                 "File saved successfully!");
@@ -212,32 +245,12 @@ void on_save(GtkButton *btn, gpointer user_data) {
  */
 void on_device_changed(GtkComboBox *combo, gpointer user_data) {
     if (is_recording) return;
-    ma_device_uninit(&device);
-
-    const char *device_name = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(combo));
-    if (!device_name) return;
-
-    ma_device_id new_id = {0};
-    ma_uint32 count;
-    ma_device_info *infos;
-    ma_context_get_devices(&context, NULL, NULL, &infos, &count);
-    for (ma_uint32 i = 0; i < count; i++) {
-        if (strcmp(infos[i].name, device_name) == 0) {
-            new_id = infos[i].id;
-            break;
-        }
-    }
-
-    ma_device_config deviceConfig = ma_device_config_init(ma_device_type_capture);
-    deviceConfig.capture.format = ma_format_s16;
-    deviceConfig.capture.channels = CHANNELS;
-    deviceConfig.sampleRate = SAMPLE_RATE;
-    deviceConfig.dataCallback = data_callback;
-    deviceConfig.capture.pDeviceID = &new_id;
-
-    if (ma_device_init(&context, &deviceConfig, &device) != MA_SUCCESS) {
-        fprintf(stderr, "Failed to init selected capture device\n");
+    if (device_open) {
+        ma_device_uninit(&device);
+        device_open = FALSE;
     }
+    if (gtk_combo_box_get_active(combo) < 0) return;
+    open_device();
 }
 
 /**
@@ -248,27 +261,6 @@ int main(int argc, char *argv[]) {
 
     audio_buffer = (int16_t *)malloc(sizeof(int16_t) * MAX_SAMPLES);
 
-    // Initialize miniaudio context.
-    ma_result result;
-    ma_context_config ctxConfig = ma_context_config_init();
-    result = ma_context_init(NULL, 0, &ctxConfig, &context);
-    if (result != MA_SUCCESS) {
-        fprintf(stderr, "Failed to init context\n");
-        return -1;
-    }
-
-    // Default device setup.
-    ma_device_config deviceConfig = ma_device_config_init(ma_device_type_capture);
-    deviceConfig.capture.format = ma_format_s16;
-    deviceConfig.capture.channels = CHANNELS;
-    deviceConfig.sampleRate = SAMPLE_RATE;
-    deviceConfig.dataCallback = data_callback;
-
-    if (ma_device_init(&context, &deviceConfig, &device) != MA_SUCCESS) {
-        fprintf(stderr, "Failed to init capture device\n");
-        return -2;
-    }
-
     // Create GTK window.
     GtkWidget *window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
     gtk_window_set_title(GTK_WINDOW(window), "Audio Recorder");
@@ -280,17 +272,11 @@ int main(int argc, char *argv[]) {
     gtk_container_set_border_width(GTK_CONTAINER(box), 10);
     gtk_container_add(GTK_CONTAINER(window), box);
 
-    // Device selector.
+    // Device selector, filled from the last run's devices until the worker
+    // thread has listed the current ones. The device is opened on first use.
     device_combo = gtk_combo_box_text_new();
     gtk_box_pack_start(GTK_BOX(box), device_combo, FALSE, FALSE, 2);
-
-    ma_uint32 capture_count;
-    ma_device_info *capture_infos;
-    ma_context_get_devices(&context, NULL, NULL, &capture_infos, &capture_count);
-    for (ma_uint32 i = 0; i < capture_count; i++) {
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(device_combo), capture_infos[i].name);
-    }
-    gtk_combo_box_set_active(GTK_COMBO_BOX(device_combo), 0);
+    devices = device_list_new("audio_recorder", device_combo, NULL);
     g_signal_connect(device_combo, "changed", G_CALLBACK(on_device_changed), NULL);
 
     // Button row.
@@ -320,13 +306,14 @@ int main(int argc, char *argv[]) {
     gtk_level_bar_set_min_value(GTK_LEVEL_BAR(level_bar), 0.0);
     gtk_level_bar_set_max_value(GTK_LEVEL_BAR(level_bar), 1.0);
     gtk_box_pack_start(GTK_BOX(box), level_bar, FALSE, FALSE, 2);
+    g_timeout_add(LEVEL_POLL_MS, update_level_bar, NULL);
     
     gtk_widget_show_all(window);
     gtk_main();
 
     // Cleanup.
-    ma_device_uninit(&device);
-    ma_context_uninit(&context);
+    if (device_open) ma_device_uninit(&device);
+    device_list_free(devices);
     free(audio_buffer);
     return 0;
 }
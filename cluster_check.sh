@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+# Runs denoise_cluster on localhost: a coordinator and two worker processes
+# denoise three copies of a file in chunks of 4 seconds, and each result is
+# compared with an rnnoise_batch run of the same file. Outputs must have the
+# same length and match exactly up to the first chunk boundary; after it,
+# RNNoise's rebuilt state may differ slightly from a single-process run.
+#
+# Usage: cluster_check.sh [input.wav] [port]   (default audio_02.wav, 48kHz mono; port 18730)
+
+INPUT=${1:-audio_02.wav}
+PORT=${2:-18730}
+DIR=$(mktemp -d)
+trap 'kill $COORD $WORKER1 $WORKER2 2>/dev/null; rm -rf "$DIR"' EXIT
+mkdir "$DIR/in" "$DIR/out" "$DIR/tmp1" "$DIR/tmp2"
+for name in a b c; do cp "$INPUT" "$DIR/in/$name.wav"; done
+
+./rnnoise_batch -i 0 "$INPUT" "$DIR/batch.wav" || exit 1
+
+./denoise_cluster -a 127.0.0.1 -p "$PORT" -c 4 -o "$DIR/out" "$DIR"/in/*.wav 2>"$DIR/coord.log" &
+COORD=$!
+sleep 1
+./denoise_cluster -W "127.0.0.1:$PORT" -j 1 -d "$DIR/tmp1" 2>"$DIR/worker1.log" &
+WORKER1=$!
+./denoise_cluster -W "127.0.0.1:$PORT" -j 1 -d "$DIR/tmp2" 2>"$DIR/worker2.log" &
+WORKER2=$!
+
+wait $COORD
+STATUS=$?
+wait $WORKER1 $WORKER2 2>/dev/null
+cat "$DIR/coord.log" "$DIR/worker1.log" "$DIR/worker2.log"
+if [ "$STATUS" -ne 0 ]; then
+    echo "cluster_check: FAILED: coordinator exited with status $STATUS"
+    exit 1
+fi
+
+# The header and the first chunk, 400 frames of 960 bytes.
+EXACT=$((44 + 400 * 960))
+for name in a b c; do
+    if [ "$(wc -c <"$DIR/out/$name.wav")" -ne "$(wc -c <"$DIR/batch.wav")" ]; then
+        echo "cluster_check: FAILED: $name.wav has a different length than the rnnoise_batch output"
+        exit 1
+    fi
+    if ! cmp -n "$EXACT" "$DIR/out/$name.wav" "$DIR/batch.wav"; then
+        echo "cluster_check: FAILED: $name.wav differs from the rnnoise_batch output in its first chunk"
+        exit 1
+    fi
+done
+echo "cluster_check: OK"
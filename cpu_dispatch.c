@@ -0,0 +1,334 @@
+/**
+ * @file
+ * @brief Run-time CPU dispatch for the hot kernels of the static build.
+ *
+ * Each kernel has a generic C version plus SSE2/AVX2/AVX-512 or NEON
+ * versions compiled with function target attributes, so the translation
+ * unit itself only needs the architecture baseline.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "cpu_dispatch.h"
+#include "rnnoise_probes.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#define CPU_NEON 1
+#include <arm_neon.h>
+#endif
+
+static const char *tier_names[CPU_TIER_COUNT] = {"generic", "sse2", "avx2", "avx512", "neon"};
+
+static const char *profile_names[CPU_PROFILE_COUNT] = {"fft960", "pitch_xcorr"};
+
+static CpuKernels kernels;
+static int kernels_ready = 0;
+
+int cpu_profiling = 0;
+static uint64_t profile_ns[CPU_PROFILE_COUNT];
+static uint64_t profile_calls[CPU_PROFILE_COUNT];
+
+/* Generic C kernels. */
+
+static void s16_to_float_c(const int16_t *in, float *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (float)in[i];
+    }
+}
+
+static void float_to_s16_c(const float *in, int16_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        float sample = in[i];
+        if (sample > 32767.0f) sample = 32767.0f;
+        if (sample < -32768.0f) sample = -32768.0f;
+        out[i] = (int16_t)sample;
+    }
+}
+
+#ifdef CPU_X86
+
+/* SSE2 kernels (4 samples per step). */
+
+__attribute__((target("sse2")))
+static void s16_to_float_sse2(const int16_t *in, float *out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(out + i, _mm_cvtepi32_ps(lo));
+        _mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(hi));
+    }
+    s16_to_float_c(in + i, out + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void float_to_s16_sse2(const float *in, int16_t *out, size_t n) {
+    const __m128 max = _mm_set1_ps(32767.0f);
+    const __m128 min = _mm_set1_ps(-32768.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 a = _mm_max_ps(_mm_min_ps(_mm_loadu_ps(in + i), max), min);
+        __m128 b = _mm_max_ps(_mm_min_ps(_mm_loadu_ps(in + i + 4), max), min);
+        __m128i packed = _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b));
+        _mm_storeu_si128((__m128i *)(out + i), packed);
+    }
+    float_to_s16_c(in + i, out + i, n - i);
+}
+
+/* AVX2 kernels (8 samples per step). */
+
+__attribute__((target("avx2")))
+static void s16_to_float_avx2(const int16_t *in, float *out, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(in + i + 8));
+        _mm256_storeu_ps(out + i, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(a)));
+        _mm256_storeu_ps(out + i + 8, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(b)));
+    }
+    s16_to_float_c(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void float_to_s16_avx2(const float *in, int16_t *out, size_t n) {
+    const __m256 max = _mm256_set1_ps(32767.0f);
+    const __m256 min = _mm256_set1_ps(-32768.0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 a = _mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(in + i), max), min);
+        __m256 b = _mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(in + i + 8), max), min);
+        __m256i packed = _mm256_packs_epi32(_mm256_cvttps_epi32(a), _mm256_cvttps_epi32(b));
+        // packs works per 128-bit lane; restore sample order.
+        packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *)(out + i), packed);
+    }
+    float_to_s16_c(in + i, out + i, n - i);
+}
+
+/* AVX-512 kernels (16 samples per step). */
+
+__attribute__((target("avx512f")))
+static void s16_to_float_avx512(const int16_t *in, float *out, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(in + i));
+        _mm512_storeu_ps(out + i, _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(x)));
+    }
+    s16_to_float_c(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void float_to_s16_avx512(const float *in, int16_t *out, size_t n) {
+    const __m512 max = _mm512_set1_ps(32767.0f);
+    const __m512 min = _mm512_set1_ps(-32768.0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 x = _mm512_max_ps(_mm512_min_ps(_mm512_loadu_ps(in + i), max), min);
+        _mm256_storeu_si256((__m256i *)(out + i), _mm512_cvtsepi32_epi16(_mm512_cvttps_epi32(x)));
+    }
+    float_to_s16_c(in + i, out + i, n - i);
+}
+
+#endif
+
+#ifdef CPU_NEON
+
+/* NEON kernels (8 samples per step). */
+
+static void s16_to_float_neon(const int16_t *in, float *out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(in + i);
+        vst1q_f32(out + i, vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))));
+        vst1q_f32(out + i + 4, vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))));
+    }
+    s16_to_float_c(in + i, out + i, n - i);
+}
+
+static void float_to_s16_neon(const float *in, int16_t *out, size_t n) {
+    const float32x4_t max = vdupq_n_f32(32767.0f);
+    const float32x4_t min = vdupq_n_f32(-32768.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t a = vmaxq_f32(vminq_f32(vld1q_f32(in + i), max), min);
+        float32x4_t b = vmaxq_f32(vminq_f32(vld1q_f32(in + i + 4), max), min);
+        int16x8_t packed = vcombine_s16(vqmovn_s32(vcvtq_s32_f32(a)), vqmovn_s32(vcvtq_s32_f32(b)));
+        vst1q_s16(out + i, packed);
+    }
+    float_to_s16_c(in + i, out + i, n - i);
+}
+
+#endif
+
+/**
+ * @brief Check whether the running CPU supports a tier.
+ */
+static int tier_supported(CpuTier tier) {
+    switch (tier) {
+        case CPU_TIER_GENERIC:
+            return 1;
+#ifdef CPU_X86
+        case CPU_TIER_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case CPU_TIER_AVX2:
+            return __builtin_cpu_supports("avx2");
+        case CPU_TIER_AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+#ifdef CPU_NEON
+        case CPU_TIER_NEON:
+            return 1;
+#endif
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Fill a dispatch table for a supported tier.
+ */
+static void fill_tier(CpuKernels *table, CpuTier tier) {
+    table->tier = tier;
+    table->s16_to_float = s16_to_float_c;
+    table->float_to_s16 = float_to_s16_c;
+    table->fft960 = fft960_generic;
+    table->pitch_xcorr = pitch_xcorr_generic;
+
+    switch (tier) {
+#ifdef CPU_X86
+        case CPU_TIER_SSE2:
+            table->s16_to_float = s16_to_float_sse2;
+            table->float_to_s16 = float_to_s16_sse2;
+            table->pitch_xcorr = pitch_xcorr_sse2;
+            break;
+        case CPU_TIER_AVX2:
+            table->s16_to_float = s16_to_float_avx2;
+            table->float_to_s16 = float_to_s16_avx2;
+            table->fft960 = fft960_avx2;
+            table->pitch_xcorr = pitch_xcorr_avx2;
+            break;
+        case CPU_TIER_AVX512:
+            table->s16_to_float = s16_to_float_avx512;
+            table->float_to_s16 = float_to_s16_avx512;
+            table->fft960 = fft960_avx2;    // An AVX-512 build was no faster.
+            table->pitch_xcorr = pitch_xcorr_avx512;
+            break;
+#endif
+#ifdef CPU_NEON
+        case CPU_TIER_NEON:
+            table->s16_to_float = s16_to_float_neon;
+            table->float_to_s16 = float_to_s16_neon;
+            table->pitch_xcorr = pitch_xcorr_neon;
+            break;
+#endif
+        default:
+            break;
+    }
+}
+
+CpuTier cpu_dispatch_init(const char *force) {
+#ifdef CPU_X86
+    __builtin_cpu_init();
+#endif
+
+    CpuTier best = CPU_TIER_GENERIC;
+    for (int t = CPU_TIER_GENERIC; t < CPU_TIER_COUNT; t++) {
+        if (tier_supported((CpuTier)t)) best = (CpuTier)t;
+    }
+
+    if (!force) force = getenv("RNNOISE_CPU");
+    if (force && *force) {
+        int found = 0;
+        for (int t = CPU_TIER_GENERIC; t < CPU_TIER_COUNT; t++) {
+            if (strcmp(force, tier_names[t]) == 0) {
+                found = 1;
+                if (tier_supported((CpuTier)t)) {
+                    best = (CpuTier)t;
+                } else {
+                    RNNOISE_PROBE1(engine_fallback, "cpu tier");
+                    fprintf(stderr, "CPU tier '%s' is not supported, using '%s'\n", force, tier_names[best]);
+                }
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "Unknown CPU tier '%s', using '%s'\n", force, tier_names[best]);
+        }
+    }
+
+    fill_tier(&kernels, best);
+    kernels_ready = 1;
+    return best;
+}
+
+const CpuKernels *cpu_kernels(void) {
+    if (!kernels_ready) {
+        cpu_dispatch_init(NULL);
+    }
+    return &kernels;
+}
+
+const CpuKernels *cpu_kernels_for(CpuTier tier) {
+    static CpuKernels tables[CPU_TIER_COUNT];
+    if (tier < 0 || tier >= CPU_TIER_COUNT) return NULL;
+#ifdef CPU_X86
+    __builtin_cpu_init();
+#endif
+    if (!tier_supported(tier)) return NULL;
+    fill_tier(&tables[tier], tier);
+    return &tables[tier];
+}
+
+const char *cpu_tier_name(CpuTier tier) {
+    return (tier >= 0 && tier < CPU_TIER_COUNT) ? tier_names[tier] : "unknown";
+}
+
+void cpu_profile_enable(int enable) {
+    if (enable) {
+        memset(profile_ns, 0, sizeof(profile_ns));
+        memset(profile_calls, 0, sizeof(profile_calls));
+    }
+    cpu_profiling = enable;
+}
+
+uint64_t cpu_profile_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void cpu_profile_add(CpuProfileSlot slot, uint64_t start) {
+    profile_ns[slot] += cpu_profile_now() - start;
+    profile_calls[slot]++;
+}
+
+void cpu_profile_get(CpuProfileSlot slot, uint64_t *ns, uint64_t *calls) {
+    *ns = profile_ns[slot];
+    *calls = profile_calls[slot];
+}
+
+const char *cpu_profile_name(CpuProfileSlot slot) {
+    return (slot >= 0 && slot < CPU_PROFILE_COUNT) ? profile_names[slot] : "unknown";
+}
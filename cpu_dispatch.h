@@ -0,0 +1,122 @@
+/**
+ * @file
+ * @brief Run-time CPU dispatch for the hot kernels of the static build.
+ *
+ * The static build is compiled for the baseline of the target architecture.
+ * Faster versions of the hot kernels are compiled alongside it and the best
+ * one supported by the running CPU is picked once at startup.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ */
+
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fft960.h"
+#include "pitch_simd.h"
+
+/**
+ * @brief Instruction set tiers, from slowest to fastest.
+ */
+typedef enum {
+    CPU_TIER_GENERIC = 0,
+    CPU_TIER_SSE2,
+    CPU_TIER_AVX2,
+    CPU_TIER_AVX512,
+    CPU_TIER_NEON,
+    CPU_TIER_COUNT
+} CpuTier;
+
+/**
+ * @brief Dispatch table of the hot kernels.
+ */
+typedef struct {
+    CpuTier tier;
+
+    // Convert 16-bit PCM to float without scaling.
+    void (*s16_to_float)(const int16_t *in, float *out, size_t n);
+
+    // Convert float to 16-bit PCM, clipping to the int16 range and truncating.
+    void (*float_to_s16)(const float *in, int16_t *out, size_t n);
+
+    // Forward 960-point FFT with kiss_fft semantics (see fft960.h).
+    void (*fft960)(const FftCpx *in, FftCpx *out);
+
+    // Pitch cross-correlation, bit-exact with RNNoise's (see pitch_simd.h).
+    void (*pitch_xcorr)(const float *x, const float *y, float *xcorr, int len, int max_pitch);
+} CpuKernels;
+
+/**
+ * @brief Kernels timed by the per-function profile.
+ */
+typedef enum {
+    CPU_PROFILE_FFT960 = 0,
+    CPU_PROFILE_PITCH_XCORR,
+    CPU_PROFILE_COUNT
+} CpuProfileSlot;
+
+/**
+ * @brief Non-zero while the redirected RNNoise entry points time themselves.
+ */
+extern int cpu_profiling;
+
+/**
+ * @brief Select the kernels for this CPU.
+ *
+ * Called implicitly by cpu_kernels(). A tier can be forced by name
+ * ("generic", "sse2", "avx2", "avx512", "neon") for benchmarking, either
+ * through the force argument or the RNNOISE_CPU environment variable.
+ * A forced tier the CPU does not support falls back to the best one.
+ *
+ * @param force Tier name, or NULL to use RNNOISE_CPU or detection.
+ * @return The selected tier.
+ */
+CpuTier cpu_dispatch_init(const char *force);
+
+/**
+ * @brief Get the dispatch table, initializing it on first use.
+ */
+const CpuKernels *cpu_kernels(void);
+
+/**
+ * @brief Get the dispatch table of a specific tier, for checks and benchmarks.
+ * @return The table, or NULL if the CPU does not support the tier.
+ */
+const CpuKernels *cpu_kernels_for(CpuTier tier);
+
+/**
+ * @brief Get the name of a tier.
+ */
+const char *cpu_tier_name(CpuTier tier);
+
+/**
+ * @brief Turn profiling on (resetting the counters) or off.
+ */
+void cpu_profile_enable(int enable);
+
+/**
+ * @brief Monotonic clock in nanoseconds.
+ */
+uint64_t cpu_profile_now(void);
+
+/**
+ * @brief Charge the time since start (from cpu_profile_now()) to a kernel.
+ */
+void cpu_profile_add(CpuProfileSlot slot, uint64_t start);
+
+/**
+ * @brief Get the accumulated time and call count of a kernel.
+ */
+void cpu_profile_get(CpuProfileSlot slot, uint64_t *ns, uint64_t *calls);
+
+/**
+ * @brief Get the name of a profiled kernel.
+ */
+const char *cpu_profile_name(CpuProfileSlot slot);
+
+#endif
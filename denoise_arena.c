@@ -0,0 +1,140 @@
+/**
+ * @file
+ * @brief Arena of denoisers for servers running thousands of streams.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "denoise_arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#define HUGE_PAGE (2u << 20)   // Chunks are rounded up to this so they can use huge pages.
+
+/**
+ * @brief A freed slot; the link lives in the slot's own memory.
+ */
+typedef struct FreeSlot {
+    struct FreeSlot *next;
+} FreeSlot;
+
+struct DenoiseArena {
+    RNNModel *model;
+    size_t slot_bytes;
+    size_t chunk_slots;
+    size_t chunk_bytes;
+    char **chunks;
+    size_t chunk_count;
+    size_t chunk_capacity;
+    size_t fresh;              // Slots of the last chunk never handed out yet.
+    FreeSlot *free_list;       // Slots given back, most recent first (still warm in cache).
+    size_t in_use;
+};
+
+static void *map_chunk(size_t bytes) {
+#ifdef _WIN32
+    return _aligned_malloc(bytes, DENOISE_CORE_ALIGN);
+#else
+    // Pages are only backed once a slot on them is used.
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+    madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+    return p;
+#endif
+}
+
+static void unmap_chunk(void *p, size_t bytes) {
+#ifdef _WIN32
+    (void)bytes;
+    _aligned_free(p);
+#else
+    munmap(p, bytes);
+#endif
+}
+
+DenoiseArena *denoise_arena_create(RNNModel *model, size_t chunk_slots) {
+    DenoiseArena *arena = calloc(1, sizeof(*arena));
+    if (!arena) return NULL;
+    arena->model = model;
+    arena->slot_bytes = denoise_core_size();
+    if (chunk_slots == 0) chunk_slots = DENOISE_ARENA_CHUNK;
+    // Whole huge pages per chunk, filled with as many slots as fit.
+    size_t bytes = chunk_slots * arena->slot_bytes;
+    arena->chunk_bytes = (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+    arena->chunk_slots = arena->chunk_bytes / arena->slot_bytes;
+    return arena;
+}
+
+void denoise_arena_destroy(DenoiseArena *arena) {
+    if (!arena) return;
+    for (size_t i = 0; i < arena->chunk_count; i++) unmap_chunk(arena->chunks[i], arena->chunk_bytes);
+    free(arena->chunks);
+    free(arena);
+}
+
+DenoiseCore *denoise_arena_get(DenoiseArena *arena) {
+    void *slot;
+    if (arena->free_list) {
+        slot = arena->free_list;
+        arena->free_list = arena->free_list->next;
+    } else {
+        if (arena->fresh == 0) {
+            if (arena->chunk_count == arena->chunk_capacity) {
+                size_t capacity = arena->chunk_capacity ? arena->chunk_capacity * 2 : 8;
+                char **chunks = realloc(arena->chunks, capacity * sizeof(char *));
+                if (!chunks) return NULL;
+                arena->chunks = chunks;
+                arena->chunk_capacity = capacity;
+            }
+            char *chunk = map_chunk(arena->chunk_bytes);
+            if (!chunk) return NULL;
+            arena->chunks[arena->chunk_count++] = chunk;
+            arena->fresh = arena->chunk_slots;
+        }
+        // Fresh slots go out in address order, so streams fill a chunk from the start.
+        char *chunk = arena->chunks[arena->chunk_count - 1];
+        slot = chunk + (arena->chunk_slots - arena->fresh) * arena->slot_bytes;
+        arena->fresh--;
+    }
+    arena->in_use++;
+    return denoise_core_init(slot, arena->model);
+}
+
+void denoise_arena_put(DenoiseArena *arena, DenoiseCore *core) {
+    if (!core) return;
+    FreeSlot *slot = (FreeSlot *)(void *)core;
+    slot->next = arena->free_list;
+    arena->free_list = slot;
+    arena->in_use--;
+}
+
+void denoise_arena_stats(const DenoiseArena *arena, DenoiseArenaStats *stats) {
+    stats->slot_bytes = arena->slot_bytes;
+    stats->in_use = arena->in_use;
+    stats->capacity = arena->chunk_count * arena->chunk_slots;
+    stats->chunks = arena->chunk_count;
+    stats->reserved_bytes = arena->chunk_count * arena->chunk_bytes;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file
+ * @brief Arena of denoisers for servers running thousands of streams.
+ *
+ * denoise_core_create() makes one heap allocation per stream. An arena
+ * instead places denoisers back to back in large chunks: each denoiser
+ * (buffers and RNNoise state) starts on a cache line, and a chunk is
+ * asked to use huge pages, so thousands of streams cost fewer TLB entries
+ * and no per-allocation malloc overhead. Freed slots are reused before
+ * the arena grows by another chunk.
+ *
+ * An arena is not thread safe: give each worker thread its own, so each
+ * thread's streams also sit together in memory.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ */
+
+#ifndef DENOISE_ARENA_H
+#define DENOISE_ARENA_H
+
+#include <stddef.h>
+
+#include "denoise_core.h"
+
+#define DENOISE_ARENA_CHUNK 64     // Default denoisers per chunk.
+
+typedef struct DenoiseArena DenoiseArena;
+
+/**
+ * @brief Memory use of an arena.
+ */
+typedef struct {
+    size_t slot_bytes;       // Memory per denoiser, alignment included.
+    size_t in_use;           // Denoisers handed out.
+    size_t capacity;         // Slots in all chunks.
+    size_t chunks;
+    size_t reserved_bytes;   // Address space of all chunks.
+} DenoiseArenaStats;
+
+/**
+ * @brief Create an empty arena; the first chunk is mapped on first use.
+ * @param model Model shared by all denoisers, or NULL for the built-in one.
+ * @param chunk_slots Denoisers per chunk; 0 uses DENOISE_ARENA_CHUNK.
+ * @return The arena, or NULL when out of memory.
+ */
+DenoiseArena *denoise_arena_create(RNNModel *model, size_t chunk_slots);
+
+/**
+ * @brief Free the arena and every denoiser still in it.
+ */
+void denoise_arena_destroy(DenoiseArena *arena);
+
+/**
+ * @brief Get a fresh denoiser. Allocates only when every slot is in use.
+ * @return The denoiser, or NULL when out of memory.
+ */
+DenoiseCore *denoise_arena_get(DenoiseArena *arena);
+
+/**
+ * @brief Give a denoiser back to the arena it came from.
+ */
+void denoise_arena_put(DenoiseArena *arena, DenoiseCore *core);
+
+void denoise_arena_stats(const DenoiseArena *arena, DenoiseArenaStats *stats);
+
+#endif
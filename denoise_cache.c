@@ -0,0 +1,376 @@
+/**
+ * @file
+ * @brief Content-addressed result cache for the offline denoiser.
+ *
+ * Entries are plain WAV files named "<key>.wav" in the cache directory.
+ * Their modification time records the last use and drives LRU eviction.
+ * The hit and miss counters live in a small "stats" file, updated under
+ * an flock() so that several processes can share one cache.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "denoise_cache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WAV_HEADER_SIZE 44  // Canonical header read by the engine.
+#define FRAME_SIZE 480      // RNNoise frame size (10ms at 48kHz).
+#define MAX_ENTRIES 65536   // Entries considered per eviction pass.
+
+/*
+ * XXH64, after the reference implementation by Yann Collet (BSD 2-Clause).
+ */
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+typedef struct {
+    uint64_t total;
+    uint64_t v[4];
+    unsigned char buffer[32];
+    size_t buffered;
+} Xxh64;
+
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t read64(const unsigned char *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static uint32_t read32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME64_2;
+    return rotl64(acc, 31) * XXH_PRIME64_1;
+}
+
+static uint64_t xxh64_merge(uint64_t acc, uint64_t v) {
+    acc ^= xxh64_round(0, v);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static void xxh64_init(Xxh64 *h, uint64_t seed) {
+    h->total = 0;
+    h->v[0] = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+    h->v[1] = seed + XXH_PRIME64_2;
+    h->v[2] = seed;
+    h->v[3] = seed - XXH_PRIME64_1;
+    h->buffered = 0;
+}
+
+static void xxh64_update(Xxh64 *h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    h->total += len;
+
+    if (h->buffered + len < 32) {
+        memcpy(h->buffer + h->buffered, p, len);
+        h->buffered += len;
+        return;
+    }
+    if (h->buffered > 0) {
+        size_t fill = 32 - h->buffered;
+        memcpy(h->buffer + h->buffered, p, fill);
+        for (int i = 0; i < 4; i++) h->v[i] = xxh64_round(h->v[i], read64(h->buffer + 8 * i));
+        p += fill;
+        len -= fill;
+        h->buffered = 0;
+    }
+    for (; len >= 32; p += 32, len -= 32) {
+        for (int i = 0; i < 4; i++) h->v[i] = xxh64_round(h->v[i], read64(p + 8 * i));
+    }
+    memcpy(h->buffer, p, len);
+    h->buffered = len;
+}
+
+static uint64_t xxh64_digest(const Xxh64 *h) {
+    uint64_t acc;
+    if (h->total >= 32) {
+        acc = rotl64(h->v[0], 1) + rotl64(h->v[1], 7) + rotl64(h->v[2], 12) + rotl64(h->v[3], 18);
+        for (int i = 0; i < 4; i++) acc = xxh64_merge(acc, h->v[i]);
+    } else {
+        acc = h->v[2] + XXH_PRIME64_5;
+    }
+    acc += h->total;
+
+    const unsigned char *p = h->buffer;
+    size_t len = h->buffered;
+    for (; len >= 8; p += 8, len -= 8) {
+        acc ^= xxh64_round(0, read64(p));
+        acc = rotl64(acc, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+    if (len >= 4) {
+        acc ^= (uint64_t)read32(p) * XXH_PRIME64_1;
+        acc = rotl64(acc, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+        len -= 4;
+    }
+    for (; len > 0; p++, len--) {
+        acc ^= *p * XXH_PRIME64_5;
+        acc = rotl64(acc, 11) * XXH_PRIME64_1;
+    }
+
+    acc ^= acc >> 33;
+    acc *= XXH_PRIME64_2;
+    acc ^= acc >> 29;
+    acc *= XXH_PRIME64_3;
+    acc ^= acc >> 32;
+    return acc;
+}
+
+/**
+ * @brief Compute the cache key of a job.
+ *
+ * The key covers everything the output depends on: the input header
+ * (without its size fields, which the engine rewrites), the audio data,
+ * the model and the engine version.
+ *
+ * @param key Receives the key as 32 hex digits.
+ * @param frames Receives the number of whole frames in the input.
+ * @return 1 on success, 0 if the input could not be read.
+ */
+static int compute_key(const DenoiseCache *cache, const DenoiseJob *job, char key[33], uint64_t *frames) {
+    FILE *file = fopen(job->input_path, "rb");
+    if (!file) return 0;
+
+    unsigned char header[WAV_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header)) {
+        fclose(file);
+        return 0;
+    }
+    memset(header + 4, 0, 4);   // RIFF size.
+    memset(header + 40, 0, 4);  // data size.
+
+    // Two seeds give a 128-bit key, so unrelated recordings never collide in practice.
+    Xxh64 h[2];
+    xxh64_init(&h[0], 0);
+    xxh64_init(&h[1], XXH_PRIME64_3);
+    const char *model_id = cache->model_id ? cache->model_id : "";
+    for (int i = 0; i < 2; i++) {
+        xxh64_update(&h[i], DENOISE_CACHE_VERSION, sizeof(DENOISE_CACHE_VERSION));
+        xxh64_update(&h[i], model_id, strlen(model_id) + 1);
+        xxh64_update(&h[i], header, sizeof(header));
+    }
+
+    unsigned char buffer[64 * 1024];
+    uint64_t data_bytes = 0;
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        xxh64_update(&h[0], buffer, n);
+        xxh64_update(&h[1], buffer, n);
+        data_bytes += n;
+    }
+    int ok = !ferror(file);
+    fclose(file);
+
+    snprintf(key, 33, "%016llx%016llx", (unsigned long long)xxh64_digest(&h[0]),
+             (unsigned long long)xxh64_digest(&h[1]));
+    *frames = data_bytes / (FRAME_SIZE * sizeof(int16_t));
+    return ok;
+}
+
+/**
+ * @brief Copy a file through a temporary name next to the destination.
+ * @return 1 on success, 0 on failure.
+ */
+static int copy_file(const char *from, const char *to) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.XXXXXX", to);
+    int out = mkstemp(tmp);
+    if (out < 0) return 0;
+    int in = open(from, O_RDONLY);
+    int ok = in >= 0;
+
+    char buffer[64 * 1024];
+    ssize_t n;
+    while (ok && (n = read(in, buffer, sizeof(buffer))) != 0) {
+        if (n < 0) {
+            ok = errno == EINTR;
+            continue;
+        }
+        for (ssize_t done = 0; ok && done < n;) {
+            ssize_t w = write(out, buffer + done, n - done);
+            if (w > 0) done += w;
+            else ok = w < 0 && errno == EINTR;
+        }
+    }
+    if (in >= 0) close(in);
+    ok = fchmod(out, 0644) == 0 && ok;
+    ok = close(out) == 0 && ok;
+    ok = ok && rename(tmp, to) == 0;
+    if (!ok) unlink(tmp);
+    return ok;
+}
+
+/**
+ * @brief Give dest the contents of src, sharing the file when possible.
+ *
+ * The destination is replaced, never written in place, so a file linked
+ * into the cache is not modified through another name.
+ *
+ * @return 1 on success, 0 on failure.
+ */
+static int link_or_copy(const char *src, const char *dest) {
+    static unsigned long counter = 0;
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.link%ld.%lu", dest, (long)getpid(), __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED));
+    unlink(tmp);
+    if (link(src, tmp) == 0) {
+        if (rename(tmp, dest) == 0) return 1;
+        unlink(tmp);
+    }
+    return copy_file(src, dest);
+}
+
+/**
+ * @brief Add delta_hits and delta_misses to the shared counters and read them back.
+ * @return 1 on success, 0 on failure.
+ */
+static int update_stats(const DenoiseCache *cache, int delta_hits, int delta_misses, DenoiseCacheStats *stats) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/stats", cache->dir);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return 0;
+    flock(fd, LOCK_EX);
+
+    DenoiseCacheStats s = {0, 0};
+    char text[128];
+    ssize_t n = pread(fd, text, sizeof(text) - 1, 0);
+    if (n > 0) {
+        text[n] = '\0';
+        unsigned long long hits, misses;
+        if (sscanf(text, "hits=%llu misses=%llu", &hits, &misses) == 2) {
+            s.hits = hits;
+            s.misses = misses;
+        }
+    }
+
+    int ok = 1;
+    if (delta_hits || delta_misses) {
+        s.hits += delta_hits;
+        s.misses += delta_misses;
+        int len = snprintf(text, sizeof(text), "hits=%llu\nmisses=%llu\n", (unsigned long long)s.hits,
+                           (unsigned long long)s.misses);
+        ok = ftruncate(fd, 0) == 0 && pwrite(fd, text, len, 0) == len;
+    }
+    close(fd);
+    if (stats) *stats = s;
+    return ok;
+}
+
+typedef struct {
+    char name[40];
+    time_t mtime;
+    uint64_t size;
+} CacheEntry;
+
+static int compare_entries(const void *a, const void *b) {
+    time_t x = ((const CacheEntry *)a)->mtime, y = ((const CacheEntry *)b)->mtime;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Remove the least recently used entries until the cache fits its limit.
+ */
+static void evict(const DenoiseCache *cache) {
+    uint64_t limit = cache->max_bytes ? cache->max_bytes : DENOISE_CACHE_MAX_BYTES;
+    DIR *dir = opendir(cache->dir);
+    if (!dir) return;
+
+    CacheEntry *entries = malloc(MAX_ENTRIES * sizeof(CacheEntry));
+    size_t count = 0;
+    uint64_t total = 0;
+    struct dirent *d;
+    while (entries && count < MAX_ENTRIES && (d = readdir(dir)) != NULL) {
+        size_t len = strlen(d->d_name);
+        if (len != 36 || strcmp(d->d_name + 32, ".wav") != 0) continue;
+        char path[4096];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", cache->dir, d->d_name);
+        if (stat(path, &st) != 0) continue;
+        memcpy(entries[count].name, d->d_name, len + 1);
+        entries[count].mtime = st.st_mtime;
+        entries[count].size = (uint64_t)st.st_size;
+        total += entries[count].size;
+        count++;
+    }
+    closedir(dir);
+
+    if (entries && total > limit) {
+        qsort(entries, count, sizeof(CacheEntry), compare_entries);
+        for (size_t i = 0; i < count && total > limit; i++) {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s", cache->dir, entries[i].name);
+            if (unlink(path) == 0) total -= entries[i].size;
+        }
+    }
+    free(entries);
+}
+
+int denoise_cache_run(const DenoiseCache *cache, const DenoiseJob *job, DenoiseResult *result, int *hit) {
+    if (hit) *hit = 0;
+    if (job->follow) return denoise_offline_run(job, result);
+
+    char key[33];
+    uint64_t frames;
+    if (mkdir(cache->dir, 0755) != 0 && errno != EEXIST) return denoise_offline_run(job, result);
+    if (!compute_key(cache, job, key, &frames)) return denoise_offline_run(job, result);
+
+    char entry[4096];
+    snprintf(entry, sizeof(entry), "%s/%s.wav", cache->dir, key);
+
+    if (access(entry, R_OK) == 0 && link_or_copy(entry, job->output_path)) {
+        // Mark the entry as recently used.
+        utimensat(AT_FDCWD, entry, NULL, 0);
+        char ckpt[4096];
+        snprintf(ckpt, sizeof(ckpt), "%s%s", job->output_path, DENOISE_CHECKPOINT_SUFFIX);
+        remove(ckpt);
+        memset(result, 0, sizeof(*result));
+        result->frames = frames;
+        update_stats(cache, 1, 0, NULL);
+        if (hit) *hit = 1;
+        return 1;
+    }
+
+    int ok = denoise_offline_run(job, result);
+    if (ok && !result->cancelled) {
+        update_stats(cache, 0, 1, NULL);
+        if (link_or_copy(job->output_path, entry)) evict(cache);
+    }
+    return ok;
+}
+
+int denoise_cache_stats(const DenoiseCache *cache, DenoiseCacheStats *stats) {
+    return update_stats(cache, 0, 0, stats);
+}
@@ -0,0 +1,70 @@
+/**
+ * @file
+ * @brief Content-addressed result cache for the offline denoiser.
+ *
+ * Results are keyed on an XXH64 hash of the input's audio data together
+ * with the model and the engine version, so re-submitting the same audio
+ * under any file name reuses the earlier output instead of running RNNoise
+ * again. A hit hardlinks the cached file to the output (or copies it when
+ * the cache is on another file system). The cache directory is kept under
+ * a size limit by evicting the least recently used entries, and hit and
+ * miss counts are kept in the directory for all processes sharing it.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ */
+
+#ifndef DENOISE_CACHE_H
+#define DENOISE_CACHE_H
+
+#include <stdint.h>
+
+#include "denoise_offline.h"
+
+// Bump when a change to the engine alters its output, so old results are not reused.
+#define DENOISE_CACHE_VERSION "1"
+
+// Default size limit of the cache directory, in bytes.
+#define DENOISE_CACHE_MAX_BYTES (1024ULL * 1024 * 1024)
+
+/**
+ * @brief A cache directory and its settings.
+ */
+typedef struct {
+    const char *dir;           // Cache directory; created if missing.
+    uint64_t max_bytes;        // Size limit; 0 uses DENOISE_CACHE_MAX_BYTES.
+    const char *model_id;      // Identifies job->model (e.g. its file name); NULL for the built-in model.
+} DenoiseCache;
+
+/**
+ * @brief Hit and miss counts of a cache directory.
+ */
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+} DenoiseCacheStats;
+
+/**
+ * @brief Run a job through the cache.
+ *
+ * On a hit the output is linked or copied from the cache. On a miss the
+ * job runs as with denoise_offline_run() and, once complete, its output
+ * is added to the cache. Follow jobs bypass the cache since their input
+ * is still changing.
+ *
+ * @param cache Cache to use.
+ * @param job Job description.
+ * @param result Filled with the outcome; frames is set on a hit too.
+ * @param hit Set to 1 on a cache hit, 0 otherwise; may be NULL.
+ * @return 1 on success or cancel, 0 on failure (see result->error).
+ */
+int denoise_cache_run(const DenoiseCache *cache, const DenoiseJob *job, DenoiseResult *result, int *hit);
+
+/**
+ * @brief Read the hit and miss counts of a cache directory.
+ * @return 1 on success, 0 if the counts could not be read.
+ */
+int denoise_cache_stats(const DenoiseCache *cache, DenoiseCacheStats *stats);
+
+#endif
@@ -0,0 +1,894 @@
+/**
+ * @file
+ * @brief Sharded batch denoising across worker processes over TCP.
+ *
+ * One program, two roles. The coordinator splits a corpus into shards
+ * (whole files, or overlapping chunks of large files) and serves them over
+ * TCP; workers on any number of machines connect, pull a shard whenever a
+ * slot is idle, denoise it with the offline engine and send the result
+ * back. Pulling is what balances the load: fast workers simply ask more
+ * often. Near the end of the run, idle workers also take a second copy of
+ * shards that have been running much longer than usual, so one slow machine
+ * cannot hold up the whole batch; the first result wins.
+ *
+ * A shard whose worker fails or disconnects goes back into the queue and is
+ * retried, up to -r times, before its file is reported as failed.
+ *
+ * Large files are cut into chunks of -c seconds. Each chunk is sent with
+ * DENOISE_WARMUP_FRAMES of audio before it, which rebuild RNNoise's state
+ * the same way a resumed job does; that overlap is denoised and dropped.
+ * The rebuilt state is only approximate: the output is equivalent to a
+ * single-process run after the warm-up window, but the first frames after
+ * each chunk boundary can differ slightly from it. Only the first chunk of
+ * a file, which starts at the beginning, matches exactly.
+ *
+ * The coordinator writes each chunk at its offset in a hidden ".partial"
+ * file and renames it into place when the last chunk arrives.
+ *
+ * Usage:
+ *   denoise_cluster [-a address] [-p port] [-c chunk_s] [-r retries] -o outdir input.wav...
+ *   denoise_cluster -W host:port [-j slots] [-d tmpdir]
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "denoise_offline.h"
+
+#define FRAME_SIZE 480     // RNNoise frame size (10ms at 48kHz).
+#define SAMPLE_RATE 48000  // Expected sample rate for RNNoise.
+#define FRAME_BYTES (FRAME_SIZE * sizeof(int16_t))
+
+#define MAX_SLOTS 64             // Worker slots per worker process.
+#define IO_BUFFER 65536          // Copy buffer for shard transfers.
+#define WAIT_MS 200              // Worker back-off when no shard is ready.
+#define CONNECT_SECONDS 30       // How long a worker keeps trying to connect.
+#define STRAGGLER_FACTOR 2.0     // A shard is a straggler after this many mean shard times...
+#define STRAGGLER_MIN_SECONDS 1.0  // ...but never before this...
+#define STRAGGLER_COLD_SECONDS 10.0  // ...or this, before any shard has finished.
+
+/**
+ * @brief Struct representing the WAV file header.
+ */
+typedef struct {
+    char riff[4];                  // "RIFF"
+    uint32_t file_size;            // Total file size minus 8 bytes
+    char wave[4];                  // "WAVE"
+    char fmt[4];                   // "fmt "
+    uint32_t fmt_size;             // Format chunk size (usually 16)
+    uint16_t format;               // Audio format (1 = PCM)
+    uint16_t channels;             // Number of audio channels
+    uint32_t sample_rate;          // Sampling rate (Hz)
+    uint32_t byte_rate;            // Bytes per second
+    uint16_t block_align;          // Block alignment (bytes per sample frame)
+    uint16_t bits_per_sample;      // Bits per sample (usually 16)
+    char data[4];                  // "data"
+    uint32_t data_size;            // Size of audio data in bytes
+} WavHeader;
+
+/*
+ * Wire protocol: every message is a 16-byte header (type, shard id and
+ * payload length, in network byte order) followed by the payload.
+ */
+enum {
+    MSG_GET = 1,     // Worker -> coordinator: a slot is idle.
+    MSG_SHARD = 2,   // Coordinator -> worker: payload is a WAV file to denoise.
+    MSG_WAIT = 3,    // Coordinator -> worker: nothing to do yet, ask again later.
+    MSG_BYE = 4,     // Coordinator -> worker: the batch is finished.
+    MSG_RESULT = 5,  // Worker -> coordinator: payload is the denoised WAV file.
+    MSG_FAIL = 6,    // Worker -> coordinator: payload is an error message.
+};
+
+typedef struct {
+    uint32_t type;
+    uint32_t shard;
+    uint64_t length;
+} Message;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+/**
+ * @brief Monotonic clock in seconds.
+ */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int send_all(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+static int recv_all(int fd, void *data, size_t len) {
+    char *p = data;
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR && !stop_requested) continue;
+        if (n <= 0) return 0;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+static int send_message(int fd, uint32_t type, uint32_t shard, uint64_t length) {
+    unsigned char buf[16];
+    uint32_t words[4] = {htonl(type), htonl(shard), htonl((uint32_t)(length >> 32)), htonl((uint32_t)length)};
+    memcpy(buf, words, sizeof(buf));
+    return send_all(fd, buf, sizeof(buf));
+}
+
+static int recv_message(int fd, Message *m) {
+    uint32_t words[4];
+    if (!recv_all(fd, words, sizeof(words))) return 0;
+    m->type = ntohl(words[0]);
+    m->shard = ntohl(words[1]);
+    m->length = ((uint64_t)ntohl(words[2]) << 32) | ntohl(words[3]);
+    return 1;
+}
+
+/**
+ * @brief Copy len bytes from a file descriptor at offset (or its current
+ *        position when offset is negative) to a socket.
+ */
+static int send_file_range(int sock, int fd, off_t offset, uint64_t len) {
+    char buffer[IO_BUFFER];
+    while (len > 0) {
+        size_t want = len < sizeof(buffer) ? (size_t)len : sizeof(buffer);
+        ssize_t n = offset >= 0 ? pread(fd, buffer, want, offset) : read(fd, buffer, want);
+        if (n <= 0 || !send_all(sock, buffer, (size_t)n)) return 0;
+        if (offset >= 0) offset += n;
+        len -= (uint64_t)n;
+    }
+    return 1;
+}
+
+/**
+ * @brief Copy len bytes from a socket to a file descriptor at offset.
+ *
+ * A negative fd discards the data. The first skip bytes are discarded too.
+ * After a write error the rest is still read, so the connection stays usable.
+ * @return 1 on success, 0 if the data was read but not all written, -1 if the connection was lost.
+ */
+static int recv_file_range(int sock, int fd, off_t offset, uint64_t skip, uint64_t len) {
+    char buffer[IO_BUFFER];
+    while (len > 0) {
+        size_t want = len < sizeof(buffer) ? (size_t)len : sizeof(buffer);
+        if (!recv_all(sock, buffer, want)) return -1;
+        len -= want;
+        size_t drop = skip < want ? (size_t)skip : want;
+        skip -= drop;
+        if (fd < 0 || drop == want) continue;
+        if (pwrite(fd, buffer + drop, want - drop, offset) != (ssize_t)(want - drop)) fd = -2;
+        offset += (off_t)(want - drop);
+    }
+    return fd != -2 ? 1 : 0;
+}
+
+/*
+ * Coordinator.
+ */
+
+typedef enum { SHARD_PENDING, SHARD_RUNNING, SHARD_DONE, SHARD_FAILED } ShardState;
+
+/**
+ * @brief An input file and its output.
+ */
+typedef struct {
+    const char *input;
+    char output[1024];
+    char partial[1024];
+    WavHeader header;
+    uint64_t samples;          // Input samples.
+    uint64_t frames;           // Input frames, the last one possibly partial.
+    int shards_left;           // Shards not done or failed yet.
+    int failed;
+} ClusterFile;
+
+/**
+ * @brief A piece of work: output frames [first, end) of a file.
+ *
+ * The engine never writes frame 0 (RNNoise's warm-up), so the first shard of
+ * a file starts at frame 1.
+ */
+typedef struct {
+    ClusterFile *file;
+    uint64_t first;
+    uint64_t end;
+    uint64_t from;             // First input frame sent: first minus the overlap.
+    ShardState state;
+    int copies;                // Workers running it right now.
+    int attempts;              // Failed attempts.
+    double started;            // When the current attempt was first dispatched.
+} Shard;
+
+static ClusterFile *files;
+static int file_count;
+static Shard *shards;
+static int shard_count;
+static int next_pending = 0;   // Shards before it are not pending, except retries.
+static int unresolved = 0;     // Files not finished yet.
+static int max_retries = 3;
+static pthread_mutex_t cluster_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cluster_done = PTHREAD_COND_INITIALIZER;
+
+static struct {
+    unsigned long dispatched;
+    unsigned long duplicates;  // Second copies given to idle workers.
+    unsigned long retries;
+    unsigned long wasted;      // Results that arrived after another copy's.
+    unsigned long completed;
+    double shard_seconds;      // Sum over completed shards, for the mean.
+    int workers;               // Worker slots that connected.
+} stats;
+
+static uint64_t shard_input_bytes(const Shard *s) {
+    uint64_t end = s->end * FRAME_SIZE < s->file->samples ? s->end * FRAME_SIZE : s->file->samples;
+    return (end - s->from * FRAME_SIZE) * sizeof(int16_t);
+}
+
+/**
+ * @brief Bytes of audio the engine writes for a shard's input (all but the first frame).
+ */
+static uint64_t shard_output_bytes(const Shard *s) {
+    uint64_t in = shard_input_bytes(s);
+    return in > FRAME_BYTES ? in - FRAME_BYTES : 0;
+}
+
+/**
+ * @brief Write the final header, sync and rename the partial file into place.
+ */
+static int finish_file(ClusterFile *f) {
+    if (f->failed) {
+        remove(f->partial);
+        return 0;
+    }
+    uint64_t data = f->samples > FRAME_SIZE ? (f->samples - FRAME_SIZE) * sizeof(int16_t) : 0;
+    WavHeader header = f->header;
+    header.data_size = (uint32_t)data;
+    header.file_size = (uint32_t)(data + sizeof(WavHeader) - 8);
+    int fd = open(f->partial, O_WRONLY);
+    int ok = fd >= 0 && pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+             ftruncate(fd, (off_t)(sizeof(header) + data)) == 0 && fsync(fd) == 0;
+    if (fd >= 0 && close(fd) != 0) ok = 0;
+    if (ok && rename(f->partial, f->output) != 0) ok = 0;
+    if (!ok) {
+        fprintf(stderr, "%s: could not write %s: %s\n", f->input, f->output, strerror(errno));
+        remove(f->partial);
+        f->failed = 1;
+    }
+    return ok;
+}
+
+/**
+ * @brief Mark a shard resolved. Call with cluster_lock held.
+ * @return The file if this was its last shard, so the caller can finish it unlocked.
+ */
+static ClusterFile *resolve_shard(Shard *s, ShardState state) {
+    s->state = state;
+    ClusterFile *f = s->file;
+    if (state == SHARD_FAILED) f->failed = 1;
+    return --f->shards_left == 0 ? f : NULL;
+}
+
+static void file_finished(ClusterFile *f) {
+    int ok = finish_file(f);
+    fprintf(stderr, "%s %s -> %s\n", ok ? "Done" : "FAILED", f->input, f->output);
+    pthread_mutex_lock(&cluster_lock);
+    unresolved--;
+    pthread_cond_broadcast(&cluster_done);
+    pthread_mutex_unlock(&cluster_lock);
+}
+
+/**
+ * @brief Pick a shard for an idle worker slot. Call with cluster_lock held.
+ *
+ * Pending shards go first, in order. With none left, a shard that has run
+ * far longer than the mean gets a second copy.
+ */
+static Shard *next_shard(ClusterFile **finished) {
+    *finished = NULL;
+    for (int i = next_pending; i < shard_count; i++) {
+        Shard *s = &shards[i];
+        if (s->state != SHARD_PENDING) {
+            if (i == next_pending) next_pending++;
+            continue;
+        }
+        if (s->file->failed) {
+            // No point in denoising the rest of a file that has failed.
+            ClusterFile *f = resolve_shard(s, SHARD_FAILED);
+            if (f) {
+                *finished = f;
+                return NULL;
+            }
+            continue;
+        }
+        return s;
+    }
+
+    double now = now_seconds();
+    double threshold = STRAGGLER_COLD_SECONDS;
+    if (stats.completed > 0) {
+        threshold = STRAGGLER_FACTOR * stats.shard_seconds / stats.completed;
+        if (threshold < STRAGGLER_MIN_SECONDS) threshold = STRAGGLER_MIN_SECONDS;
+    }
+    Shard *slowest = NULL;
+    for (int i = 0; i < shard_count; i++) {
+        Shard *s = &shards[i];
+        if (s->state == SHARD_RUNNING && s->copies == 1 && now - s->started > threshold &&
+            (!slowest || s->started < slowest->started)) {
+            slowest = s;
+        }
+    }
+    if (slowest) stats.duplicates++;
+    return slowest;
+}
+
+/**
+ * @brief Give up a connection's claim on a shard after a failure. Call with cluster_lock held.
+ * @return The file if this failure resolved its last shard.
+ */
+static ClusterFile *release_shard(Shard *s, const char *peer, const char *why) {
+    s->copies--;
+    if (s->state != SHARD_RUNNING || s->copies > 0) return NULL;
+    s->attempts++;
+    fprintf(stderr, "%s: shard %d of %s failed (%s), attempt %d of %d\n", peer, (int)(s - shards),
+            s->file->input, why, s->attempts, max_retries + 1);
+    if (s->attempts > max_retries) return resolve_shard(s, SHARD_FAILED);
+    stats.retries++;
+    s->state = SHARD_PENDING;
+    int index = (int)(s - shards);
+    if (index < next_pending) next_pending = index;
+    return NULL;
+}
+
+/**
+ * @brief Send a shard: a WAV header followed by its input frames, overlap included.
+ */
+static int send_shard(int sock, const Shard *s) {
+    uint64_t bytes = shard_input_bytes(s);
+    WavHeader header = s->file->header;
+    header.data_size = (uint32_t)bytes;
+    header.file_size = (uint32_t)(bytes + sizeof(WavHeader) - 8);
+
+    int fd = open(s->file->input, O_RDONLY);
+    if (fd < 0) return 0;
+    int ok = send_message(sock, MSG_SHARD, (uint32_t)(s - shards), sizeof(header) + bytes) &&
+             send_all(sock, &header, sizeof(header)) &&
+             send_file_range(sock, fd, (off_t)(sizeof(WavHeader) + s->from * FRAME_BYTES), bytes);
+    close(fd);
+    return ok;
+}
+
+/**
+ * @brief Receive a shard's result and write the frames it owns into the partial file.
+ * @return 1 if the result was complete and stored, 0 if it was read and dropped,
+ *         -1 if the connection was lost.
+ */
+static int receive_result(int sock, const Message *m, Shard *s, int store) {
+    uint64_t expected = sizeof(WavHeader) + shard_output_bytes(s);
+    if (m->length != expected) {
+        // Read and drop it so the connection stays usable.
+        return recv_file_range(sock, -1, 0, 0, m->length) < 0 ? -1 : 0;
+    }
+    // The worker's output starts at input frame from + 1; keep frames from first on.
+    uint64_t skip = sizeof(WavHeader) + (s->first - s->from - 1) * FRAME_BYTES;
+    off_t offset = (off_t)(sizeof(WavHeader) + (s->first - 1) * FRAME_BYTES);
+    // The partial file is gone if another copy finished the file meanwhile;
+    // the result is still read, and then dropped.
+    int fd = store ? open(s->file->partial, O_WRONLY) : -1;
+    // Two copies of a shard write the same bytes, so they may overlap safely.
+    int got = recv_file_range(sock, fd, offset, skip, m->length);
+    if (fd >= 0 && close(fd) != 0 && got > 0) got = 0;
+    if (store && fd < 0 && got > 0) got = 0;
+    return got;
+}
+
+static void *coordinator_conn_main(void *arg) {
+    int sock = (int)(intptr_t)arg;
+    char peer[64] = "worker";
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    if (getpeername(sock, (struct sockaddr *)&addr, &addr_len) == 0) {
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+        snprintf(peer, sizeof(peer), "%s:%d", ip, ntohs(addr.sin_port));
+    }
+    Shard *held = NULL;
+    Message m;
+
+    while (recv_message(sock, &m)) {
+        ClusterFile *finished = NULL;
+        if (m.type == MSG_GET) {
+            pthread_mutex_lock(&cluster_lock);
+            Shard *s = next_shard(&finished);
+            if (s) {
+                if (s->state == SHARD_PENDING) {
+                    s->state = SHARD_RUNNING;
+                    s->started = now_seconds();
+                }
+                s->copies++;
+                stats.dispatched++;
+                held = s;
+            }
+            int all_done = unresolved == 0;
+            pthread_mutex_unlock(&cluster_lock);
+            if (finished) file_finished(finished);
+
+            if (s) {
+                if (!send_shard(sock, s)) break;
+            } else if (all_done) {
+                send_message(sock, MSG_BYE, 0, 0);
+                break;
+            } else if (!send_message(sock, MSG_WAIT, 0, 0)) {
+                break;
+            }
+        } else if ((m.type == MSG_RESULT || m.type == MSG_FAIL) && held && m.shard == (uint32_t)(held - shards)) {
+            Shard *s = held;
+            held = NULL;
+            char why[256] = "worker error";
+            int got = 0;
+            if (m.type == MSG_RESULT) {
+                pthread_mutex_lock(&cluster_lock);
+                int store = s->state == SHARD_RUNNING;
+                pthread_mutex_unlock(&cluster_lock);
+                got = receive_result(sock, &m, s, store);
+                if (got <= 0) snprintf(why, sizeof(why), "bad result");
+            } else {
+                size_t n = m.length < sizeof(why) - 1 ? (size_t)m.length : sizeof(why) - 1;
+                if (!recv_all(sock, why, n) || recv_file_range(sock, -1, 0, 0, m.length - n) < 0) break;
+                why[n] = '\0';
+            }
+            int ok = got > 0;
+
+            pthread_mutex_lock(&cluster_lock);
+            if (ok && s->state == SHARD_RUNNING) {
+                s->copies--;
+                stats.completed++;
+                stats.shard_seconds += now_seconds() - s->started;
+                finished = resolve_shard(s, SHARD_DONE);
+            } else if (ok || s->state == SHARD_DONE) {
+                // Another copy got there first; this one may have found the
+                // file already renamed into place.
+                s->copies--;
+                stats.wasted++;
+            } else {
+                finished = release_shard(s, peer, why);
+            }
+            pthread_mutex_unlock(&cluster_lock);
+            if (finished) file_finished(finished);
+            if (got < 0) break;
+        } else {
+            fprintf(stderr, "%s: protocol error\n", peer);
+            break;
+        }
+    }
+
+    close(sock);
+    pthread_mutex_lock(&cluster_lock);
+    ClusterFile *finished = held ? release_shard(held, peer, "disconnected") : NULL;
+    pthread_mutex_unlock(&cluster_lock);
+    if (finished) file_finished(finished);
+    return NULL;
+}
+
+/**
+ * @brief Check an input file and cut it into shards.
+ * @return 1 on success, 0 if the file cannot be processed.
+ */
+static int plan_file(ClusterFile *f, const char *outdir, uint64_t chunk_frames) {
+    FILE *in = fopen(f->input, "rb");
+    struct stat st;
+    if (!in || fstat(fileno(in), &st) != 0 || fread(&f->header, sizeof(WavHeader), 1, in) != 1) {
+        if (in) fclose(in);
+        fprintf(stderr, "%s: cannot read\n", f->input);
+        return 0;
+    }
+    fclose(in);
+    if (memcmp(f->header.riff, "RIFF", 4) != 0 || memcmp(f->header.wave, "WAVE", 4) != 0 ||
+        memcmp(f->header.data, "data", 4) != 0 || f->header.channels != 1 ||
+        f->header.sample_rate != SAMPLE_RATE || f->header.bits_per_sample != 16) {
+        fprintf(stderr, "%s: only mono 16-bit 48kHz WAV files are supported\n", f->input);
+        return 0;
+    }
+
+    const char *base = strrchr(f->input, '/');
+    base = base ? base + 1 : f->input;
+    snprintf(f->output, sizeof(f->output), "%s/%s", outdir, base);
+    snprintf(f->partial, sizeof(f->partial), "%s/.%s.partial", outdir, base);
+    // Outputs are named after the input's base name only.
+    for (const ClusterFile *other = files; other < f; other++) {
+        if (strcmp(other->output, f->output) == 0) {
+            fprintf(stderr, "%s: same output name as %s, skipped\n", f->input, other->input);
+            return 0;
+        }
+    }
+    int fd = open(f->partial, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", f->partial, strerror(errno));
+        return 0;
+    }
+    close(fd);
+
+    // The engine reads samples up to the end of the file.
+    f->samples = ((uint64_t)st.st_size - sizeof(WavHeader)) / sizeof(int16_t);
+    f->frames = (f->samples + FRAME_SIZE - 1) / FRAME_SIZE;
+    for (uint64_t first = 1; first < f->frames; first += chunk_frames) {
+        Shard *s = &shards[shard_count++];
+        memset(s, 0, sizeof(*s));
+        s->file = f;
+        s->first = first;
+        s->end = first + chunk_frames < f->frames ? first + chunk_frames : f->frames;
+        s->from = first > 1 + DENOISE_WARMUP_FRAMES ? first - 1 - DENOISE_WARMUP_FRAMES : 0;
+        s->state = SHARD_PENDING;
+        f->shards_left++;
+    }
+    return 1;
+}
+
+static int run_coordinator(const char *address, int port, const char *outdir, double chunk_seconds, char **inputs,
+                           int input_count) {
+    uint64_t chunk_frames = (uint64_t)(chunk_seconds * SAMPLE_RATE / FRAME_SIZE);
+    if (chunk_frames < 1) chunk_frames = 1;
+
+    if (mkdir(outdir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "%s: %s\n", outdir, strerror(errno));
+        return 1;
+    }
+
+    // Size the shard table before planning.
+    size_t max_shards = 0;
+    for (int i = 0; i < input_count; i++) {
+        struct stat st;
+        if (stat(inputs[i], &st) == 0 && st.st_size > (off_t)sizeof(WavHeader)) {
+            uint64_t frames = ((uint64_t)st.st_size - sizeof(WavHeader)) / FRAME_BYTES + 1;
+            max_shards += frames / chunk_frames + 1;
+        }
+    }
+    files = calloc((size_t)input_count, sizeof(ClusterFile));
+    shards = calloc(max_shards ? max_shards : 1, sizeof(Shard));
+    if (!files || !shards) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    int failed = 0;
+    for (int i = 0; i < input_count; i++) {
+        ClusterFile *f = &files[file_count];
+        f->input = inputs[i];
+        if (!plan_file(f, outdir, chunk_frames)) {
+            failed++;
+            continue;
+        }
+        file_count++;
+        if (f->shards_left == 0) {
+            // Too short to produce any audio: finish it right away.
+            if (!finish_file(f)) failed++;
+        } else {
+            unresolved++;
+        }
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+        fprintf(stderr, "Invalid address: %s\n", address);
+        return 1;
+    }
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    if (listener < 0 || setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 64) != 0) {
+        fprintf(stderr, "Cannot listen on %s:%d: %s\n", address, port, strerror(errno));
+        return 1;
+    }
+    fprintf(stderr, "Coordinating %d files in %d shards on %s:%d\n", file_count, shard_count, address, port);
+
+    pthread_attr_t detached;
+    pthread_attr_init(&detached);
+    pthread_attr_setdetachstate(&detached, PTHREAD_CREATE_DETACHED);
+    double start = now_seconds();
+
+    while (!stop_requested) {
+        pthread_mutex_lock(&cluster_lock);
+        int left = unresolved;
+        pthread_mutex_unlock(&cluster_lock);
+        if (left == 0) break;
+
+        struct pollfd pfd = {listener, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) continue;
+        int sock = accept(listener, NULL, NULL);
+        if (sock < 0) continue;
+
+        // Notice workers whose machine went away while they held a shard.
+        int idle = 10, interval = 5, count = 3;
+        setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+        setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+        setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+        setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+
+        pthread_t thread;
+        if (pthread_create(&thread, &detached, coordinator_conn_main, (void *)(intptr_t)sock) != 0) {
+            close(sock);
+            continue;
+        }
+        pthread_mutex_lock(&cluster_lock);
+        stats.workers++;
+        pthread_mutex_unlock(&cluster_lock);
+    }
+    close(listener);
+
+    double elapsed = now_seconds() - start;
+    double audio = 0.0;
+    pthread_mutex_lock(&cluster_lock);
+    for (int i = 0; i < file_count; i++) {
+        if (files[i].failed) {
+            failed++;
+        } else if (files[i].shards_left == 0) {
+            audio += (double)files[i].samples / SAMPLE_RATE;
+        } else {
+            // Interrupted.
+            remove(files[i].partial);
+            failed++;
+        }
+    }
+    fprintf(stderr,
+            "%d files, %d failed, %d shards in %.1f s (%.1fx real time); %lu dispatched, %lu duplicates, "
+            "%lu retries, %lu wasted results, %d worker slots\n",
+            input_count, failed, shard_count, elapsed, elapsed > 0 ? audio / elapsed : 0.0, stats.dispatched,
+            stats.duplicates, stats.retries, stats.wasted, stats.workers);
+    pthread_mutex_unlock(&cluster_lock);
+    return failed ? 1 : 0;
+}
+
+/*
+ * Worker.
+ */
+
+static const char *worker_host;
+static const char *worker_port;
+static const char *worker_tmpdir = "/tmp";
+
+static int worker_cancelled(void *user) {
+    (void)user;
+    return stop_requested;
+}
+
+static int connect_coordinator(void) {
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    double deadline = now_seconds() + CONNECT_SECONDS;
+    while (!stop_requested && now_seconds() < deadline) {
+        if (getaddrinfo(worker_host, worker_port, &hints, &res) == 0) {
+            for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+                int sock = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+                if (sock < 0) continue;
+                if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0) {
+                    freeaddrinfo(res);
+                    return sock;
+                }
+                close(sock);
+            }
+            freeaddrinfo(res);
+        }
+        usleep(500 * 1000);
+    }
+    return -1;
+}
+
+/**
+ * @brief Denoise one shard received on the socket and send back the result.
+ * @return 1 to go on, 0 if the connection is lost or the worker is stopping.
+ */
+static int work_shard(int sock, const Message *m, int slot) {
+    char in_path[1024], out_path[1024];
+    snprintf(in_path, sizeof(in_path), "%s/denoise_cluster.%d.%d.in.wav", worker_tmpdir, (int)getpid(), slot);
+    snprintf(out_path, sizeof(out_path), "%s/denoise_cluster.%d.%d.out.wav", worker_tmpdir, (int)getpid(), slot);
+
+    int fd = open(in_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    int ok = recv_file_range(sock, fd, 0, 0, m->length) > 0;
+    if (fd >= 0) close(fd);
+    if (!ok && fd >= 0) {
+        remove(in_path);
+        return 0;
+    }
+
+    DenoiseResult result;
+    memset(&result, 0, sizeof(result));
+    if (fd < 0) {
+        snprintf(result.error, sizeof(result.error), "Cannot write the shard file: %s", strerror(errno));
+    } else {
+        DenoiseJob job = {
+            .input_path = in_path,
+            .output_path = out_path,
+            .cancelled = worker_cancelled,
+        };
+        ok = denoise_offline_run(&job, &result) && !result.cancelled;
+    }
+    remove(in_path);
+
+    if (stop_requested) {
+        remove(out_path);
+        return 0;
+    }
+    if (ok) {
+        struct stat st;
+        int out = open(out_path, O_RDONLY);
+        ok = out >= 0 && fstat(out, &st) == 0 && send_message(sock, MSG_RESULT, m->shard, (uint64_t)st.st_size) &&
+             send_file_range(sock, out, -1, (uint64_t)st.st_size);
+        if (out >= 0) close(out);
+        remove(out_path);
+        return ok;
+    }
+    remove(out_path);
+    size_t len = strlen(result.error);
+    return send_message(sock, MSG_FAIL, m->shard, len) && send_all(sock, result.error, len);
+}
+
+static void *worker_slot_main(void *arg) {
+    int slot = (int)(intptr_t)arg;
+    unsigned long done = 0;
+    int sock = connect_coordinator();
+    if (sock < 0) {
+        fprintf(stderr, "Slot %d: cannot connect to %s:%s\n", slot, worker_host, worker_port);
+        return (void *)0;
+    }
+
+    Message m;
+    while (!stop_requested && send_message(sock, MSG_GET, 0, 0) && recv_message(sock, &m)) {
+        if (m.type == MSG_SHARD) {
+            if (!work_shard(sock, &m, slot)) break;
+            done++;
+        } else if (m.type == MSG_WAIT) {
+            usleep(WAIT_MS * 1000);
+        } else {
+            break;
+        }
+    }
+    close(sock);
+    fprintf(stderr, "Slot %d: %lu shards\n", slot, done);
+    return (void *)(intptr_t)1;
+}
+
+static int run_worker(const char *target, int slots) {
+    static char host[256];
+    const char *colon = strrchr(target, ':');
+    if (!colon || colon == target || (size_t)(colon - target) >= sizeof(host)) {
+        fprintf(stderr, "Expected host:port, got %s\n", target);
+        return 1;
+    }
+    memcpy(host, target, (size_t)(colon - target));
+    host[colon - target] = '\0';
+    worker_host = host;
+    worker_port = colon + 1;
+
+    pthread_t threads[MAX_SLOTS];
+    int started = 0;
+    for (; started < slots; started++) {
+        if (pthread_create(&threads[started], NULL, worker_slot_main, (void *)(intptr_t)started) != 0) break;
+    }
+    int connected = 0;
+    for (int i = 0; i < started; i++) {
+        void *ret;
+        pthread_join(threads[i], &ret);
+        connected += ret != NULL;
+    }
+    return connected ? 0 : 1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-a address] [-p port] [-c chunk_s] [-r retries] -o outdir input.wav...\n"
+            "       %s -W host:port [-j slots] [-d tmpdir]\n"
+            "Coordinator:\n"
+            "  -a  address to listen on (default 127.0.0.1; 0.0.0.0 for remote workers)\n"
+            "  -p  port (default 7070)\n"
+            "  -c  split files into chunks of this many seconds (default 60)\n"
+            "  -r  retries per shard before its file fails (default 3)\n"
+            "  -o  output directory\n"
+            "Worker:\n"
+            "  -W  coordinator to pull shards from\n"
+            "  -j  shards processed at once (default: number of CPUs)\n"
+            "  -d  directory for shard files (default /tmp)\n",
+            prog, prog);
+}
+
+/**
+ * @brief Main entry point.
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return 0 if every file was denoised, 1 otherwise.
+ */
+int main(int argc, char *argv[]) {
+    const char *address = "127.0.0.1";
+    int port = 7070;
+    double chunk_seconds = 60.0;
+    const char *outdir = NULL;
+    const char *coordinator = NULL;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int slots = cpus > 0 ? (int)cpus : 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:p:c:r:o:W:j:d:h")) != -1) {
+        switch (opt) {
+            case 'a': address = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'c': chunk_seconds = atof(optarg); break;
+            case 'r': max_retries = atoi(optarg); break;
+            case 'o': outdir = optarg; break;
+            case 'W': coordinator = optarg; break;
+            case 'j': slots = atoi(optarg); break;
+            case 'd': worker_tmpdir = optarg; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (coordinator) {
+        if (slots < 1) slots = 1;
+        if (slots > MAX_SLOTS) slots = MAX_SLOTS;
+        return run_worker(coordinator, slots);
+    }
+    if (!outdir || optind >= argc || chunk_seconds <= 0.0 || max_retries < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    return run_coordinator(address, port, outdir, chunk_seconds, argv + optind, argc - optind);
+}
@@ -0,0 +1,173 @@
+/**
+ * @file
+ * @brief Streaming RNNoise denoiser shared by all the tools.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "denoise_core.h"
+#include "rnnoise_probes.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#define FRAME_SIZE DENOISE_CORE_FRAME
+
+// Rounds a size up to whole cache lines.
+#define LINE_ROUND(n) (((n) + DENOISE_CORE_ALIGN - 1) & ~(size_t)(DENOISE_CORE_ALIGN - 1))
+
+struct DenoiseCore {
+    RNNModel *model;
+    DenoiseState *st;              // Right after this struct, in the same block.
+    int owned;                     // Allocated by denoise_core_create().
+    float vad;
+    float in_frame[FRAME_SIZE];    // Input gathered for the next frame.
+    float out_frame[FRAME_SIZE];   // Last denoised frame, being played out.
+    size_t pos;                    // Position in both frames.
+};
+
+size_t denoise_core_size(void) {
+    return LINE_ROUND(sizeof(DenoiseCore)) + LINE_ROUND((size_t)rnnoise_get_size());
+}
+
+DenoiseCore *denoise_core_init(void *mem, RNNModel *model) {
+    DenoiseCore *core = mem;
+    memset(core, 0, sizeof(*core));
+    core->model = model;
+    core->st = (DenoiseState *)((char *)mem + LINE_ROUND(sizeof(DenoiseCore)));
+    rnnoise_init(core->st, model);
+    return core;
+}
+
+DenoiseCore *denoise_core_create(RNNModel *model) {
+    // One block for the buffers and RNNoise's state, instead of two allocations.
+    void *mem;
+#ifdef _WIN32
+    mem = _aligned_malloc(denoise_core_size(), DENOISE_CORE_ALIGN);
+#else
+    if (posix_memalign(&mem, DENOISE_CORE_ALIGN, denoise_core_size()) != 0) mem = NULL;
+#endif
+    if (!mem) return NULL;
+    DenoiseCore *core = denoise_core_init(mem, model);
+    core->owned = 1;
+    return core;
+}
+
+void denoise_core_destroy(DenoiseCore *core) {
+    if (!core || !core->owned) return;
+#ifdef _WIN32
+    _aligned_free(core);
+#else
+    free(core);
+#endif
+}
+
+void denoise_core_reset(DenoiseCore *core) {
+    rnnoise_init(core->st, core->model);
+    memset(core->in_frame, 0, sizeof(core->in_frame));
+    memset(core->out_frame, 0, sizeof(core->out_frame));
+    core->pos = 0;
+    core->vad = 0.0f;
+}
+
+void denoise_core_warm_up(DenoiseCore *core, int frames) {
+    float frame[FRAME_SIZE];
+    uint32_t seed = 1;
+    for (int f = 0; f < frames; f++) {
+        // Quiet white noise, about -60 dBFS.
+        for (int i = 0; i < FRAME_SIZE; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            frame[i] = (float)((int32_t)(seed >> 16) - 32768) / 1000.0f;
+        }
+        denoise_core_process_frame(core, frame);
+    }
+    denoise_core_reset(core);
+}
+
+int denoise_core_latency(const DenoiseCore *core) {
+    (void)core;
+    return 2 * FRAME_SIZE;
+}
+
+float denoise_core_vad(const DenoiseCore *core) {
+    return core->vad;
+}
+
+float denoise_core_process_frame(DenoiseCore *core, float *frame) {
+    RNNOISE_PROBE1(frame_start, core);
+    core->vad = rnnoise_process_frame(core->st, frame, frame);
+    RNNOISE_PROBE2(frame_done, core, (int)(core->vad * 1000.0f));
+    return core->vad;
+}
+
+/**
+ * @brief Denoise the gathered frame once it is complete.
+ */
+static inline void advance(DenoiseCore *core, size_t count) {
+    core->pos += count;
+    if (core->pos == FRAME_SIZE) {
+        RNNOISE_PROBE1(frame_start, core);
+        core->vad = rnnoise_process_frame(core->st, core->out_frame, core->in_frame);
+        RNNOISE_PROBE2(frame_done, core, (int)(core->vad * 1000.0f));
+        core->pos = 0;
+    }
+}
+
+void denoise_core_process_s16(DenoiseCore *core, const int16_t *in, int16_t *out, size_t n) {
+    while (n > 0) {
+        // Up to the end of the current frame, so the inner loop has no branches on the position.
+        size_t count = FRAME_SIZE - core->pos;
+        if (count > n) count = n;
+        float *gather = core->in_frame + core->pos;
+        const float *ready = core->out_frame + core->pos;
+        // Each sample is read before it is overwritten, so in and out may alias.
+        for (size_t i = 0; i < count; i++) {
+            float v = ready[i];
+            gather[i] = in[i];
+            if (v > 32767.0f) v = 32767.0f;
+            if (v < -32768.0f) v = -32768.0f;
+            out[i] = (int16_t)v;
+        }
+        advance(core, count);
+        in += count;
+        out += count;
+        n -= count;
+    }
+}
+
+void denoise_core_process_float(DenoiseCore *core, const float *in, float *out, size_t n) {
+    while (n > 0) {
+        size_t count = FRAME_SIZE - core->pos;
+        if (count > n) count = n;
+        float *gather = core->in_frame + core->pos;
+        const float *ready = core->out_frame + core->pos;
+        for (size_t i = 0; i < count; i++) {
+            float v = ready[i];
+            // RNNoise works on samples in the 16-bit range.
+            gather[i] = in[i] * 32768.0f;
+            out[i] = v * (1.0f / 32768.0f);
+        }
+        advance(core, count);
+        in += count;
+        out += count;
+        n -= count;
+    }
+}
@@ -0,0 +1,112 @@
+/**
+ * @file
+ * @brief Streaming RNNoise denoiser shared by all the tools.
+ *
+ * Callers hand over buffers of any length, as 16-bit samples or as floats
+ * in -1..1, and get the same number of samples back. Samples are gathered
+ * into 480-sample frames internally, so the output is a constant
+ * denoise_core_latency() samples behind the input whatever the buffer
+ * sizes: one frame of buffering plus the frame RNNoise itself delays.
+ *
+ * Everything is allocated by denoise_core_create(), or placed in the
+ * caller's memory by denoise_core_init(). Processing never allocates, locks
+ * or does I/O, so it is safe in audio callbacks; so is denoise_core_reset()
+ * with the built-in model (RNNoise parses a file model's weights again).
+ *
+ * Tools that already work in whole frames (the offline engine, RTP and
+ * shared-memory servers) use denoise_core_process_frame() instead and
+ * handle RNNoise's frame of delay themselves, usually by dropping the
+ * first output frame.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ */
+
+#ifndef DENOISE_CORE_H
+#define DENOISE_CORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rnnoise/include/rnnoise.h"
+
+#define DENOISE_CORE_FRAME 480    // RNNoise frame size (10ms at 48kHz).
+#define DENOISE_CORE_RATE 48000   // The only sample rate RNNoise supports.
+#define DENOISE_CORE_ALIGN 64     // Denoisers start on a cache line.
+
+typedef struct DenoiseCore DenoiseCore;
+
+/**
+ * @brief Create a denoiser.
+ * @param model Model, or NULL for the built-in one. It may be shared by any
+ *        number of denoisers and must outlive them.
+ * @return The denoiser, or NULL when out of memory.
+ */
+DenoiseCore *denoise_core_create(RNNModel *model);
+
+/**
+ * @brief Free a denoiser from denoise_core_create(). Placed ones are left alone.
+ */
+void denoise_core_destroy(DenoiseCore *core);
+
+/**
+ * @brief Bytes needed to place a denoiser, RNNoise's state included.
+ */
+size_t denoise_core_size(void);
+
+/**
+ * @brief Place a denoiser in caller-provided memory (see denoise_arena.h).
+ * @param mem denoise_core_size() bytes aligned to DENOISE_CORE_ALIGN.
+ * @return The denoiser, at mem.
+ */
+DenoiseCore *denoise_core_init(void *mem, RNNModel *model);
+
+/**
+ * @brief Forget all audio so far, as if the denoiser were new.
+ */
+void denoise_core_reset(DenoiseCore *core);
+
+/**
+ * @brief Run synthetic audio through the denoiser, then reset it.
+ *
+ * Touches the model weights, state and code once, so the first real frames
+ * are not slowed by page faults and cold caches. Call it outside the audio
+ * callback, e.g. when the application starts.
+ *
+ * @param frames Frames to run; 50 (half a second) is plenty.
+ */
+void denoise_core_warm_up(DenoiseCore *core, int frames);
+
+/**
+ * @brief Delay of the streaming calls, in samples.
+ */
+int denoise_core_latency(const DenoiseCore *core);
+
+/**
+ * @brief Voice probability (0..1) of the last frame processed.
+ */
+float denoise_core_vad(const DenoiseCore *core);
+
+/**
+ * @brief Denoise n 16-bit samples. in and out may be the same buffer.
+ */
+void denoise_core_process_s16(DenoiseCore *core, const int16_t *in, int16_t *out, size_t n);
+
+/**
+ * @brief Denoise n float samples in -1..1. in and out may be the same buffer.
+ */
+void denoise_core_process_float(DenoiseCore *core, const float *in, float *out, size_t n);
+
+/**
+ * @brief Denoise one whole frame in place, bypassing the streaming buffers.
+ *
+ * Samples are floats in the 16-bit range, as RNNoise takes them. The output
+ * is one frame behind the input. Do not mix with the streaming calls
+ * without a reset in between.
+ *
+ * @return Voice probability of the frame.
+ */
+float denoise_core_process_frame(DenoiseCore *core, float *frame);
+
+#endif
@@ -0,0 +1,1216 @@
+/**
+ * @file
+ * @brief Offline WAV denoising engine with checkpoint and resume.
+ *
+ * The checkpoint is a small text file holding the identity of the input
+ * (size and modification time), the number of input frames done and the
+ * number of audio bytes written. It is only written after the output has
+ * been synced to disk, and replaced atomically (write to a temporary file,
+ * then rename), so whatever interrupts the job, the last checkpoint always
+ * describes data that is really in the output file.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// O_DIRECT for the io_uring output.
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "denoise_offline.h"
+#include "denoise_core.h"
+#include "rnnoise_probes.h"
+#include "uring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#define fsync _commit
+#define fileno _fileno
+#define ftruncate _chsize
+#define sleep_ms(ms) Sleep(ms)
+#else
+#include <unistd.h>
+#define sleep_ms(ms) usleep((ms) * 1000)
+#endif
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#define FRAME_SIZE 480     // RNNoise frame size (10ms at 48kHz).
+#define SAMPLE_RATE 48000  // Expected sample rate for RNNoise.
+
+#define CHECKPOINT_MAGIC "rnnoise-checkpoint 1"
+
+// How often follow mode looks at the input when no event arrives.
+#define FOLLOW_POLL_MS 100
+
+// Once the writer has closed the input, follow mode stops after this long
+// without growth (a writer may reopen the file to append).
+#define FOLLOW_CLOSE_GRACE_SECONDS 1.0
+
+// Frames per pipeline batch (1s of audio).
+#define PIPELINE_BATCH_FRAMES 100
+
+// Batches in flight between the pipeline stages; a power of two.
+#define PIPELINE_BATCHES 8
+
+// Times a pipeline stage yields before it starts sleeping on an empty or full ring.
+#define PIPELINE_SPINS 64
+
+// io_uring output: chunk size and alignment for O_DIRECT, and chunks in flight.
+#define DIRECT_CHUNK (1 << 20)
+#define DIRECT_ALIGN 4096
+#define DIRECT_CHUNKS 4
+
+#ifndef O_DIRECT
+#define O_DIRECT 0
+#endif
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+/**
+ * @brief Struct representing the WAV file header.
+ */
+typedef struct {
+    char riff[4];                  // "RIFF"
+    uint32_t file_size;            // Total file size minus 8 bytes
+    char wave[4];                  // "WAVE"
+    char fmt[4];                   // "fmt "
+    uint32_t fmt_size;             // Format chunk size (usually 16)
+    uint16_t format;               // Audio format (1 = PCM)
+    uint16_t channels;             // Number of audio channels
+    uint32_t sample_rate;          // Sampling rate (Hz)
+    uint32_t byte_rate;            // Bytes per second
+    uint16_t block_align;          // Block alignment (bytes per sample frame)
+    uint16_t bits_per_sample;      // Bits per sample (usually 16)
+    char data[4];                  // "data"
+    uint32_t data_size;            // Size of audio data in bytes
+} WavHeader;
+
+/**
+ * @brief Progress saved in the checkpoint file.
+ */
+typedef struct {
+    unsigned long long input_size;    // Input file size, to detect a different input.
+    long long input_mtime;            // Input modification time, likewise.
+    unsigned long long input_inode;   // Input inode; the only identity of a growing input.
+    unsigned long long frames;        // Input frames processed.
+    unsigned long long output_bytes;  // Audio bytes in the output after the header.
+} Checkpoint;
+
+static void s16_to_float_c(const int16_t *in, float *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (float)in[i];
+    }
+}
+
+static void float_to_s16_c(const float *in, int16_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        float sample = in[i];
+        if (sample > 32767.0f) sample = 32767.0f;
+        if (sample < -32768.0f) sample = -32768.0f;
+        out[i] = (int16_t)sample;
+    }
+}
+
+static void set_error(DenoiseResult *result, const char *message) {
+    snprintf(result->error, sizeof(result->error), "%s", message);
+}
+
+/**
+ * @brief Flush a stream and force its data to disk.
+ * @return 1 on success, 0 on failure.
+ */
+static int sync_file(FILE *file) {
+    if (fflush(file) != 0) return 0;
+    return fsync(fileno(file)) == 0;
+}
+
+/**
+ * @brief Atomically replace the checkpoint file.
+ * @param path Checkpoint path.
+ * @param ck Progress to save.
+ * @return 1 on success, 0 on failure.
+ */
+static int save_checkpoint(const char *path, const Checkpoint *ck) {
+    size_t len = strlen(path) + sizeof(".tmp");
+    char *tmp_path = malloc(len);
+    if (!tmp_path) return 0;
+    snprintf(tmp_path, len, "%s.tmp", path);
+
+    FILE *file = fopen(tmp_path, "w");
+    if (!file) {
+        free(tmp_path);
+        return 0;
+    }
+    int ok = fprintf(file, "%s\ninput_size=%llu\ninput_mtime=%lld\ninput_inode=%llu\nframes=%llu\noutput_bytes=%llu\n",
+                     CHECKPOINT_MAGIC, ck->input_size, ck->input_mtime, ck->input_inode, ck->frames,
+                     ck->output_bytes) > 0;
+    ok = sync_file(file) && ok;
+    ok = fclose(file) == 0 && ok;
+
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows.
+    if (ok) remove(path);
+#endif
+    ok = ok && rename(tmp_path, path) == 0;
+    if (!ok) remove(tmp_path);
+    free(tmp_path);
+    return ok;
+}
+
+/**
+ * @brief Read a checkpoint file.
+ * @return 1 if a well-formed checkpoint was read, 0 otherwise.
+ */
+static int load_checkpoint(const char *path, Checkpoint *ck) {
+    FILE *file = fopen(path, "r");
+    if (!file) return 0;
+
+    char magic[64];
+    int ok = fgets(magic, sizeof(magic), file) != NULL &&
+             strncmp(magic, CHECKPOINT_MAGIC "\n", sizeof(CHECKPOINT_MAGIC)) == 0 &&
+             fscanf(file, " input_size=%llu input_mtime=%lld input_inode=%llu frames=%llu output_bytes=%llu",
+                    &ck->input_size, &ck->input_mtime, &ck->input_inode, &ck->frames, &ck->output_bytes) == 5;
+    fclose(file);
+    return ok;
+}
+
+/**
+ * @brief Reopen the output of an interrupted run at its last checkpoint.
+ *
+ * Audio written after the checkpoint is cut off, since it may be partial.
+ *
+ * @return The output stream positioned for appending, or NULL to start over.
+ */
+static FILE *reopen_output(const char *path, const Checkpoint *ck) {
+    FILE *file = fopen(path, "r+b");
+    if (!file) return NULL;
+
+    struct stat st;
+    long end = (long)(sizeof(WavHeader) + ck->output_bytes);
+    if (fstat(fileno(file), &st) != 0 || (unsigned long long)st.st_size < (unsigned long long)end ||
+        fflush(file) != 0 || ftruncate(fileno(file), end) != 0 || fseek(file, end, SEEK_SET) != 0) {
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+/**
+ * @brief Sync the output, then record the progress that is now on disk.
+ * @return 1 on success, 0 on failure.
+ */
+static int write_checkpoint(FILE *fout, const char *path, const Checkpoint *ck) {
+    return sync_file(fout) && save_checkpoint(path, ck);
+}
+
+/**
+ * @brief Check whether a checkpoint was made for this input.
+ *
+ * A finished input must be unchanged. A followed input may have grown
+ * since, so only its inode and the audio already consumed are checked.
+ */
+static int checkpoint_matches(const Checkpoint *saved, const Checkpoint *now, int follow) {
+    if (!follow) {
+        return saved->input_size == now->input_size && saved->input_mtime == now->input_mtime;
+    }
+    return saved->input_inode == now->input_inode &&
+           now->input_size >= sizeof(WavHeader) + saved->frames * FRAME_SIZE * sizeof(int16_t);
+}
+
+/**
+ * @brief Rewrite the output header for the audio written so far.
+ *
+ * Leaves the stream at the end of the file.
+ *
+ * @return 1 on success, 0 on failure.
+ */
+static int update_output_header(FILE *fout, WavHeader header, unsigned long long data_bytes) {
+    header.data_size = (uint32_t)data_bytes;
+    header.file_size = header.data_size + sizeof(WavHeader) - 8;
+    return fseek(fout, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(WavHeader), 1, fout) == 1 &&
+           fseek(fout, 0, SEEK_END) == 0 && fflush(fout) == 0;
+}
+
+/**
+ * @brief Watches the input of a follow-mode job for new audio.
+ */
+typedef struct {
+    int fd;             // inotify descriptor, or -1 to poll the file size.
+    long long size;     // Input size last seen.
+    int closed;         // The writer closed the file.
+} Follower;
+
+static void follower_open(Follower *fw, const char *path, long long size) {
+    fw->fd = -1;
+    fw->size = size;
+    fw->closed = 0;
+#ifdef __linux__
+    fw->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fw->fd >= 0 && inotify_add_watch(fw->fd, path, IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+        close(fw->fd);
+        fw->fd = -1;
+    }
+#else
+    (void)path;
+#endif
+}
+
+static void follower_close(Follower *fw) {
+#ifdef __linux__
+    if (fw->fd >= 0) close(fw->fd);
+#endif
+    fw->fd = -1;
+}
+
+/**
+ * @brief Wait for the input to grow.
+ *
+ * Keeps calling the progress callback (which lets the GUI stay responsive)
+ * and the cancel callback while waiting.
+ *
+ * @return 1 if the input grew, 0 if the writer is done (closed the file or
+ *         idle too long), -1 if the job was cancelled.
+ */
+static int follower_wait(Follower *fw, FILE *fin, const DenoiseJob *job, double fraction) {
+    double idle_limit = job->follow_idle_seconds > 0.0 ? job->follow_idle_seconds : DENOISE_FOLLOW_IDLE_SECONDS;
+    double idle = 0.0;
+
+    while (1) {
+#ifdef __linux__
+        if (fw->fd >= 0) {
+            struct pollfd pfd = {fw->fd, POLLIN, 0};
+            if (poll(&pfd, 1, FOLLOW_POLL_MS) > 0) {
+                char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+                ssize_t len;
+                while ((len = read(fw->fd, events, sizeof(events))) > 0) {
+                    for (char *p = events; p < events + len;) {
+                        const struct inotify_event *ev = (const struct inotify_event *)p;
+                        if (ev->mask & IN_CLOSE_WRITE) fw->closed = 1;
+                        p += sizeof(struct inotify_event) + ev->len;
+                    }
+                }
+            }
+        } else {
+            sleep_ms(FOLLOW_POLL_MS);
+        }
+#else
+        sleep_ms(FOLLOW_POLL_MS);
+#endif
+
+        struct stat st;
+        if (fstat(fileno(fin), &st) == 0 && (long long)st.st_size > fw->size) {
+            fw->size = (long long)st.st_size;
+            fw->closed = 0;
+            return 1;
+        }
+        if (job->cancelled && job->cancelled(job->user)) return -1;
+        if (job->progress) job->progress(fraction, job->user);
+
+        idle += FOLLOW_POLL_MS / 1000.0;
+        if (idle >= (fw->closed ? FOLLOW_CLOSE_GRACE_SECONDS : idle_limit)) return 0;
+    }
+}
+
+/**
+ * @brief Output writer on io_uring with O_DIRECT.
+ *
+ * Audio is gathered into aligned chunks that are written whole, several
+ * in flight, bypassing the page cache where the file system allows. The
+ * unaligned tail is written through the stdio stream only when the output
+ * must be consistent on disk (before a checkpoint and at the end), and
+ * again as part of its chunk once that fills.
+ */
+typedef struct {
+    Uring ring;
+    const char *path;
+    int fd;                                // Output, opened with O_DIRECT when possible.
+    int direct;                            // fd bypasses the page cache.
+    unsigned char *chunks[DIRECT_CHUNKS];
+    uint64_t offset[DIRECT_CHUNKS];        // File offset of each chunk.
+    size_t written[DIRECT_CHUNKS];         // Bytes of a chunk's write done so far.
+    int busy[DIRECT_CHUNKS];               // Write in flight.
+    int queued_direct[DIRECT_CHUNKS];      // That write went to the O_DIRECT descriptor.
+    int current;                           // Chunk being filled.
+    size_t fill;                           // Bytes in the current chunk.
+} DirectWriter;
+
+/**
+ * @brief Queue (the rest of) a full chunk's write.
+ */
+static int direct_queue(DirectWriter *w, int i) {
+    size_t done = w->written[i];
+    w->queued_direct[i] = w->direct;
+    return uring_queue_write(&w->ring, w->fd, w->chunks[i] + done, (unsigned)(DIRECT_CHUNK - done),
+                             w->offset[i] + done, i, (uint64_t)i) &&
+           uring_submit(&w->ring);
+}
+
+/**
+ * @brief Wait for one write to complete, retrying it if needed.
+ * @return 1 on success, 0 on failure.
+ */
+static int direct_reap(DirectWriter *w) {
+    UringCompletion c;
+    if (!uring_complete(&w->ring, &c, 1)) return 0;
+    int i = (int)c.user_data;
+    if (c.res == -EINVAL && w->queued_direct[i]) {
+        if (w->direct) {
+            // The file system refused direct I/O after all: go through the
+            // page cache. Writes still in flight keep their own reference to
+            // the old descriptor.
+            int fd = open(w->path, O_WRONLY | O_CLOEXEC);
+            if (fd < 0) return 0;
+            close(w->fd);
+            w->fd = fd;
+            w->direct = 0;
+        }
+        // The other direct writes in flight may fail the same way; each is
+        // sent again through the page cache as it is reaped.
+        return direct_queue(w, i);
+    }
+    if (c.res == -EINTR || c.res == -EAGAIN) return direct_queue(w, i);
+    if (c.res <= 0) return 0;
+    w->written[i] += (size_t)c.res;
+    if (w->written[i] < DIRECT_CHUNK) return direct_queue(w, i);
+    w->busy[i] = 0;
+    return 1;
+}
+
+/**
+ * @brief Wait for all writes in flight.
+ * @return 1 on success, 0 on failure.
+ */
+static int direct_drain(DirectWriter *w) {
+    int ok = 1;
+    for (int i = 0; i < DIRECT_CHUNKS; i++) {
+        while (w->busy[i]) {
+            if (!direct_reap(w)) {
+                // Give up on this write; the run fails.
+                w->busy[i] = 0;
+                ok = 0;
+            }
+        }
+    }
+    return ok;
+}
+
+static void direct_writer_close(DirectWriter *w) {
+    direct_drain(w);
+    if (w->fd >= 0) close(w->fd);
+    uring_exit(&w->ring);
+    for (int i = 0; i < DIRECT_CHUNKS; i++) free(w->chunks[i]);
+    free(w);
+}
+
+/**
+ * @brief Start writing the output through io_uring.
+ *
+ * The output must already hold the header (and, on resume, the audio up
+ * to the checkpoint); fout's position marks where new audio goes.
+ *
+ * @return The writer, or NULL if io_uring or the buffers are not available.
+ */
+static DirectWriter *direct_writer_open(const char *path, FILE *fout) {
+    long end = ftell(fout);
+    if (end < 0 || fflush(fout) != 0) return NULL;
+
+    DirectWriter *w = calloc(1, sizeof(DirectWriter));
+    if (!w) return NULL;
+    w->fd = -1;
+    w->path = path;
+    if (!uring_init(&w->ring, DIRECT_CHUNKS * 2)) {
+        direct_writer_close(w);
+        return NULL;
+    }
+    for (int i = 0; i < DIRECT_CHUNKS; i++) {
+        void *chunk = NULL;
+        if (posix_memalign(&chunk, DIRECT_ALIGN, DIRECT_CHUNK) != 0) {
+            direct_writer_close(w);
+            return NULL;
+        }
+        w->chunks[i] = chunk;
+    }
+    // Without registration the writes still work, just with per-request pinning.
+    uring_register_buffers(&w->ring, (void *const *)w->chunks, DIRECT_CHUNK, DIRECT_CHUNKS);
+
+    w->fd = open(path, O_RDWR | O_DIRECT | O_CLOEXEC);
+    w->direct = w->fd >= 0;
+    if (w->fd < 0) w->fd = open(path, O_RDWR | O_CLOEXEC);
+    if (w->fd < 0) {
+        direct_writer_close(w);
+        return NULL;
+    }
+
+    // The first chunk starts at the aligned offset below the end and holds
+    // the bytes already in the file before it.
+    w->offset[0] = (uint64_t)end & ~(uint64_t)(DIRECT_ALIGN - 1);
+    w->fill = (size_t)((uint64_t)end - w->offset[0]);
+    if (w->fill > 0 && pread(w->fd, w->chunks[0], DIRECT_ALIGN, (off_t)w->offset[0]) < (ssize_t)w->fill) {
+        direct_writer_close(w);
+        return NULL;
+    }
+    return w;
+}
+
+/**
+ * @brief Append audio to the output.
+ * @return 1 on success, 0 on failure.
+ */
+static int direct_writer_append(DirectWriter *w, const void *data, size_t n) {
+    const unsigned char *p = data;
+    while (n > 0) {
+        size_t take = DIRECT_CHUNK - w->fill < n ? DIRECT_CHUNK - w->fill : n;
+        memcpy(w->chunks[w->current] + w->fill, p, take);
+        w->fill += take;
+        p += take;
+        n -= take;
+        if (w->fill < DIRECT_CHUNK) break;
+
+        // The chunk is full: write it and continue in the next free one.
+        int i = w->current;
+        w->written[i] = 0;
+        w->busy[i] = 1;
+        if (!direct_queue(w, i)) return 0;
+        int next = (i + 1) % DIRECT_CHUNKS;
+        while (w->busy[next]) {
+            if (!direct_reap(w)) return 0;
+        }
+        w->offset[next] = w->offset[i] + DIRECT_CHUNK;
+        w->current = next;
+        w->fill = 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Get everything appended so far into the file.
+ *
+ * Leaves fout positioned at the end of the audio, so it can be synced and
+ * its header rewritten as with stdio output.
+ *
+ * @return 1 on success, 0 on failure.
+ */
+static int direct_writer_flush(DirectWriter *w, FILE *fout) {
+    if (!direct_drain(w)) return 0;
+    uint64_t offset = w->offset[w->current];
+    return fseek(fout, (long)offset, SEEK_SET) == 0 &&
+           fwrite(w->chunks[w->current], 1, w->fill, fout) == w->fill && fflush(fout) == 0;
+}
+
+/**
+ * @brief State of a running job, shared by the serial loop and the pipeline.
+ */
+typedef struct {
+    const DenoiseJob *job;
+    DenoiseResult *result;
+    FILE *fin;
+    FILE *fout;
+    DenoiseCore *core;
+    WavHeader header;
+    const char *ckpt_path;
+    Checkpoint ck;
+    unsigned long long start_frame;       // First frame written (frames before it are replayed).
+    unsigned long long frame;             // Next input frame.
+    unsigned long long checkpoint_every;  // Frames between checkpoints, or 0.
+    unsigned long long next_checkpoint;
+    size_t total_samples;                 // Input size, for the progress callback.
+    void (*to_float)(const int16_t *in, float *out, size_t n);
+    void (*to_s16)(const float *in, int16_t *out, size_t n);
+    unsigned long long input_size;
+    DirectWriter *writer;                 // io_uring output, or NULL for stdio.
+} Run;
+
+/**
+ * @brief Denoise one frame in place.
+ * @param pcm Samples of the frame.
+ * @param read Number of samples; a short last frame is zero padded.
+ */
+static void denoise_frame(Run *r, int16_t *pcm, size_t read) {
+    float x[FRAME_SIZE];  // Float buffer for RNNoise processing
+
+    r->to_float(pcm, x, read);
+
+    // Zero padding for last frame.
+    for (size_t i = read; i < FRAME_SIZE; i++) {
+        x[i] = 0.0f;
+    }
+
+    // Apply RNNoise.
+    denoise_core_process_frame(r->core, x);
+    r->to_s16(x, pcm, read);
+}
+
+/**
+ * @brief Write a denoised frame, then report progress and checkpoint as due.
+ * @return 1 to go on, 0 when cancelled (after a checkpoint), -1 on failure.
+ */
+static int finish_frame(Run *r, const int16_t *pcm, size_t read) {
+    const DenoiseJob *job = r->job;
+
+    // Skip first frame (RNNoise warm-up) and frames replayed on resume.
+    if (r->frame != 0 && r->frame >= r->start_frame) {
+        int written = r->writer ? direct_writer_append(r->writer, pcm, read * sizeof(int16_t))
+                                : fwrite(pcm, sizeof(int16_t), read, r->fout) == read;
+        if (!written) {
+            set_error(r->result, "Failed to write the output file.");
+            return -1;
+        }
+        r->ck.output_bytes += read * sizeof(int16_t);
+    }
+    r->frame++;
+
+    // Update progress.
+    if (job->progress && r->total_samples > 0) {
+        double fraction = (double)(r->frame * FRAME_SIZE) / r->total_samples;
+        job->progress(fraction < 1.0 ? fraction : 1.0, job->user);
+    }
+
+    if (r->frame <= r->start_frame) return 1;
+    r->ck.frames = r->frame;
+
+    int cancel = job->cancelled && job->cancelled(job->user);
+    if (cancel || (r->checkpoint_every && r->frame >= r->next_checkpoint)) {
+        // The output must be on disk before the checkpoint refers to it.
+        if (r->writer && !direct_writer_flush(r->writer, r->fout)) {
+            set_error(r->result, "Failed to write the output file.");
+            return -1;
+        }
+        if (!write_checkpoint(r->fout, r->ckpt_path, &r->ck)) {
+            set_error(r->result, "Failed to write the checkpoint file.");
+            return -1;
+        }
+        r->next_checkpoint = r->frame + r->checkpoint_every;
+    }
+    if (cancel) {
+        r->result->cancelled = 1;
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Read, denoise and write one frame at a time on the calling thread.
+ *
+ * Used for follow mode, where the input arrives at recording speed and
+ * there is nothing to overlap.
+ *
+ * @return 1 on success or cancel, 0 on failure.
+ */
+static int run_serial(Run *r, struct stat *in_stat) {
+    const DenoiseJob *job = r->job;
+    int16_t tmp[FRAME_SIZE];  // Temporary buffer for raw PCM data
+    int ok = 1;
+
+    // A growing file's header does not describe its audio yet.
+    Follower follower = {-1, 0, 0};
+    int following = job->follow;
+    unsigned long long header_bytes = r->ck.output_bytes;
+    if (following) {
+        follower_open(&follower, job->input_path, (long long)in_stat->st_size);
+        r->total_samples = (in_stat->st_size - sizeof(WavHeader)) / sizeof(int16_t);
+    }
+
+    // Process each frame of audio.
+    while (1) {
+        long frame_pos = following ? ftell(r->fin) : 0;
+        size_t read = fread(tmp, sizeof(int16_t), FRAME_SIZE, r->fin);
+
+        // In follow mode only whole frames are processed until the writer is done.
+        if (following && read < FRAME_SIZE) {
+            if (ferror(r->fin)) {
+                set_error(r->result, "Failed to read the input file.");
+                ok = 0;
+                break;
+            }
+            // Rewind to the frame start: fread may also have taken half a sample.
+            clearerr(r->fin);
+            if (fseek(r->fin, frame_pos, SEEK_SET) != 0) {
+                set_error(r->result, "Failed to read the input file.");
+                ok = 0;
+                break;
+            }
+
+            // Publish what is done so far before waiting for more.
+            if (r->ck.output_bytes != header_bytes) {
+                if (!update_output_header(r->fout, r->header, r->ck.output_bytes)) {
+                    set_error(r->result, "Failed to write the output WAV file header.");
+                    ok = 0;
+                    break;
+                }
+                header_bytes = r->ck.output_bytes;
+            }
+
+            double fraction = r->total_samples ? (double)(r->frame * FRAME_SIZE) / r->total_samples : 0.0;
+            int status = follower_wait(&follower, r->fin, job, fraction < 1.0 ? fraction : 1.0);
+            if (status < 0) {
+                if (!write_checkpoint(r->fout, r->ckpt_path, &r->ck)) {
+                    set_error(r->result, "Failed to write the checkpoint file.");
+                    ok = 0;
+                } else {
+                    r->result->cancelled = 1;
+                }
+                break;
+            }
+            if (status == 0) following = 0;
+            r->total_samples = (follower.size - sizeof(WavHeader)) / sizeof(int16_t);
+            continue;
+        }
+
+        if (read == 0) {
+            if (ferror(r->fin)) {
+                set_error(r->result, "Failed to read the input file.");
+                ok = 0;
+            }
+            break;
+        }
+
+        denoise_frame(r, tmp, read);
+        int status = finish_frame(r, tmp, read);
+        if (status < 0) ok = 0;
+        if (status <= 0) break;
+    }
+
+    if (job->follow) follower_close(&follower);
+    return ok;
+}
+
+/**
+ * @brief A batch of input frames travelling through the pipeline.
+ */
+typedef struct {
+    int16_t pcm[PIPELINE_BATCH_FRAMES * FRAME_SIZE];
+    size_t samples;     // Valid samples in pcm.
+    int last;           // End of the input: no batch follows.
+    int error;          // The input could not be read.
+
+    // io_uring reader state.
+    uint64_t offset;    // File offset of pcm[0].
+    size_t want;        // Bytes requested.
+    size_t got;         // Bytes read so far.
+    int done;           // The read is complete.
+} Batch;
+
+/**
+ * @brief Lock-free single-producer, single-consumer ring of batches.
+ *
+ * head and tail count pops and pushes; they sit on separate cache lines so
+ * the two threads do not contend for them.
+ */
+typedef struct {
+    Batch *slots[PIPELINE_BATCHES];
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) atomic_size_t tail;
+} BatchRing;
+
+static int ring_push(BatchRing *q, Batch *b) {
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&q->head, memory_order_acquire) == PIPELINE_BATCHES) return 0;
+    q->slots[tail % PIPELINE_BATCHES] = b;
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+static Batch *ring_pop(BatchRing *q) {
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    if (head == atomic_load_explicit(&q->tail, memory_order_acquire)) return NULL;
+    Batch *b = q->slots[head % PIPELINE_BATCHES];
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return b;
+}
+
+enum { STAGE_READ, STAGE_DENOISE, STAGE_WRITE, STAGE_COUNT };
+
+/**
+ * @brief Reader, denoiser and writer connected by rings.
+ *
+ * Batches circulate free -> filled -> denoised -> free, so no memory is
+ * allocated while the job runs.
+ */
+typedef struct {
+    Run *run;
+    BatchRing free;        // Writer to reader: empty batches.
+    BatchRing filled;      // Reader to denoiser: input audio.
+    BatchRing denoised;    // Denoiser to writer: output audio.
+    atomic_int stop;       // The writer is done; the other stages exit.
+    double stall[STAGE_COUNT];
+
+    // io_uring reader.
+    Batch *batches;
+    Uring read_ring;
+    uint64_t read_offset;  // Where the audio to read starts.
+    uint64_t read_end;     // End of the whole samples in the input.
+} Pipeline;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Back off while a ring is empty or full: yield first, then sleep.
+ */
+static void pipeline_pause(int spins) {
+    if (spins < PIPELINE_SPINS) {
+        sched_yield();
+    } else {
+        sleep_ms(1);
+    }
+}
+
+/**
+ * @brief Push a batch, waiting while the ring is full.
+ * @return 1 on success, 0 if the pipeline was stopped.
+ */
+static int pipeline_push(Pipeline *p, BatchRing *q, Batch *b, int stage) {
+    if (ring_push(q, b)) return 1;
+    double start = now_seconds();
+    int ok = 1;
+    for (int spins = 0; !ring_push(q, b); spins++) {
+        if (atomic_load(&p->stop)) {
+            ok = 0;
+            break;
+        }
+        pipeline_pause(spins);
+    }
+    p->stall[stage] += now_seconds() - start;
+    return ok;
+}
+
+/**
+ * @brief Pop a batch, waiting while the ring is empty.
+ * @return The batch, or NULL if the pipeline was stopped.
+ */
+static Batch *pipeline_pop(Pipeline *p, BatchRing *q, int stage) {
+    Batch *b = ring_pop(q);
+    if (b) return b;
+    double start = now_seconds();
+    for (int spins = 0; (b = ring_pop(q)) == NULL; spins++) {
+        if (atomic_load(&p->stop)) break;
+        pipeline_pause(spins);
+    }
+    p->stall[stage] += now_seconds() - start;
+    return b;
+}
+
+static void *reader_main(void *arg) {
+    Pipeline *p = arg;
+    Batch *b;
+    while ((b = pipeline_pop(p, &p->free, STAGE_READ)) != NULL) {
+        b->samples = fread(b->pcm, sizeof(int16_t), PIPELINE_BATCH_FRAMES * FRAME_SIZE, p->run->fin);
+        b->error = ferror(p->run->fin) != 0;
+        b->last = b->samples < PIPELINE_BATCH_FRAMES * FRAME_SIZE;
+        int last = b->last;
+        if (!pipeline_push(p, &p->filled, b, STAGE_READ) || last) break;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Hand finished reads on in file order.
+ * @return 1 to go on, 0 once the last batch was handed on or the pipeline stopped.
+ */
+static int reader_uring_deliver(Pipeline *p, Batch **inflight, int *head, int *count) {
+    while (*count > 0 && inflight[*head]->done) {
+        Batch *b = inflight[*head];
+        *head = (*head + 1) % PIPELINE_BATCHES;
+        (*count)--;
+        b->samples = b->got / sizeof(int16_t);
+        b->last = b->error || b->got < b->want || b->offset + b->got >= p->read_end;
+        int last = b->last;
+        if (!pipeline_push(p, &p->filled, b, STAGE_READ) || last) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Reader stage on io_uring: keeps a read in flight for every free batch.
+ *
+ * Reads may complete in any order; batches are handed on in file order.
+ */
+static void *reader_uring_main(void *arg) {
+    Pipeline *p = arg;
+    int fd = fileno(p->run->fin);
+    const size_t batch_bytes = sizeof(((Batch *)0)->pcm);
+    uint64_t next = p->read_offset;
+    Batch *inflight[PIPELINE_BATCHES];  // Submitted batches in file order.
+    int head = 0, count = 0, outstanding = 0;
+
+    if (next >= p->read_end) {
+        // No audio: just tell the other stages.
+        Batch *b = pipeline_pop(p, &p->free, STAGE_READ);
+        if (b) {
+            b->samples = 0;
+            b->error = 0;
+            b->last = 1;
+            pipeline_push(p, &p->filled, b, STAGE_READ);
+        }
+        return NULL;
+    }
+
+    int running = 1;
+    while (running) {
+        // Start reads ahead into every free batch.
+        while (count < PIPELINE_BATCHES && next < p->read_end) {
+            Batch *b = count == 0 ? pipeline_pop(p, &p->free, STAGE_READ) : ring_pop(&p->free);
+            if (!b) break;
+            b->offset = next;
+            b->want = p->read_end - next < batch_bytes ? (size_t)(p->read_end - next) : batch_bytes;
+            b->got = 0;
+            b->done = 0;
+            b->error = 0;
+            int index = (int)(b - p->batches);
+            if (!uring_queue_read(&p->read_ring, fd, b->pcm, (unsigned)b->want, b->offset, index, index)) {
+                ring_push(&p->free, b);
+                break;
+            }
+            outstanding++;
+            next += b->want;
+            inflight[(head + count) % PIPELINE_BATCHES] = b;
+            count++;
+        }
+        if (count == 0) break;  // Stopped while waiting for a free batch.
+
+        UringCompletion c;
+        if (!uring_complete(&p->read_ring, &c, 1)) {
+            // The ring itself failed: report it with the oldest batch.
+            inflight[head]->error = 1;
+            inflight[head]->done = 1;
+            reader_uring_deliver(p, inflight, &head, &count);
+            break;
+        }
+        outstanding--;
+        Batch *b = &p->batches[c.user_data];
+        if (c.res == -EINTR || c.res == -EAGAIN || (c.res > 0 && b->got + (size_t)c.res < b->want)) {
+            // Interrupted or short read: ask for the rest.
+            if (c.res > 0) b->got += (size_t)c.res;
+            if (uring_queue_read(&p->read_ring, fd, (char *)b->pcm + b->got, (unsigned)(b->want - b->got),
+                                 b->offset + b->got, (int)c.user_data, c.user_data)) {
+                outstanding++;
+                continue;
+            }
+            b->error = 1;
+        } else if (c.res < 0) {
+            b->error = 1;
+        } else {
+            // A zero-byte read means the file shrank: end the input here.
+            b->got += (size_t)c.res;
+        }
+        b->done = 1;
+        running = reader_uring_deliver(p, inflight, &head, &count);
+    }
+
+    // The kernel may still be filling batches; they must not be released before it is done.
+    UringCompletion c;
+    while (outstanding > 0 && uring_complete(&p->read_ring, &c, 1)) outstanding--;
+    return NULL;
+}
+
+static void *denoiser_main(void *arg) {
+    Pipeline *p = arg;
+    Batch *b;
+    while ((b = pipeline_pop(p, &p->filled, STAGE_DENOISE)) != NULL) {
+        for (size_t i = 0; i < b->samples; i += FRAME_SIZE) {
+            size_t read = b->samples - i < FRAME_SIZE ? b->samples - i : FRAME_SIZE;
+            denoise_frame(p->run, b->pcm + i, read);
+        }
+        int last = b->last;
+        if (!pipeline_push(p, &p->denoised, b, STAGE_DENOISE) || last) break;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Read, denoise and write on three threads so I/O and compute overlap.
+ *
+ * The calling thread is the writer, so the progress and cancel callbacks
+ * run on the same thread as with run_serial().
+ *
+ * @return 1 on success or cancel, 0 on failure, -1 if the threads could
+ *         not be started (nothing was consumed).
+ */
+static int run_pipeline(Run *r) {
+    Pipeline *p = calloc(1, sizeof(Pipeline));
+    Batch *batches = malloc(PIPELINE_BATCHES * sizeof(Batch));
+    if (!p || !batches) {
+        free(p);
+        free(batches);
+        return -1;
+    }
+    p->run = r;
+    p->batches = batches;
+    p->read_ring.fd = -1;
+    for (int i = 0; i < PIPELINE_BATCHES; i++) ring_push(&p->free, &batches[i]);
+
+    // io_uring where asked for and available; stdio otherwise.
+    void *(*reader_fn)(void *) = reader_main;
+    long start = ftell(r->fin);
+    if (r->job->io_uring && start >= 0 && uring_init(&p->read_ring, PIPELINE_BATCHES * 2)) {
+        void *bufs[PIPELINE_BATCHES];
+        for (int i = 0; i < PIPELINE_BATCHES; i++) bufs[i] = batches[i].pcm;
+        uring_register_buffers(&p->read_ring, bufs, sizeof(batches[0].pcm), PIPELINE_BATCHES);
+        p->read_offset = (uint64_t)start;
+        p->read_end = p->read_offset;
+        if (r->input_size > p->read_offset) {
+            p->read_end += (r->input_size - p->read_offset) / sizeof(int16_t) * sizeof(int16_t);
+        }
+        reader_fn = reader_uring_main;
+        r->result->io_uring_reads = 1;
+    } else if (r->job->io_uring) {
+        RNNOISE_PROBE1(engine_fallback, "stdio reads");
+    }
+    if (r->job->io_uring) {
+        r->writer = direct_writer_open(r->job->output_path, r->fout);
+        r->result->io_uring_writes = r->writer != NULL;
+        if (!r->writer) RNNOISE_PROBE1(engine_fallback, "stdio writes");
+    }
+
+    pthread_t reader, denoiser;
+    int started = pthread_create(&reader, NULL, reader_fn, p) == 0;
+    if (started && pthread_create(&denoiser, NULL, denoiser_main, p) != 0) {
+        atomic_store(&p->stop, 1);
+        pthread_join(reader, NULL);
+        started = 0;
+    }
+    int ok = started ? 1 : -1;
+
+    Batch *b;
+    while (started && (b = pipeline_pop(p, &p->denoised, STAGE_WRITE)) != NULL) {
+        int status = 1;
+        for (size_t i = 0; status > 0 && i < b->samples; i += FRAME_SIZE) {
+            size_t read = b->samples - i < FRAME_SIZE ? b->samples - i : FRAME_SIZE;
+            status = finish_frame(r, b->pcm + i, read);
+        }
+        if (status > 0 && b->error) {
+            set_error(r->result, "Failed to read the input file.");
+            status = -1;
+        }
+        if (status < 0) ok = 0;
+        if (status <= 0 || b->last) break;
+        pipeline_push(p, &p->free, b, STAGE_WRITE);
+    }
+
+    if (started) {
+        atomic_store(&p->stop, 1);
+        pthread_join(reader, NULL);
+        pthread_join(denoiser, NULL);
+    }
+
+    if (r->writer) {
+        // Leave the output in the same state as stdio would.
+        if (ok > 0 && !direct_writer_flush(r->writer, r->fout)) {
+            set_error(r->result, "Failed to write the output file.");
+            ok = 0;
+        }
+        r->result->direct_writes = r->writer->direct;
+        direct_writer_close(r->writer);
+        r->writer = NULL;
+    }
+    if (ok < 0) {
+        // Nothing was consumed; the caller runs the job serially instead.
+        if (fseek(r->fin, start, SEEK_SET) != 0) {
+            set_error(r->result, "Failed to read the input file.");
+            ok = 0;
+        }
+        r->result->io_uring_reads = r->result->io_uring_writes = r->result->direct_writes = 0;
+    }
+
+    r->result->read_stall_seconds = p->stall[STAGE_READ];
+    r->result->denoise_stall_seconds = p->stall[STAGE_DENOISE];
+    r->result->write_stall_seconds = p->stall[STAGE_WRITE];
+    uring_exit(&p->read_ring);
+    free(p);
+    free(batches);
+    return ok;
+}
+
+int denoise_offline_run(const DenoiseJob *job, DenoiseResult *result) {
+    void (*to_float)(const int16_t *, float *, size_t) = job->s16_to_float ? job->s16_to_float : s16_to_float_c;
+    void (*to_s16)(const float *, int16_t *, size_t) = job->float_to_s16 ? job->float_to_s16 : float_to_s16_c;
+
+    memset(result, 0, sizeof(*result));
+
+    FILE *fin = fopen(job->input_path, "rb");
+    struct stat in_stat;
+    if (!fin || fstat(fileno(fin), &in_stat) != 0) {
+        if (fin) fclose(fin);
+        set_error(result, "Could not open the input file.");
+        return 0;
+    }
+
+    WavHeader header;
+    if (fread(&header, sizeof(WavHeader), 1, fin) != 1) {
+        fclose(fin);
+        set_error(result, "Failed to read the input WAV file header.");
+        return 0;
+    }
+
+    // Validate WAV header contents.
+    if (memcmp(header.riff, "RIFF", 4) != 0 ||
+        memcmp(header.wave, "WAVE", 4) != 0 ||
+        memcmp(header.fmt, "fmt ", 4) != 0 ||
+        memcmp(header.data, "data", 4) != 0) {
+        fclose(fin);
+        set_error(result, "Invalid input WAV file.");
+        return 0;
+    }
+
+    // Only 48kHz, 16-bit, mono files are supported.
+    if (header.channels != 1 || header.sample_rate != SAMPLE_RATE || header.bits_per_sample != 16) {
+        fclose(fin);
+        set_error(result, "Only mono 16-bit 48kHz WAV files are supported.");
+        return 0;
+    }
+
+    size_t ckpt_len = strlen(job->output_path) + sizeof(DENOISE_CHECKPOINT_SUFFIX);
+    char *ckpt_path = malloc(ckpt_len);
+    if (!ckpt_path) {
+        fclose(fin);
+        set_error(result, "Out of memory.");
+        return 0;
+    }
+    snprintf(ckpt_path, ckpt_len, "%s%s", job->output_path, DENOISE_CHECKPOINT_SUFFIX);
+
+    Checkpoint ck = {(unsigned long long)in_stat.st_size, (long long)in_stat.st_mtime,
+                     (unsigned long long)in_stat.st_ino, 0, 0};
+    FILE *fout = NULL;
+
+    // Pick up an interrupted run of the same input.
+    Checkpoint saved;
+    if (job->resume && load_checkpoint(ckpt_path, &saved) && checkpoint_matches(&saved, &ck, job->follow)) {
+        fout = reopen_output(job->output_path, &saved);
+        if (fout) ck = saved;
+    }
+
+    if (!fout) {
+        // Replace the output rather than truncating it, so that files hard
+        // linked to an earlier output (e.g. cache entries) keep their contents.
+        remove(job->output_path);
+        fout = fopen(job->output_path, "wb");
+        if (!fout) {
+            fclose(fin);
+            free(ckpt_path);
+            set_error(result, "Could not create the output file.");
+            return 0;
+        }
+        if (fwrite(&header, sizeof(WavHeader), 1, fout) != 1) {
+            fclose(fin);
+            fclose(fout);
+            free(ckpt_path);
+            set_error(result, "Failed to write the output WAV file header.");
+            return 0;
+        }
+        // A checkpoint left over from another run no longer applies.
+        remove(ckpt_path);
+    }
+
+    // Create RNNoise state.
+    DenoiseCore *core = denoise_core_create(job->model);
+    if (!core) {
+        fclose(fin);
+        fclose(fout);
+        free(ckpt_path);
+        set_error(result, "Failed to initialize RNNoise.");
+        return 0;
+    }
+
+    // Rebuild RNNoise's state by replaying the frames just before the
+    // checkpoint. From the start of the file the replay is exact.
+    unsigned long long start_frame = ck.frames;
+    unsigned long long warmup = job->warmup_frames > 0 ? (unsigned long long)job->warmup_frames
+                                                       : DENOISE_WARMUP_FRAMES;
+    unsigned long long frame = start_frame > warmup ? start_frame - warmup : 0;
+    if (fseek(fin, (long)(sizeof(WavHeader) + frame * FRAME_SIZE * sizeof(int16_t)), SEEK_SET) != 0) {
+        denoise_core_destroy(core);
+        fclose(fin);
+        fclose(fout);
+        free(ckpt_path);
+        set_error(result, "Failed to read the input file.");
+        return 0;
+    }
+    result->resumed_frames = start_frame;
+
+    unsigned long long checkpoint_every = 0;
+    if (job->checkpoint_seconds > 0.0) {
+        checkpoint_every = (unsigned long long)(job->checkpoint_seconds * SAMPLE_RATE / FRAME_SIZE);
+        if (checkpoint_every == 0) checkpoint_every = 1;
+    }
+
+    Run run = {
+        .job = job,
+        .result = result,
+        .fin = fin,
+        .fout = fout,
+        .core = core,
+        .header = header,
+        .ckpt_path = ckpt_path,
+        .ck = ck,
+        .start_frame = start_frame,
+        .frame = frame,
+        .checkpoint_every = checkpoint_every,
+        .next_checkpoint = start_frame + checkpoint_every,
+        .total_samples = header.data_size / sizeof(int16_t),
+        .to_float = to_float,
+        .to_s16 = to_s16,
+        .input_size = (unsigned long long)in_stat.st_size,
+    };
+    int ok = job->follow ? -1 : run_pipeline(&run);
+    if (ok < 0) {
+        if (!job->follow) RNNOISE_PROBE1(engine_fallback, "serial");
+        ok = run_serial(&run, &in_stat);
+    }
+    ck = run.ck;
+    result->frames = run.frame;
+
+    // Cleanup.
+    denoise_core_destroy(core);
+    fclose(fin);
+
+    if (ok && !result->cancelled) {
+        // Record the size actually written: the warm-up frame is not in the output.
+        if (!update_output_header(fout, header, ck.output_bytes) || !sync_file(fout)) {
+            set_error(result, "Failed to write the output WAV file header.");
+            ok = 0;
+        }
+    }
+    if (fclose(fout) != 0 && ok) {
+        set_error(result, "Failed to write the output file.");
+        ok = 0;
+    }
+
+    // The checkpoint stays while the output is incomplete.
+    if (ok && !result->cancelled) remove(ckpt_path);
+    free(ckpt_path);
+    return ok;
+}
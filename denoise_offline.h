@@ -0,0 +1,116 @@
+/**
+ * @file
+ * @brief Offline WAV denoising engine with checkpoint and resume.
+ *
+ * Shared by rnnoise_gui, rnnoise_gui_static and rnnoise_batch. The engine
+ * has no GTK dependency: progress and cancellation go through callbacks.
+ *
+ * While it runs, the engine periodically syncs the output and writes a
+ * checkpoint next to it (output path + ".ckpt"). A later run on the same
+ * input and output picks up from the last checkpoint instead of starting
+ * over. RNNoise's state holds pointers and cannot be saved, so on resume
+ * the engine replays a short window of input before the checkpoint to
+ * rebuild it, discarding that output.
+ *
+ * Reading, denoising and writing run on separate threads connected by
+ * bounded queues of large batches, so disk I/O and RNNoise overlap.
+ *
+ * In follow mode the engine tails an input that is still being recorded
+ * (inotify on Linux, polling elsewhere), so clean audio is available
+ * shortly behind the live recording.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ */
+
+#ifndef DENOISE_OFFLINE_H
+#define DENOISE_OFFLINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rnnoise/include/rnnoise.h"
+
+#define DENOISE_CHECKPOINT_SUFFIX ".ckpt"
+
+// Default audio between checkpoints, in seconds.
+#define DENOISE_CHECKPOINT_SECONDS 60.0
+
+// Default frames replayed before the checkpoint on resume (2s).
+#define DENOISE_WARMUP_FRAMES 200
+
+// Default time a followed input may stop growing before the job ends.
+#define DENOISE_FOLLOW_IDLE_SECONDS 10.0
+
+/**
+ * @brief Description of an offline denoise job.
+ */
+typedef struct {
+    const char *input_path;    // Mono 16-bit 48kHz WAV file.
+    const char *output_path;   // Output WAV file.
+    RNNModel *model;           // Model, or NULL for the built-in one.
+
+    double checkpoint_seconds; // Audio between checkpoints; 0 disables them.
+    int resume;                // Resume from a matching checkpoint if present.
+    int warmup_frames;         // Frames replayed on resume; 0 uses the default.
+
+    // Follow an input that is still being written: new audio is processed
+    // as it is appended, with the output header kept up to date. The job
+    // ends once the writer closes the file, or after follow_idle_seconds
+    // (0 uses the default) without growth.
+    int follow;
+    double follow_idle_seconds;
+
+    // Called after each frame with the fraction done (0..1).
+    void (*progress)(double fraction, void *user);
+    // Polled after each frame; non-zero stops the job after a checkpoint.
+    int (*cancelled)(void *user);
+    void *user;
+
+    // Read and write through io_uring (Linux), with O_DIRECT output where the
+    // file system allows it. Falls back to stdio when io_uring is unavailable,
+    // and is not used in follow mode.
+    int io_uring;
+
+    // Sample conversions; NULL uses the plain C loops.
+    void (*s16_to_float)(const int16_t *in, float *out, size_t n);
+    void (*float_to_s16)(const float *in, int16_t *out, size_t n);
+} DenoiseJob;
+
+/**
+ * @brief Outcome of denoise_offline_run().
+ */
+typedef struct {
+    int cancelled;             // Stopped by the cancel callback (checkpoint kept).
+    uint64_t resumed_frames;   // Input frames skipped thanks to a checkpoint.
+    uint64_t frames;           // Input frames processed in total.
+    char error[256];           // Error message when the run fails.
+
+    // Time each stage of the read -> denoise -> write pipeline spent waiting
+    // on its neighbours, in seconds. A stage that rarely waits is the
+    // bottleneck. All zero when the job ran serially (follow mode).
+    double read_stall_seconds;
+    double denoise_stall_seconds;
+    double write_stall_seconds;
+
+    // I/O actually used when DenoiseJob.io_uring was set.
+    int io_uring_reads;
+    int io_uring_writes;
+    int direct_writes;         // The output was written with O_DIRECT.
+} DenoiseResult;
+
+/**
+ * @brief Denoise a WAV file, checkpointing and resuming as configured.
+ *
+ * On success the output header is finalized with the actual data size and
+ * the checkpoint is removed. On cancel the output is synced and a final
+ * checkpoint is written, so the job can be resumed later.
+ *
+ * @param job Job description.
+ * @param result Filled with the outcome; may not be NULL.
+ * @return 1 on success or cancel, 0 on failure (see result->error).
+ */
+int denoise_offline_run(const DenoiseJob *job, DenoiseResult *result);
+
+#endif
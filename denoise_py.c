@@ -0,0 +1,586 @@
+/**
+ * @file
+ * @brief Python extension module "denoise" over the offline engine and denoise_core.
+ *
+ * Samples are passed through the buffer protocol, so NumPy int16 and
+ * float32 arrays (and array.array, memoryview, ...) are read and written
+ * in place without copies. Every call releases the GIL while it denoises,
+ * so Python threads scale across cores, and the batch helpers spread their
+ * work over a native pool of worker threads.
+ *
+ *     import denoise, numpy as np
+ *     clean = np.empty_like(noisy)
+ *     denoise.process(noisy, out=clean)               # Whole clip, aligned.
+ *     denoise.process_batch(clips, workers=8)         # Many clips.
+ *     denoise.process_files([("a.wav", "a_clean.wav")], workers=4)
+ *     d = denoise.Denoiser(); d.process(chunk)        # Streaming.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "denoise_core.h"
+#include "denoise_offline.h"
+#include "job_queue.h"
+
+#define FRAME_SIZE DENOISE_CORE_FRAME
+#define MAX_WORKERS 256
+
+/**
+ * @brief Sample formats accepted through the buffer protocol.
+ */
+typedef enum {
+    SAMPLES_S16,
+    SAMPLES_F32
+} SampleFormat;
+
+/**
+ * @brief A buffer of samples held for the duration of a call.
+ */
+typedef struct {
+    Py_buffer view;
+    SampleFormat format;
+    size_t count;
+} Samples;
+
+/**
+ * @brief Work for one clip of process_batch().
+ */
+typedef struct {
+    Samples in;
+    Samples out;
+} ClipJob;
+
+/**
+ * @brief Work for one file of process_files().
+ */
+typedef struct {
+    DenoiseJob job;
+    DenoiseResult result;
+    int ok;
+} FileJob;
+
+/**
+ * @brief Native worker pool running one kind of job.
+ */
+typedef struct {
+    JobQueue queue;
+    void (*run)(void *job, DenoiseCore *core);
+    int needs_core;              // Give each worker a denoiser, reused across its jobs.
+} Pool;
+
+// ---------------------------------------------------------------------------
+// Buffers and denoising, without the GIL.
+// ---------------------------------------------------------------------------
+
+/**
+ * @brief Get a contiguous 1-D int16 or float32 buffer from obj.
+ * @return 1 on success, 0 with a Python exception set.
+ */
+static int samples_get(PyObject *obj, Samples *s, int writable) {
+    int flags = PyBUF_FORMAT | PyBUF_C_CONTIGUOUS | (writable ? PyBUF_WRITABLE : 0);
+    if (PyObject_GetBuffer(obj, &s->view, flags) != 0) return 0;
+    const char *f = s->view.format ? s->view.format : "B";
+    // Native or explicit little-endian byte order; NumPy uses "h"/"<h" and "f"/"<f".
+    if (*f == '@' || *f == '=' || *f == '<') f++;
+    if (strcmp(f, "h") == 0 && s->view.itemsize == 2) {
+        s->format = SAMPLES_S16;
+    } else if (strcmp(f, "f") == 0 && s->view.itemsize == 4) {
+        s->format = SAMPLES_F32;
+    } else {
+        PyBuffer_Release(&s->view);
+        PyErr_SetString(PyExc_TypeError, "expected int16 or float32 samples");
+        return 0;
+    }
+    if (s->view.ndim > 1) {
+        PyBuffer_Release(&s->view);
+        PyErr_SetString(PyExc_ValueError, "expected a 1-D buffer of mono samples");
+        return 0;
+    }
+    s->count = (size_t)(s->view.len / s->view.itemsize);
+    return 1;
+}
+
+/**
+ * @brief Get the output buffer for in: out itself, or a new one of the same type and length.
+ * @return New reference to the object to return, or NULL with an exception set.
+ */
+static PyObject *output_for(const Samples *in, PyObject *out_obj, Samples *out) {
+    if (out_obj && out_obj != Py_None) {
+        if (!samples_get(out_obj, out, 1)) return NULL;
+        if (out->format != in->format || out->count != in->count) {
+            PyBuffer_Release(&out->view);
+            PyErr_SetString(PyExc_ValueError, "out must have the same type and length as the input");
+            return NULL;
+        }
+        Py_INCREF(out_obj);
+        return out_obj;
+    }
+    // A memoryview over a new bytearray; np.frombuffer() wraps it without copying.
+    PyObject *bytes = PyByteArray_FromStringAndSize(NULL, (Py_ssize_t)(in->count * in->view.itemsize));
+    PyObject *view = bytes ? PyMemoryView_FromObject(bytes) : NULL;
+    Py_XDECREF(bytes);
+    PyObject *cast = view ? PyObject_CallMethod(view, "cast", "s", in->format == SAMPLES_S16 ? "h" : "f") : NULL;
+    Py_XDECREF(view);
+    if (!cast) return NULL;
+    if (!samples_get(cast, out, 1)) {
+        Py_DECREF(cast);
+        return NULL;
+    }
+    return cast;
+}
+
+/**
+ * @brief Stream samples through core, in blocks of a frame.
+ *
+ * The output is shifted back by the denoiser's latency and the end is
+ * flushed with silence, so out[i] is the denoised in[i]. The first samples
+ * match the offline engine's output; unlike it, the last frame is kept.
+ * in and out may be the same buffer: each output sample is written after
+ * the input at that position has been read.
+ */
+static void denoise_clip(DenoiseCore *core, const Samples *in, const Samples *out) {
+    size_t n = in->count;
+    size_t latency = (size_t)denoise_core_latency(core);
+    size_t read = 0, written = 0;
+    while (written < n) {
+        size_t count = n + latency - read;
+        if (count > FRAME_SIZE) count = FRAME_SIZE;
+        size_t real = read < n ? (n - read < count ? n - read : count) : 0;
+        // Samples before the latency has passed are the denoiser's initial silence.
+        size_t skip = read < latency ? (latency - read < count ? latency - read : count) : 0;
+        if (in->format == SAMPLES_S16) {
+            int16_t block[FRAME_SIZE];
+            memcpy(block, (const int16_t *)in->view.buf + read, real * sizeof(int16_t));
+            memset(block + real, 0, (count - real) * sizeof(int16_t));
+            denoise_core_process_s16(core, block, block, count);
+            memcpy((int16_t *)out->view.buf + written, block + skip, (count - skip) * sizeof(int16_t));
+        } else {
+            float block[FRAME_SIZE];
+            memcpy(block, (const float *)in->view.buf + read, real * sizeof(float));
+            memset(block + real, 0, (count - real) * sizeof(float));
+            denoise_core_process_float(core, block, block, count);
+            memcpy((float *)out->view.buf + written, block + skip, (count - skip) * sizeof(float));
+        }
+        read += count;
+        written += count - skip;
+    }
+}
+
+static void run_clip(void *job, DenoiseCore *core) {
+    ClipJob *clip = job;
+    denoise_core_reset(core);
+    denoise_clip(core, &clip->in, &clip->out);
+}
+
+static void run_file(void *job, DenoiseCore *core) {
+    FileJob *file = job;
+    (void)core;
+    file->ok = denoise_offline_run(&file->job, &file->result);
+}
+
+static void *pool_worker(void *arg) {
+    Pool *pool = arg;
+    DenoiseCore *core = NULL;
+    // Without a denoiser, leave the jobs to the other workers.
+    if (pool->needs_core && !(core = denoise_core_create(NULL))) return NULL;
+    void *job;
+    while ((job = job_queue_pop(&pool->queue)) != NULL) pool->run(job, core);
+    denoise_core_destroy(core);
+    return NULL;
+}
+
+/**
+ * @brief Run jobs on up to workers threads (0: one per CPU). Called without the GIL.
+ * @return 1 when every job ran, 0 when no worker could start.
+ */
+static int pool_run(void **jobs, size_t count, int workers, int needs_core, void (*run)(void *, DenoiseCore *)) {
+    Pool pool = {.run = run, .needs_core = needs_core};
+    if (workers <= 0) workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers < 1) workers = 1;
+    if (workers > MAX_WORKERS) workers = MAX_WORKERS;
+    if ((size_t)workers > count) workers = (int)count;
+    if (count == 0) return 1;
+    if (!job_queue_init(&pool.queue, count)) return 0;
+    // Everything is queued up front, so the workers never wait on a producer.
+    for (size_t i = 0; i < count; i++) job_queue_push(&pool.queue, jobs[i]);
+    job_queue_close(&pool.queue);
+
+    pthread_t threads[MAX_WORKERS];
+    int started = 0;
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&threads[started], NULL, pool_worker, &pool) == 0) started++;
+    }
+    // Without any thread, run them here.
+    if (started == 0) pool_worker(&pool);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+
+    // Jobs left behind by workers that failed to start.
+    size_t left;
+    job_queue_depth(&pool.queue, &left, &(size_t){0});
+    job_queue_destroy(&pool.queue);
+    return left == 0;
+}
+
+// ---------------------------------------------------------------------------
+// Module functions.
+// ---------------------------------------------------------------------------
+
+PyDoc_STRVAR(process_doc,
+"process(samples, out=None)\n"
+"\n"
+"Denoise a whole mono 48kHz clip of int16 or float32 (-1..1) samples.\n"
+"The result has the same length and is aligned with the input. It is written\n"
+"into out when given (which may be samples itself); otherwise a new\n"
+"memoryview is returned. The GIL is released while denoising.");
+
+static PyObject *py_process(PyObject *self, PyObject *args, PyObject *kwargs) {
+    (void)self;
+    static char *keywords[] = {"samples", "out", NULL};
+    PyObject *in_obj, *out_obj = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O:process", keywords, &in_obj, &out_obj)) return NULL;
+
+    Samples in, out;
+    if (!samples_get(in_obj, &in, 0)) return NULL;
+    PyObject *result = output_for(&in, out_obj, &out);
+    if (!result) {
+        PyBuffer_Release(&in.view);
+        return NULL;
+    }
+    DenoiseCore *core = denoise_core_create(NULL);
+    if (core) {
+        Py_BEGIN_ALLOW_THREADS
+        denoise_clip(core, &in, &out);
+        Py_END_ALLOW_THREADS
+        denoise_core_destroy(core);
+    }
+    PyBuffer_Release(&out.view);
+    PyBuffer_Release(&in.view);
+    if (!core) {
+        Py_DECREF(result);
+        return PyErr_NoMemory();
+    }
+    return result;
+}
+
+PyDoc_STRVAR(process_batch_doc,
+"process_batch(clips, outs=None, workers=0)\n"
+"\n"
+"Denoise a sequence of clips like process(), spread over a native pool of\n"
+"worker threads (0: one per CPU). Results go into the buffers of outs when\n"
+"given; the list of results is returned either way.");
+
+static PyObject *py_process_batch(PyObject *self, PyObject *args, PyObject *kwargs) {
+    (void)self;
+    static char *keywords[] = {"clips", "outs", "workers", NULL};
+    PyObject *clips_obj, *outs_obj = NULL;
+    int workers = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|Oi:process_batch", keywords, &clips_obj, &outs_obj, &workers))
+        return NULL;
+
+    PyObject *clips = PySequence_Fast(clips_obj, "clips must be a sequence");
+    PyObject *outs = NULL;
+    if (!clips) return NULL;
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(clips);
+    if (outs_obj && outs_obj != Py_None) {
+        outs = PySequence_Fast(outs_obj, "outs must be a sequence");
+        if (outs && PySequence_Fast_GET_SIZE(outs) != count) {
+            PyErr_SetString(PyExc_ValueError, "outs must have one buffer per clip");
+            Py_CLEAR(outs);
+        }
+        if (!outs) {
+            Py_DECREF(clips);
+            return NULL;
+        }
+    }
+
+    ClipJob *jobs = PyMem_Calloc((size_t)count + 1, sizeof(ClipJob));
+    void **queue = PyMem_Calloc((size_t)count + 1, sizeof(void *));
+    PyObject *results = PyList_New(count);
+    Py_ssize_t held = 0;
+    int ok = jobs && queue && results;
+    if (!jobs || !queue) PyErr_NoMemory();
+
+    // All buffers are acquired with the GIL, before the workers start.
+    for (; ok && held < count; held++) {
+        ClipJob *job = &jobs[held];
+        if (!samples_get(PySequence_Fast_GET_ITEM(clips, held), &job->in, 0)) {
+            ok = 0;
+            break;
+        }
+        PyObject *result = output_for(&job->in, outs ? PySequence_Fast_GET_ITEM(outs, held) : NULL, &job->out);
+        if (!result) {
+            PyBuffer_Release(&job->in.view);
+            ok = 0;
+            break;
+        }
+        PyList_SET_ITEM(results, held, result);
+        queue[held] = job;
+    }
+
+    if (ok) {
+        Py_BEGIN_ALLOW_THREADS
+        ok = pool_run(queue, (size_t)count, workers, 1, run_clip);
+        Py_END_ALLOW_THREADS
+        if (!ok) PyErr_NoMemory();
+    }
+
+    for (Py_ssize_t i = 0; i < held; i++) {
+        PyBuffer_Release(&jobs[i].out.view);
+        PyBuffer_Release(&jobs[i].in.view);
+    }
+    PyMem_Free(jobs);
+    PyMem_Free(queue);
+    Py_DECREF(clips);
+    Py_XDECREF(outs);
+    if (!ok) {
+        Py_XDECREF(results);
+        return NULL;
+    }
+    return results;
+}
+
+/**
+ * @brief Convert a file job's outcome into a dict.
+ */
+static PyObject *file_result(const FileJob *file) {
+    return Py_BuildValue("{s:O,s:s,s:K,s:K,s:O}",
+                         "ok", file->ok && !file->result.cancelled ? Py_True : Py_False,
+                         "error", file->ok ? "" : file->result.error,
+                         "frames", (unsigned long long)file->result.frames,
+                         "resumed_frames", (unsigned long long)file->result.resumed_frames,
+                         "io_uring", file->result.io_uring_reads || file->result.io_uring_writes ? Py_True : Py_False);
+}
+
+PyDoc_STRVAR(process_files_doc,
+"process_files(pairs, workers=0, checkpoint_seconds=0, resume=False, io_uring=False)\n"
+"\n"
+"Denoise (input, output) WAV file pairs with the offline engine, as\n"
+"rnnoise_batch does, on a native pool of worker threads (0: one per CPU).\n"
+"Returns one dict per pair with ok, error, frames, resumed_frames and io_uring.\n"
+"Failures are reported there rather than raised, so one bad file does not\n"
+"lose the others' results.");
+
+static PyObject *py_process_files(PyObject *self, PyObject *args, PyObject *kwargs) {
+    (void)self;
+    static char *keywords[] = {"pairs", "workers", "checkpoint_seconds", "resume", "io_uring", NULL};
+    PyObject *pairs_obj;
+    int workers = 0, resume = 0, io_uring = 0;
+    double checkpoint_seconds = 0.0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|idpp:process_files", keywords, &pairs_obj, &workers,
+                                     &checkpoint_seconds, &resume, &io_uring))
+        return NULL;
+
+    PyObject *pairs = PySequence_Fast(pairs_obj, "pairs must be a sequence of (input, output) paths");
+    if (!pairs) return NULL;
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(pairs);
+    FileJob *jobs = PyMem_Calloc((size_t)count + 1, sizeof(FileJob));
+    void **queue = PyMem_Calloc((size_t)count + 1, sizeof(void *));
+    // Encoded paths, kept alive until the jobs are done.
+    PyObject *paths = PyList_New(0);
+    int ok = jobs && queue && paths;
+    if (!jobs || !queue) PyErr_NoMemory();
+
+    for (Py_ssize_t i = 0; ok && i < count; i++) {
+        PyObject *in = NULL, *out = NULL;
+        PyObject *pair = PySequence_Fast_GET_ITEM(pairs, i);
+        if (!PyArg_ParseTuple(pair, "O&O&:process_files", PyUnicode_FSConverter, &in, PyUnicode_FSConverter, &out)) {
+            Py_XDECREF(in);
+            ok = 0;
+            break;
+        }
+        if (PyList_Append(paths, in) < 0 || PyList_Append(paths, out) < 0) {
+            Py_DECREF(in);
+            Py_DECREF(out);
+            ok = 0;
+            break;
+        }
+        jobs[i].job.input_path = PyBytes_AS_STRING(in);
+        jobs[i].job.output_path = PyBytes_AS_STRING(out);
+        Py_DECREF(in);
+        Py_DECREF(out);
+        jobs[i].job.checkpoint_seconds = checkpoint_seconds;
+        jobs[i].job.resume = resume;
+        jobs[i].job.io_uring = io_uring;
+        queue[i] = &jobs[i];
+    }
+
+    if (ok) {
+        Py_BEGIN_ALLOW_THREADS
+        ok = pool_run(queue, (size_t)count, workers, 0, run_file);
+        Py_END_ALLOW_THREADS
+        if (!ok) PyErr_NoMemory();
+    }
+
+    PyObject *results = ok ? PyList_New(count) : NULL;
+    for (Py_ssize_t i = 0; results && i < count; i++) {
+        PyObject *item = file_result(&jobs[i]);
+        if (!item) {
+            Py_CLEAR(results);
+            break;
+        }
+        PyList_SET_ITEM(results, i, item);
+    }
+    PyMem_Free(jobs);
+    PyMem_Free(queue);
+    Py_XDECREF(paths);
+    Py_DECREF(pairs);
+    return results;
+}
+
+// ---------------------------------------------------------------------------
+// Streaming Denoiser type.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    PyObject_HEAD
+    DenoiseCore *core;
+    PyThread_type_lock lock;     // One caller at a time, without holding the GIL.
+} DenoiserObject;
+
+static PyObject *denoiser_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, ":Denoiser", keywords)) return NULL;
+    DenoiserObject *self = (DenoiserObject *)type->tp_alloc(type, 0);
+    if (!self) return NULL;
+    self->core = denoise_core_create(NULL);
+    self->lock = PyThread_allocate_lock();
+    if (!self->core || !self->lock) {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+    return (PyObject *)self;
+}
+
+static void denoiser_dealloc(DenoiserObject *self) {
+    denoise_core_destroy(self->core);
+    if (self->lock) PyThread_free_lock(self->lock);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+PyDoc_STRVAR(denoiser_process_doc,
+"process(samples, out=None)\n"
+"\n"
+"Denoise the next chunk of a stream, of any length. The output has the\n"
+"same length and is latency samples behind the input.");
+
+static PyObject *denoiser_process(DenoiserObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"samples", "out", NULL};
+    PyObject *in_obj, *out_obj = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O:process", keywords, &in_obj, &out_obj)) return NULL;
+
+    Samples in, out;
+    if (!samples_get(in_obj, &in, 0)) return NULL;
+    PyObject *result = output_for(&in, out_obj, &out);
+    if (!result) {
+        PyBuffer_Release(&in.view);
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, WAIT_LOCK);
+    if (in.format == SAMPLES_S16) {
+        denoise_core_process_s16(self->core, in.view.buf, out.view.buf, in.count);
+    } else {
+        denoise_core_process_float(self->core, in.view.buf, out.view.buf, in.count);
+    }
+    PyThread_release_lock(self->lock);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&out.view);
+    PyBuffer_Release(&in.view);
+    return result;
+}
+
+static PyObject *denoiser_reset(DenoiserObject *self, PyObject *unused) {
+    (void)unused;
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, WAIT_LOCK);
+    denoise_core_reset(self->core);
+    PyThread_release_lock(self->lock);
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+static PyObject *denoiser_get_latency(DenoiserObject *self, void *closure) {
+    (void)closure;
+    return PyLong_FromLong(denoise_core_latency(self->core));
+}
+
+static PyObject *denoiser_get_vad(DenoiserObject *self, void *closure) {
+    (void)closure;
+    return PyFloat_FromDouble(denoise_core_vad(self->core));
+}
+
+static PyMethodDef denoiser_methods[] = {
+    {"process", (PyCFunction)(void (*)(void))denoiser_process, METH_VARARGS | METH_KEYWORDS, denoiser_process_doc},
+    {"reset", (PyCFunction)denoiser_reset, METH_NOARGS, "Forget all audio so far."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef denoiser_getset[] = {
+    {"latency", (getter)denoiser_get_latency, NULL, "Delay of the output, in samples.", NULL},
+    {"vad", (getter)denoiser_get_vad, NULL, "Voice probability of the last frame.", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyTypeObject DenoiserType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "denoise.Denoiser",
+    .tp_doc = "Denoiser()\n\nStreaming denoiser for chunks of any length (see denoise_core.h).",
+    .tp_basicsize = sizeof(DenoiserObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = denoiser_new,
+    .tp_dealloc = (destructor)denoiser_dealloc,
+    .tp_methods = denoiser_methods,
+    .tp_getset = denoiser_getset,
+};
+
+static PyMethodDef module_methods[] = {
+    {"process", (PyCFunction)(void (*)(void))py_process, METH_VARARGS | METH_KEYWORDS, process_doc},
+    {"process_batch", (PyCFunction)(void (*)(void))py_process_batch, METH_VARARGS | METH_KEYWORDS, process_batch_doc},
+    {"process_files", (PyCFunction)(void (*)(void))py_process_files, METH_VARARGS | METH_KEYWORDS, process_files_doc},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "denoise",
+    .m_doc = "RNNoise denoising of NumPy arrays and WAV files, without copies and without the GIL.",
+    .m_size = -1,
+    .m_methods = module_methods,
+};
+
+PyMODINIT_FUNC PyInit_denoise(void) {
+    if (PyType_Ready(&DenoiserType) < 0) return NULL;
+    PyObject *m = PyModule_Create(&module);
+    if (!m) return NULL;
+    Py_INCREF(&DenoiserType);
+    if (PyModule_AddObject(m, "Denoiser", (PyObject *)&DenoiserType) < 0 ||
+        PyModule_AddIntConstant(m, "SAMPLE_RATE", DENOISE_CORE_RATE) < 0 ||
+        PyModule_AddIntConstant(m, "FRAME_SIZE", DENOISE_CORE_FRAME) < 0) {
+        Py_DECREF(&DenoiserType);
+        Py_DECREF(m);
+        return NULL;
+    }
+    return m;
+}
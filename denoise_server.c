@@ -0,0 +1,1081 @@
+/**
+ * @file
+ * @brief Local HTTP/1.1 job server for offline denoising.
+ *
+ * Lets other services submit denoise jobs over HTTP instead of running a
+ * GTK program. Uploaded audio is streamed to a spool file as it arrives
+ * (plain or chunked transfer encoding), so requests are never held in
+ * memory. Jobs go into a bounded queue served by a pool of workers
+ * running the offline engine; when the queue is full the server answers
+ * 503 so clients can back off.
+ *
+ * Endpoints:
+ *   POST   /jobs                   body is a WAV file (PUT also works); ?output=/path writes the
+ *                                  result there; ?wait=1 answers with the result
+ *   POST   /jobs?input=/path.wav   denoise a local file (empty body)
+ *   GET    /jobs/<id>              job status as JSON
+ *   GET    /jobs/<id>/result       the denoised WAV; ?wait=1 waits for it
+ *   DELETE /jobs/<id>              cancel the job and drop its files
+ *   GET    /metrics                queue depth and throughput (Prometheus text)
+ *
+ * The server binds to 127.0.0.1 by default: local paths are read and
+ * written with the server's permissions.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "denoise_offline.h"
+#include "job_queue.h"
+
+#define FRAME_SIZE 480     // RNNoise frame size (10ms at 48kHz).
+#define SAMPLE_RATE 48000  // Expected sample rate for RNNoise.
+
+#define MAX_WORKERS 64        // Worker threads.
+#define MAX_CONNECTIONS 128   // Connections served at once.
+#define MAX_JOBS 1024         // Jobs remembered; the oldest finished ones are dropped.
+#define HEAD_MAX 16384        // Request line and headers.
+#define IO_BUFFER 65536       // Body and result copy buffer.
+#define IDLE_TIMEOUT_MS 30000 // Keep-alive and slow-client timeout.
+#define STOP_POLL_MS 200      // How often idle connections look for a stop.
+
+typedef enum { JOB_QUEUED, JOB_RUNNING, JOB_DONE, JOB_FAILED, JOB_CANCELLED } JobState;
+
+static const char *job_state_names[] = {"queued", "running", "done", "failed", "cancelled"};
+
+/**
+ * @brief A submitted job. Owned by the job table; fields are guarded by jobs_lock.
+ */
+typedef struct {
+    unsigned long id;
+    JobState state;
+    char input[1024];
+    char output[1024];
+    int spooled_input;       // The input is an upload and is removed with the job.
+    int spooled_output;      // The output lives in the spool directory.
+    volatile int cancel;     // Set by DELETE; the job is dropped once finished and unwatched.
+    int waiters;             // Clients blocked in wait_for_job(); the job is kept meanwhile.
+    double progress;
+    unsigned long long frames;
+    double submitted_at;
+    double started_at;
+    double finished_at;
+    char error[256];
+} Job;
+
+static Job *jobs[MAX_JOBS];
+static int job_count = 0;
+static unsigned long next_job_id = 1;
+static pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobs_changed = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief Counters behind /metrics, guarded by jobs_lock.
+ */
+static struct {
+    unsigned long long submitted;
+    unsigned long long rejected;          // Queue full.
+    unsigned long long finished[5];       // By final JobState.
+    unsigned long long upload_bytes;
+    int running;
+    double audio_seconds;                 // Audio denoised.
+    double busy_seconds;                  // Worker time spent in jobs.
+    double queue_wait_seconds;            // Time jobs waited before a worker took them.
+} metrics;
+
+static JobQueue queue;
+static size_t queue_capacity;
+static const char *spool_dir = "/tmp/denoise_server";
+static int use_io_uring = 0;
+static double start_time;
+static int active_connections = 0;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+/**
+ * @brief Monotonic clock in seconds.
+ */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Job table.
+ */
+
+/**
+ * @brief Find a job by id. Call with jobs_lock held.
+ */
+static Job *find_job(unsigned long id) {
+    for (int i = 0; i < job_count; i++) {
+        if (jobs[i]->id == id) return jobs[i];
+    }
+    return NULL;
+}
+
+static int job_finished(const Job *job) {
+    return job->state != JOB_QUEUED && job->state != JOB_RUNNING;
+}
+
+/**
+ * @brief Remove a finished job's spool files and forget it. Call with jobs_lock held.
+ */
+static void drop_job(int index) {
+    Job *job = jobs[index];
+    if (job->spooled_input) remove(job->input);
+    if (job->spooled_output || (job->state == JOB_CANCELLED && job->started_at)) {
+        // A cancelled run leaves a partial output and its checkpoint. A job
+        // cancelled before it started has none, and a local output path may
+        // hold an older file that is not ours to remove.
+        char checkpoint[1100];
+        snprintf(checkpoint, sizeof(checkpoint), "%s%s", job->output, DENOISE_CHECKPOINT_SUFFIX);
+        remove(job->output);
+        remove(checkpoint);
+    }
+    free(job);
+    jobs[index] = jobs[--job_count];
+}
+
+/**
+ * @brief Add a job to the table, making room by dropping the oldest finished job.
+ * @return The job (state JOB_QUEUED), or NULL if the table is full of live jobs.
+ */
+static Job *new_job(void) {
+    pthread_mutex_lock(&jobs_lock);
+    if (job_count == MAX_JOBS) {
+        int oldest = -1;
+        for (int i = 0; i < job_count; i++) {
+            if (job_finished(jobs[i]) && jobs[i]->waiters == 0 && (oldest < 0 || jobs[i]->id < jobs[oldest]->id)) {
+                oldest = i;
+            }
+        }
+        if (oldest >= 0) drop_job(oldest);
+    }
+    Job *job = job_count < MAX_JOBS ? calloc(1, sizeof(Job)) : NULL;
+    if (job) {
+        job->id = next_job_id++;
+        job->state = JOB_QUEUED;
+        job->submitted_at = now_seconds();
+        jobs[job_count++] = job;
+    }
+    pthread_mutex_unlock(&jobs_lock);
+    return job;
+}
+
+/**
+ * @brief Drop a deleted job once it is finished and no client waits on it.
+ *
+ * Called by DELETE, by the worker that takes a cancelled job off the queue
+ * and by the last client waiting on it, whichever comes last. Call with
+ * jobs_lock held; the job may be freed.
+ */
+static void reap_job(Job *job) {
+    if (!job->cancel || !job_finished(job) || job->waiters > 0) return;
+    for (int i = 0; i < job_count; i++) {
+        if (jobs[i] == job) {
+            drop_job(i);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Forget a job that never made it into the queue.
+ */
+static void abandon_job(Job *job) {
+    pthread_mutex_lock(&jobs_lock);
+    for (int i = 0; i < job_count; i++) {
+        if (jobs[i] == job) {
+            drop_job(i);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&jobs_lock);
+}
+
+/*
+ * Workers.
+ */
+
+static void on_job_progress(double fraction, void *user) {
+    Job *job = user;
+    // Called for every frame: only take the lock for visible changes.
+    if (fraction - job->progress < 0.001 && fraction < 1.0) return;
+    pthread_mutex_lock(&jobs_lock);
+    job->progress = fraction;
+    pthread_mutex_unlock(&jobs_lock);
+}
+
+static int job_cancelled(void *user) {
+    const Job *job = user;
+    return job->cancel || stop_requested;
+}
+
+static void *worker_main(void *arg) {
+    (void)arg;
+    Job *job;
+    while ((job = job_queue_pop(&queue)) != NULL) {
+        pthread_mutex_lock(&jobs_lock);
+        double now = now_seconds();
+        metrics.queue_wait_seconds += now - job->submitted_at;
+        if (job->cancel || stop_requested) {
+            job->state = JOB_CANCELLED;
+            job->finished_at = now;
+            metrics.finished[JOB_CANCELLED]++;
+            pthread_cond_broadcast(&jobs_changed);
+            // Deleted while queued: nothing else would remove its spooled input.
+            reap_job(job);
+            pthread_mutex_unlock(&jobs_lock);
+            continue;
+        }
+        job->state = JOB_RUNNING;
+        job->started_at = now;
+        metrics.running++;
+        pthread_cond_broadcast(&jobs_changed);
+        pthread_mutex_unlock(&jobs_lock);
+
+        DenoiseJob dj = {
+            .input_path = job->input,
+            .output_path = job->output,
+            .checkpoint_seconds = DENOISE_CHECKPOINT_SECONDS,
+            .io_uring = use_io_uring,
+            .progress = on_job_progress,
+            .cancelled = job_cancelled,
+            .user = job,
+        };
+        DenoiseResult result;
+        int ok = denoise_offline_run(&dj, &result);
+
+        pthread_mutex_lock(&jobs_lock);
+        now = now_seconds();
+        job->state = !ok ? JOB_FAILED : result.cancelled ? JOB_CANCELLED : JOB_DONE;
+        job->frames = result.frames;
+        job->finished_at = now;
+        if (!ok) snprintf(job->error, sizeof(job->error), "%s", result.error);
+        if (job->state == JOB_DONE) {
+            job->progress = 1.0;
+            metrics.audio_seconds += (double)result.frames * FRAME_SIZE / SAMPLE_RATE;
+        }
+        metrics.running--;
+        metrics.busy_seconds += now - job->started_at;
+        metrics.finished[job->state]++;
+        pthread_cond_broadcast(&jobs_changed);
+        pthread_mutex_unlock(&jobs_lock);
+    }
+    return NULL;
+}
+
+/*
+ * HTTP connection I/O.
+ */
+
+/**
+ * @brief A client connection with a read buffer.
+ */
+typedef struct {
+    int fd;
+    char buf[IO_BUFFER];
+    size_t len;               // Bytes in buf.
+    size_t pos;               // Next unread byte.
+} Conn;
+
+/**
+ * @brief Read more data into the connection buffer.
+ * @return Bytes read, 0 on end of stream, timeout or error.
+ */
+static ssize_t conn_fill(Conn *c) {
+    if (c->pos == c->len) {
+        c->pos = c->len = 0;
+    } else if (c->pos > 0 && c->len == sizeof(c->buf)) {
+        memmove(c->buf, c->buf + c->pos, c->len - c->pos);
+        c->len -= c->pos;
+        c->pos = 0;
+    }
+    if (c->len == sizeof(c->buf)) return 0;
+
+    // Wait in short slices, so that a stopping server is not held up by idle clients.
+    struct pollfd pfd = {c->fd, POLLIN, 0};
+    int ready = 0;
+    for (int waited = 0; !ready && !stop_requested && waited < IDLE_TIMEOUT_MS; waited += STOP_POLL_MS) {
+        ready = poll(&pfd, 1, STOP_POLL_MS);
+        if (ready < 0 && errno != EINTR) return 0;
+        if (ready < 0) ready = 0;
+    }
+    if (!ready) return 0;
+    ssize_t n;
+    do {
+        n = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return 0;
+    c->len += (size_t)n;
+    return n;
+}
+
+/**
+ * @brief Read a line ending in CRLF (or LF) into line, without the ending.
+ * @return 1 on success, 0 on end of stream or an overlong line.
+ */
+static int conn_read_line(Conn *c, char *line, size_t size) {
+    while (1) {
+        char *nl = memchr(c->buf + c->pos, '\n', c->len - c->pos);
+        if (nl) {
+            size_t n = (size_t)(nl - (c->buf + c->pos));
+            if (n > 0 && nl[-1] == '\r') n--;
+            if (n >= size) return 0;
+            memcpy(line, c->buf + c->pos, n);
+            line[n] = '\0';
+            c->pos = (size_t)(nl - c->buf) + 1;
+            return 1;
+        }
+        if (c->len - c->pos >= size || conn_fill(c) == 0) return 0;
+    }
+}
+
+/**
+ * @brief Read up to n body bytes.
+ * @return Pointer into the buffer, with *got set; NULL on end of stream.
+ */
+static const char *conn_read(Conn *c, size_t n, size_t *got) {
+    if (c->pos == c->len && conn_fill(c) == 0) return NULL;
+    size_t avail = c->len - c->pos;
+    *got = n < avail ? n : avail;
+    const char *p = c->buf + c->pos;
+    c->pos += *got;
+    return p;
+}
+
+static int send_all(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+static const char *status_text(int status) {
+    switch (status) {
+        case 100: return "Continue";
+        case 200: return "OK";
+        case 202: return "Accepted";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 409: return "Conflict";
+        case 411: return "Length Required";
+        case 413: return "Payload Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        default: return "Unknown";
+    }
+}
+
+/**
+ * @brief Send a complete response with a small body.
+ * @return 1 on success, 0 if the client went away.
+ */
+static int send_response(int fd, int status, const char *content_type, const char *body, int keep_alive,
+                         const char *extra_headers) {
+    char head[512];
+    size_t len = strlen(body);
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n%s%s\r\n", status,
+                     status_text(status), content_type, len, keep_alive ? "" : "Connection: close\r\n",
+                     extra_headers ? extra_headers : "");
+    return send_all(fd, head, (size_t)n) && send_all(fd, body, len);
+}
+
+static int send_error(int fd, int status, const char *message, int keep_alive) {
+    char body[512];
+    snprintf(body, sizeof(body), "{\"error\":\"%s\"}\n", message);
+    return send_response(fd, status, "application/json", body, keep_alive, NULL);
+}
+
+/**
+ * @brief Send a file as the response body.
+ * @return 1 on success, 0 if the client went away or the file could not be read.
+ */
+static int send_file(int fd, const char *path, int keep_alive) {
+    int in = open(path, O_RDONLY);
+    struct stat st;
+    if (in < 0 || fstat(in, &st) != 0) {
+        if (in >= 0) close(in);
+        return send_error(fd, 500, "result not readable", keep_alive);
+    }
+    char head[256];
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: audio/wav\r\nContent-Length: %lld\r\n%s\r\n",
+                     (long long)st.st_size, keep_alive ? "" : "Connection: close\r\n");
+    int ok = send_all(fd, head, (size_t)n);
+
+    char buffer[IO_BUFFER];
+    ssize_t r;
+    while (ok && (r = read(in, buffer, sizeof(buffer))) > 0) ok = send_all(fd, buffer, (size_t)r);
+    close(in);
+    return ok;
+}
+
+/*
+ * Requests.
+ */
+
+/**
+ * @brief The parts of a request the server uses.
+ */
+typedef struct {
+    char method[16];
+    char path[2048];
+    char query[2048];
+    long long content_length;   // -1 when absent.
+    int chunked;
+    int keep_alive;
+    int expect_continue;
+} Request;
+
+/**
+ * @brief Read the request line and headers.
+ * @return 1 on success, 0 if the connection closed, -1 on a malformed request.
+ */
+static int read_request(Conn *c, Request *req) {
+    char line[HEAD_MAX];
+    memset(req, 0, sizeof(*req));
+    req->content_length = -1;
+
+    // Tolerate empty lines between keep-alive requests.
+    do {
+        if (!conn_read_line(c, line, sizeof(line))) return 0;
+    } while (line[0] == '\0');
+
+    char target[2048], version[16];
+    if (sscanf(line, "%15s %2047s %15s", req->method, target, version) != 3 || strncmp(version, "HTTP/1.", 7) != 0) {
+        return -1;
+    }
+    req->keep_alive = strcmp(version, "HTTP/1.1") == 0;
+
+    char *q = strchr(target, '?');
+    if (q) *q++ = '\0';
+    snprintf(req->path, sizeof(req->path), "%s", target);
+    snprintf(req->query, sizeof(req->query), "%s", q ? q : "");
+
+    size_t head_bytes = strlen(line);
+    while (1) {
+        if (!conn_read_line(c, line, sizeof(line))) return -1;
+        head_bytes += strlen(line);
+        if (head_bytes > HEAD_MAX) return -1;
+        if (line[0] == '\0') break;
+
+        char *colon = strchr(line, ':');
+        if (!colon) return -1;
+        *colon = '\0';
+        char *value = colon + 1;
+        while (*value == ' ' || *value == '\t') value++;
+
+        if (strcasecmp(line, "Content-Length") == 0) {
+            req->content_length = strtoll(value, NULL, 10);
+        } else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+            req->chunked = strcasestr(value, "chunked") != NULL;
+        } else if (strcasecmp(line, "Connection") == 0) {
+            if (strcasestr(value, "close")) req->keep_alive = 0;
+            if (strcasestr(value, "keep-alive")) req->keep_alive = 1;
+        } else if (strcasecmp(line, "Expect") == 0) {
+            req->expect_continue = strcasecmp(value, "100-continue") == 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Get a query parameter, percent-decoded.
+ * @return 1 if present, 0 otherwise.
+ */
+static int query_param(const char *query, const char *name, char *out, size_t size) {
+    size_t name_len = strlen(name);
+    for (const char *p = query; *p;) {
+        const char *end = strchr(p, '&');
+        if (!end) end = p + strlen(p);
+        if ((size_t)(end - p) > name_len && strncmp(p, name, name_len) == 0 && p[name_len] == '=') {
+            size_t n = 0;
+            for (const char *s = p + name_len + 1; s < end && n + 1 < size; s++) {
+                if (*s == '%' && end - s > 2) {
+                    char hex[3] = {s[1], s[2], 0};
+                    out[n++] = (char)strtol(hex, NULL, 16);
+                    s += 2;
+                } else {
+                    out[n++] = *s == '+' ? ' ' : *s;
+                }
+            }
+            out[n] = '\0';
+            return 1;
+        }
+        if ((size_t)(end - p) == name_len && strncmp(p, name, name_len) == 0) {
+            out[0] = '\0';
+            return 1;
+        }
+        p = *end ? end + 1 : end;
+    }
+    return 0;
+}
+
+/**
+ * @brief Discard a request body the server does not use.
+ * @return 1 on success, 0 if the connection should be closed.
+ */
+static int skip_body(Conn *c, const Request *req) {
+    if (req->chunked) return 0;
+    long long left = req->content_length > 0 ? req->content_length : 0;
+    while (left > 0) {
+        size_t got;
+        if (!conn_read(c, (size_t)(left < IO_BUFFER ? left : IO_BUFFER), &got)) return 0;
+        left -= (long long)got;
+    }
+    return 1;
+}
+
+/**
+ * @brief Stream the request body into a file, decoding chunked transfer encoding.
+ * @return Bytes written, or -1 on a broken stream or a write error.
+ */
+static long long receive_body(Conn *c, const Request *req, FILE *file) {
+    long long total = 0;
+    if (!req->chunked) {
+        long long left = req->content_length;
+        while (left > 0) {
+            size_t got;
+            const char *data = conn_read(c, (size_t)(left < IO_BUFFER ? left : IO_BUFFER), &got);
+            if (!data || fwrite(data, 1, got, file) != got) return -1;
+            left -= (long long)got;
+            total += (long long)got;
+        }
+        return total;
+    }
+
+    char line[256];
+    while (1) {
+        if (!conn_read_line(c, line, sizeof(line))) return -1;
+        char *end;
+        long long size = strtoll(line, &end, 16);
+        if (end == line || size < 0) return -1;
+        if (size == 0) break;
+        while (size > 0) {
+            size_t got;
+            const char *data = conn_read(c, (size_t)(size < IO_BUFFER ? size : IO_BUFFER), &got);
+            if (!data || fwrite(data, 1, got, file) != got) return -1;
+            size -= (long long)got;
+            total += (long long)got;
+        }
+        // CRLF after the chunk data.
+        if (!conn_read_line(c, line, sizeof(line)) || line[0] != '\0') return -1;
+    }
+    // Trailers, up to the empty line.
+    do {
+        if (!conn_read_line(c, line, sizeof(line))) return -1;
+    } while (line[0] != '\0');
+    return total;
+}
+
+/**
+ * @brief Copy text into a JSON string body, escaping quotes, backslashes and control characters.
+ */
+static void json_escape(const char *text, char *out, size_t size) {
+    size_t n = 0;
+    for (; *text && n + 7 < size; text++) {
+        unsigned char ch = (unsigned char)*text;
+        if (ch == '"' || ch == '\\') {
+            out[n++] = '\\';
+            out[n++] = (char)ch;
+        } else if (ch < 0x20) {
+            n += (size_t)snprintf(out + n, size - n, "\\u%04x", ch);
+        } else {
+            out[n++] = (char)ch;
+        }
+    }
+    out[n] = '\0';
+}
+
+/**
+ * @brief Format a job's status as JSON. Call with jobs_lock held.
+ */
+static void job_json(const Job *job, char *out, size_t size) {
+    char error[6 * sizeof(job->error)];
+    json_escape(job->error, error, sizeof(error));
+    double now = now_seconds();
+    double waited = (job->started_at ? job->started_at : now) - job->submitted_at;
+    double ran = job->started_at ? (job->finished_at ? job->finished_at : now) - job->started_at : 0.0;
+    snprintf(out, size,
+             "{\"id\":%lu,\"status\":\"%s\",\"progress\":%.3f,\"frames\":%llu,"
+             "\"queued_seconds\":%.3f,\"run_seconds\":%.3f,\"result\":\"/jobs/%lu/result\"%s%s%s}\n",
+             job->id, job_state_names[job->state], job->progress, job->frames, waited, ran, job->id,
+             job->error[0] ? ",\"error\":\"" : "", error, job->error[0] ? "\"" : "");
+}
+
+/**
+ * @brief Wait until a job is finished or the server stops. Call with jobs_lock held.
+ */
+static void wait_for_job(const Job *job) {
+    while (!job_finished(job) && !stop_requested) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 1;
+        pthread_cond_timedwait(&jobs_changed, &jobs_lock, &deadline);
+    }
+}
+
+/**
+ * @brief Answer with a job's result, or its status if it has none.
+ * @return 1 to keep the connection, 0 to close it.
+ */
+static int respond_with_result(int fd, unsigned long id, int wait, int keep_alive) {
+    char body[2048], path[1024];
+    pthread_mutex_lock(&jobs_lock);
+    Job *job = find_job(id);
+    if (!job) {
+        pthread_mutex_unlock(&jobs_lock);
+        return send_error(fd, 404, "no such job", keep_alive) && keep_alive;
+    }
+    if (wait) {
+        // Waiting keeps the job in the table, even if it is deleted meanwhile.
+        job->waiters++;
+        wait_for_job(job);
+        job->waiters--;
+    }
+    if (job->state != JOB_DONE || job->cancel) {
+        job_json(job, body, sizeof(body));
+        reap_job(job);
+        pthread_mutex_unlock(&jobs_lock);
+        return send_response(fd, 409, "application/json", body, keep_alive, NULL) && keep_alive;
+    }
+    snprintf(path, sizeof(path), "%s", job->output);
+    pthread_mutex_unlock(&jobs_lock);
+    return send_file(fd, path, keep_alive) && keep_alive;
+}
+
+static void count_rejected(void) {
+    pthread_mutex_lock(&jobs_lock);
+    metrics.rejected++;
+    pthread_mutex_unlock(&jobs_lock);
+}
+
+/**
+ * @brief Tell the client the queue is full and when to try again.
+ */
+static int send_busy(int fd, int keep_alive) {
+    return send_response(fd, 503, "application/json", "{\"error\":\"queue full\"}\n", keep_alive,
+                         "Retry-After: 1\r\n");
+}
+
+/**
+ * @brief POST /jobs: create a job from an upload or a local path.
+ * @return 1 to keep the connection, 0 to close it.
+ */
+static int handle_submit(Conn *c, const Request *req) {
+    int fd = c->fd;
+    char input[1024], output[1024], wait_value[8];
+    int has_input = query_param(req->query, "input", input, sizeof(input));
+    int has_output = query_param(req->query, "output", output, sizeof(output));
+    int wait = query_param(req->query, "wait", wait_value, sizeof(wait_value)) && strcmp(wait_value, "0") != 0;
+
+    if ((has_input && input[0] != '/') || (has_output && output[0] != '/')) {
+        skip_body(c, req);
+        return send_error(fd, 400, "input and output must be absolute paths", 0) && 0;
+    }
+    if (!has_input && !req->chunked && req->content_length < 0) {
+        return send_error(fd, 411, "upload needs Content-Length or chunked encoding", 0) && 0;
+    }
+
+    // Refuse before the upload when the queue is already full; the body is
+    // left unread, so the connection is closed.
+    size_t depth, max_depth;
+    job_queue_depth(&queue, &depth, &max_depth);
+    if (depth >= queue_capacity) {
+        count_rejected();
+        return send_busy(fd, 0);
+    }
+    Job *job = new_job();
+    if (!job) {
+        count_rejected();
+        return send_busy(fd, 0);
+    }
+
+    if (has_input) {
+        snprintf(job->input, sizeof(job->input), "%s", input);
+        if (!skip_body(c, req)) {
+            abandon_job(job);
+            return 0;
+        }
+    } else {
+        // Stream the upload to the spool; it is never held in memory.
+        snprintf(job->input, sizeof(job->input), "%s/%lu.in.wav", spool_dir, job->id);
+        job->spooled_input = 1;
+        FILE *file = fopen(job->input, "wb");
+        if (!file) {
+            abandon_job(job);
+            skip_body(c, req);
+            return send_error(fd, 500, "cannot write to the spool directory", 0) && 0;
+        }
+        if (req->expect_continue && !send_all(fd, "HTTP/1.1 100 Continue\r\n\r\n", 25)) {
+            fclose(file);
+            abandon_job(job);
+            return 0;
+        }
+        long long bytes = receive_body(c, req, file);
+        if (fclose(file) != 0) bytes = -1;
+        if (bytes < 0) {
+            abandon_job(job);
+            return send_error(fd, 400, "incomplete upload", 0) && 0;
+        }
+        pthread_mutex_lock(&jobs_lock);
+        metrics.upload_bytes += (unsigned long long)bytes;
+        pthread_mutex_unlock(&jobs_lock);
+    }
+
+    if (has_output) {
+        snprintf(job->output, sizeof(job->output), "%s", output);
+    } else {
+        snprintf(job->output, sizeof(job->output), "%s/%lu.out.wav", spool_dir, job->id);
+        job->spooled_output = 1;
+    }
+
+    if (!job_queue_try_push(&queue, job)) {
+        count_rejected();
+        abandon_job(job);
+        return send_busy(fd, req->keep_alive) && req->keep_alive;
+    }
+
+    char body[2048];
+    pthread_mutex_lock(&jobs_lock);
+    metrics.submitted++;
+    unsigned long id = job->id;
+    job_json(job, body, sizeof(body));
+    pthread_mutex_unlock(&jobs_lock);
+
+    if (wait) return respond_with_result(fd, id, 1, req->keep_alive);
+    char location[64];
+    snprintf(location, sizeof(location), "Location: /jobs/%lu\r\n", id);
+    return send_response(fd, 202, "application/json", body, req->keep_alive, location) && req->keep_alive;
+}
+
+/**
+ * @brief GET /metrics in the Prometheus text format.
+ */
+static int handle_metrics(int fd, int keep_alive) {
+    size_t depth, max_depth;
+    job_queue_depth(&queue, &depth, &max_depth);
+
+    char body[4096];
+    pthread_mutex_lock(&jobs_lock);
+    double uptime = now_seconds() - start_time;
+    snprintf(body, sizeof(body),
+             "# HELP denoise_queue_depth Jobs waiting for a worker.\n"
+             "# TYPE denoise_queue_depth gauge\n"
+             "denoise_queue_depth %zu\n"
+             "denoise_queue_max_depth %zu\n"
+             "# HELP denoise_jobs_running Jobs being denoised.\n"
+             "# TYPE denoise_jobs_running gauge\n"
+             "denoise_jobs_running %d\n"
+             "# TYPE denoise_jobs_submitted_total counter\n"
+             "denoise_jobs_submitted_total %llu\n"
+             "denoise_jobs_rejected_total %llu\n"
+             "# TYPE denoise_jobs_finished_total counter\n"
+             "denoise_jobs_finished_total{status=\"done\"} %llu\n"
+             "denoise_jobs_finished_total{status=\"failed\"} %llu\n"
+             "denoise_jobs_finished_total{status=\"cancelled\"} %llu\n"
+             "# HELP denoise_audio_seconds_total Audio denoised.\n"
+             "# TYPE denoise_audio_seconds_total counter\n"
+             "denoise_audio_seconds_total %.3f\n"
+             "denoise_worker_busy_seconds_total %.3f\n"
+             "denoise_queue_wait_seconds_total %.3f\n"
+             "denoise_upload_bytes_total %llu\n"
+             "# HELP denoise_realtime_factor Audio seconds denoised per second of worker time.\n"
+             "# TYPE denoise_realtime_factor gauge\n"
+             "denoise_realtime_factor %.2f\n"
+             "# HELP denoise_throughput_jobs_per_second Finished jobs per second since start.\n"
+             "# TYPE denoise_throughput_jobs_per_second gauge\n"
+             "denoise_throughput_jobs_per_second %.4f\n"
+             "denoise_uptime_seconds %.0f\n",
+             depth, max_depth, metrics.running, metrics.submitted, metrics.rejected, metrics.finished[JOB_DONE],
+             metrics.finished[JOB_FAILED], metrics.finished[JOB_CANCELLED], metrics.audio_seconds,
+             metrics.busy_seconds, metrics.queue_wait_seconds, metrics.upload_bytes,
+             metrics.busy_seconds > 0 ? metrics.audio_seconds / metrics.busy_seconds : 0.0,
+             uptime > 0 ? metrics.finished[JOB_DONE] / uptime : 0.0, uptime);
+    pthread_mutex_unlock(&jobs_lock);
+    return send_response(fd, 200, "text/plain; version=0.0.4", body, keep_alive, NULL) && keep_alive;
+}
+
+/**
+ * @brief Handle one request.
+ * @return 1 to keep the connection open, 0 to close it.
+ */
+static int handle_request(Conn *c, const Request *req) {
+    int fd = c->fd;
+    int keep_alive = req->keep_alive;
+    unsigned long id = 0;
+    char rest[64] = "";
+    int is_job = sscanf(req->path, "/jobs/%lu%63s", &id, rest) >= 1;
+
+    if (strcmp(req->path, "/jobs") == 0) {
+        // PUT is what `curl -T` sends for a streamed upload.
+        if (strcmp(req->method, "POST") == 0 || strcmp(req->method, "PUT") == 0) return handle_submit(c, req);
+        skip_body(c, req);
+        return send_error(fd, 405, "use POST", keep_alive) && keep_alive;
+    }
+
+    if (!skip_body(c, req)) return 0;
+
+    if (strcmp(req->path, "/metrics") == 0 && strcmp(req->method, "GET") == 0) {
+        return handle_metrics(fd, keep_alive);
+    }
+    if (is_job && strcmp(rest, "/result") == 0 && strcmp(req->method, "GET") == 0) {
+        char wait_value[8];
+        int wait = query_param(req->query, "wait", wait_value, sizeof(wait_value)) && strcmp(wait_value, "0") != 0;
+        return respond_with_result(fd, id, wait, keep_alive);
+    }
+    if (is_job && rest[0] == '\0' && strcmp(req->method, "GET") == 0) {
+        char body[2048];
+        pthread_mutex_lock(&jobs_lock);
+        Job *job = find_job(id);
+        if (job) job_json(job, body, sizeof(body));
+        pthread_mutex_unlock(&jobs_lock);
+        if (!job) return send_error(fd, 404, "no such job", keep_alive) && keep_alive;
+        return send_response(fd, 200, "application/json", body, keep_alive, NULL) && keep_alive;
+    }
+    if (is_job && rest[0] == '\0' && strcmp(req->method, "DELETE") == 0) {
+        pthread_mutex_lock(&jobs_lock);
+        Job *job = find_job(id);
+        if (job) {
+            job->cancel = 1;
+            // A running job stops at its next frame; wait so its files can go.
+            while (job->state == JOB_RUNNING) pthread_cond_wait(&jobs_changed, &jobs_lock);
+            // A queued job is reaped by the worker that takes it off the
+            // queue, one with waiting clients by the last of them.
+            reap_job(job);
+        }
+        pthread_mutex_unlock(&jobs_lock);
+        if (!job) return send_error(fd, 404, "no such job", keep_alive) && keep_alive;
+        return send_response(fd, 200, "application/json", "{\"deleted\":true}\n", keep_alive, NULL) && keep_alive;
+    }
+    if (is_job || strcmp(req->path, "/metrics") == 0) {
+        return send_error(fd, 405, "method not allowed", keep_alive) && keep_alive;
+    }
+    return send_error(fd, 404, "not found", keep_alive) && keep_alive;
+}
+
+static void *connection_main(void *arg) {
+    Conn *c = arg;
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    while (!stop_requested) {
+        Request req;
+        int status = read_request(c, &req);
+        if (status == 0) break;
+        if (status < 0) {
+            send_error(c->fd, 400, "malformed request", 0);
+            break;
+        }
+        if (!handle_request(c, &req)) break;
+    }
+
+    close(c->fd);
+    free(c);
+    pthread_mutex_lock(&jobs_lock);
+    active_connections--;
+    pthread_cond_broadcast(&jobs_changed);
+    pthread_mutex_unlock(&jobs_lock);
+    return NULL;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-a address] [-p port] [-j workers] [-q queue_size] [-d spool_dir] [-u]\n"
+            "  -a  address to listen on (default 127.0.0.1)\n"
+            "  -p  port (default 8080)\n"
+            "  -j  worker threads (default: number of CPUs)\n"
+            "  -q  queued jobs before submissions get 503 (default 4 per worker)\n"
+            "  -d  directory for uploads and results (default /tmp/denoise_server)\n"
+            "  -u  read and write through io_uring when available\n",
+            prog);
+}
+
+/**
+ * @brief Main entry point.
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return 0 on a clean stop, 1 on error.
+ */
+int main(int argc, char *argv[]) {
+    const char *address = "127.0.0.1";
+    int port = 8080;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers = cpus > 0 ? (int)cpus : 1;
+    int queue_size = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:p:j:q:d:uh")) != -1) {
+        switch (opt) {
+            case 'a': address = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'j': workers = atoi(optarg); break;
+            case 'q': queue_size = atoi(optarg); break;
+            case 'd': spool_dir = optarg; break;
+            case 'u': use_io_uring = 1; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (workers < 1) workers = 1;
+    if (workers > MAX_WORKERS) workers = MAX_WORKERS;
+    if (queue_size < 1) queue_size = 4 * workers;
+
+    if (mkdir(spool_dir, 0700) != 0 && errno != EEXIST) {
+        fprintf(stderr, "%s: %s\n", spool_dir, strerror(errno));
+        return 1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+        fprintf(stderr, "Invalid address: %s\n", address);
+        return 1;
+    }
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    if (listener < 0 || setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 64) != 0) {
+        fprintf(stderr, "Cannot listen on %s:%d: %s\n", address, port, strerror(errno));
+        return 1;
+    }
+
+    queue_capacity = (size_t)queue_size;
+    if (!job_queue_init(&queue, queue_capacity)) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    start_time = now_seconds();
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    pthread_t threads[MAX_WORKERS];
+    int started = 0;
+    for (; started < workers; started++) {
+        if (pthread_create(&threads[started], NULL, worker_main, NULL) != 0) break;
+    }
+    if (started == 0) {
+        fprintf(stderr, "Could not start worker threads\n");
+        return 1;
+    }
+    fprintf(stderr, "Listening on http://%s:%d with %d workers, queue size %d\n", address, port, started,
+            queue_size);
+
+    pthread_attr_t detached;
+    pthread_attr_init(&detached);
+    pthread_attr_setdetachstate(&detached, PTHREAD_CREATE_DETACHED);
+
+    while (!stop_requested) {
+        struct pollfd pfd = {listener, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) continue;
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) continue;
+
+        pthread_mutex_lock(&jobs_lock);
+        int busy = active_connections >= MAX_CONNECTIONS;
+        if (!busy) active_connections++;
+        pthread_mutex_unlock(&jobs_lock);
+        Conn *c = busy ? NULL : malloc(sizeof(Conn));
+        if (!c) {
+            send_error(fd, 503, "too many connections", 0);
+            close(fd);
+            if (!busy) {
+                pthread_mutex_lock(&jobs_lock);
+                active_connections--;
+                pthread_mutex_unlock(&jobs_lock);
+            }
+            continue;
+        }
+        c->fd = fd;
+        c->len = c->pos = 0;
+        pthread_t thread;
+        if (pthread_create(&thread, &detached, connection_main, c) != 0) {
+            send_error(fd, 503, "too many connections", 0);
+            close(fd);
+            free(c);
+            pthread_mutex_lock(&jobs_lock);
+            active_connections--;
+            pthread_mutex_unlock(&jobs_lock);
+        }
+    }
+
+    // Running and queued jobs see stop_requested and are cancelled. The job
+    // table is not kept across restarts, so the spool is cleaned up.
+    fprintf(stderr, "Stopping\n");
+    close(listener);
+    job_queue_close(&queue);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    pthread_mutex_lock(&jobs_lock);
+    // Connection threads may still hold jobs. Waiting clients are answered
+    // with the job's status, idle ones and uploads are dropped within
+    // STOP_POLL_MS; only a client that stops reading a result can outlast
+    // the deadline, and then the jobs and their spool files are left alone.
+    pthread_cond_broadcast(&jobs_changed);
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += IDLE_TIMEOUT_MS / 1000;
+    while (active_connections > 0) {
+        if (pthread_cond_timedwait(&jobs_changed, &jobs_lock, &deadline) == ETIMEDOUT) break;
+    }
+    if (active_connections > 0) {
+        fprintf(stderr, "%d connections still open, leaving the spool as it is\n", active_connections);
+    } else {
+        while (job_count > 0) drop_job(job_count - 1);
+    }
+    pthread_mutex_unlock(&jobs_lock);
+    return 0;
+}
@@ -0,0 +1,805 @@
+/**
+ * @file
+ * @brief Drop-folder service that denoises new WAV and MP3 files.
+ *
+ * Watches one or more input directories with inotify. A new file is
+ * considered complete once it has been closed (or moved in) and its size
+ * has not changed for the debounce period; a writer that pauses with the
+ * file still open is waited for however long the pause. Files found by a
+ * directory scan (at startup, or after lost events) count as closed.
+ * Complete files go into a bounded queue served by a pool of worker
+ * threads. When the queue is full, ready files wait in the watcher instead
+ * (backpressure), so intake never outruns the workers. A file that changes
+ * again while its job is queued or running is queued again only after that
+ * job has finished. Outputs are named after the input's stem; when another
+ * queued or running job already writes that name (a.wav and a.mp3, or the
+ * same name in two input directories), the new job writes
+ * "<stem>-<hash of its path>.wav" instead, so two jobs never share an
+ * output, a .partial file or a checkpoint.
+ *
+ * Each worker denoises into a hidden ".partial" file in the output
+ * directory and renames it into place when done, so the output directory
+ * only ever shows complete files. Inputs that are not 48kHz mono 16-bit WAV
+ * (including MP3) are first decoded and resampled with miniaudio. Jobs
+ * checkpoint like rnnoise_batch: after a restart, interrupted files resume.
+ * With -C, results come from and go to a content-addressed cache, so
+ * re-submitted recordings are not denoised again.
+ *
+ * Queue depth, throughput and latency are logged periodically, on SIGUSR1
+ * and at exit, and can be written to a stats file for monitoring.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define MINIAUDIO_IMPLEMENTATION
+#define MA_NO_DEVICE_IO
+#include "miniaudio.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "denoise_cache.h"
+#include "denoise_offline.h"
+#include "job_queue.h"
+
+#define FRAME_SIZE 480     // RNNoise frame size (10ms at 48kHz).
+#define SAMPLE_RATE 48000  // Expected sample rate for RNNoise.
+
+#define MAX_DIRS 16          // Input directories.
+#define MAX_WORKERS 64       // Worker threads.
+#define MAX_PENDING 4096     // Files being debounced or waiting for queue room.
+#define LATENCY_WINDOW 1024  // Jobs kept for the latency percentiles.
+#define TICK_MS 100          // Watcher loop period.
+
+/**
+ * @brief Struct representing the WAV file header.
+ */
+typedef struct {
+    char riff[4];                  // "RIFF"
+    uint32_t file_size;            // Total file size minus 8 bytes
+    char wave[4];                  // "WAVE"
+    char fmt[4];                   // "fmt "
+    uint32_t fmt_size;             // Format chunk size (usually 16)
+    uint16_t format;               // Audio format (1 = PCM)
+    uint16_t channels;             // Number of audio channels
+    uint32_t sample_rate;          // Sampling rate (Hz)
+    uint32_t byte_rate;            // Bytes per second
+    uint16_t block_align;          // Block alignment (bytes per sample frame)
+    uint16_t bits_per_sample;      // Bits per sample (usually 16)
+    char data[4];                  // "data"
+    uint32_t data_size;            // Size of audio data in bytes
+} WavHeader;
+
+/**
+ * @brief A file handed to the workers.
+ */
+typedef struct {
+    char *path;
+    char *name;          // Output name: the input's stem, or stem-<hash> if that was in use.
+    double ready_at;     // When the file was found complete (latency start).
+} WatchJob;
+
+/**
+ * @brief A file seen by the watcher but not queued yet.
+ */
+typedef struct {
+    char *path;
+    double deadline;     // Earliest time to queue it.
+    long long size;      // Size at the last check; a change restarts the debounce.
+    double ready_at;     // When it first passed the debounce (0 if not yet).
+    int closed;          // Closed by its writer or moved in since it was last modified.
+    int waiting;         // Ready but the queue was full.
+} Pending;
+
+/**
+ * @brief Service counters, shared by the watcher and the workers.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    unsigned long long done;
+    unsigned long long failed;
+    unsigned long long skipped;      // Already up to date.
+    unsigned long long cache_hits;   // Done jobs served from the result cache.
+    unsigned long long backpressure; // Ready files that had to wait for queue room.
+    int in_progress;
+    double audio_seconds;            // Audio denoised.
+    double latency[LATENCY_WINDOW];  // Ready-to-output times of recent jobs.
+    size_t latency_count;
+} Stats;
+
+static const char *output_dir;
+static const char *input_dirs[MAX_DIRS];
+static int input_dir_count = 0;
+static double debounce_seconds = 2.0;
+static DenoiseCache cache;
+static int use_io_uring = 0;
+
+static JobQueue queue;
+static Stats stats = {.lock = PTHREAD_MUTEX_INITIALIZER};
+static Pending pending[MAX_PENDING];
+static int pending_count = 0;
+static int rescan_needed = 0;
+
+// Jobs queued or running, so that no two of them share an input or an output.
+static pthread_mutex_t active_lock = PTHREAD_MUTEX_INITIALIZER;
+static const WatchJob **active;
+static int active_count = 0;
+
+static volatile sig_atomic_t stop_requested = 0;
+static volatile sig_atomic_t stats_requested = 0;
+
+static void on_stop_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static void on_stats_signal(int sig) {
+    (void)sig;
+    stats_requested = 1;
+}
+
+/**
+ * @brief Monotonic clock in seconds.
+ */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Check for a .wav or .mp3 name that is not hidden.
+ */
+static int is_audio_name(const char *name) {
+    const char *dot = strrchr(name, '.');
+    if (name[0] == '.' || !dot) return 0;
+    return strcasecmp(dot, ".wav") == 0 || strcasecmp(dot, ".mp3") == 0;
+}
+
+/**
+ * @brief The input's file name without directory and extension.
+ * @return A newly allocated string, or NULL.
+ */
+static char *input_stem(const char *input) {
+    const char *base = strrchr(input, '/');
+    base = base ? base + 1 : input;
+    const char *dot = strrchr(base, '.');
+    return strndup(base, dot ? (size_t)(dot - base) : strlen(base));
+}
+
+/**
+ * @brief The output name used when the input's stem is taken: "<stem>-<hash of the input path>".
+ * @return A newly allocated string, or NULL.
+ */
+static char *unique_name(const char *stem, const char *input) {
+    uint32_t hash = 2166136261u;  // FNV-1a
+    for (const char *c = input; *c; c++) hash = (hash ^ (unsigned char)*c) * 16777619u;
+    size_t len = strlen(stem) + 10;
+    char *name = malloc(len);
+    if (name) snprintf(name, len, "%s-%08x", stem, hash);
+    return name;
+}
+
+/**
+ * @brief Build "<output_dir>/<prefix><name><suffix>".
+ * @return A newly allocated path, or NULL.
+ */
+static char *output_path_for(const char *name, const char *prefix, const char *suffix) {
+    size_t len = strlen(output_dir) + strlen(prefix) + strlen(name) + strlen(suffix) + 2;
+    char *path = malloc(len);
+    if (path) snprintf(path, len, "%s/%s%s%s", output_dir, prefix, name, suffix);
+    return path;
+}
+
+/**
+ * @brief Check whether a file already has an output at least as new as itself.
+ * @param name Output name, or NULL for the input's stem.
+ */
+static int output_up_to_date(const char *input, const char *name) {
+    char *stem = name ? NULL : input_stem(input);
+    char *out = name || stem ? output_path_for(name ? name : stem, "", ".wav") : NULL;
+    struct stat in_st, out_st;
+    int ok = out && stat(input, &in_st) == 0 && stat(out, &out_st) == 0 && out_st.st_mtime >= in_st.st_mtime;
+    free(stem);
+    free(out);
+    return ok;
+}
+
+/**
+ * @brief Check whether a queued or running job reads this input.
+ */
+static int input_active(const char *path) {
+    int found = 0;
+    pthread_mutex_lock(&active_lock);
+    for (int i = 0; i < active_count && !found; i++) found = strcmp(active[i]->path, path) == 0;
+    pthread_mutex_unlock(&active_lock);
+    return found;
+}
+
+/**
+ * @brief Check whether a queued or running job writes this output name.
+ */
+static int name_active(const char *name) {
+    int found = 0;
+    pthread_mutex_lock(&active_lock);
+    for (int i = 0; i < active_count && !found; i++) found = strcmp(active[i]->name, name) == 0;
+    pthread_mutex_unlock(&active_lock);
+    return found;
+}
+
+/**
+ * @brief Record a job as queued. The array has room for every queued and running job.
+ */
+static void add_active(const WatchJob *job) {
+    pthread_mutex_lock(&active_lock);
+    active[active_count++] = job;
+    pthread_mutex_unlock(&active_lock);
+}
+
+/**
+ * @brief Forget a job once it has finished (or was never queued).
+ */
+static void remove_active(const WatchJob *job) {
+    pthread_mutex_lock(&active_lock);
+    for (int i = 0; i < active_count; i++) {
+        if (active[i] == job) {
+            active[i] = active[--active_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&active_lock);
+}
+
+/**
+ * @brief Start or restart the debounce of a file.
+ * @param closed 1 when the writer closed the file or it was moved in, 0 when it
+ *               was modified (and so is open for writing).
+ */
+static void touch_pending(const char *path, int closed) {
+    double now = now_seconds();
+    for (int i = 0; i < pending_count; i++) {
+        if (strcmp(pending[i].path, path) == 0) {
+            if (!pending[i].waiting) pending[i].deadline = now + debounce_seconds;
+            pending[i].closed = closed;
+            return;
+        }
+    }
+    if (pending_count == MAX_PENDING) {
+        // Picked up by a rescan once there is room again.
+        rescan_needed = 1;
+        return;
+    }
+    char *copy = strdup(path);
+    if (!copy) return;
+    pending[pending_count++] = (Pending){copy, now + debounce_seconds, -1, 0.0, closed, 0};
+}
+
+/**
+ * @brief Queue every audio file of the input directories that has no output yet.
+ *
+ * Run at startup and whenever inotify events were lost.
+ */
+static void scan_input_dirs(void) {
+    rescan_needed = 0;
+    for (int d = 0; d < input_dir_count; d++) {
+        DIR *dir = opendir(input_dirs[d]);
+        if (!dir) continue;
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (!is_audio_name(entry->d_name)) continue;
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s", input_dirs[d], entry->d_name);
+            if (!output_up_to_date(path, NULL)) touch_pending(path, 1);
+        }
+        closedir(dir);
+    }
+}
+
+/**
+ * @brief Move debounced files into the queue, as far as there is room.
+ */
+static void flush_pending(void) {
+    double now = now_seconds();
+    for (int i = 0; i < pending_count;) {
+        Pending *p = &pending[i];
+        if (now < p->deadline) {
+            i++;
+            continue;
+        }
+
+        struct stat st;
+        if (stat(p->path, &st) != 0) {
+            // Deleted or moved away before it was complete.
+            free(p->path);
+            pending[i] = pending[--pending_count];
+            continue;
+        }
+        if (!p->closed) {
+            // Still open for writing: look again after another debounce period.
+            p->deadline = now + debounce_seconds;
+            i++;
+            continue;
+        }
+        if (!p->waiting && (long long)st.st_size != p->size) {
+            // Still growing: wait another debounce period.
+            p->size = (long long)st.st_size;
+            p->deadline = now + debounce_seconds;
+            i++;
+            continue;
+        }
+
+        if (input_active(p->path)) {
+            // Changed again while its job is queued or running: queued once
+            // that job is done (the worker skips it if the output is current).
+            i++;
+            continue;
+        }
+
+        // a.wav and a.mp3, or the same name in two input directories, map
+        // to the same output: a second one at a time gets its own name.
+        char *name = input_stem(p->path);
+        int renamed = name && name_active(name);
+        if (renamed) {
+            char *unique = unique_name(name, p->path);
+            free(name);
+            name = unique;
+        }
+        if (!name || name_active(name)) {
+            free(name);
+            i++;
+            continue;
+        }
+
+        if (p->ready_at == 0.0) p->ready_at = now;
+        WatchJob *job = malloc(sizeof(WatchJob));
+        if (job) {
+            job->path = p->path;
+            job->name = name;
+            job->ready_at = p->ready_at;
+            add_active(job);
+        }
+        if (!job || !job_queue_try_push(&queue, job)) {
+            if (job) remove_active(job);
+            free(job);
+            free(name);
+            if (!p->waiting) {
+                pthread_mutex_lock(&stats.lock);
+                stats.backpressure++;
+                pthread_mutex_unlock(&stats.lock);
+                p->waiting = 1;
+            }
+            i++;
+            continue;
+        }
+        if (renamed) fprintf(stderr, "%s: its output name is in use, writing %s.wav\n", job->path, name);
+        pending[i] = pending[--pending_count];
+    }
+    if (rescan_needed && pending_count < MAX_PENDING / 2) scan_input_dirs();
+}
+
+/**
+ * @brief Check for a 48kHz mono 16-bit WAV that RNNoise can read as is.
+ */
+static int is_native_wav(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return 0;
+    WavHeader header;
+    int ok = fread(&header, sizeof(WavHeader), 1, file) == 1 &&
+             memcmp(header.riff, "RIFF", 4) == 0 && memcmp(header.wave, "WAVE", 4) == 0 &&
+             memcmp(header.fmt, "fmt ", 4) == 0 && memcmp(header.data, "data", 4) == 0 &&
+             header.format == 1 && header.channels == 1 && header.sample_rate == SAMPLE_RATE &&
+             header.bits_per_sample == 16;
+    fclose(file);
+    return ok;
+}
+
+/**
+ * @brief Decode any format miniaudio supports into a 48kHz mono 16-bit WAV.
+ * @return 1 on success, 0 on failure.
+ */
+static int decode_to_wav(const char *input, const char *output) {
+    ma_decoder_config config = ma_decoder_config_init(ma_format_s16, 1, SAMPLE_RATE);
+    ma_decoder decoder;
+    if (ma_decoder_init_file(input, &config, &decoder) != MA_SUCCESS) return 0;
+
+    FILE *file = fopen(output, "wb");
+    if (!file) {
+        ma_decoder_uninit(&decoder);
+        return 0;
+    }
+
+    WavHeader header = {{'R', 'I', 'F', 'F'}, 0, {'W', 'A', 'V', 'E'}, {'f', 'm', 't', ' '}, 16, 1, 1,
+                        SAMPLE_RATE, SAMPLE_RATE * sizeof(int16_t), sizeof(int16_t), 16,
+                        {'d', 'a', 't', 'a'}, 0};
+    int ok = fwrite(&header, sizeof(WavHeader), 1, file) == 1;
+
+    int16_t buffer[FRAME_SIZE * 16];
+    uint64_t total = 0;
+    ma_uint64 frames_read = 0;
+    while (ok && ma_decoder_read_pcm_frames(&decoder, buffer, FRAME_SIZE * 16, &frames_read) == MA_SUCCESS &&
+           frames_read > 0) {
+        ok = fwrite(buffer, sizeof(int16_t), (size_t)frames_read, file) == frames_read;
+        total += frames_read;
+    }
+    ma_decoder_uninit(&decoder);
+
+    header.data_size = (uint32_t)(total * sizeof(int16_t));
+    header.file_size = header.data_size + sizeof(WavHeader) - 8;
+    ok = ok && total > 0 && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(WavHeader), 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+    return ok;
+}
+
+static int job_cancelled(void *user) {
+    (void)user;
+    return stop_requested;
+}
+
+/**
+ * @brief Denoise one file into the output directory.
+ *
+ * @param hit Set to 1 when the result came from the cache.
+ * @return 1 when done, 0 on failure, -1 when stopped (the job resumes on restart).
+ */
+static int run_job(const WatchJob *job, double *audio_seconds, int *hit) {
+    char *final_path = output_path_for(job->name, "", ".wav");
+    char *partial_path = output_path_for(job->name, ".", ".wav.partial");
+    char *decoded_path = output_path_for(job->name, ".", ".decoded.wav");
+    int status = 0;
+
+    if (!final_path || !partial_path || !decoded_path) goto out;
+
+    const char *source = job->path;
+    if (!is_native_wav(job->path)) {
+        if (!decode_to_wav(job->path, decoded_path)) {
+            fprintf(stderr, "%s: could not decode\n", job->path);
+            goto out;
+        }
+        source = decoded_path;
+    }
+
+    DenoiseJob dj = {
+        .input_path = source,
+        .output_path = partial_path,
+        .checkpoint_seconds = DENOISE_CHECKPOINT_SECONDS,
+        .resume = 1,
+        .io_uring = use_io_uring,
+        .cancelled = job_cancelled,
+    };
+    DenoiseResult result;
+    int ok = cache.dir ? denoise_cache_run(&cache, &dj, &result, hit) : denoise_offline_run(&dj, &result);
+    if (!ok) {
+        fprintf(stderr, "%s: %s\n", job->path, result.error);
+        goto out;
+    }
+    if (result.cancelled) {
+        status = -1;
+        goto out;
+    }
+
+    // Publish the finished file in one step.
+    if (rename(partial_path, final_path) != 0) {
+        fprintf(stderr, "%s: could not rename into place: %s\n", final_path, strerror(errno));
+        goto out;
+    }
+    *audio_seconds = (double)result.frames * FRAME_SIZE / SAMPLE_RATE;
+    status = 1;
+
+out:
+    // A decoded copy is cheap to rebuild and its checkpoint would not match a
+    // new one anyway, so it never outlives the job.
+    if (decoded_path) remove(decoded_path);
+    if (status == 0 && partial_path) {
+        char ckpt[4096];
+        snprintf(ckpt, sizeof(ckpt), "%s%s", partial_path, DENOISE_CHECKPOINT_SUFFIX);
+        remove(partial_path);
+        remove(ckpt);
+    }
+    free(final_path);
+    free(partial_path);
+    free(decoded_path);
+    return status;
+}
+
+/**
+ * @brief Record a finished job in the stats.
+ */
+static void record_job(int status, double latency, double audio_seconds, int hit) {
+    pthread_mutex_lock(&stats.lock);
+    stats.in_progress--;
+    if (status > 0) {
+        stats.done++;
+        stats.cache_hits += hit;
+        stats.audio_seconds += audio_seconds;
+        stats.latency[stats.latency_count++ % LATENCY_WINDOW] = latency;
+    } else if (status == 0) {
+        stats.failed++;
+    }
+    pthread_mutex_unlock(&stats.lock);
+}
+
+/**
+ * @brief Release a job taken from the queue; its file may be queued again.
+ */
+static void free_job(WatchJob *job) {
+    remove_active(job);
+    free(job->path);
+    free(job->name);
+    free(job);
+}
+
+/**
+ * @brief Worker thread: denoise queued files until the queue is closed.
+ */
+static void *worker_main(void *arg) {
+    (void)arg;
+    WatchJob *job;
+    while ((job = job_queue_pop(&queue)) != NULL) {
+        if (stop_requested) {
+            // Left for the next start; its input has no output yet.
+            free_job(job);
+            continue;
+        }
+        if (output_up_to_date(job->path, job->name)) {
+            // Queued twice, e.g. by a rescan while it was being processed.
+            pthread_mutex_lock(&stats.lock);
+            stats.skipped++;
+            pthread_mutex_unlock(&stats.lock);
+            free_job(job);
+            continue;
+        }
+
+        pthread_mutex_lock(&stats.lock);
+        stats.in_progress++;
+        pthread_mutex_unlock(&stats.lock);
+
+        double audio_seconds = 0.0;
+        int hit = 0;
+        int status = run_job(job, &audio_seconds, &hit);
+        double latency = now_seconds() - job->ready_at;
+        record_job(status, latency, audio_seconds, hit);
+        if (status > 0) {
+            fprintf(stderr, "%s: done (%.1fs of audio, %.1fs after it was ready%s)\n", job->path, audio_seconds,
+                    latency, hit ? ", from cache" : "");
+        }
+        free_job(job);
+    }
+    return NULL;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Log the service counters and optionally write them to a file.
+ *
+ * Rates are computed over the period since the previous report.
+ *
+ * @param stats_file Path written atomically in "key value" lines, or NULL.
+ */
+static void report_stats(const char *stats_file) {
+    static double last_time = 0.0;
+    static unsigned long long last_done = 0;
+    static double last_audio = 0.0;
+    static double start_time = 0.0;
+
+    double now = now_seconds();
+    if (start_time == 0.0) start_time = last_time = now;
+
+    size_t depth, max_depth;
+    job_queue_depth(&queue, &depth, &max_depth);
+
+    double latency[LATENCY_WINDOW];
+    pthread_mutex_lock(&stats.lock);
+    Stats snap = stats;
+    size_t n = stats.latency_count < LATENCY_WINDOW ? stats.latency_count : LATENCY_WINDOW;
+    memcpy(latency, stats.latency, n * sizeof(double));
+    pthread_mutex_unlock(&stats.lock);
+
+    double mean = 0.0, p95 = 0.0, max = 0.0;
+    if (n > 0) {
+        qsort(latency, n, sizeof(double), compare_doubles);
+        for (size_t i = 0; i < n; i++) mean += latency[i];
+        mean /= n;
+        p95 = latency[(size_t)(0.95 * (n - 1))];
+        max = latency[n - 1];
+    }
+
+    double period = now - last_time;
+    double files_per_min = period > 0 ? (snap.done - last_done) * 60.0 / period : 0.0;
+    double realtime = period > 0 ? (snap.audio_seconds - last_audio) / period : 0.0;
+    last_time = now;
+    last_done = snap.done;
+    last_audio = snap.audio_seconds;
+
+    fprintf(stderr,
+            "stats: queue %zu (max %zu), pending %d, running %d, done %llu, failed %llu, "
+            "cache hits %llu, backpressure %llu, %.1f files/min, %.1fx real time, "
+            "latency mean %.1fs p95 %.1fs max %.1fs\n",
+            depth, max_depth, pending_count, snap.in_progress, snap.done, snap.failed, snap.cache_hits,
+            snap.backpressure, files_per_min, realtime, mean, p95, max);
+
+    if (!stats_file) return;
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", stats_file);
+    FILE *file = fopen(tmp, "w");
+    if (!file) return;
+    fprintf(file,
+            "uptime_seconds %.0f\nqueue_depth %zu\nqueue_max_depth %zu\npending %d\nrunning %d\n"
+            "done %llu\nfailed %llu\nskipped %llu\ncache_hits %llu\nbackpressure %llu\naudio_seconds %.1f\n"
+            "files_per_minute %.2f\nrealtime_factor %.2f\n"
+            "latency_mean_seconds %.2f\nlatency_p95_seconds %.2f\nlatency_max_seconds %.2f\n",
+            now - start_time, depth, max_depth, pending_count, snap.in_progress, snap.done, snap.failed,
+            snap.skipped, snap.cache_hits, snap.backpressure, snap.audio_seconds, files_per_min, realtime, mean, p95, max);
+    if (fclose(file) == 0) rename(tmp, stats_file);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-j workers] [-q queue_size] [-d debounce_seconds] [-s stats_seconds] [-S stats_file]\n"
+            "          [-C cache_dir [-L cache_mb]] [-u] -o output_dir input_dir...\n"
+            "  -j  worker threads (default: number of CPUs)\n"
+            "  -q  queued files before intake is held back (default 2 per worker)\n"
+            "  -d  time a file must stay unchanged before it is processed (default 2)\n"
+            "  -s  seconds between stats reports, 0 disables (default 60)\n"
+            "  -S  also write the stats to this file\n"
+            "  -C  reuse and store results in this cache directory\n"
+            "  -L  cache size limit in MiB (default %llu)\n"
+            "  -u  read and write through io_uring (O_DIRECT output) when available\n"
+            "Send SIGUSR1 for a stats report; SIGTERM or SIGINT stops after checkpointing running jobs.\n",
+            prog, DENOISE_CACHE_MAX_BYTES >> 20);
+}
+
+/**
+ * @brief Main entry point.
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return 0 on a clean stop, 1 on error.
+ */
+int main(int argc, char *argv[]) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers = cpus > 0 ? (int)cpus : 1;
+    int queue_size = 0;
+    double stats_seconds = 60.0;
+    const char *stats_file = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:q:d:s:S:C:L:uo:h")) != -1) {
+        switch (opt) {
+            case 'j': workers = atoi(optarg); break;
+            case 'q': queue_size = atoi(optarg); break;
+            case 'd': debounce_seconds = atof(optarg); break;
+            case 's': stats_seconds = atof(optarg); break;
+            case 'S': stats_file = optarg; break;
+            case 'C': cache.dir = optarg; break;
+            case 'L': cache.max_bytes = strtoull(optarg, NULL, 10) << 20; break;
+            case 'u': use_io_uring = 1; break;
+            case 'o': output_dir = optarg; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (!output_dir || optind == argc || argc - optind > MAX_DIRS) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (workers < 1) workers = 1;
+    if (workers > MAX_WORKERS) workers = MAX_WORKERS;
+    if (queue_size < 1) queue_size = 2 * workers;
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        perror("inotify_init1");
+        return 1;
+    }
+    int watches[MAX_DIRS];
+    for (int i = optind; i < argc; i++) {
+        int wd = inotify_add_watch(fd, argv[i], IN_CLOSE_WRITE | IN_MOVED_TO | IN_MODIFY);
+        if (wd < 0) {
+            fprintf(stderr, "%s: %s\n", argv[i], strerror(errno));
+            return 1;
+        }
+        watches[input_dir_count] = wd;
+        input_dirs[input_dir_count++] = argv[i];
+    }
+
+    active = malloc((size_t)(queue_size + workers + 1) * sizeof(*active));
+    if (!active || !job_queue_init(&queue, queue_size)) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    struct sigaction sa = {0};
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    sa.sa_handler = on_stats_signal;
+    sigaction(SIGUSR1, &sa, NULL);
+
+    pthread_t threads[MAX_WORKERS];
+    int started = 0;
+    for (; started < workers; started++) {
+        if (pthread_create(&threads[started], NULL, worker_main, NULL) != 0) break;
+    }
+    if (started == 0) {
+        fprintf(stderr, "Could not start worker threads\n");
+        return 1;
+    }
+    fprintf(stderr, "Watching %d director%s with %d workers, queue size %d\n", input_dir_count,
+            input_dir_count == 1 ? "y" : "ies", started, queue_size);
+
+    report_stats(NULL);  // Start the rate period.
+    scan_input_dirs();
+    double next_report = now_seconds() + stats_seconds;
+
+    char events[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (!stop_requested) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, TICK_MS) > 0) {
+            ssize_t len;
+            while ((len = read(fd, events, sizeof(events))) > 0) {
+                for (char *p = events; p < events + len;) {
+                    struct inotify_event *ev = (struct inotify_event *)p;
+                    p += sizeof(struct inotify_event) + ev->len;
+                    if (ev->mask & IN_Q_OVERFLOW) {
+                        rescan_needed = 1;
+                        continue;
+                    }
+                    if (ev->len == 0 || !is_audio_name(ev->name)) continue;
+                    for (int d = 0; d < input_dir_count; d++) {
+                        if (watches[d] != ev->wd) continue;
+                        char path[4096];
+                        snprintf(path, sizeof(path), "%s/%s", input_dirs[d], ev->name);
+                        touch_pending(path, (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0);
+                    }
+                }
+            }
+        }
+        flush_pending();
+
+        if (stats_requested || (stats_seconds > 0 && now_seconds() >= next_report)) {
+            stats_requested = 0;
+            report_stats(stats_file);
+            next_report = now_seconds() + stats_seconds;
+        }
+    }
+
+    // Running jobs see stop_requested, checkpoint and return.
+    fprintf(stderr, "Stopping\n");
+    job_queue_close(&queue);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    report_stats(stats_file);
+
+    for (int i = 0; i < pending_count; i++) free(pending[i].path);
+    job_queue_destroy(&queue);
+    free(active);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,385 @@
+/**
+ * @file
+ * @brief Audio device combo boxes filled in the background.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "device_list.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define INPUT 0
+#define OUTPUT 1
+
+static const char *const kind_names[2] = {"input", "output"};
+
+/**
+ * @brief One device, as shown in a combo row.
+ */
+typedef struct {
+    ma_device_id id;
+    char name[MA_MAX_DEVICE_NAME_LENGTH + 1];
+    gboolean is_default;
+} DeviceEntry;
+
+struct DeviceList {
+    char *app;
+    GtkComboBoxText *combos[2];
+    GArray *rows[2];             // DeviceEntry per combo row. Main thread only.
+    char *remembered[2];         // Base64 ID of the device used last.
+    char *backend;               // Backend the rows' IDs belong to.
+    gboolean live;               // Rows come from this run, not from the cache.
+
+    GThread *thread;
+    GMutex lock;
+    GCond cond;
+    gboolean context_done;       // The worker finished ma_context_init().
+    gboolean context_ok;
+    gboolean stopping;
+    ma_context context;
+    GArray *pending[2];          // Latest enumeration, not yet applied.
+    guint idle_id;
+};
+
+static char *cache_path(void) {
+    return g_build_filename(g_get_user_cache_dir(), "rnnoise-gui", "devices.ini", NULL);
+}
+
+static int find_entry(GArray *entries, const ma_device_id *id) {
+    for (guint i = 0; i < entries->len; i++) {
+        if (ma_device_id_equal(&g_array_index(entries, DeviceEntry, i).id, id)) return (int)i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Row to select when there is no better choice: the system default, else the first.
+ */
+static int default_entry(GArray *entries) {
+    for (guint i = 0; i < entries->len; i++) {
+        if (g_array_index(entries, DeviceEntry, i).is_default) return (int)i;
+    }
+    return entries->len > 0 ? 0 : -1;
+}
+
+static void add_row(DeviceList *list, int k, const DeviceEntry *entry) {
+    gtk_combo_box_text_append_text(list->combos[k], entry->name);
+    g_array_append_val(list->rows[k], *entry);
+}
+
+static void clear_rows(DeviceList *list, int k) {
+    gtk_combo_box_text_remove_all(list->combos[k]);
+    g_array_set_size(list->rows[k], 0);
+}
+
+/**
+ * @brief Fill the combos with the devices found on the last run.
+ */
+static void load_cache(DeviceList *list) {
+    GKeyFile *keys = g_key_file_new();
+    char *path = cache_path();
+    if (g_key_file_load_from_file(keys, path, G_KEY_FILE_NONE, NULL)) {
+        list->backend = g_key_file_get_string(keys, list->app, "backend", NULL);
+        for (int k = 0; k < 2; k++) {
+            if (!list->combos[k]) continue;
+            char key[32];
+            gsize name_count = 0, id_count = 0;
+            snprintf(key, sizeof(key), "%s_names", kind_names[k]);
+            char **names = g_key_file_get_string_list(keys, list->app, key, &name_count, NULL);
+            snprintf(key, sizeof(key), "%s_ids", kind_names[k]);
+            char **ids = g_key_file_get_string_list(keys, list->app, key, &id_count, NULL);
+            snprintf(key, sizeof(key), "%s_selected", kind_names[k]);
+            list->remembered[k] = g_key_file_get_string(keys, list->app, key, NULL);
+
+            int active = -1;
+            for (gsize i = 0; i < name_count && i < id_count; i++) {
+                gsize length = 0;
+                guchar *raw = g_base64_decode(ids[i], &length);
+                if (length == sizeof(ma_device_id)) {
+                    DeviceEntry entry;
+                    memset(&entry, 0, sizeof(entry));
+                    memcpy(&entry.id, raw, sizeof(entry.id));
+                    g_strlcpy(entry.name, names[i], sizeof(entry.name));
+                    if (list->remembered[k] && strcmp(ids[i], list->remembered[k]) == 0) active = (int)list->rows[k]->len;
+                    add_row(list, k, &entry);
+                }
+                g_free(raw);
+            }
+            if (active < 0 && list->rows[k]->len > 0) active = 0;
+            gtk_combo_box_set_active(GTK_COMBO_BOX(list->combos[k]), active);
+            g_strfreev(names);
+            g_strfreev(ids);
+        }
+    }
+    g_free(path);
+    g_key_file_free(keys);
+}
+
+/**
+ * @brief Write this application's devices to the cache, keeping other groups.
+ */
+static void save_cache(DeviceList *list) {
+    GKeyFile *keys = g_key_file_new();
+    char *path = cache_path();
+    g_key_file_load_from_file(keys, path, G_KEY_FILE_KEEP_COMMENTS, NULL);
+    if (list->backend) g_key_file_set_string(keys, list->app, "backend", list->backend);
+    for (int k = 0; k < 2; k++) {
+        if (!list->combos[k]) continue;
+        GArray *rows = list->rows[k];
+        const char **names = g_new0(const char *, rows->len + 1);
+        char **ids = g_new0(char *, rows->len + 1);
+        for (guint i = 0; i < rows->len; i++) {
+            DeviceEntry *entry = &g_array_index(rows, DeviceEntry, i);
+            names[i] = entry->name;
+            ids[i] = g_base64_encode((const guchar *)&entry->id, sizeof(entry->id));
+        }
+        char key[32];
+        snprintf(key, sizeof(key), "%s_names", kind_names[k]);
+        g_key_file_set_string_list(keys, list->app, key, names, rows->len);
+        snprintf(key, sizeof(key), "%s_ids", kind_names[k]);
+        g_key_file_set_string_list(keys, list->app, key, (const char *const *)ids, rows->len);
+        snprintf(key, sizeof(key), "%s_selected", kind_names[k]);
+        if (list->remembered[k]) g_key_file_set_string(keys, list->app, key, list->remembered[k]);
+        g_free(names);
+        g_strfreev(ids);
+    }
+
+    char *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0700);
+    GError *error = NULL;
+    if (!g_key_file_save_to_file(keys, path, &error)) {
+        fprintf(stderr, "Cannot write device cache %s: %s\n", path, error->message);
+        g_error_free(error);
+    }
+    g_free(dir);
+    g_free(path);
+    g_key_file_free(keys);
+}
+
+/**
+ * @brief Bring a combo in line with the devices found, touching only what changed.
+ * @return TRUE if any row was added or removed.
+ */
+static gboolean update_combo(DeviceList *list, int k, GArray *found) {
+    GtkComboBox *combo = GTK_COMBO_BOX(list->combos[k]);
+    GArray *rows = list->rows[k];
+    gboolean changed = FALSE;
+
+    ma_device_id active_id;
+    int active = gtk_combo_box_get_active(combo);
+    gboolean had_active = active >= 0 && (guint)active < rows->len;
+    if (had_active) active_id = g_array_index(rows, DeviceEntry, active).id;
+
+    // Remove devices that are gone, from the end so indexes stay valid.
+    for (int i = (int)rows->len - 1; i >= 0; i--) {
+        if (find_entry(found, &g_array_index(rows, DeviceEntry, i).id) < 0) {
+            gtk_combo_box_text_remove(list->combos[k], i);
+            g_array_remove_index(rows, (guint)i);
+            changed = TRUE;
+        }
+    }
+
+    // Append new ones.
+    for (guint i = 0; i < found->len; i++) {
+        DeviceEntry *entry = &g_array_index(found, DeviceEntry, i);
+        if (find_entry(rows, &entry->id) < 0) {
+            add_row(list, k, entry);
+            changed = TRUE;
+        }
+    }
+
+    // Keep the selection on the same device if it is still there.
+    if (changed || gtk_combo_box_get_active(combo) < 0) {
+        int index = had_active ? find_entry(rows, &active_id) : -1;
+        if (index < 0) {
+            int fallback = default_entry(found);
+            index = fallback >= 0 ? find_entry(rows, &g_array_index(found, DeviceEntry, fallback).id) : -1;
+        }
+        if (index != gtk_combo_box_get_active(combo)) gtk_combo_box_set_active(combo, index);
+    }
+    return changed;
+}
+
+/**
+ * @brief Apply the latest enumeration to the combos (main thread).
+ */
+static gboolean apply_devices(gpointer data) {
+    DeviceList *list = data;
+    GArray *found[2];
+    g_mutex_lock(&list->lock);
+    found[INPUT] = list->pending[INPUT];
+    found[OUTPUT] = list->pending[OUTPUT];
+    list->pending[INPUT] = list->pending[OUTPUT] = NULL;
+    list->idle_id = 0;
+    g_mutex_unlock(&list->lock);
+    if (!found[INPUT]) return FALSE;
+
+    gboolean changed = FALSE;
+    if (!list->live) {
+        // IDs cached from another backend mean nothing to this one.
+        const char *backend = ma_get_backend_name(list->context.backend);
+        if (g_strcmp0(list->backend, backend) != 0) {
+            for (int k = 0; k < 2; k++) {
+                if (list->combos[k]) clear_rows(list, k);
+            }
+            g_free(list->backend);
+            list->backend = g_strdup(backend);
+        }
+        list->live = TRUE;
+        changed = TRUE;
+    }
+    for (int k = 0; k < 2; k++) {
+        if (list->combos[k] && update_combo(list, k, found[k])) changed = TRUE;
+    }
+    if (changed) save_cache(list);
+
+    g_array_free(found[INPUT], TRUE);
+    g_array_free(found[OUTPUT], TRUE);
+    return FALSE;
+}
+
+static ma_bool32 collect_device(ma_context *context, ma_device_type type, const ma_device_info *info, void *user_data) {
+    (void)context;
+    GArray **found = user_data;
+    DeviceEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.id = info->id;
+    g_strlcpy(entry.name, info->name, sizeof(entry.name));
+    entry.is_default = info->isDefault ? TRUE : FALSE;
+    g_array_append_val(found[type == ma_device_type_playback ? OUTPUT : INPUT], entry);
+    return MA_TRUE;
+}
+
+/**
+ * @brief Hand an enumeration to the main thread, replacing one not yet applied.
+ */
+static void publish(DeviceList *list, GArray **found) {
+    g_mutex_lock(&list->lock);
+    for (int k = 0; k < 2; k++) {
+        if (list->pending[k]) g_array_free(list->pending[k], TRUE);
+        list->pending[k] = found[k];
+    }
+    if (list->idle_id == 0 && !list->stopping) list->idle_id = g_idle_add(apply_devices, list);
+    g_mutex_unlock(&list->lock);
+}
+
+static gpointer enumerate_thread(gpointer data) {
+    DeviceList *list = data;
+    gboolean ok = ma_context_init(NULL, 0, NULL, &list->context) == MA_SUCCESS;
+    if (!ok) fprintf(stderr, "Failed to initialize context\n");
+
+    g_mutex_lock(&list->lock);
+    list->context_done = TRUE;
+    list->context_ok = ok;
+    g_cond_broadcast(&list->cond);
+    while (ok && !list->stopping) {
+        g_mutex_unlock(&list->lock);
+        GArray *found[2] = {g_array_new(FALSE, FALSE, sizeof(DeviceEntry)), g_array_new(FALSE, FALSE, sizeof(DeviceEntry))};
+        if (ma_context_enumerate_devices(&list->context, collect_device, found) == MA_SUCCESS) {
+            publish(list, found);
+        } else {
+            fprintf(stderr, "Failed to enumerate devices\n");
+            g_array_free(found[INPUT], TRUE);
+            g_array_free(found[OUTPUT], TRUE);
+        }
+
+        // Wait for the next hotplug check, or for device_list_free().
+        g_mutex_lock(&list->lock);
+        gint64 until = g_get_monotonic_time() + DEVICE_LIST_POLL_SECONDS * G_TIME_SPAN_SECOND;
+        while (!list->stopping) {
+            if (!g_cond_wait_until(&list->cond, &list->lock, until)) break;
+        }
+    }
+    g_mutex_unlock(&list->lock);
+    return NULL;
+}
+
+DeviceList *device_list_new(const char *app, GtkWidget *input_combo, GtkWidget *output_combo) {
+    DeviceList *list = g_new0(DeviceList, 1);
+    list->app = g_strdup(app);
+    list->combos[INPUT] = input_combo ? GTK_COMBO_BOX_TEXT(input_combo) : NULL;
+    list->combos[OUTPUT] = output_combo ? GTK_COMBO_BOX_TEXT(output_combo) : NULL;
+    list->rows[INPUT] = g_array_new(FALSE, FALSE, sizeof(DeviceEntry));
+    list->rows[OUTPUT] = g_array_new(FALSE, FALSE, sizeof(DeviceEntry));
+    g_mutex_init(&list->lock);
+    g_cond_init(&list->cond);
+
+    load_cache(list);
+    list->thread = g_thread_new("device-list", enumerate_thread, list);
+    return list;
+}
+
+void device_list_free(DeviceList *list) {
+    if (!list) return;
+    g_mutex_lock(&list->lock);
+    list->stopping = TRUE;
+    g_cond_broadcast(&list->cond);
+    if (list->idle_id) {
+        g_source_remove(list->idle_id);
+        list->idle_id = 0;
+    }
+    g_mutex_unlock(&list->lock);
+    g_thread_join(list->thread);
+
+    if (list->context_ok) ma_context_uninit(&list->context);
+    for (int k = 0; k < 2; k++) {
+        if (list->pending[k]) g_array_free(list->pending[k], TRUE);
+        g_array_free(list->rows[k], TRUE);
+        g_free(list->remembered[k]);
+    }
+    g_mutex_clear(&list->lock);
+    g_cond_clear(&list->cond);
+    g_free(list->backend);
+    g_free(list->app);
+    g_free(list);
+}
+
+ma_context *device_list_context(DeviceList *list) {
+    g_mutex_lock(&list->lock);
+    while (!list->context_done) g_cond_wait(&list->cond, &list->lock);
+    gboolean ok = list->context_ok;
+    g_mutex_unlock(&list->lock);
+    return ok ? &list->context : NULL;
+}
+
+gboolean device_list_selected(DeviceList *list, gboolean playback, ma_device_id *id) {
+    int k = playback ? OUTPUT : INPUT;
+    if (!list->combos[k]) return FALSE;
+    int index = gtk_combo_box_get_active(GTK_COMBO_BOX(list->combos[k]));
+    if (index < 0 || (guint)index >= list->rows[k]->len) return FALSE;
+    // A cached ID is only usable if this run picked the same backend.
+    if (!list->live) {
+        ma_context *context = device_list_context(list);
+        if (!context || g_strcmp0(list->backend, ma_get_backend_name(context->backend)) != 0) return FALSE;
+    }
+    *id = g_array_index(list->rows[k], DeviceEntry, index).id;
+    return TRUE;
+}
+
+void device_list_remember(DeviceList *list) {
+    for (int k = 0; k < 2; k++) {
+        if (!list->combos[k]) continue;
+        int index = gtk_combo_box_get_active(GTK_COMBO_BOX(list->combos[k]));
+        if (index < 0 || (guint)index >= list->rows[k]->len) continue;
+        g_free(list->remembered[k]);
+        list->remembered[k] = g_base64_encode((const guchar *)&g_array_index(list->rows[k], DeviceEntry, index).id,
+                                              sizeof(ma_device_id));
+    }
+    save_cache(list);
+}
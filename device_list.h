@@ -0,0 +1,76 @@
+/**
+ * @file
+ * @brief Audio device combo boxes filled in the background.
+ *
+ * Initializing a miniaudio context and listing its devices can take seconds
+ * on machines with Bluetooth or HDMI audio. A DeviceList does both on a
+ * worker thread, so the window can be shown at once:
+ *
+ *   - The combos are first filled from the devices found on the last run,
+ *     with the device used last selected, so Start works immediately.
+ *   - When enumeration finishes the combos are updated in place: devices
+ *     that are gone are removed, new ones are appended, and the selection
+ *     is kept if its device still exists.
+ *   - Devices are listed again every few seconds, so plugging or unplugging
+ *     a device updates the combos the same way.
+ *
+ * The cache is a GKeyFile in the user cache directory
+ * (~/.cache/rnnoise-gui/devices.ini), with one group per application.
+ *
+ * All functions must be called from the GTK main thread, except
+ * device_list_context(), which may block and is best called from a worker.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ */
+
+#ifndef DEVICE_LIST_H
+#define DEVICE_LIST_H
+
+#include <gtk/gtk.h>
+
+#include "miniaudio.h"
+
+#define DEVICE_LIST_POLL_SECONDS 3   // Interval between hotplug checks.
+
+typedef struct DeviceList DeviceList;
+
+/**
+ * @brief Fill the combos from the cache and start enumerating in the background.
+ * @param app Cache group, usually the program name.
+ * @param input_combo GtkComboBoxText for capture devices, or NULL.
+ * @param output_combo GtkComboBoxText for playback devices, or NULL.
+ * @return The list; never NULL.
+ */
+DeviceList *device_list_new(const char *app, GtkWidget *input_combo, GtkWidget *output_combo);
+
+/**
+ * @brief Stop the worker thread and free the miniaudio context.
+ *
+ * Devices opened on the context must be uninitialized first.
+ */
+void device_list_free(DeviceList *list);
+
+/**
+ * @brief The miniaudio context, waiting for it if it is still being initialized.
+ *
+ * Safe to call from any thread while the list exists.
+ * @return The context, or NULL if no backend could be initialized.
+ */
+ma_context *device_list_context(DeviceList *list);
+
+/**
+ * @brief ID of the device selected in a combo.
+ * @param playback TRUE for the output combo, FALSE for the input combo.
+ * @param id Receives the ID.
+ * @return FALSE when nothing usable is selected.
+ */
+gboolean device_list_selected(DeviceList *list, gboolean playback, ma_device_id *id);
+
+/**
+ * @brief Remember the selected devices as the ones to select on the next run.
+ */
+void device_list_remember(DeviceList *list);
+
+#endif
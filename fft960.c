@@ -0,0 +1,483 @@
+/**
+ * @file
+ * @brief Fixed-size FFT for RNNoise's 960-point analysis and synthesis.
+ *
+ * The transform is a Stockham (self-sorting) mixed-radix FFT with radix
+ * 2/3/4/5 butterflies and per-stage twiddle tables computed once. Real
+ * input is packed into a 480-point complex FFT, and so are Hermitian
+ * spectra, whose transform is real.
+ *
+ * There are no hand-written SIMD butterflies. fft960_avx2 is the same code
+ * compiled with target("avx2,fma"), which the compiler auto-vectorizes with
+ * 256-bit registers and FMA; that helps mostly the complex path. A build
+ * for AVX-512 was no faster than AVX2, so that tier uses the AVX2 variant.
+ * The SSE2 and NEON tiers use the generic code, which the compiler
+ * vectorizes for the baseline anyway.
+ *
+ * In the static build the linker redirects kiss_fft's entry point here
+ * (see FFT960_SYMBOL in Makefile.static); other sizes go back to kiss_fft.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "fft960.h"
+#include "cpu_dispatch.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HALF_SIZE (FFT960_SIZE / 2)
+#define MAX_STAGES 8
+
+#define FFT_INLINE static inline __attribute__((always_inline))
+
+/**
+ * @brief Precomputed FFT plan for one size.
+ */
+typedef struct {
+    int n;                           // Transform size.
+    int stages;                      // Number of radix stages.
+    int radix[MAX_STAGES];           // Radix of each stage.
+    const FftCpx *tw[MAX_STAGES];    // Twiddles of each stage, (radix - 1) per butterfly.
+    FftCpx tw_storage[2 * FFT960_SIZE];
+} FftPlan;
+
+static FftPlan plan480;
+static FftPlan plan960;
+static FftCpx pack_tw[HALF_SIZE + 1];  // exp(-2*pi*i*k/960), k = 0..480.
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Fill a plan and its twiddle tables.
+ */
+static void plan_init(FftPlan *plan, int n, const int *radix, int stages) {
+    FftCpx *tw = plan->tw_storage;
+    int len = n;
+
+    plan->n = n;
+    plan->stages = stages;
+    for (int s = 0; s < stages; s++) {
+        int r = radix[s];
+        int m = len / r;
+        plan->radix[s] = r;
+        plan->tw[s] = tw;
+        for (int p = 0; p < m; p++) {
+            for (int k = 1; k < r; k++) {
+                double a = -2.0 * M_PI * p * k / len;
+                tw->r = (float)cos(a);
+                tw->i = (float)sin(a);
+                tw++;
+            }
+        }
+        len = m;
+    }
+}
+
+static void tables_init(void) {
+    // Small radices first: later stages have long contiguous inner loops.
+    static const int radix480[] = {2, 3, 5, 4, 4};
+    static const int radix960[] = {2, 2, 3, 5, 4, 4};
+    plan_init(&plan480, HALF_SIZE, radix480, 5);
+    plan_init(&plan960, FFT960_SIZE, radix960, 6);
+    for (int k = 0; k <= HALF_SIZE; k++) {
+        double a = -2.0 * M_PI * k / FFT960_SIZE;
+        pack_tw[k].r = (float)cos(a);
+        pack_tw[k].i = (float)sin(a);
+    }
+}
+
+/* Complex helpers. */
+
+FFT_INLINE FftCpx cadd(FftCpx a, FftCpx b) { return (FftCpx){a.r + b.r, a.i + b.i}; }
+FFT_INLINE FftCpx csub(FftCpx a, FftCpx b) { return (FftCpx){a.r - b.r, a.i - b.i}; }
+FFT_INLINE FftCpx cscale(FftCpx a, float s) { return (FftCpx){a.r * s, a.i * s}; }
+FFT_INLINE FftCpx cconj(FftCpx a) { return (FftCpx){a.r, -a.i}; }
+FFT_INLINE FftCpx cmul_neg_i(FftCpx a) { return (FftCpx){a.i, -a.r}; }  // -i * a
+FFT_INLINE FftCpx cmul(FftCpx a, FftCpx b) {
+    return (FftCpx){a.r * b.r - a.i * b.i, a.r * b.i + a.i * b.r};
+}
+
+/* Radix-r butterflies on x[j * xs] -> y[k * ys], then multiplied by tw[k - 1]. */
+
+FFT_INLINE void bfly2(const FftCpx *x, int xs, FftCpx *y, int ys, const FftCpx *tw) {
+    FftCpx a0 = x[0], a1 = x[xs];
+    y[0] = cadd(a0, a1);
+    y[ys] = cmul(csub(a0, a1), tw[0]);
+}
+
+FFT_INLINE void bfly3(const FftCpx *x, int xs, FftCpx *y, int ys, const FftCpx *tw) {
+    const float c = -0.5f;
+    const float sn = 0.86602540378443864676f;  // sin(2*pi/3)
+    FftCpx a0 = x[0], a1 = x[xs], a2 = x[2 * xs];
+    FftCpx t = cadd(a1, a2);
+    FftCpx mid = cadd(a0, cscale(t, c));
+    FftCpx d = cscale(cmul_neg_i(csub(a1, a2)), sn);
+    y[0] = cadd(a0, t);
+    y[ys] = cmul(cadd(mid, d), tw[0]);
+    y[2 * ys] = cmul(csub(mid, d), tw[1]);
+}
+
+FFT_INLINE void bfly4(const FftCpx *x, int xs, FftCpx *y, int ys, const FftCpx *tw) {
+    FftCpx a0 = x[0], a1 = x[xs], a2 = x[2 * xs], a3 = x[3 * xs];
+    FftCpx t0 = cadd(a0, a2), t1 = csub(a0, a2);
+    FftCpx t2 = cadd(a1, a3), t3 = cmul_neg_i(csub(a1, a3));
+    y[0] = cadd(t0, t2);
+    y[ys] = cmul(cadd(t1, t3), tw[0]);
+    y[2 * ys] = cmul(csub(t0, t2), tw[1]);
+    y[3 * ys] = cmul(csub(t1, t3), tw[2]);
+}
+
+FFT_INLINE void bfly5(const FftCpx *x, int xs, FftCpx *y, int ys, const FftCpx *tw) {
+    const float c1 = 0.30901699437494742410f;   // cos(2*pi/5)
+    const float c2 = -0.80901699437494742410f;  // cos(4*pi/5)
+    const float s1 = 0.95105651629515357212f;   // sin(2*pi/5)
+    const float s2 = 0.58778525229247312917f;   // sin(4*pi/5)
+    FftCpx a0 = x[0], a1 = x[xs], a2 = x[2 * xs], a3 = x[3 * xs], a4 = x[4 * xs];
+    FftCpx t1 = cadd(a1, a4), t2 = cadd(a2, a3);
+    FftCpx d1 = csub(a1, a4), d2 = csub(a2, a3);
+    FftCpx m1 = cadd(a0, cadd(cscale(t1, c1), cscale(t2, c2)));
+    FftCpx m2 = cadd(a0, cadd(cscale(t1, c2), cscale(t2, c1)));
+    FftCpx n1 = cmul_neg_i(cadd(cscale(d1, s1), cscale(d2, s2)));
+    FftCpx n2 = cmul_neg_i(csub(cscale(d1, s2), cscale(d2, s1)));
+    y[0] = cadd(a0, cadd(t1, t2));
+    y[ys] = cmul(cadd(m1, n1), tw[0]);
+    y[2 * ys] = cmul(cadd(m2, n2), tw[1]);
+    y[3 * ys] = cmul(csub(m2, n2), tw[2]);
+    y[4 * ys] = cmul(csub(m1, n1), tw[3]);
+}
+
+/*
+ * Stockham pass: y[q + s*(r*p + k)] = tw(p, k) * DFT_r(x[q + s*(p + j*m)])[k].
+ * The first pass (s == 1) has no inner loop, so it runs over p instead.
+ */
+#define STOCKHAM_PASS(name, bfly, r)                                                    \
+    FFT_INLINE void name(const FftCpx *restrict x, FftCpx *restrict y, int m, int s,  \
+                         const FftCpx *tw) {                                          \
+        if (s == 1) {                                                                 \
+            for (int p = 0; p < m; p++) {                                             \
+                bfly(x + p, m, y + (r) * p, 1, tw + ((r) - 1) * p);                   \
+            }                                                                         \
+            return;                                                                   \
+        }                                                                             \
+        for (int p = 0; p < m; p++) {                                                 \
+            const FftCpx *xp = x + s * p;                                             \
+            FftCpx *yp = y + s * (r) * p;                                             \
+            const FftCpx *twp = tw + ((r) - 1) * p;                                   \
+            for (int q = 0; q < s; q++) {                                             \
+                bfly(xp + q, s * m, yp + q, s, twp);                                  \
+            }                                                                         \
+        }                                                                             \
+    }
+
+STOCKHAM_PASS(pass2, bfly2, 2)
+STOCKHAM_PASS(pass3, bfly3, 3)
+STOCKHAM_PASS(pass4, bfly4, 4)
+STOCKHAM_PASS(pass5, bfly5, 5)
+
+/**
+ * @brief Run a plan (unnormalized, forward sign).
+ * @param x Input, overwritten.
+ * @param y Scratch of the same size.
+ * @return Pointer to the result, either x or y.
+ */
+FFT_INLINE FftCpx *stockham(const FftPlan *plan, FftCpx *x, FftCpx *y) {
+    int n = plan->n;
+    int s = 1;
+    for (int st = 0; st < plan->stages; st++) {
+        int r = plan->radix[st];
+        int m = n / r;
+        switch (r) {
+            case 2: pass2(x, y, m, s, plan->tw[st]); break;
+            case 3: pass3(x, y, m, s, plan->tw[st]); break;
+            case 4: pass4(x, y, m, s, plan->tw[st]); break;
+            case 5: pass5(x, y, m, s, plan->tw[st]); break;
+        }
+        FftCpx *t = x;
+        x = y;
+        y = t;
+        n = m;
+        s *= r;
+    }
+    return x;
+}
+
+/**
+ * @brief Transform of real input through a packed 480-point FFT.
+ */
+FFT_INLINE void forward_real(const FftCpx *in, FftCpx *out) {
+    FftCpx a[HALF_SIZE], b[HALF_SIZE];
+    const float scale = 1.0f / FFT960_SIZE;
+
+    for (int n = 0; n < HALF_SIZE; n++) {
+        a[n].r = in[2 * n].r;
+        a[n].i = in[2 * n + 1].r;
+    }
+    const FftCpx *z = stockham(&plan480, a, b);
+
+    // Split the packed spectrum into the even/odd sample spectra and combine.
+    out[0] = (FftCpx){(z[0].r + z[0].i) * scale, 0.0f};
+    out[HALF_SIZE] = (FftCpx){(z[0].r - z[0].i) * scale, 0.0f};
+    for (int k = 1; k < HALF_SIZE; k++) {
+        FftCpx zk = z[k];
+        FftCpx zc = cconj(z[HALF_SIZE - k]);
+        FftCpx even = cadd(zk, zc);
+        FftCpx diff = csub(zk, zc);
+        FftCpx odd = {diff.i, -diff.r};  // (zk - zc) / i
+        FftCpx x = cscale(cadd(even, cmul(pack_tw[k], odd)), 0.5f * scale);
+        out[k] = x;
+        out[FFT960_SIZE - k] = cconj(x);
+    }
+}
+
+/**
+ * @brief Transform of a Hermitian spectrum (real output) through a packed 480-point FFT.
+ *
+ * The imaginary parts of bins 0 and 480 are not part of the Hermitian
+ * spectrum; their contribution to the output is added back separately.
+ */
+FFT_INLINE void forward_hermitian(const FftCpx *in, FftCpx *out) {
+    FftCpx a[HALF_SIZE], b[HALF_SIZE];
+    const float scale = 1.0f / FFT960_SIZE;
+    const float dc_i = in[0].i;
+    const float nyq_i = in[HALF_SIZE].i;
+
+    // The forward DFT of a Hermitian X equals the unnormalized inverse DFT of conj(X).
+    for (int k = 0; k < HALF_SIZE; k++) {
+        FftCpx lo = cconj(in[k]);
+        FftCpx hi = cconj(in[k + HALF_SIZE]);
+        if (k == 0) {
+            lo.i = 0.0f;
+            hi.i = 0.0f;
+        }
+        FftCpx even = cadd(lo, hi);
+        FftCpx odd = cmul(csub(lo, hi), cconj(pack_tw[k]));  // exp(+2*pi*i*k/960)
+        // Z = even + i * odd, conjugated so that a forward FFT computes the inverse.
+        a[k] = cconj((FftCpx){even.r - odd.i, even.i + odd.r});
+    }
+    const FftCpx *z = stockham(&plan480, a, b);
+
+    for (int n = 0; n < HALF_SIZE; n++) {
+        out[2 * n].r = z[n].r * scale;
+        out[2 * n].i = (dc_i + nyq_i) * scale;
+        out[2 * n + 1].r = -z[n].i * scale;
+        out[2 * n + 1].i = (dc_i - nyq_i) * scale;
+    }
+}
+
+/**
+ * @brief General complex 960-point transform.
+ */
+FFT_INLINE void forward_complex(const FftCpx *in, FftCpx *out) {
+    FftCpx a[FFT960_SIZE], b[FFT960_SIZE];
+    const float scale = 1.0f / FFT960_SIZE;
+
+    memcpy(a, in, sizeof(a));
+    const FftCpx *z = stockham(&plan960, a, b);
+    for (int k = 0; k < FFT960_SIZE; k++) {
+        out[k] = cscale(z[k], scale);
+    }
+}
+
+FFT_INLINE void transform(const FftCpx *in, FftCpx *out) {
+    int real = 1;
+    int hermitian = 1;
+
+    pthread_once(&tables_once, tables_init);
+
+    for (int k = 0; k < FFT960_SIZE && real; k++) {
+        real = in[k].i == 0.0f;
+    }
+    if (real) {
+        FftCpx tmp[FFT960_SIZE];
+        memcpy(tmp, in, sizeof(tmp));
+        forward_real(tmp, out);
+        return;
+    }
+
+    for (int k = 1; k < HALF_SIZE && hermitian; k++) {
+        hermitian = in[k].r == in[FFT960_SIZE - k].r && in[k].i == -in[FFT960_SIZE - k].i;
+    }
+    if (hermitian) {
+        FftCpx tmp[FFT960_SIZE];
+        memcpy(tmp, in, sizeof(tmp));
+        forward_hermitian(tmp, out);
+        return;
+    }
+
+    forward_complex(in, out);
+}
+
+void fft960_generic(const FftCpx *in, FftCpx *out) {
+    transform(in, out);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("avx2,fma")))
+void fft960_avx2(const FftCpx *in, FftCpx *out) {
+    transform(in, out);
+}
+
+#endif
+
+#ifdef FFT960_SYMBOL
+
+#include "kiss_fft.h"
+#include "rnnoise.h"
+
+#define FFT960_PASTE(a, b) a##b
+#define FFT960_NAME(prefix, sym) FFT960_PASTE(prefix, sym)
+#define REAL_FFT FFT960_NAME(__real_, FFT960_SYMBOL)
+#define WRAP_FFT FFT960_NAME(__wrap_, FFT960_SYMBOL)
+
+void REAL_FFT(const kiss_fft_state *st, const kiss_fft_cpx *fin, kiss_fft_cpx *fout);
+void WRAP_FFT(const kiss_fft_state *st, const kiss_fft_cpx *fin, kiss_fft_cpx *fout);
+
+static const kiss_fft_state *kiss960;  // RNNoise's own 960-point state, for fft960_check().
+
+/**
+ * @brief Linker-wrapped kiss_fft entry point.
+ */
+void WRAP_FFT(const kiss_fft_state *st, const kiss_fft_cpx *fin, kiss_fft_cpx *fout) {
+    if (st->nfft != FFT960_SIZE) {
+        REAL_FFT(st, fin, fout);
+        return;
+    }
+    kiss960 = st;
+    if (!cpu_profiling) {
+        cpu_kernels()->fft960((const FftCpx *)fin, (FftCpx *)fout);
+        return;
+    }
+    uint64_t t0 = cpu_profile_now();
+    cpu_kernels()->fft960((const FftCpx *)fin, (FftCpx *)fout);
+    cpu_profile_add(CPU_PROFILE_FFT960, t0);
+}
+
+/**
+ * @brief Run kiss_fft on a 960-point input, if its state is known.
+ * @return 1 if kiss_fft ran, 0 otherwise.
+ */
+static int kiss_reference(const FftCpx *in, FftCpx *out) {
+    if (!kiss960) {
+        // Let RNNoise hand us its state by processing one frame.
+        float frame[FFT960_SIZE / 2] = {0};
+        DenoiseState *st = rnnoise_create(NULL);
+        rnnoise_process_frame(st, frame, frame);
+        rnnoise_destroy(st);
+    }
+    if (!kiss960) return 0;
+    REAL_FFT(kiss960, (const kiss_fft_cpx *)in, (kiss_fft_cpx *)out);
+    return 1;
+}
+
+#else
+
+static int kiss_reference(const FftCpx *in, FftCpx *out) {
+    (void)in;
+    (void)out;
+    return 0;
+}
+
+#endif
+
+/**
+ * @brief Largest error against the double precision DFT, relative to the peak.
+ */
+static double relative_error(const FftCpx *out, const double *ref) {
+    double err = 0.0, peak = 0.0;
+    for (int k = 0; k < FFT960_SIZE; k++) {
+        double dr = out[k].r - ref[2 * k];
+        double di = out[k].i - ref[2 * k + 1];
+        double e = sqrt(dr * dr + di * di);
+        double m = sqrt(ref[2 * k] * ref[2 * k] + ref[2 * k + 1] * ref[2 * k + 1]);
+        if (e > err) err = e;
+        if (m > peak) peak = m;
+    }
+    return peak > 0.0 ? err / peak : err;
+}
+
+static double seconds_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int fft960_check(void) {
+    static const char *names[] = {"real", "hermitian", "complex"};
+    const CpuKernels *kernels = cpu_kernels();
+    FftCpx in[FFT960_SIZE], out[FFT960_SIZE];
+    static double ref[2 * FFT960_SIZE];
+    const int iterations = 2000;
+    int ok = 1;
+
+    srand(1234);
+    for (int kind = 0; kind < 3; kind++) {
+        for (int n = 0; n < FFT960_SIZE; n++) {
+            in[n].r = (float)(rand() % 65536 - 32768);
+            in[n].i = kind == 2 ? (float)(rand() % 65536 - 32768) : 0.0f;
+        }
+        if (kind == 1) {
+            // Hermitian spectrum, as built by RNNoise's inverse transform.
+            for (int k = 1; k < FFT960_SIZE; k++) {
+                in[k].i = (float)(rand() % 65536 - 32768);
+            }
+            for (int k = HALF_SIZE + 1; k < FFT960_SIZE; k++) {
+                in[k].r = in[FFT960_SIZE - k].r;
+                in[k].i = -in[FFT960_SIZE - k].i;
+            }
+            in[HALF_SIZE].i = 0.0f;
+        }
+
+        for (int k = 0; k < FFT960_SIZE; k++) {
+            double sr = 0.0, si = 0.0;
+            for (int n = 0; n < FFT960_SIZE; n++) {
+                double a = -2.0 * M_PI * (double)((long)n * k % FFT960_SIZE) / FFT960_SIZE;
+                sr += in[n].r * cos(a) - in[n].i * sin(a);
+                si += in[n].r * sin(a) + in[n].i * cos(a);
+            }
+            ref[2 * k] = sr / FFT960_SIZE;
+            ref[2 * k + 1] = si / FFT960_SIZE;
+        }
+
+        double t0 = seconds_now();
+        for (int i = 0; i < iterations; i++) kernels->fft960(in, out);
+        double fast_ns = (seconds_now() - t0) / iterations * 1e9;
+        double fast_err = relative_error(out, ref);
+
+        printf("fft960 %-9s (%s): error %.2e, %.0f ns", names[kind],
+               cpu_tier_name(kernels->tier), fast_err, fast_ns);
+
+        if (kiss_reference(in, out)) {
+            double kiss_err = relative_error(out, ref);
+            t0 = seconds_now();
+            for (int i = 0; i < iterations; i++) kiss_reference(in, out);
+            double kiss_ns = (seconds_now() - t0) / iterations * 1e9;
+            printf(" | kiss_fft: error %.2e, %.0f ns (%.2fx)", kiss_err, kiss_ns, kiss_ns / fast_ns);
+            // Allow for float rounding differences between the two decompositions.
+            if (fast_err > 2.0 * kiss_err + 1e-6) ok = 0;
+        } else if (fast_err > 1e-5) {
+            ok = 0;
+        }
+        printf("\n");
+    }
+    return ok;
+}
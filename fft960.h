@@ -0,0 +1,55 @@
+/**
+ * @file
+ * @brief Fixed-size FFT for RNNoise's 960-point analysis and synthesis.
+ *
+ * RNNoise only ever transforms real 20ms windows (forward) and Hermitian
+ * spectra (synthesis), always with 960 points. This module replaces the
+ * generic kiss_fft for that size with a self-sorting mixed-radix FFT using
+ * precomputed twiddles, run at half size through real-input packing.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ */
+
+#ifndef FFT960_H
+#define FFT960_H
+
+#define FFT960_SIZE 960
+
+/**
+ * @brief Complex value, layout-compatible with the float kiss_fft_cpx.
+ */
+typedef struct {
+    float r;
+    float i;
+} FftCpx;
+
+/**
+ * @brief Forward 960-point transform with kiss_fft semantics.
+ *
+ * Computes out[k] = (1/960) * sum_n in[n] * exp(-2*pi*i*n*k/960). Real and
+ * Hermitian inputs are detected and go through the half-size packed path.
+ * The generic version is exposed for the dispatch table; callers should
+ * use cpu_kernels()->fft960.
+ *
+ * @param in Input, 960 values.
+ * @param out Output, 960 values. May alias the input.
+ */
+void fft960_generic(const FftCpx *in, FftCpx *out);
+
+#if defined(__x86_64__) || defined(__i386__)
+void fft960_avx2(const FftCpx *in, FftCpx *out);
+#endif
+
+/**
+ * @brief Compare the FFT against kiss_fft and a double precision DFT.
+ *
+ * Prints accuracy and per-transform timings of both implementations for
+ * real, Hermitian and general complex input.
+ *
+ * @return 1 if the FFT is at least as accurate as kiss_fft, 0 otherwise.
+ */
+int fft960_check(void);
+
+#endif
@@ -0,0 +1,106 @@
+/**
+ * @file
+ * @brief Bounded job queue feeding a pool of worker threads.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "job_queue.h"
+
+#include <stdlib.h>
+
+int job_queue_init(JobQueue *q, size_t capacity) {
+    q->items = calloc(capacity ? capacity : 1, sizeof(void *));
+    if (!q->items) return 0;
+    q->capacity = capacity ? capacity : 1;
+    q->head = 0;
+    q->count = 0;
+    q->max_count = 0;
+    q->closed = 0;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    return 1;
+}
+
+void job_queue_destroy(JobQueue *q) {
+    pthread_cond_destroy(&q->not_full);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_mutex_destroy(&q->lock);
+    free(q->items);
+    q->items = NULL;
+}
+
+/**
+ * @brief Append a job; the lock is held and there is room.
+ */
+static void enqueue_locked(JobQueue *q, void *job) {
+    q->items[(q->head + q->count) % q->capacity] = job;
+    q->count++;
+    if (q->count > q->max_count) q->max_count = q->count;
+    pthread_cond_signal(&q->not_empty);
+}
+
+int job_queue_push(JobQueue *q, void *job) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->capacity && !q->closed) {
+        pthread_cond_wait(&q->not_full, &q->lock);
+    }
+    int ok = !q->closed;
+    if (ok) enqueue_locked(q, job);
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+int job_queue_try_push(JobQueue *q, void *job) {
+    pthread_mutex_lock(&q->lock);
+    int ok = !q->closed && q->count < q->capacity;
+    if (ok) enqueue_locked(q, job);
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+void *job_queue_pop(JobQueue *q) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed) {
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    }
+    void *job = NULL;
+    if (q->count > 0) {
+        job = q->items[q->head];
+        q->head = (q->head + 1) % q->capacity;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return job;
+}
+
+void job_queue_close(JobQueue *q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = 1;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+}
+
+void job_queue_depth(JobQueue *q, size_t *depth, size_t *max_depth) {
+    pthread_mutex_lock(&q->lock);
+    if (depth) *depth = q->count;
+    if (max_depth) *max_depth = q->max_count;
+    pthread_mutex_unlock(&q->lock);
+}
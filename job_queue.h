@@ -0,0 +1,76 @@
+/**
+ * @file
+ * @brief Bounded job queue feeding a pool of worker threads.
+ *
+ * Producers either block or get an immediate "full" answer, so a service
+ * can apply backpressure instead of growing without bound. Closing the
+ * queue wakes every worker once the remaining jobs are drained.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ */
+
+#ifndef JOB_QUEUE_H
+#define JOB_QUEUE_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+/**
+ * @brief Fixed-capacity FIFO of opaque job pointers.
+ */
+typedef struct {
+    void **items;
+    size_t capacity;
+    size_t head;             // Index of the oldest job.
+    size_t count;            // Jobs currently queued.
+    size_t max_count;        // Highest depth seen.
+    int closed;              // No more jobs will be pushed.
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} JobQueue;
+
+/**
+ * @brief Initialize a queue.
+ * @param q Queue to initialize.
+ * @param capacity Maximum number of queued jobs.
+ * @return 1 on success, 0 on failure.
+ */
+int job_queue_init(JobQueue *q, size_t capacity);
+
+/**
+ * @brief Free the queue's resources. Jobs still queued are not freed.
+ */
+void job_queue_destroy(JobQueue *q);
+
+/**
+ * @brief Add a job, waiting while the queue is full.
+ * @return 1 on success, 0 if the queue was closed.
+ */
+int job_queue_push(JobQueue *q, void *job);
+
+/**
+ * @brief Add a job if there is room.
+ * @return 1 on success, 0 if the queue is full or closed.
+ */
+int job_queue_try_push(JobQueue *q, void *job);
+
+/**
+ * @brief Take the oldest job, waiting while the queue is empty.
+ * @return The job, or NULL once the queue is closed and drained.
+ */
+void *job_queue_pop(JobQueue *q);
+
+/**
+ * @brief Stop accepting jobs and wake all waiting threads.
+ */
+void job_queue_close(JobQueue *q);
+
+/**
+ * @brief Get the current and highest depth of the queue.
+ */
+void job_queue_depth(JobQueue *q, size_t *depth, size_t *max_depth);
+
+#endif
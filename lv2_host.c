@@ -0,0 +1,257 @@
+/**
+ * @file
+ * @brief Headless host that runs the RNNoise LV2 plugin over a WAV file.
+ *
+ * Loads rnnoise.lv2/rnnoise_lv2.so the way an LV2 host would and feeds it a
+ * WAV file in blocks of -b samples, or of random sizes up to -b with -r, to
+ * check that the output does not depend on the host's block size. The
+ * latency the plugin reports is compensated, so the output lines up with
+ * the input. With -n, several instances process the same file side by side
+ * and must produce the same output.
+ *
+ * Usage: lv2_host [-p plugin.so] [-b block] [-r] [-n instances] input.wav output.wav
+ *
+ * The port layout is that of rnnoise.lv2/rnnoise.ttl. For other hosts, see
+ * the README.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <lv2/core/lv2.h>
+
+#include <dlfcn.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SAMPLE_RATE 48000  // Expected sample rate for RNNoise.
+
+#define MAX_INSTANCES 64
+
+/**
+ * @brief Struct representing the WAV file header.
+ */
+typedef struct {
+    char riff[4];                  // "RIFF"
+    uint32_t file_size;            // Total file size minus 8 bytes
+    char wave[4];                  // "WAVE"
+    char fmt[4];                   // "fmt "
+    uint32_t fmt_size;             // Format chunk size (usually 16)
+    uint16_t format;               // Audio format (1 = PCM)
+    uint16_t channels;             // Number of audio channels
+    uint32_t sample_rate;          // Sampling rate (Hz)
+    uint32_t byte_rate;            // Bytes per second
+    uint16_t block_align;          // Block alignment (bytes per sample frame)
+    uint16_t bits_per_sample;      // Bits per sample (usually 16)
+    char data[4];                  // "data"
+    uint32_t data_size;            // Size of audio data in bytes
+} WavHeader;
+
+/**
+ * @brief One running plugin instance and its port buffers.
+ */
+typedef struct {
+    LV2_Handle handle;
+    float *output;
+    float latency;
+    float vad;
+    int16_t *result;               // Whole output, before latency compensation.
+} Instance;
+
+/**
+ * @brief Monotonic clock in seconds.
+ */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Read a whole mono 16-bit 48kHz WAV file.
+ * @return The samples, or NULL on error.
+ */
+static int16_t *read_wav(const char *path, WavHeader *header, size_t *count) {
+    FILE *f = fopen(path, "rb");
+    if (!f || fread(header, sizeof(*header), 1, f) != 1 || header->channels != 1 ||
+        header->sample_rate != SAMPLE_RATE || header->bits_per_sample != 16) {
+        fprintf(stderr, "%s: expected a mono 16-bit 48kHz WAV file\n", path);
+        if (f) fclose(f);
+        return NULL;
+    }
+    size_t capacity = SAMPLE_RATE, n = 0, got;
+    int16_t *samples = malloc(capacity * sizeof(int16_t));
+    while (samples && (got = fread(samples + n, sizeof(int16_t), capacity - n, f)) > 0) {
+        n += got;
+        if (n == capacity) {
+            int16_t *bigger = realloc(samples, capacity * 2 * sizeof(int16_t));
+            if (!bigger) {
+                free(samples);
+                samples = NULL;
+                break;
+            }
+            samples = bigger;
+            capacity *= 2;
+        }
+    }
+    fclose(f);
+    *count = n;
+    return samples;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-p plugin.so] [-b block] [-r] [-n instances] input.wav output.wav\n"
+            "  -p  plugin binary (default rnnoise.lv2/rnnoise_lv2.so)\n"
+            "  -b  samples per run() call (default 256)\n"
+            "  -r  random block sizes from 1 to -b\n"
+            "  -n  instances run side by side (default 1)\n",
+            prog);
+}
+
+/**
+ * @brief Main entry point.
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return 0 on success, 1 on error.
+ */
+int main(int argc, char *argv[]) {
+    const char *plugin_path = "rnnoise.lv2/rnnoise_lv2.so";
+    int block = 256, random_blocks = 0, count = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:b:rn:h")) != -1) {
+        switch (opt) {
+            case 'p': plugin_path = optarg; break;
+            case 'b': block = atoi(optarg); break;
+            case 'r': random_blocks = 1; break;
+            case 'n': count = atoi(optarg); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (argc - optind != 2 || block < 1 || count < 1 || count > MAX_INSTANCES) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    WavHeader header;
+    size_t total;
+    int16_t *input = read_wav(argv[optind], &header, &total);
+    if (!input) return 1;
+
+    // Load the plugin the way a host does: dlopen the binary and ask for its descriptor.
+    void *lib = dlopen(plugin_path, RTLD_NOW | RTLD_LOCAL);
+    LV2_Descriptor_Function get_descriptor = lib ? (LV2_Descriptor_Function)dlsym(lib, "lv2_descriptor") : NULL;
+    const LV2_Descriptor *descriptor = get_descriptor ? get_descriptor(0) : NULL;
+    if (!descriptor) {
+        fprintf(stderr, "%s: not an LV2 plugin (%s)\n", plugin_path, lib ? "no descriptor" : dlerror());
+        free(input);
+        return 1;
+    }
+    char bundle_buf[4096];
+    snprintf(bundle_buf, sizeof(bundle_buf), "%s", plugin_path);
+    const char *bundle = dirname(bundle_buf);
+    const LV2_Feature *features[] = {NULL};
+
+    float *in_buf = malloc((size_t)block * sizeof(float));
+    static Instance instances[MAX_INSTANCES];
+    int ok = in_buf != NULL;
+    for (int i = 0; ok && i < count; i++) {
+        Instance *inst = &instances[i];
+        inst->handle = descriptor->instantiate(descriptor, SAMPLE_RATE, bundle, features);
+        inst->output = malloc((size_t)block * sizeof(float));
+        inst->result = malloc((total + 1) * sizeof(int16_t));
+        if (!inst->handle || !inst->output || !inst->result) {
+            fprintf(stderr, "Cannot instantiate %s\n", descriptor->URI);
+            ok = 0;
+            break;
+        }
+        descriptor->connect_port(inst->handle, 0, in_buf);
+        descriptor->connect_port(inst->handle, 1, inst->output);
+        descriptor->connect_port(inst->handle, 2, &inst->latency);
+        descriptor->connect_port(inst->handle, 3, &inst->vad);
+        if (descriptor->activate) descriptor->activate(inst->handle);
+    }
+
+    // Feed the file, then as much silence as the plugin's latency to flush it.
+    double busy = 0.0;
+    size_t pos = 0, extra = 0, calls = 0;
+    srand(1);
+    while (ok && pos < total + extra) {
+        int n = random_blocks ? 1 + rand() % block : block;
+        if ((size_t)n > total + extra - pos) n = (int)(total + extra - pos);
+        for (int i = 0; i < n; i++) in_buf[i] = pos + i < total ? input[pos + i] / 32768.0f : 0.0f;
+        for (int k = 0; k < count; k++) {
+            Instance *inst = &instances[k];
+            double t0 = now_seconds();
+            descriptor->run(inst->handle, (uint32_t)n);
+            busy += now_seconds() - t0;
+            for (int i = 0; i < n; i++) {
+                float v = inst->output[i] * 32768.0f;
+                if (v > 32767.0f) v = 32767.0f;
+                if (v < -32768.0f) v = -32768.0f;
+                // Only the samples that line up with the input are kept.
+                if (pos + i >= (size_t)inst->latency) inst->result[pos + i - (size_t)inst->latency] = (int16_t)v;
+            }
+        }
+        // Latency is reported after the first run().
+        if (calls++ == 0) extra = (size_t)instances[0].latency;
+        pos += (size_t)n;
+    }
+
+    for (int k = 1; ok && k < count; k++) {
+        if (instances[k].latency != instances[0].latency ||
+            memcmp(instances[k].result, instances[0].result, total * sizeof(int16_t)) != 0) {
+            fprintf(stderr, "Instance %d differs from instance 0\n", k);
+            ok = 0;
+        }
+    }
+
+    if (ok) {
+        FILE *out = fopen(argv[optind + 1], "wb");
+        header.data_size = (uint32_t)(total * sizeof(int16_t));
+        header.file_size = (uint32_t)(header.data_size + sizeof(WavHeader) - 8);
+        if (!out || fwrite(&header, sizeof(header), 1, out) != 1 ||
+            fwrite(instances[0].result, sizeof(int16_t), total, out) != total) {
+            fprintf(stderr, "Cannot write %s\n", argv[optind + 1]);
+            ok = 0;
+        }
+        if (out && fclose(out) != 0) ok = 0;
+    }
+    if (ok) {
+        double audio = (double)total / SAMPLE_RATE * count;
+        fprintf(stderr, "%d instance(s), %zu run() calls, latency %.0f samples, %.1fx real time\n", count, calls,
+                instances[0].latency, busy > 0 ? audio / busy : 0.0);
+    }
+
+    for (int k = 0; k < count; k++) {
+        if (instances[k].handle) {
+            if (descriptor->deactivate) descriptor->deactivate(instances[k].handle);
+            descriptor->cleanup(instances[k].handle);
+        }
+        free(instances[k].output);
+        free(instances[k].result);
+    }
+    free(in_buf);
+    free(input);
+    dlclose(lib);
+    return ok ? 0 : 1;
+}
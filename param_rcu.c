@@ -0,0 +1,110 @@
+/**
+ * @file
+ * @brief Parameters shared with the audio thread as immutable snapshots.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "param_rcu.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief A snapshot: header, then the caller's parameter struct.
+ */
+typedef struct Snapshot {
+    struct Snapshot *next;         // Retired list link (writer only).
+    unsigned long generation;      // Never changes once published.
+    max_align_t data[];
+} Snapshot;
+
+struct ParamRcu {
+    size_t size;
+    _Atomic(Snapshot *) current;
+    atomic_ulong reader_generation;   // Generation of the snapshot the reader holds.
+    unsigned long generation;         // Last published (writer only).
+    Snapshot *retired;                // Replaced snapshots, newest first (writer only).
+};
+
+static Snapshot *new_snapshot(ParamRcu *rcu, const void *params) {
+    Snapshot *s = malloc(sizeof(Snapshot) + rcu->size);
+    if (!s) return NULL;
+    s->next = NULL;
+    s->generation = ++rcu->generation;
+    memcpy(s->data, params, rcu->size);
+    return s;
+}
+
+/**
+ * @brief Free retired snapshots older than the one the reader holds.
+ */
+static void reclaim(ParamRcu *rcu, unsigned long oldest_in_use) {
+    Snapshot **link = &rcu->retired;
+    while (*link) {
+        Snapshot *s = *link;
+        if (s->generation < oldest_in_use) {
+            *link = s->next;
+            free(s);
+        } else {
+            link = &s->next;
+        }
+    }
+}
+
+ParamRcu *param_rcu_create(const void *initial, size_t size) {
+    ParamRcu *rcu = calloc(1, sizeof(*rcu));
+    if (!rcu) return NULL;
+    rcu->size = size;
+    Snapshot *s = new_snapshot(rcu, initial);
+    if (!s) {
+        free(rcu);
+        return NULL;
+    }
+    atomic_init(&rcu->current, s);
+    atomic_init(&rcu->reader_generation, s->generation);
+    return rcu;
+}
+
+void param_rcu_destroy(ParamRcu *rcu) {
+    if (!rcu) return;
+    reclaim(rcu, rcu->generation + 1);
+    free(atomic_load_explicit(&rcu->current, memory_order_relaxed));
+    free(rcu);
+}
+
+int param_rcu_publish(ParamRcu *rcu, const void *params) {
+    Snapshot *s = new_snapshot(rcu, params);
+    if (!s) return 0;
+    Snapshot *old = atomic_exchange_explicit(&rcu->current, s, memory_order_acq_rel);
+    old->next = rcu->retired;
+    rcu->retired = old;
+    reclaim(rcu, atomic_load_explicit(&rcu->reader_generation, memory_order_acquire));
+    return 1;
+}
+
+void param_rcu_offline(ParamRcu *rcu) {
+    reclaim(rcu, rcu->generation + 1);
+}
+
+const void *param_rcu_read(ParamRcu *rcu) {
+    Snapshot *s = atomic_load_explicit(&rcu->current, memory_order_acquire);
+    // Done with the previous snapshot: announce which one is in use now.
+    atomic_store_explicit(&rcu->reader_generation, s->generation, memory_order_release);
+    return s->data;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file
+ * @brief Parameters shared with the audio thread as immutable snapshots.
+ *
+ * The UI thread never changes parameters the audio thread is using. It
+ * publishes a whole new copy instead, swapped in with one atomic pointer
+ * store. The audio thread takes the current snapshot once per block, with
+ * one atomic load and one atomic store: no locks, no waiting, and no half
+ * updated filter coefficients.
+ *
+ * Replaced snapshots are freed by the writer once the reader has moved on
+ * to a newer one. Each snapshot carries a generation number, and the reader
+ * records the generation it took, so anything older can no longer be in
+ * use (epoch-based reclamation).
+ *
+ * One writer thread and one reader thread per ParamRcu.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ */
+
+#ifndef PARAM_RCU_H
+#define PARAM_RCU_H
+
+#include <stddef.h>
+
+typedef struct ParamRcu ParamRcu;
+
+/**
+ * @brief Create with an initial snapshot.
+ * @param initial Parameters to copy.
+ * @param size Size of the parameter struct.
+ * @return The ParamRcu, or NULL when out of memory.
+ */
+ParamRcu *param_rcu_create(const void *initial, size_t size);
+
+/**
+ * @brief Free all snapshots. The reader must no longer be running.
+ */
+void param_rcu_destroy(ParamRcu *rcu);
+
+/**
+ * @brief Publish a copy of params (writer thread).
+ *
+ * Also frees the replaced snapshots the reader is done with.
+ *
+ * @return 1 on success, 0 when out of memory (the old snapshot stays).
+ */
+int param_rcu_publish(ParamRcu *rcu, const void *params);
+
+/**
+ * @brief Tell the writer the reader is stopped, so every old snapshot can go.
+ *
+ * Call from the writer thread, e.g. after the audio device was stopped.
+ */
+void param_rcu_offline(ParamRcu *rcu);
+
+/**
+ * @brief The current snapshot (reader thread). Wait-free.
+ *
+ * The pointer stays valid until the reader's next call.
+ */
+const void *param_rcu_read(ParamRcu *rcu);
+
+#endif
@@ -4,6 +4,8 @@
 #include <string.h>
 #include <gtk/gtk.h>
 
+#include "traced_file.h"
+
 // Structure representing a standard WAV file header.
 typedef struct {
     char riff[4];              // "RIFF"
@@ -62,7 +64,7 @@ static void create_wav_header(WavHeader *header, uint32_t data_size) {
 
 // Convert a raw PCM file to a valid WAV file.
 static void convert_pcm_to_wav(const char *input_path, const char *output_path) {
-    FILE *fin = fopen(input_path, "rb");
+    FILE *fin = traced_fopen(input_path, "rb");
     if (!fin) {
         show_error_dialog("Unable to open the input PCM file.");
         return;
@@ -74,21 +76,21 @@ static void convert_pcm_to_wav(const char *input_path, const char *output_path)
     fseek(fin, 0, SEEK_SET);
 
     if (file_size <= 0) {
-        fclose(fin);
+        traced_fclose(fin, input_path);
         show_error_dialog("Input PCM file is empty or invalid.");
         return;
     }
 
     // Ensure the file size is even (16-bit = 2 bytes/sample).
     if (file_size % 2 != 0) {
-        fclose(fin);
+        traced_fclose(fin, input_path);
         show_error_dialog("Invalid PCM file size (must be multiple of 2 for 16-bit audio).");
         return;
     }
 
-    FILE *fout = fopen(output_path, "wb");
+    FILE *fout = traced_fopen(output_path, "wb");
     if (!fout) {
-        fclose(fin);
+        traced_fclose(fin, input_path);
         show_error_dialog("Unable to create the output WAV file.");
         return;
     }
@@ -97,8 +99,8 @@ static void convert_pcm_to_wav(const char *input_path, const char *output_path)
     WavHeader header;
     create_wav_header(&header, file_size);
     if (fwrite(&header, sizeof(WavHeader), 1, fout) != 1) {
-        fclose(fin);
-        fclose(fout);
+        traced_fclose(fin, input_path);
+        traced_fclose(fout, output_path);
         show_error_dialog("Failed to write WAV header.");
         return;
     }
@@ -106,8 +108,8 @@ static void convert_pcm_to_wav(const char *input_path, const char *output_path)
     // Read PCM data and write it to the WAV file.
     uint8_t *buffer = malloc(file_size);
     if (!buffer) {
-        fclose(fin);
-        fclose(fout);
+        traced_fclose(fin, input_path);
+        traced_fclose(fout, output_path);
         show_error_dialog("Memory allocation failed.");
         return;
     }
@@ -124,8 +126,8 @@ static void convert_pcm_to_wav(const char *input_path, const char *output_path)
     }
 
     free(buffer);
-    fclose(fin);
-    fclose(fout);
+    traced_fclose(fin, input_path);
+    traced_fclose(fout, output_path);
 }
 
 // Handle the "Convert" button click.
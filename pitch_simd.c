@@ -0,0 +1,268 @@
+/**
+ * @file
+ * @brief Vectorized pitch cross-correlation for the static build.
+ *
+ * Upstream's xcorr_kernel() accumulates each lag over the taps in order.
+ * Vectorizing over the taps would reorder those sums, so the kernels here
+ * keep one lag per vector lane instead: every step broadcasts x[j] and
+ * multiplies it with y[i + j .. i + j + width - 1]. Each lane then performs
+ * exactly the scalar operations of its lag, so every tier is bit-exact with
+ * pitch_xcorr_generic(), which is what pitch_simd_check() verifies.
+ *
+ * Upstream's own pitch_xcorr cannot be called for comparison in the static
+ * build (this file replaces it), so equality with upstream rests on
+ * pitch_xcorr_generic() following its loop and its contraction choice (see
+ * MAC below). That holds for the default baseline build. With MARCH set to
+ * an FMA-capable -march, the compiler may fuse upstream's multiply-adds
+ * while this file keeps them separate, and results can differ in the last
+ * bit.
+ *
+ * In the static build RNNoise's own pitch_xcorr is made weak and this file
+ * provides the strong definition (see PITCH_XCORR_SYMBOL in Makefile.static),
+ * so the coarse pitch search, the pitch downsampling autocorrelation and the
+ * LPC analysis all land here.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pitch_simd.h"
+#include "cpu_dispatch.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PITCH_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#define PITCH_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Upstream is built with GCC's default -ffp-contract=fast: AArch64 fuses its
+// multiply-adds, baseline x86 has no FMA to fuse them with. This file is
+// built with -ffp-contract=off and spells out the same choice.
+#ifdef __aarch64__
+#define MAC(acc, a, b) fmaf(a, b, acc)
+#define MACQ(acc, a, b) vfmaq_f32(acc, a, b)
+#else
+#define MAC(acc, a, b) ((acc) + (a) * (b))
+#define MACQ(acc, a, b) vmlaq_f32(acc, a, b)     // 32-bit NEON: unfused, like MAC.
+#endif
+
+void pitch_xcorr_generic(const float *x, const float *y, float *xcorr, int len, int max_pitch) {
+    for (int i = 0; i < max_pitch; i++) {
+        float sum = 0.0f;
+        for (int j = 0; j < len; j++) {
+            sum = MAC(sum, x[j], y[i + j]);
+        }
+        xcorr[i] = sum;
+    }
+}
+
+#ifdef PITCH_X86
+
+/**
+ * @brief Lags [i, i + 4k) with SSE2, four lags per register.
+ * @return The first lag left for the caller.
+ */
+__attribute__((target("sse2")))
+static int xcorr_sse2_from(const float *x, const float *y, float *xcorr, int len, int max_pitch, int i) {
+    for (; i + 16 <= max_pitch; i += 16) {
+        __m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps();
+        __m128 a2 = _mm_setzero_ps(), a3 = _mm_setzero_ps();
+        const float *yp = y + i;
+        for (int j = 0; j < len; j++, yp++) {
+            __m128 xj = _mm_set1_ps(x[j]);
+            a0 = _mm_add_ps(a0, _mm_mul_ps(xj, _mm_loadu_ps(yp)));
+            a1 = _mm_add_ps(a1, _mm_mul_ps(xj, _mm_loadu_ps(yp + 4)));
+            a2 = _mm_add_ps(a2, _mm_mul_ps(xj, _mm_loadu_ps(yp + 8)));
+            a3 = _mm_add_ps(a3, _mm_mul_ps(xj, _mm_loadu_ps(yp + 12)));
+        }
+        _mm_storeu_ps(xcorr + i, a0);
+        _mm_storeu_ps(xcorr + i + 4, a1);
+        _mm_storeu_ps(xcorr + i + 8, a2);
+        _mm_storeu_ps(xcorr + i + 12, a3);
+    }
+    for (; i + 4 <= max_pitch; i += 4) {
+        __m128 a0 = _mm_setzero_ps();
+        for (int j = 0; j < len; j++) {
+            a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_set1_ps(x[j]), _mm_loadu_ps(y + i + j)));
+        }
+        _mm_storeu_ps(xcorr + i, a0);
+    }
+    return i;
+}
+
+void pitch_xcorr_sse2(const float *x, const float *y, float *xcorr, int len, int max_pitch) {
+    int i = xcorr_sse2_from(x, y, xcorr, len, max_pitch, 0);
+    pitch_xcorr_generic(x, y + i, xcorr + i, len, max_pitch - i);
+}
+
+__attribute__((target("avx2")))
+void pitch_xcorr_avx2(const float *x, const float *y, float *xcorr, int len, int max_pitch) {
+    int i = 0;
+    for (; i + 32 <= max_pitch; i += 32) {
+        __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+        __m256 a2 = _mm256_setzero_ps(), a3 = _mm256_setzero_ps();
+        const float *yp = y + i;
+        for (int j = 0; j < len; j++, yp++) {
+            __m256 xj = _mm256_broadcast_ss(x + j);
+            a0 = _mm256_add_ps(a0, _mm256_mul_ps(xj, _mm256_loadu_ps(yp)));
+            a1 = _mm256_add_ps(a1, _mm256_mul_ps(xj, _mm256_loadu_ps(yp + 8)));
+            a2 = _mm256_add_ps(a2, _mm256_mul_ps(xj, _mm256_loadu_ps(yp + 16)));
+            a3 = _mm256_add_ps(a3, _mm256_mul_ps(xj, _mm256_loadu_ps(yp + 24)));
+        }
+        _mm256_storeu_ps(xcorr + i, a0);
+        _mm256_storeu_ps(xcorr + i + 8, a1);
+        _mm256_storeu_ps(xcorr + i + 16, a2);
+        _mm256_storeu_ps(xcorr + i + 24, a3);
+    }
+    for (; i + 8 <= max_pitch; i += 8) {
+        __m256 a0 = _mm256_setzero_ps();
+        for (int j = 0; j < len; j++) {
+            a0 = _mm256_add_ps(a0, _mm256_mul_ps(_mm256_broadcast_ss(x + j), _mm256_loadu_ps(y + i + j)));
+        }
+        _mm256_storeu_ps(xcorr + i, a0);
+    }
+    i = xcorr_sse2_from(x, y, xcorr, len, max_pitch, i);
+    pitch_xcorr_generic(x, y + i, xcorr + i, len, max_pitch - i);
+}
+
+__attribute__((target("avx512f")))
+void pitch_xcorr_avx512(const float *x, const float *y, float *xcorr, int len, int max_pitch) {
+    int i = 0;
+    for (; i + 64 <= max_pitch; i += 64) {
+        __m512 a0 = _mm512_setzero_ps(), a1 = _mm512_setzero_ps();
+        __m512 a2 = _mm512_setzero_ps(), a3 = _mm512_setzero_ps();
+        const float *yp = y + i;
+        for (int j = 0; j < len; j++, yp++) {
+            __m512 xj = _mm512_set1_ps(x[j]);
+            a0 = _mm512_add_ps(a0, _mm512_mul_ps(xj, _mm512_loadu_ps(yp)));
+            a1 = _mm512_add_ps(a1, _mm512_mul_ps(xj, _mm512_loadu_ps(yp + 16)));
+            a2 = _mm512_add_ps(a2, _mm512_mul_ps(xj, _mm512_loadu_ps(yp + 32)));
+            a3 = _mm512_add_ps(a3, _mm512_mul_ps(xj, _mm512_loadu_ps(yp + 48)));
+        }
+        _mm512_storeu_ps(xcorr + i, a0);
+        _mm512_storeu_ps(xcorr + i + 16, a1);
+        _mm512_storeu_ps(xcorr + i + 32, a2);
+        _mm512_storeu_ps(xcorr + i + 48, a3);
+    }
+    for (; i + 16 <= max_pitch; i += 16) {
+        __m512 a0 = _mm512_setzero_ps();
+        for (int j = 0; j < len; j++) {
+            a0 = _mm512_add_ps(a0, _mm512_mul_ps(_mm512_set1_ps(x[j]), _mm512_loadu_ps(y + i + j)));
+        }
+        _mm512_storeu_ps(xcorr + i, a0);
+    }
+    i = xcorr_sse2_from(x, y, xcorr, len, max_pitch, i);
+    pitch_xcorr_generic(x, y + i, xcorr + i, len, max_pitch - i);
+}
+
+#endif
+
+#ifdef PITCH_NEON
+
+void pitch_xcorr_neon(const float *x, const float *y, float *xcorr, int len, int max_pitch) {
+    int i = 0;
+    for (; i + 16 <= max_pitch; i += 16) {
+        float32x4_t a0 = vdupq_n_f32(0.0f), a1 = vdupq_n_f32(0.0f);
+        float32x4_t a2 = vdupq_n_f32(0.0f), a3 = vdupq_n_f32(0.0f);
+        const float *yp = y + i;
+        for (int j = 0; j < len; j++, yp++) {
+            float32x4_t xj = vdupq_n_f32(x[j]);
+            a0 = MACQ(a0, xj, vld1q_f32(yp));
+            a1 = MACQ(a1, xj, vld1q_f32(yp + 4));
+            a2 = MACQ(a2, xj, vld1q_f32(yp + 8));
+            a3 = MACQ(a3, xj, vld1q_f32(yp + 12));
+        }
+        vst1q_f32(xcorr + i, a0);
+        vst1q_f32(xcorr + i + 4, a1);
+        vst1q_f32(xcorr + i + 8, a2);
+        vst1q_f32(xcorr + i + 12, a3);
+    }
+    for (; i + 4 <= max_pitch; i += 4) {
+        float32x4_t a0 = vdupq_n_f32(0.0f);
+        for (int j = 0; j < len; j++) {
+            a0 = MACQ(a0, vdupq_n_f32(x[j]), vld1q_f32(y + i + j));
+        }
+        vst1q_f32(xcorr + i, a0);
+    }
+    pitch_xcorr_generic(x, y + i, xcorr + i, len, max_pitch - i);
+}
+
+#endif
+
+#ifdef PITCH_XCORR_SYMBOL
+
+void PITCH_XCORR_SYMBOL(const float *x, const float *y, float *xcorr, int len, int max_pitch);
+
+/**
+ * @brief Strong definition replacing RNNoise's pitch_xcorr.
+ */
+void PITCH_XCORR_SYMBOL(const float *x, const float *y, float *xcorr, int len, int max_pitch) {
+    const CpuKernels *k = cpu_kernels();
+    if (!cpu_profiling) {
+        k->pitch_xcorr(x, y, xcorr, len, max_pitch);
+        return;
+    }
+    uint64_t t0 = cpu_profile_now();
+    k->pitch_xcorr(x, y, xcorr, len, max_pitch);
+    cpu_profile_add(CPU_PROFILE_PITCH_XCORR, t0);
+}
+
+#endif
+
+int pitch_simd_check(void) {
+    // Shapes RNNoise uses (coarse pitch search, downsampling autocorrelation)
+    // plus odd sizes that exercise every tail path.
+    static const int shapes[][2] = {{240, 177}, {860, 5}, {480, 354}, {37, 1}, {101, 63}, {17, 129}};
+    const int nshapes = (int)(sizeof(shapes) / sizeof(shapes[0]));
+    const int iterations = 200;
+    float x[1024], y[2048], ref[512], out[512];
+    int ok = 1;
+
+    srand(4321);
+    for (int n = 0; n < 1024; n++) x[n] = (float)(rand() % 65536 - 32768) / 32768.0f;
+    for (int n = 0; n < 2048; n++) y[n] = (float)(rand() % 65536 - 32768) / 32768.0f;
+
+    for (int t = CPU_TIER_GENERIC; t < CPU_TIER_COUNT; t++) {
+        const CpuKernels *k = cpu_kernels_for((CpuTier)t);
+        if (!k) continue;
+
+        int exact = 1;
+        double ns = 0.0;
+        for (int s = 0; s < nshapes; s++) {
+            int len = shapes[s][0], max_pitch = shapes[s][1];
+            pitch_xcorr_generic(x, y, ref, len, max_pitch);
+            k->pitch_xcorr(x, y, out, len, max_pitch);
+            if (memcmp(ref, out, max_pitch * sizeof(float)) != 0) exact = 0;
+        }
+
+        // Time the coarse pitch search shape, RNNoise's largest call.
+        uint64_t t0 = cpu_profile_now();
+        for (int i = 0; i < iterations; i++) k->pitch_xcorr(x, y, out, shapes[0][0], shapes[0][1]);
+        ns = (double)(cpu_profile_now() - t0) / iterations;
+
+        printf("pitch_xcorr %-7s: %s, %.0f ns per %dx%d call\n", cpu_tier_name((CpuTier)t),
+               exact ? "bit-exact with generic" : "MISMATCH with generic", ns, shapes[0][0], shapes[0][1]);
+        if (!exact) ok = 0;
+    }
+    return ok;
+}
@@ -0,0 +1,51 @@
+/**
+ * @file
+ * @brief Vectorized pitch cross-correlation for the static build.
+ *
+ * RNNoise's coarse pitch search and the autocorrelation of its pitch
+ * downsampling and LPC analysis all go through pitch_xcorr(). The versions
+ * here vectorize across lags instead of taps, so every lag is still summed
+ * in the same order as the scalar code, and every tier is bit-exact with
+ * pitch_xcorr_generic(). That function follows upstream's loop; it matches
+ * upstream exactly in the default baseline build (see pitch_simd.c).
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ */
+
+#ifndef PITCH_SIMD_H
+#define PITCH_SIMD_H
+
+/**
+ * @brief Cross-correlation xcorr[i] = sum_j x[j] * y[i + j], for i < max_pitch.
+ *
+ * Each sum runs over j in increasing order starting from zero, like
+ * upstream's xcorr_kernel(). Callers should use cpu_kernels()->pitch_xcorr.
+ *
+ * @param x First signal, len samples.
+ * @param y Second signal, len + max_pitch - 1 samples.
+ * @param xcorr Output, max_pitch values.
+ * @param len Correlation length.
+ * @param max_pitch Number of lags.
+ */
+void pitch_xcorr_generic(const float *x, const float *y, float *xcorr, int len, int max_pitch);
+
+#if defined(__x86_64__) || defined(__i386__)
+void pitch_xcorr_sse2(const float *x, const float *y, float *xcorr, int len, int max_pitch);
+void pitch_xcorr_avx2(const float *x, const float *y, float *xcorr, int len, int max_pitch);
+void pitch_xcorr_avx512(const float *x, const float *y, float *xcorr, int len, int max_pitch);
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+void pitch_xcorr_neon(const float *x, const float *y, float *xcorr, int len, int max_pitch);
+#endif
+
+/**
+ * @brief Check that every supported tier matches the generic kernel bit for bit.
+ *
+ * Prints the result and per-call timing of each tier.
+ *
+ * @return 1 if all tiers are bit-exact, 0 otherwise.
+ */
+int pitch_simd_check(void);
+
+#endif
@@ -1,6 +1,8 @@
 #define MINIAUDIO_IMPLEMENTATION
 #include "miniaudio.h"
 
+#include "traced_file.h"
+
 #include <gtk/gtk.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -104,7 +106,7 @@ void on_save(GtkButton *btn, gpointer user_data) {
     if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
         char *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
 
-        FILE *f = fopen(filename, "wb");
+        FILE *f = traced_fopen(filename, "wb");
         if (!f) {
             GtkWidget *err = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
                                                     "Failed to open file for writing.");
@@ -119,7 +121,7 @@ void on_save(GtkButton *btn, gpointer user_data) {
         create_wav_header(&header, audio_buffer_pos * sizeof(int16_t));
         fwrite(&header, sizeof(WavHeader), 1, f);
         fwrite(audio_buffer, sizeof(int16_t), audio_buffer_pos, f);
-        fclose(f);
+        traced_fclose(f, filename);
 
         GtkWidget *msg = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_INFO, GTK_BUTTONS_OK,
                                                 "File saved successfully!");
@@ -9,6 +9,7 @@
 #define MINIAUDIO_IMPLEMENTATION
 #include "miniaudio.h"
 
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -16,10 +17,13 @@
 #include <gtk/gtk.h>
 #include <math.h>
 
-#include "rnnoise/include/rnnoise.h"
+#include "denoise_core.h"
+#include "rnnoise_probes.h"
+#include "rt_audit.h"
 
 #define FRAME_SIZE 480
 #define SAMPLE_RATE 48000
+#define WARM_UP_FRAMES 50   // Synthetic frames run through the model at launch.
 
 typedef struct {
     GtkWidget *window;
@@ -27,9 +31,21 @@ typedef struct {
     GtkWidget *stop_button;
     GtkWidget *status_label;
 
-    ma_context context;
     ma_device device;
-    DenoiseState *rnnoise_state;
+    DenoiseCore *denoiser;
+
+    // Prepared at launch: the device runs with the output muted until Start
+    // sets live, so Start opens and allocates nothing.
+    atomic_int live;
+    atomic_llong first_audio_us;   // When the callback first played audio after Start.
+    gint64 start_us;
+    guint first_audio_timer;
+
+    // The device is opened on a worker thread: initializing miniaudio can
+    // take seconds, and the window must keep responding meanwhile.
+    GThread *opener;               // Set while the device is being opened.
+    const char *open_error;        // Written by the opener, NULL on success.
+    gboolean start_pending;        // Start was clicked while opening.
 
     gboolean is_processing;
     gboolean device_initialized;
@@ -39,40 +55,43 @@ typedef struct {
 
 static void duplex_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
     AppState *state = (AppState*)pDevice->pUserData;
+    RT_AUDIT_ENTER();
+    RNNOISE_PROBE1(callback_start, frameCount);
 
-    if (!state || !state->is_processing || !pInput || !pOutput || !state->rnnoise_state) {
+    if (!state || !pInput || !pOutput || !state->denoiser) {
         memset(pOutput, 0, frameCount * sizeof(int16_t));
+        RNNOISE_PROBE1(callback_done, frameCount);
+        RT_AUDIT_LEAVE();
         return;
     }
 
-    int16_t *in  = (int16_t*)pInput;
+    const int16_t *in  = (const int16_t*)pInput;
     int16_t *out = (int16_t*)pOutput;
-    float float_buffer[FRAME_SIZE];
-
-    for (ma_uint32 i = 0; i < frameCount; i += FRAME_SIZE) {
-        ma_uint32 block = (i + FRAME_SIZE <= frameCount) ? FRAME_SIZE : (frameCount - i);
-
-        for (ma_uint32 j = 0; j < block; j++) {
-            float_buffer[j] = (float)in[i + j] / 32768.0f;
-        }
-
-        rnnoise_process_frame(state->rnnoise_state, float_buffer, float_buffer);
 
-        for (ma_uint32 j = 0; j < block; j++) {
-            float sample = float_buffer[j] * RNNOISE_GAIN;
-            sample = fmaxf(-1.0f, fminf(1.0f, sample));
-            out[i + j] = (int16_t)(sample * 32767.0f);
-        }
+    // Any period size works: denoise_core re-blocks the audio into RNNoise frames.
+    // The denoiser runs while muted too, so it is adapted to the input at Start.
+    denoise_core_process_s16(state->denoiser, in, out, frameCount);
+    if (!atomic_load_explicit(&state->live, memory_order_acquire)) {
+        memset(pOutput, 0, frameCount * sizeof(int16_t));
+        RNNOISE_PROBE1(callback_done, frameCount);
+        RT_AUDIT_LEAVE();
+        return;
     }
+    for (ma_uint32 i = 0; i < frameCount; i++) {
+        out[i] = (int16_t)(out[i] * RNNOISE_GAIN);
+    }
+    if (atomic_load_explicit(&state->first_audio_us, memory_order_relaxed) == 0) {
+        atomic_store_explicit(&state->first_audio_us, g_get_monotonic_time(), memory_order_relaxed);
+    }
+    RNNOISE_PROBE1(callback_done, frameCount);
+    RT_AUDIT_LEAVE();
 }
 
-static void start_processing(AppState *state) {
-    state->rnnoise_state = rnnoise_create(NULL);
-    if (!state->rnnoise_state) {
-        gtk_label_set_text(GTK_LABEL(state->status_label), "Failed to initialize RNNoise");
-        return;
-    }
+static gboolean device_opened(gpointer data);
 
+// Runs on the opener thread; touches nothing but the device and open_error.
+static gpointer open_device_thread(gpointer data) {
+    AppState *state = (AppState*)data;
     ma_device_config config = ma_device_config_init(ma_device_type_duplex);
     config.sampleRate       = SAMPLE_RATE;
     config.capture.format   = ma_format_s16;
@@ -82,39 +101,107 @@ static void start_processing(AppState *state) {
     config.dataCallback     = duplex_callback;
     config.pUserData        = state;
 
+    state->open_error = NULL;
     if (ma_device_init(NULL, &config, &state->device) != MA_SUCCESS) {
-        gtk_label_set_text(GTK_LABEL(state->status_label), "Failed to init device");
-        rnnoise_destroy(state->rnnoise_state);
-        state->rnnoise_state = NULL;
-        return;
+        state->open_error = "Failed to init device";
+    } else if (ma_device_start(&state->device) != MA_SUCCESS) {
+        ma_device_uninit(&state->device);
+        state->open_error = "Failed to start device";
     }
+    g_idle_add(device_opened, state);
+    return NULL;
+}
+
+// Starts opening the device in the background.
+// Returns TRUE if the device is open or being opened.
+static gboolean prepare_pipeline(AppState *state) {
+    if (state->device_initialized || state->opener) return TRUE;
+
+    state->denoiser = denoise_core_create(NULL);
+    if (!state->denoiser) {
+        gtk_label_set_text(GTK_LABEL(state->status_label), "Failed to initialize RNNoise");
+        return FALSE;
+    }
+    denoise_core_warm_up(state->denoiser, WARM_UP_FRAMES);
 
-    state->device_initialized = TRUE;
+    gtk_label_set_text(GTK_LABEL(state->status_label), "Opening the audio device...");
+    state->opener = g_thread_new("open-device", open_device_thread, state);
+    return TRUE;
+}
 
-    if (ma_device_start(&state->device) != MA_SUCCESS) {
-        gtk_label_set_text(GTK_LABEL(state->status_label), "Failed to start device");
+// Waits for the opener thread and takes over the device it opened.
+static void finish_open(AppState *state) {
+    g_thread_join(state->opener);
+    state->opener = NULL;
+    state->device_initialized = state->open_error == NULL;
+}
+
+static void release_pipeline(AppState *state) {
+    if (state->device_initialized) {
         ma_device_uninit(&state->device);
-        rnnoise_destroy(state->rnnoise_state);
-        state->rnnoise_state = NULL;
-        return;
+        state->device_initialized = FALSE;
     }
+    denoise_core_destroy(state->denoiser);
+    state->denoiser = NULL;
+}
+
+static gboolean show_first_audio(gpointer data) {
+    AppState *state = (AppState*)data;
+    long long first = atomic_load_explicit(&state->first_audio_us, memory_order_relaxed);
+    if (first == 0) return TRUE;
+
+    char text[64];
+    snprintf(text, sizeof(text), "Processing (audio after %.1f ms)", (first - state->start_us) / 1000.0);
+    gtk_label_set_text(GTK_LABEL(state->status_label), text);
+    state->first_audio_timer = 0;
+    return FALSE;
+}
+
+static void go_live(AppState *state) {
+    state->start_us = g_get_monotonic_time();
+    atomic_store_explicit(&state->first_audio_us, 0, memory_order_relaxed);
+    atomic_store_explicit(&state->live, 1, memory_order_release);
 
     state->is_processing = TRUE;
     gtk_label_set_text(GTK_LABEL(state->status_label), "Processing...");
     gtk_widget_set_sensitive(state->start_button, FALSE);
     gtk_widget_set_sensitive(state->stop_button, TRUE);
+    state->first_audio_timer = g_timeout_add(5, show_first_audio, state);
+}
+
+static void start_processing(AppState *state) {
+    if (state->device_initialized) {
+        go_live(state);
+        return;
+    }
+    // Normally opened at launch; retried here if that failed. Goes live once open.
+    state->start_pending = prepare_pipeline(state);
+}
+
+// Back on the main thread once the opener is done.
+static gboolean device_opened(gpointer data) {
+    AppState *state = (AppState*)data;
+    if (!state->opener) return FALSE;   // Already collected by on_window_destroy.
+    finish_open(state);
+    gboolean start = state->start_pending;
+    state->start_pending = FALSE;
+    if (state->open_error) {
+        gtk_label_set_text(GTK_LABEL(state->status_label), state->open_error);
+        release_pipeline(state);
+    } else if (start) {
+        go_live(state);
+    } else {
+        gtk_label_set_text(GTK_LABEL(state->status_label), "Ready: click Start");
+    }
+    return FALSE;
 }
 
 static void stop_processing(AppState *state) {
     if (state->is_processing) {
-        if (state->device_initialized) {
-            ma_device_uninit(&state->device);
-            state->device_initialized = FALSE;
-        }
-
-        if (state->rnnoise_state) {
-            rnnoise_destroy(state->rnnoise_state);
-            state->rnnoise_state = NULL;
+        atomic_store_explicit(&state->live, 0, memory_order_release);
+        if (state->first_audio_timer) {
+            g_source_remove(state->first_audio_timer);
+            state->first_audio_timer = 0;
         }
 
         state->is_processing = FALSE;
@@ -124,6 +211,12 @@ static void stop_processing(AppState *state) {
     }
 }
 
+static gboolean prepare_at_launch(gpointer data) {
+    AppState *state = (AppState*)data;
+    prepare_pipeline(state);
+    return FALSE;
+}
+
 static void on_start(GtkWidget *widget, gpointer data) {
     AppState *state = (AppState*)data;
     start_processing(state);
@@ -137,6 +230,8 @@ static void on_stop(GtkWidget *widget, gpointer data) {
 static void on_window_destroy(GtkWidget *widget, gpointer data) {
     AppState *state = (AppState*)data;
     stop_processing(state);
+    if (state->opener) finish_open(state);
+    release_pipeline(state);
     gtk_main_quit();
 }
 
@@ -167,6 +262,9 @@ int main(int argc, char *argv[]) {
     gtk_box_pack_start(GTK_BOX(vbox), state.status_label, FALSE, FALSE, 0);
 
     gtk_widget_show_all(state.window);
+
+    // Open the devices and warm up the model before the first Start.
+    g_idle_add(prepare_at_launch, &state);
     gtk_main();
 
     return 0;
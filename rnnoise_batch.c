@@ -0,0 +1,147 @@
+/**
+ * @file
+ * @brief Headless, resumable WAV denoiser for batch nodes.
+ *
+ * Runs the same offline engine as rnnoise_gui. On SIGTERM or SIGINT (for
+ * example when a preemptible node is reclaimed) the job stops at the next
+ * frame, syncs the output and writes a checkpoint; running the same command
+ * again resumes from there. A crash loses at most the audio processed
+ * since the last periodic checkpoint.
+ *
+ * With -F the input may still be growing (e.g. a recording in progress):
+ * new audio is denoised as it is appended and the job ends when the
+ * writer closes the file or stops writing.
+ *
+ * With -C results are kept in a content-addressed cache, so re-submitted
+ * recordings are not denoised again.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "denoise_cache.h"
+#include "denoise_offline.h"
+
+#define EXIT_INTERRUPTED 75  // EX_TEMPFAIL: the job can be retried.
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static int job_cancelled(void *user) {
+    (void)user;
+    return stop_requested;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-i checkpoint_seconds] [-w warmup_frames] [-f] [-F [-I idle_seconds]] [-C cache_dir [-L cache_mb]] [-u] [-v]\n"
+            "          input.wav output.wav\n"
+            "  -i  audio between checkpoints, in seconds (default %.0f, 0 disables)\n"
+            "  -w  frames replayed before the checkpoint on resume (default %d)\n"
+            "  -f  start from scratch even if a checkpoint exists\n"
+            "  -F  follow an input that is still being written\n"
+            "  -I  with -F, stop after the input has not grown for this long (default %.0f)\n"
+            "  -C  reuse and store results in this cache directory\n"
+            "  -L  cache size limit in MiB (default %llu)\n"
+            "  -u  read and write through io_uring (O_DIRECT output) when available\n"
+            "  -v  report how long each pipeline stage waited\n"
+            "Exit status: 0 done, 1 error, %d interrupted (run again to resume)\n",
+            prog, DENOISE_CHECKPOINT_SECONDS, DENOISE_WARMUP_FRAMES, DENOISE_FOLLOW_IDLE_SECONDS,
+            DENOISE_CACHE_MAX_BYTES >> 20, EXIT_INTERRUPTED);
+}
+
+/**
+ * @brief Main entry point.
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return 0 when done, 1 on error, EXIT_INTERRUPTED when stopped by a signal.
+ */
+int main(int argc, char *argv[]) {
+    DenoiseJob job = {
+        .checkpoint_seconds = DENOISE_CHECKPOINT_SECONDS,
+        .resume = 1,
+        .cancelled = job_cancelled,
+    };
+    DenoiseCache cache = {0};
+    int verbose = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:w:fFI:C:L:uvh")) != -1) {
+        switch (opt) {
+            case 'i': job.checkpoint_seconds = atof(optarg); break;
+            case 'w': job.warmup_frames = atoi(optarg); break;
+            case 'f': job.resume = 0; break;
+            case 'F': job.follow = 1; break;
+            case 'I': job.follow_idle_seconds = atof(optarg); break;
+            case 'C': cache.dir = optarg; break;
+            case 'L': cache.max_bytes = strtoull(optarg, NULL, 10) << 20; break;
+            case 'u': job.io_uring = 1; break;
+            case 'v': verbose = 1; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (optind != argc - 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    job.input_path = argv[optind];
+    job.output_path = argv[optind + 1];
+
+    signal(SIGTERM, on_signal);
+    signal(SIGINT, on_signal);
+
+    DenoiseResult result;
+    int hit = 0;
+    int ok = cache.dir ? denoise_cache_run(&cache, &job, &result, &hit) : denoise_offline_run(&job, &result);
+    if (!ok) {
+        fprintf(stderr, "%s: %s\n", job.input_path, result.error);
+        return 1;
+    }
+    if (result.resumed_frames > 0) {
+        fprintf(stderr, "%s: resumed at frame %llu\n", job.input_path,
+                (unsigned long long)result.resumed_frames);
+    }
+    if (verbose && !hit) {
+        fprintf(stderr, "%s: pipeline waits: read %.2fs, denoise %.2fs, write %.2fs\n", job.input_path,
+                result.read_stall_seconds, result.denoise_stall_seconds, result.write_stall_seconds);
+        if (job.io_uring) {
+            fprintf(stderr, "%s: reads via %s, writes via %s\n", job.input_path,
+                    result.io_uring_reads ? "io_uring" : "stdio",
+                    result.direct_writes ? "io_uring (O_DIRECT)" : result.io_uring_writes ? "io_uring" : "stdio");
+        }
+    }
+    if (result.cancelled) {
+        fprintf(stderr, "%s: interrupted at frame %llu, checkpoint saved\n", job.input_path,
+                (unsigned long long)result.frames);
+        return EXIT_INTERRUPTED;
+    }
+    DenoiseCacheStats stats;
+    if (cache.dir && !job.follow && denoise_cache_stats(&cache, &stats)) {
+        unsigned long long lookups = stats.hits + stats.misses;
+        fprintf(stderr, "%s: cache %s, hit ratio %.1f%% (%llu of %llu)\n", job.input_path, hit ? "hit" : "miss",
+                lookups ? 100.0 * stats.hits / lookups : 0.0, (unsigned long long)stats.hits, lookups);
+    }
+    return 0;
+}
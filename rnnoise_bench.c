@@ -0,0 +1,454 @@
+/**
+ * @file
+ * @brief Command line benchmark for the statically built RNNoise.
+ *
+ * Runs 48kHz mono 16-bit WAV files through RNNoise and reports per-frame
+ * timings. When a reference WAV is given, the output is compared against
+ * it so that alternative inference paths (e.g. the int8 build) can be
+ * checked against the float path.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "rnnoise/include/rnnoise.h"
+#include "cpu_dispatch.h"
+
+#define FRAME_SIZE 480     // RNNoise frame size (10ms at 48kHz).
+#define SAMPLE_RATE 48000  // Expected sample rate for RNNoise.
+
+/**
+ * @brief Struct representing the WAV file header.
+ */
+typedef struct {
+    char riff[4];                  // "RIFF"
+    uint32_t file_size;            // Total file size minus 8 bytes
+    char wave[4];                  // "WAVE"
+    char fmt[4];                   // "fmt "
+    uint32_t fmt_size;             // Format chunk size (usually 16)
+    uint16_t format;               // Audio format (1 = PCM)
+    uint16_t channels;             // Number of audio channels
+    uint32_t sample_rate;          // Sampling rate (Hz)
+    uint32_t byte_rate;            // Bytes per second
+    uint16_t block_align;          // Block alignment (bytes per sample frame)
+    uint16_t bits_per_sample;      // Bits per sample (usually 16)
+    char data[4];                  // "data"
+    uint32_t data_size;            // Size of audio data in bytes
+} WavHeader;
+
+/**
+ * @brief Audio samples loaded from a WAV file.
+ */
+typedef struct {
+    WavHeader header;
+    int16_t *samples;
+    size_t count;
+} WavData;
+
+/**
+ * @brief Read a mono 16-bit 48kHz WAV file into memory.
+ * @param path Path of the WAV file.
+ * @param wav Pointer to a WavData struct to fill.
+ * @return 1 on success, 0 on failure.
+ */
+static int load_wav(const char *path, WavData *wav) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "%s: could not open file\n", path);
+        return 0;
+    }
+
+    if (fread(&wav->header, sizeof(WavHeader), 1, f) != 1 ||
+        memcmp(wav->header.riff, "RIFF", 4) != 0 ||
+        memcmp(wav->header.wave, "WAVE", 4) != 0 ||
+        memcmp(wav->header.data, "data", 4) != 0) {
+        fprintf(stderr, "%s: invalid WAV file\n", path);
+        fclose(f);
+        return 0;
+    }
+
+    if (wav->header.channels != 1 || wav->header.sample_rate != SAMPLE_RATE ||
+        wav->header.bits_per_sample != 16) {
+        fprintf(stderr, "%s: only mono 16-bit 48kHz WAV files are supported\n", path);
+        fclose(f);
+        return 0;
+    }
+
+    wav->count = wav->header.data_size / sizeof(int16_t);
+    wav->samples = malloc(wav->count * sizeof(int16_t) + 1);
+    if (!wav->samples) {
+        fclose(f);
+        return 0;
+    }
+    wav->count = fread(wav->samples, sizeof(int16_t), wav->count, f);
+    fclose(f);
+    return 1;
+}
+
+/**
+ * @brief Monotonic clock in nanoseconds.
+ */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Denoise a loaded file the same way rnnoise_gui does.
+ * @param in Input samples.
+ * @param out Output buffer with room for in->count samples.
+ * @param frame_ns Per-frame timings, one entry per frame.
+ * @return Number of output samples (the warm-up frame is dropped).
+ */
+static size_t denoise(const WavData *in, int16_t *out, uint64_t *frame_ns) {
+    const CpuKernels *k = cpu_kernels();
+    DenoiseState *st = rnnoise_create(NULL);
+    float x[FRAME_SIZE];
+    size_t written = 0;
+    size_t frame = 0;
+
+    for (size_t pos = 0; pos < in->count; pos += FRAME_SIZE, frame++) {
+        size_t n = in->count - pos < FRAME_SIZE ? in->count - pos : FRAME_SIZE;
+
+        k->s16_to_float(in->samples + pos, x, n);
+        for (size_t i = n; i < FRAME_SIZE; i++) x[i] = 0.0f;
+
+        uint64_t t0 = now_ns();
+        rnnoise_process_frame(st, x, x);
+        frame_ns[frame] = now_ns() - t0;
+
+        // Skip first frame (RNNoise warm-up).
+        if (frame == 0) continue;
+        k->float_to_s16(x, out + written, n);
+        written += n;
+    }
+
+    rnnoise_destroy(st);
+    return written;
+}
+
+/**
+ * @brief Compare an output against a reference and print the quality delta.
+ * @param out Output samples.
+ * @param count Number of output samples.
+ * @param ref Reference WAV (usually the float build's output).
+ * @return SNR of the output relative to the reference, in dB.
+ */
+static double compare_reference(const int16_t *out, size_t count, const WavData *ref) {
+    size_t n = count < ref->count ? count : ref->count;
+    double signal = 0.0, noise = 0.0;
+    int max_diff = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        int diff = (int)out[i] - (int)ref->samples[i];
+        signal += (double)ref->samples[i] * ref->samples[i];
+        noise += (double)diff * diff;
+        if (abs(diff) > max_diff) max_diff = abs(diff);
+    }
+
+    double snr = noise > 0.0 ? 10.0 * log10(signal / noise) : INFINITY;
+    printf("  reference: SNR %.2f dB, max |diff| %d LSB over %zu samples%s\n",
+           snr, max_diff, n, count != ref->count ? " (length mismatch)" : "");
+    return snr;
+}
+
+/**
+ * @brief Write samples as a mono 16-bit 48kHz WAV file.
+ * @return 1 on success, 0 on failure.
+ */
+static int save_wav(const char *path, const WavHeader *templ, const int16_t *samples, size_t count) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return 0;
+    WavHeader header = *templ;
+    header.data_size = (uint32_t)(count * sizeof(int16_t));
+    header.file_size = header.data_size + sizeof(WavHeader) - 8;
+    int ok = fwrite(&header, sizeof(WavHeader), 1, f) == 1 &&
+             fwrite(samples, sizeof(int16_t), count, f) == count;
+    fclose(f);
+    return ok;
+}
+
+/**
+ * @brief Run the file once more with the kernel timers on and print the split.
+ *
+ * The timed runs above leave profiling off, so the timer overhead only
+ * affects this breakdown.
+ */
+static void print_profile(const WavData *in, int16_t *out, uint64_t *frame_ns, size_t frames) {
+    cpu_profile_enable(1);
+    denoise(in, out, frame_ns);
+    cpu_profile_enable(0);
+
+    uint64_t total = 0, kernels_ns = 0;
+    for (size_t i = 0; i < frames; i++) total += frame_ns[i];
+    printf("  profile (us per frame):\n");
+    for (int slot = 0; slot < CPU_PROFILE_COUNT; slot++) {
+        uint64_t ns, calls;
+        cpu_profile_get((CpuProfileSlot)slot, &ns, &calls);
+        kernels_ns += ns;
+        printf("    %-12s %8.2f  %5.1f%%  (%.1f calls)\n", cpu_profile_name((CpuProfileSlot)slot),
+               ns / 1e3 / frames, total ? 100.0 * ns / total : 0.0, (double)calls / frames);
+    }
+    uint64_t rest = total > kernels_ns ? total - kernels_ns : 0;
+    printf("    %-12s %8.2f  %5.1f%%\n", "other", rest / 1e3 / frames, total ? 100.0 * rest / total : 0.0);
+}
+
+/**
+ * @brief Hardware event counted by print_counters().
+ */
+typedef struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} CounterSpec;
+
+#ifdef __linux__
+
+static const CounterSpec counter_specs[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache refs", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {"cache misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"L1d misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+};
+#define COUNTER_COUNT (sizeof(counter_specs) / sizeof(counter_specs[0]))
+
+/**
+ * @brief Open a user-space counter on the calling thread.
+ * @return The file descriptor, or -1 if the event is not available.
+ */
+static int open_counter(const CounterSpec *spec) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = spec->type;
+    attr.config = spec->config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+ * @brief Run the file once more under hardware counters and print them per frame.
+ *
+ * Shows how weight layout changes affect cache behaviour. Events the CPU or
+ * kernel do not provide (e.g. in VMs, or with perf_event_paranoid > 2) are
+ * skipped.
+ */
+static void print_counters(const WavData *in, int16_t *out, uint64_t *frame_ns, size_t frames) {
+    int fds[COUNTER_COUNT];
+    uint64_t values[COUNTER_COUNT] = {0};
+    int opened = 0, first_errno = 0;
+
+    for (size_t i = 0; i < COUNTER_COUNT; i++) {
+        fds[i] = open_counter(&counter_specs[i]);
+        if (fds[i] >= 0) {
+            opened++;
+        } else if (!first_errno) {
+            first_errno = errno;
+        }
+    }
+    if (!opened) {
+        printf("  counters: unavailable (%s)\n", strerror(first_errno));
+        return;
+    }
+
+    for (size_t i = 0; i < COUNTER_COUNT; i++) {
+        if (fds[i] < 0) continue;
+        ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+    denoise(in, out, frame_ns);
+    for (size_t i = 0; i < COUNTER_COUNT; i++) {
+        if (fds[i] < 0) continue;
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fds[i], &values[i], sizeof(uint64_t)) != sizeof(uint64_t)) values[i] = 0;
+        close(fds[i]);
+    }
+
+    printf("  counters (per frame):");
+    for (size_t i = 0; i < COUNTER_COUNT; i++) {
+        if (fds[i] < 0) {
+            printf(" %s n/a,", counter_specs[i].name);
+        } else {
+            printf(" %s %.0f,", counter_specs[i].name, (double)values[i] / frames);
+        }
+    }
+    printf("\n");
+    if (fds[0] >= 0 && fds[1] >= 0 && values[0]) {
+        printf("  IPC %.2f", (double)values[1] / values[0]);
+        if (fds[2] >= 0 && fds[3] >= 0 && values[2]) {
+            printf(", cache miss rate %.2f%%", 100.0 * values[3] / values[2]);
+        }
+        printf("\n");
+    }
+}
+
+#else
+
+static void print_counters(const WavData *in, int16_t *out, uint64_t *frame_ns, size_t frames) {
+    (void)in;
+    (void)out;
+    (void)frame_ns;
+    (void)frames;
+    printf("  counters: unavailable on this platform\n");
+}
+
+#endif
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-c tier] [-n repeats] [-m] [-p] [-o output.wav] [-r reference.wav] [-t min_snr_db] input.wav\n"
+            "       %s [-c tier] -k\n"
+            "  -c  force a CPU tier: generic, sse2, avx2, avx512 or neon\n"
+            "  -k  check the dispatched kernels against RNNoise's implementation\n"
+            "  -m  count cycles, instructions and cache misses per frame (perf_event_open)\n"
+            "  -n  process the file n times and report the best run (default 3)\n"
+            "  -p  print how the per-frame time splits across the dispatched kernels\n"
+            "  -o  write the denoised output\n"
+            "  -r  compare the output against a reference WAV\n"
+            "  -t  fail (exit 1) when the SNR against the reference is below this\n",
+            prog, prog);
+}
+
+/**
+ * @brief Main entry point.
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return 0 on success, 1 if the quality threshold is not met, 2 on error.
+ */
+int main(int argc, char *argv[]) {
+    const char *output_path = NULL;
+    const char *reference_path = NULL;
+    double min_snr = -INFINITY;
+    const char *cpu_tier = NULL;
+    int check_kernels = 0;
+    int profile = 0;
+    int counters = 0;
+    int repeats = 3;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:kmn:o:pr:t:h")) != -1) {
+        switch (opt) {
+            case 'c': cpu_tier = optarg; break;
+            case 'k': check_kernels = 1; break;
+            case 'm': counters = 1; break;
+            case 'n': repeats = atoi(optarg); break;
+            case 'o': output_path = optarg; break;
+            case 'p': profile = 1; break;
+            case 'r': reference_path = optarg; break;
+            case 't': min_snr = atof(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    CpuTier tier = cpu_dispatch_init(cpu_tier);
+    if (check_kernels) {
+        int ok = fft960_check();
+        ok = pitch_simd_check() && ok;
+        return ok ? 0 : 1;
+    }
+
+    if (optind != argc - 1 || repeats < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    WavData in;
+    if (!load_wav(argv[optind], &in)) return 2;
+
+    size_t frames = (in.count + FRAME_SIZE - 1) / FRAME_SIZE;
+    if (frames == 0) {
+        fprintf(stderr, "%s: no audio data\n", argv[optind]);
+        return 2;
+    }
+    int16_t *out = malloc(in.count * sizeof(int16_t) + 1);
+    uint64_t *frame_ns = malloc(frames * sizeof(uint64_t) + 1);
+    uint64_t *best_ns = malloc(frames * sizeof(uint64_t) + 1);
+    if (!out || !frame_ns || !best_ns) {
+        fprintf(stderr, "Out of memory\n");
+        return 2;
+    }
+
+    // Keep the fastest run so that scheduler noise does not hide kernel changes.
+    uint64_t best_total = UINT64_MAX;
+    size_t written = 0;
+    for (int r = 0; r < repeats; r++) {
+        written = denoise(&in, out, frame_ns);
+        uint64_t total = 0;
+        for (size_t i = 0; i < frames; i++) total += frame_ns[i];
+        if (total < best_total) {
+            best_total = total;
+            memcpy(best_ns, frame_ns, frames * sizeof(uint64_t));
+        }
+    }
+
+    qsort(best_ns, frames, sizeof(uint64_t), compare_u64);
+    double audio_s = (double)in.count / SAMPLE_RATE;
+    printf("%s: %zu frames, %.2f s of audio, %s kernels\n", argv[optind], frames, audio_s,
+           cpu_tier_name(tier));
+    printf("  per frame: mean %.2f us, p50 %.2f us, p99 %.2f us, max %.2f us\n",
+           best_total / 1e3 / frames, best_ns[frames / 2] / 1e3,
+           best_ns[frames * 99 / 100] / 1e3, best_ns[frames - 1] / 1e3);
+    printf("  real-time factor: %.1fx\n", audio_s / (best_total / 1e9));
+    if (profile) print_profile(&in, out, frame_ns, frames);
+    if (counters) print_counters(&in, out, frame_ns, frames);
+
+    int status = 0;
+    if (output_path && !save_wav(output_path, &in.header, out, written)) {
+        fprintf(stderr, "%s: could not write output\n", output_path);
+        status = 2;
+    }
+
+    if (reference_path) {
+        WavData ref;
+        if (!load_wav(reference_path, &ref)) return 2;
+        double snr = compare_reference(out, written, &ref);
+        if (snr < min_snr) {
+            printf("  FAIL: SNR below %.2f dB\n", min_snr);
+            status = status ? status : 1;
+        }
+        free(ref.samples);
+    }
+
+    free(best_ns);
+    free(frame_ns);
+    free(out);
+    free(in.samples);
+    return status;
+}
@@ -30,9 +30,8 @@
 
 // Include RNNoise headers directly.
 #include "rnnoise/include/rnnoise.h"
-
-#define FRAME_SIZE 480     // RNNoise frame size (10ms at 48kHz).
-#define SAMPLE_RATE 48000  // Expected sample rate for RNNoise.
+#include "denoise_offline.h"
+#include "rnnoise_probes.h"
 
 /**
  * @brief Struct holding all GTK widgets for the application.
@@ -43,27 +42,13 @@ typedef struct {
     GtkWidget *output_entry;
     GtkWidget *status_label;
     GtkWidget *progress_bar;
+    GtkWidget *follow_check;
+    GtkWidget *process_button;
+    GtkWidget *cancel_button;
+    gboolean cancel_requested;     // Set by Cancel or by closing the window.
+    gboolean closing;              // The window is gone; skip UI updates.
 } AppWidgets;
 
-/**
- * @brief Struct representing the WAV file header.
- */
-typedef struct {
-    char riff[4];                  // "RIFF"
-    uint32_t file_size;            // Total file size minus 8 bytes
-    char wave[4];                  // "WAVE"
-    char fmt[4];                   // "fmt "
-    uint32_t fmt_size;             // Format chunk size (usually 16)
-    uint16_t format;               // Audio format (1 = PCM)
-    uint16_t channels;             // Number of audio channels
-    uint32_t sample_rate;          // Sampling rate (Hz)
-    uint32_t byte_rate;            // Bytes per second
-    uint16_t block_align;          // Block alignment (bytes per sample frame)
-    uint16_t bits_per_sample;      // Bits per sample (usually 16)
-    char data[4];                  // "data"
-    uint32_t data_size;            // Size of audio data in bytes
-} WavHeader;
-
 /**
  * @brief Show an error message dialog.
  * @param parent Parent GTK window.
@@ -94,32 +79,6 @@ static void show_info_dialog(GtkWidget *parent, const char *message) {
     gtk_widget_destroy(dialog);
 }
 
-/**
- * @brief Read a WAV header from a file.
- * @param file Pointer to the opened WAV file.
- * @param header Pointer to a WavHeader struct to fill.
- * @return 1 on success, 0 on failure.
- */
-static int read_wav_header(FILE *file, WavHeader *header) {
-    if (fread(header, sizeof(WavHeader), 1, file) != 1) {
-        return 0;
-    }
-    return 1;
-}
-
-/**
- * @brief Write a WAV header to a file.
- * @param file Pointer to the opened WAV file.
- * @param header Pointer to a WavHeader struct to write.
- * @return 1 on success, 0 on failure.
- */
-static int write_wav_header(FILE *file, WavHeader *header) {
-    if (fwrite(header, sizeof(WavHeader), 1, file) != 1) {
-        return 0;
-    }
-    return 1;
-}
-
 /**
  * @brief Callback for the "Browse Input" button.
  * Opens a file dialog to choose an input WAV file.
@@ -178,8 +137,35 @@ static void on_browse_output(GtkWidget *widget, gpointer data) {
     gtk_widget_destroy(dialog);
 }
 
+/**
+ * @brief Progress callback of the offline engine.
+ * @param fraction Fraction of the input processed.
+ * @param user Pointer to the AppWidgets struct.
+ */
+static void on_job_progress(double fraction, void *user) {
+    AppWidgets *widgets = (AppWidgets *)user;
+    if (!widgets->closing) {
+        gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(widgets->progress_bar), fraction);
+    }
+
+    while (gtk_events_pending()) gtk_main_iteration();  // Allow GTK UI to update.
+}
+
+/**
+ * @brief Cancel callback of the offline engine.
+ * @param user Pointer to the AppWidgets struct.
+ * @return Non-zero when the user asked to stop.
+ */
+static int on_job_cancelled(void *user) {
+    return ((AppWidgets *)user)->cancel_requested;
+}
+
 /**
  * @brief Perform noise reduction on a WAV file using RNNoise.
+ *
+ * The job checkpoints its progress next to the output file, so a run that
+ * was cancelled or interrupted resumes where it stopped.
+ *
  * @param data Pointer to the AppWidgets struct.
  * @return FALSE to remove the source from the main loop after execution.
  */
@@ -194,117 +180,49 @@ static gboolean process_audio(gpointer data) {
         return G_SOURCE_REMOVE;
     }
 
-    FILE *fin = fopen(input_file, "rb");
-    if (!fin) {
-        show_error_dialog(widgets->window, "Could not open the input file.");
-        return G_SOURCE_REMOVE;
-    }
-
-    WavHeader header;
-    if (!read_wav_header(fin, &header)) {
-        fclose(fin);
-        show_error_dialog(widgets->window, "Failed to read the input WAV file header.");
-        return G_SOURCE_REMOVE;
-    }
-
-    // Validate WAV header contents.
-    if (memcmp(header.riff, "RIFF", 4) != 0 ||
-        memcmp(header.wave, "WAVE", 4) != 0 ||
-        memcmp(header.fmt, "fmt ", 4) != 0 ||
-        memcmp(header.data, "data", 4) != 0) {
-        fclose(fin);
-        show_error_dialog(widgets->window, "Invalid input WAV file.");
-        return G_SOURCE_REMOVE;
-    }
-
-    // Only 48kHz, 16-bit, mono files are supported.
-    if (header.channels != 1 || header.sample_rate != SAMPLE_RATE || header.bits_per_sample != 16) {
-        fclose(fin);
-        show_error_dialog(widgets->window, "Only mono 16-bit 48kHz WAV files are supported.");
-        return G_SOURCE_REMOVE;
-    }
-
-    FILE *fout = fopen(output_file, "wb");
-    if (!fout) {
-        fclose(fin);
-        show_error_dialog(widgets->window, "Could not create the output file.");
-        return G_SOURCE_REMOVE;
-    }
-
-    if (!write_wav_header(fout, &header)) {
-        fclose(fin);
-        fclose(fout);
-        show_error_dialog(widgets->window, "Failed to write the output WAV file header.");
-        return G_SOURCE_REMOVE;
-    }
-
-    // Create RNNoise state.
-    DenoiseState *st = rnnoise_create(NULL);
-    if (!st) {
-        fclose(fin);
-        fclose(fout);
-        show_error_dialog(widgets->window, "Failed to initialize RNNoise.");
-        return G_SOURCE_REMOVE;
-    }
-
-    gtk_label_set_text(GTK_LABEL(widgets->status_label), "Processing...");
-    gtk_widget_set_sensitive(widgets->window, FALSE);
-
-    int16_t tmp[FRAME_SIZE];  // Temporary buffer for raw PCM data
-    float x[FRAME_SIZE];      // Float buffer for RNNoise processing
-    size_t total_samples = header.data_size / sizeof(int16_t);
-    size_t processed_samples = 0;
-    gboolean first = TRUE;
-
-    // Process each frame of audio.
-    while (!feof(fin)) {
-        size_t read = fread(tmp, sizeof(int16_t), FRAME_SIZE, fin);
-        if (read == 0) break;
-
-        // Convert PCM to float.
-        for (size_t i = 0; i < read; i++) {
-            x[i] = (float)tmp[i];
-        }
-
-        // Zero padding for last frame.
-        for (size_t i = read; i < FRAME_SIZE; i++) {
-            x[i] = 0.0f;
-        }
-
-        // Apply RNNoise.
-        rnnoise_process_frame(st, x, x);
-
-        // Convert float back to PCM.
-        for (size_t i = 0; i < read; i++) {
-            float sample = x[i];
-            if (sample > 32767.0f) sample = 32767.0f;
-            if (sample < -32768.0f) sample = -32768.0f;
-            tmp[i] = (int16_t)sample;
-        }
-
-        // Skip first frame (RNNoise warm-up).
-        if (!first) {
-            fwrite(tmp, sizeof(int16_t), read, fout);
-        }
-        first = FALSE;
-
-        // Update progress.
-        processed_samples += read;
-        gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(widgets->progress_bar),
-                                      (double)processed_samples / total_samples);
-
-        while (gtk_events_pending()) gtk_main_iteration();  // Allow GTK UI to update.
+    // The entries stay editable while processing, so keep our own copies.
+    char *input_path = g_strdup(input_file);
+    char *output_path = g_strdup(output_file);
+
+    DenoiseJob job = {
+        .input_path = input_path,
+        .output_path = output_path,
+        .checkpoint_seconds = DENOISE_CHECKPOINT_SECONDS,
+        .resume = 1,
+        .follow = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widgets->follow_check)),
+        .progress = on_job_progress,
+        .cancelled = on_job_cancelled,
+        .user = widgets,
+    };
+    DenoiseResult result;
+
+    widgets->cancel_requested = FALSE;
+    gtk_label_set_text(GTK_LABEL(widgets->status_label), job.follow ? "Following input..." : "Processing...");
+    gtk_widget_set_sensitive(widgets->process_button, FALSE);
+    gtk_widget_set_sensitive(widgets->cancel_button, TRUE);
+
+    RNNOISE_PROBE2(job_start, input_path, output_path);
+    int ok = denoise_offline_run(&job, &result);
+    RNNOISE_PROBE2(job_done, result.frames, ok);
+    g_free(input_path);
+    g_free(output_path);
+    if (widgets->closing) return G_SOURCE_REMOVE;
+
+    gtk_widget_set_sensitive(widgets->process_button, TRUE);
+    gtk_widget_set_sensitive(widgets->cancel_button, FALSE);
+
+    if (!ok) {
+        gtk_label_set_text(GTK_LABEL(widgets->status_label), "Failed.");
+        show_error_dialog(widgets->window, result.error);
+    } else if (result.cancelled) {
+        gtk_label_set_text(GTK_LABEL(widgets->status_label), "Cancelled. Processing again will resume from here.");
+    } else {
+        gtk_label_set_text(GTK_LABEL(widgets->status_label), "Done!");
+        show_info_dialog(widgets->window, result.resumed_frames > 0
+                                              ? "Processing completed successfully (resumed from a checkpoint)!"
+                                              : "Processing completed successfully!");
     }
 
-    // Cleanup.
-    rnnoise_destroy(st);
-    fclose(fin);
-    fclose(fout);
-
-    gtk_label_set_text(GTK_LABEL(widgets->status_label), "Done!");
-    gtk_widget_set_sensitive(widgets->window, TRUE);
-    show_info_dialog(widgets->window, "Processing completed successfully!");
-
     return G_SOURCE_REMOVE;
 }
 
@@ -318,6 +236,29 @@ static void on_process(GtkWidget *widget, gpointer data) {
     g_idle_add(process_audio, data);
 }
 
+/**
+ * @brief Callback for the "Cancel" button.
+ * Stops the running job after writing a checkpoint.
+ * @param widget The GTK widget triggering the callback.
+ * @param data Pointer to the AppWidgets struct.
+ */
+static void on_cancel(GtkWidget *widget, gpointer data) {
+    ((AppWidgets *)data)->cancel_requested = TRUE;
+}
+
+/**
+ * @brief Callback for the window "destroy" signal.
+ * Stops a running job (it stays resumable) and quits the main loop.
+ * @param widget The GTK widget triggering the callback.
+ * @param data Pointer to the AppWidgets struct.
+ */
+static void on_window_destroy(GtkWidget *widget, gpointer data) {
+    AppWidgets *widgets = (AppWidgets *)data;
+    widgets->cancel_requested = TRUE;
+    widgets->closing = TRUE;
+    gtk_main_quit();
+}
+
 /**
  * @brief Main entry point. Initializes GTK, creates UI, and starts main loop.
  * @param argc Argument count.
@@ -328,14 +269,14 @@ int main(int argc, char *argv[]) {
     gtk_init(&argc, &argv);
 
     // Declare widget container structure.
-    AppWidgets widgets;
+    AppWidgets widgets = {0};
 
     // Create main window.
     widgets.window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
     gtk_window_set_title(GTK_WINDOW(widgets.window), "RNNoise Noise Remover");
     gtk_window_set_default_size(GTK_WINDOW(widgets.window), 400, 200);
     gtk_container_set_border_width(GTK_CONTAINER(widgets.window), 10);
-    g_signal_connect(widgets.window, "destroy", G_CALLBACK(gtk_main_quit), NULL);
+    g_signal_connect(widgets.window, "destroy", G_CALLBACK(on_window_destroy), &widgets);
 
     GtkWidget *grid = gtk_grid_new();
     gtk_grid_set_column_spacing(GTK_GRID(grid), 5);
@@ -364,18 +305,28 @@ int main(int argc, char *argv[]) {
     g_signal_connect(output_button, "clicked", G_CALLBACK(on_browse_output), &widgets);
     gtk_grid_attach(GTK_GRID(grid), output_button, 2, 1, 1, 1);
 
+    // Follow mode, for inputs that are still being recorded.
+    widgets.follow_check = gtk_check_button_new_with_label("Follow input while it is being written");
+    gtk_grid_attach(GTK_GRID(grid), widgets.follow_check, 0, 2, 3, 1);
+
     // Progress bar.
     widgets.progress_bar = gtk_progress_bar_new();
-    gtk_grid_attach(GTK_GRID(grid), widgets.progress_bar, 0, 2, 3, 1);
+    gtk_grid_attach(GTK_GRID(grid), widgets.progress_bar, 0, 3, 3, 1);
 
     // Status label.
     widgets.status_label = gtk_label_new("Waiting...");
-    gtk_grid_attach(GTK_GRID(grid), widgets.status_label, 0, 3, 3, 1);
+    gtk_grid_attach(GTK_GRID(grid), widgets.status_label, 0, 4, 3, 1);
 
     // Process button.
-    GtkWidget *process_button = gtk_button_new_with_label("Process");
-    g_signal_connect(process_button, "clicked", G_CALLBACK(on_process), &widgets);
-    gtk_grid_attach(GTK_GRID(grid), process_button, 0, 4, 3, 1);
+    widgets.process_button = gtk_button_new_with_label("Process");
+    g_signal_connect(widgets.process_button, "clicked", G_CALLBACK(on_process), &widgets);
+    gtk_grid_attach(GTK_GRID(grid), widgets.process_button, 0, 5, 2, 1);
+
+    // Cancel button, active while processing.
+    widgets.cancel_button = gtk_button_new_with_label("Cancel");
+    g_signal_connect(widgets.cancel_button, "clicked", G_CALLBACK(on_cancel), &widgets);
+    gtk_widget_set_sensitive(widgets.cancel_button, FALSE);
+    gtk_grid_attach(GTK_GRID(grid), widgets.cancel_button, 2, 5, 1, 1);
 
     gtk_widget_show_all(widgets.window);
     gtk_main();
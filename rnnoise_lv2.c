@@ -0,0 +1,191 @@
+/**
+ * @file
+ * @brief RNNoise as an LV2 plugin, for DAWs, OBS and other LV2 hosts.
+ *
+ * Runs the same processing as audio_denoiser.c inside the host instead of
+ * through a separate program and a virtual cable. Hosts may call run() with
+ * any block size: denoise_core re-blocks them into 480-sample frames, so the
+ * output is a constant two frames late (one of buffering, one of RNNoise's
+ * own delay) whatever the block size. That latency is reported on the
+ * latency port for the host to compensate.
+ *
+ * run() does not allocate, lock or do I/O. Everything is allocated in
+ * instantiate(), and activate() resets the denoiser in place.
+ *
+ * All instances share one model: the built-in one, or the file named by
+ * RNNOISE_MODEL, which is loaded by the first instance and freed with the
+ * last one.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <lv2/core/lv2.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "denoise_core.h"
+
+#define SAMPLE_RATE 48000  // Expected sample rate for RNNoise.
+
+#define RNNOISE_LV2_URI "https://github.com/souzamonteiro/rnnoise-gui#denoiser"
+
+/**
+ * @brief Port indices, as declared in rnnoise.lv2/rnnoise.ttl.
+ */
+typedef enum {
+    PORT_INPUT = 0,
+    PORT_OUTPUT = 1,
+    PORT_LATENCY = 2,
+    PORT_VAD = 3
+} PortIndex;
+
+/**
+ * @brief One plugin instance.
+ */
+typedef struct {
+    const float *input;
+    float *output;
+    float *latency;
+    float *vad;
+
+    DenoiseCore *core;
+} Denoiser;
+
+// Model shared by all instances in the process.
+static pthread_mutex_t model_lock = PTHREAD_MUTEX_INITIALIZER;
+static RNNModel *shared_model = NULL;
+static FILE *model_file = NULL;    // Must stay open while the model is in use.
+static int model_users = 0;
+
+/**
+ * @brief Take a reference on the shared model, loading it for the first user.
+ * @return 1 on success, 0 if RNNOISE_MODEL names a file that cannot be loaded.
+ */
+static int model_acquire(RNNModel **model) {
+    int ok = 1;
+    pthread_mutex_lock(&model_lock);
+    if (model_users == 0) {
+        const char *path = getenv("RNNOISE_MODEL");
+        if (path && *path) {
+            model_file = fopen(path, "rb");
+            shared_model = model_file ? rnnoise_model_from_file(model_file) : NULL;
+            if (!shared_model) {
+                if (model_file) fclose(model_file);
+                model_file = NULL;
+                fprintf(stderr, "rnnoise_lv2: cannot load model %s\n", path);
+                ok = 0;
+            }
+        }
+    }
+    if (ok) {
+        model_users++;
+        *model = shared_model;
+    }
+    pthread_mutex_unlock(&model_lock);
+    return ok;
+}
+
+static void model_release(void) {
+    pthread_mutex_lock(&model_lock);
+    if (--model_users == 0 && shared_model) {
+        rnnoise_model_free(shared_model);
+        fclose(model_file);
+        shared_model = NULL;
+        model_file = NULL;
+    }
+    pthread_mutex_unlock(&model_lock);
+}
+
+static LV2_Handle instantiate(const LV2_Descriptor *descriptor, double rate, const char *bundle_path,
+                              const LV2_Feature *const *features) {
+    (void)descriptor;
+    (void)bundle_path;
+    (void)features;
+    // RNNoise only works at 48kHz; the host has to resample around the plugin.
+    if ((int)rate != SAMPLE_RATE) {
+        fprintf(stderr, "rnnoise_lv2: %.0f Hz is not supported, only %d Hz\n", rate, SAMPLE_RATE);
+        return NULL;
+    }
+
+    Denoiser *d = calloc(1, sizeof(*d));
+    RNNModel *model = NULL;
+    if (!d || !model_acquire(&model)) {
+        free(d);
+        return NULL;
+    }
+    d->core = denoise_core_create(model);
+    if (!d->core) {
+        model_release();
+        free(d);
+        return NULL;
+    }
+    return d;
+}
+
+static void connect_port(LV2_Handle instance, uint32_t port, void *data) {
+    Denoiser *d = instance;
+    switch ((PortIndex)port) {
+        case PORT_INPUT: d->input = data; break;
+        case PORT_OUTPUT: d->output = data; break;
+        case PORT_LATENCY: d->latency = data; break;
+        case PORT_VAD: d->vad = data; break;
+    }
+}
+
+static void activate(LV2_Handle instance) {
+    Denoiser *d = instance;
+    // Start over without allocating: hosts may call this from their audio setup.
+    denoise_core_reset(d->core);
+}
+
+static void run(LV2_Handle instance, uint32_t sample_count) {
+    Denoiser *d = instance;
+    // Input and output may share a buffer; denoise_core allows that.
+    denoise_core_process_float(d->core, d->input, d->output, sample_count);
+    if (d->latency) *d->latency = (float)denoise_core_latency(d->core);
+    if (d->vad) *d->vad = denoise_core_vad(d->core);
+}
+
+static void cleanup(LV2_Handle instance) {
+    Denoiser *d = instance;
+    denoise_core_destroy(d->core);
+    model_release();
+    free(d);
+}
+
+static const void *extension_data(const char *uri) {
+    (void)uri;
+    return NULL;
+}
+
+static const LV2_Descriptor descriptor = {
+    RNNOISE_LV2_URI,
+    instantiate,
+    connect_port,
+    activate,
+    run,
+    NULL,
+    cleanup,
+    extension_data
+};
+
+LV2_SYMBOL_EXPORT const LV2_Descriptor *lv2_descriptor(uint32_t index) {
+    return index == 0 ? &descriptor : NULL;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file
+ * @brief USDT static probes (provider "rnnoise") for bpftrace and perf.
+ *
+ * When <sys/sdt.h> is available (systemtap-sdt-dev, systemtap-sdt-devel),
+ * each probe compiles to a single nop plus an ELF note describing where its
+ * arguments live. Nothing runs until a tracer attaches, which turns the nop
+ * into a breakpoint. Without the header, or with -DRNNOISE_NO_PROBES, the
+ * probes compile to nothing.
+ *
+ * Probes and arguments:
+ *   frame_start(core)              denoise_core: before RNNoise runs on a frame
+ *   frame_done(core, vad_permille) denoise_core: after it
+ *   callback_start(frames)         audio callbacks, on entry
+ *   callback_done(frames)          audio callbacks, on return
+ *   underrun(stream, late_us)      audio device late (stream 0) or an RTP
+ *                                  jitter buffer empty (stream = SSRC)
+ *   engine_fallback(reason)        the offline engine or CPU dispatch took a
+ *                                  slower path; reason is a string
+ *   job_start(input, output)       rnnoise_gui: denoising a file starts
+ *   job_done(frames, ok)           rnnoise_gui: it ended
+ *   file_open(path, writing)       converters and recorders opened a file
+ *   file_close(path, bytes)        and closed it; bytes read or written
+ *                                  (both fired by traced_file.h)
+ *
+ * List them with: readelf -n <binary> | grep -A2 rnnoise
+ * See rnnoise_frames.bt and rnnoise_callbacks.bt for examples.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ */
+
+#ifndef RNNOISE_PROBES_H
+#define RNNOISE_PROBES_H
+
+#if !defined(RNNOISE_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define RNNOISE_HAVE_PROBES 1
+#endif
+#endif
+
+#ifdef RNNOISE_HAVE_PROBES
+
+#include <sys/sdt.h>
+
+#define RNNOISE_PROBE1(name, a) DTRACE_PROBE1(rnnoise, name, a)
+#define RNNOISE_PROBE2(name, a, b) DTRACE_PROBE2(rnnoise, name, a, b)
+
+#else
+
+#define RNNOISE_PROBE1(name, a) ((void)0)
+#define RNNOISE_PROBE2(name, a, b) ((void)0)
+
+#endif
+
+#endif
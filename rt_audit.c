@@ -0,0 +1,301 @@
+/**
+ * @file
+ * @brief Finds allocations, locks and system calls made on the audio thread.
+ *
+ * Linked into a program built with -DRT_AUDIT, the definitions below take
+ * the place of the C library's. Each checks whether the calling thread is
+ * inside RT_AUDIT_ENTER()/RT_AUDIT_LEAVE(), reports the call if it is, and
+ * then forwards to the real function: glibc's __libc_* allocator entry
+ * points, or the next definition found by dlsym(RTLD_NEXT).
+ *
+ * Only calls that go through the dynamic linker are seen: calls made
+ * inside the C library itself (printf's own write) are not.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include "rt_audit.h"
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_REPORTS 20      // Violations printed with a backtrace; later ones are only counted.
+#define MAX_FRAMES 32
+
+// glibc's allocator, callable without dlsym (which itself allocates).
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static __thread int realtime_depth;   // > 0 inside RT_AUDIT_ENTER()/RT_AUDIT_LEAVE().
+static __thread int reporting;        // Set while a report is written, so it is not itself reported.
+static atomic_ulong violations;
+static int abort_on_violation;
+
+static int (*real_mutex_lock)(pthread_mutex_t *);
+static int (*real_cond_wait)(pthread_cond_t *, pthread_mutex_t *);
+static int (*real_cond_timedwait)(pthread_cond_t *, pthread_mutex_t *, const struct timespec *);
+static int (*real_rwlock_rdlock)(pthread_rwlock_t *);
+static int (*real_rwlock_wrlock)(pthread_rwlock_t *);
+static int (*real_sem_wait)(sem_t *);
+static ssize_t (*real_read)(int, void *, size_t);
+static ssize_t (*real_write)(int, const void *, size_t);
+static int (*real_open)(const char *, int, ...);
+static int (*real_openat)(int, const char *, int, ...);
+static int (*real_close)(int);
+static int (*real_poll)(struct pollfd *, nfds_t, int);
+static int (*real_nanosleep)(const struct timespec *, struct timespec *);
+static int (*real_clock_nanosleep)(clockid_t, int, const struct timespec *, struct timespec *);
+static int (*real_usleep)(useconds_t);
+static int (*real_sched_yield)(void);
+static long (*real_syscall)(long, ...);
+
+/**
+ * @brief Look a function up on first use, for calls made before the constructor ran.
+ */
+#define REAL(name, symbol) \
+    (real_##name ? real_##name : (*(void **)&real_##name = dlsym(RTLD_NEXT, symbol), real_##name))
+
+__attribute__((constructor)) static void rt_audit_init(void) {
+    (void)REAL(mutex_lock, "pthread_mutex_lock");
+    (void)REAL(cond_wait, "pthread_cond_wait");
+    (void)REAL(cond_timedwait, "pthread_cond_timedwait");
+    (void)REAL(rwlock_rdlock, "pthread_rwlock_rdlock");
+    (void)REAL(rwlock_wrlock, "pthread_rwlock_wrlock");
+    (void)REAL(sem_wait, "sem_wait");
+    (void)REAL(read, "read");
+    (void)REAL(write, "write");
+    (void)REAL(open, "open");
+    (void)REAL(openat, "openat");
+    (void)REAL(close, "close");
+    (void)REAL(poll, "poll");
+    (void)REAL(nanosleep, "nanosleep");
+    (void)REAL(clock_nanosleep, "clock_nanosleep");
+    (void)REAL(usleep, "usleep");
+    (void)REAL(sched_yield, "sched_yield");
+    (void)REAL(syscall, "syscall");
+
+    const char *env = getenv("RT_AUDIT_ABORT");
+    abort_on_violation = env && atoi(env) != 0;
+
+    // The first backtrace() loads libgcc; do it now rather than on the audio thread.
+    void *frames[2];
+    backtrace(frames, 2);
+}
+
+__attribute__((destructor)) static void rt_audit_summary(void) {
+    unsigned long n = atomic_load(&violations);
+    fprintf(stderr, "rt_audit: %lu call%s on the audio thread\n", n, n == 1 ? "" : "s");
+}
+
+/**
+ * @brief Report a call if the calling thread is in a realtime section.
+ */
+static void check(const char *what) {
+    if (realtime_depth == 0 || reporting) return;
+    reporting = 1;
+    unsigned long n = atomic_fetch_add(&violations, 1) + 1;
+    if (n <= MAX_REPORTS) {
+        char line[128];
+        int length = snprintf(line, sizeof(line), "rt_audit: %s on the audio thread%s\n", what,
+                              n == MAX_REPORTS ? " (further calls are only counted)" : "");
+        REAL(write, "write")(STDERR_FILENO, line, (size_t)length);
+        void *frames[MAX_FRAMES];
+        int depth = backtrace(frames, MAX_FRAMES);
+        // Skip check() and the interposed function.
+        if (depth > 2) backtrace_symbols_fd(frames + 2, depth - 2, STDERR_FILENO);
+    }
+    if (abort_on_violation) abort();
+    reporting = 0;
+}
+
+void rt_audit_enter(void) {
+    realtime_depth++;
+}
+
+void rt_audit_leave(void) {
+    if (realtime_depth > 0) realtime_depth--;
+}
+
+unsigned long rt_audit_violations(void) {
+    return atomic_load(&violations);
+}
+
+/*
+ * Memory allocation.
+ */
+
+void *malloc(size_t size) {
+    check("malloc");
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    check("calloc");
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    check("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    if (ptr) check("free");
+    __libc_free(ptr);
+}
+
+int posix_memalign(void **out, size_t alignment, size_t size) {
+    check("posix_memalign");
+    void *p = __libc_memalign(alignment, size);
+    if (!p) return 12;   // ENOMEM
+    *out = p;
+    return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    check("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+/*
+ * Locks. pthread_mutex_trylock is allowed: it never blocks.
+ */
+
+int pthread_mutex_lock(pthread_mutex_t *mutex) {
+    check("pthread_mutex_lock");
+    return REAL(mutex_lock, "pthread_mutex_lock")(mutex);
+}
+
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex) {
+    check("pthread_cond_wait");
+    return REAL(cond_wait, "pthread_cond_wait")(cond, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *deadline) {
+    check("pthread_cond_timedwait");
+    return REAL(cond_timedwait, "pthread_cond_timedwait")(cond, mutex, deadline);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t *lock) {
+    check("pthread_rwlock_rdlock");
+    return REAL(rwlock_rdlock, "pthread_rwlock_rdlock")(lock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t *lock) {
+    check("pthread_rwlock_wrlock");
+    return REAL(rwlock_wrlock, "pthread_rwlock_wrlock")(lock);
+}
+
+int sem_wait(sem_t *sem) {
+    check("sem_wait");
+    return REAL(sem_wait, "sem_wait")(sem);
+}
+
+/*
+ * System calls.
+ */
+
+ssize_t read(int fd, void *buf, size_t count) {
+    check("read");
+    return REAL(read, "read")(fd, buf, count);
+}
+
+ssize_t write(int fd, const void *buf, size_t count) {
+    check("write");
+    return REAL(write, "write")(fd, buf, count);
+}
+
+int open(const char *path, int flags, ...) {
+    check("open");
+    va_list args;
+    va_start(args, flags);
+    mode_t mode = (flags & (O_CREAT | O_TMPFILE)) ? va_arg(args, mode_t) : 0;
+    va_end(args);
+    return REAL(open, "open")(path, flags, mode);
+}
+
+int openat(int dirfd, const char *path, int flags, ...) {
+    check("openat");
+    va_list args;
+    va_start(args, flags);
+    mode_t mode = (flags & (O_CREAT | O_TMPFILE)) ? va_arg(args, mode_t) : 0;
+    va_end(args);
+    return REAL(openat, "openat")(dirfd, path, flags, mode);
+}
+
+int close(int fd) {
+    check("close");
+    return REAL(close, "close")(fd);
+}
+
+int poll(struct pollfd *fds, nfds_t count, int timeout) {
+    check("poll");
+    return REAL(poll, "poll")(fds, count, timeout);
+}
+
+int nanosleep(const struct timespec *duration, struct timespec *remaining) {
+    check("nanosleep");
+    return REAL(nanosleep, "nanosleep")(duration, remaining);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec *when, struct timespec *remaining) {
+    check("clock_nanosleep");
+    return REAL(clock_nanosleep, "clock_nanosleep")(clock, flags, when, remaining);
+}
+
+int usleep(useconds_t usec) {
+    check("usleep");
+    return REAL(usleep, "usleep")(usec);
+}
+
+int sched_yield(void) {
+    check("sched_yield");
+    return REAL(sched_yield, "sched_yield")();
+}
+
+/**
+ * @brief Raw system calls; GLib's mutexes and condition variables use futex() this way.
+ */
+long syscall(long number, ...) {
+    if (realtime_depth > 0) {
+        char what[32];
+        snprintf(what, sizeof(what), "syscall(%ld)", number);
+        check(what);
+    }
+    va_list args;
+    va_start(args, number);
+    long a[6];
+    for (int i = 0; i < 6; i++) a[i] = va_arg(args, long);
+    va_end(args);
+    return REAL(syscall, "syscall")(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
@@ -0,0 +1,53 @@
+/**
+ * @file
+ * @brief Finds allocations, locks and system calls made on the audio thread.
+ *
+ * Audio callbacks must not allocate, take locks or make blocking system
+ * calls: any of them can stall the thread past its deadline and cause a
+ * dropout. Built with -DRT_AUDIT and rt_audit.c ("make audit"), the
+ * program's malloc family, pthread mutex and condition waits, and common
+ * system calls (read, write, open, poll, sleeps, futex) are interposed.
+ * A call made between RT_AUDIT_ENTER() and RT_AUDIT_LEAVE() on the same
+ * thread is reported on stderr with a backtrace.
+ *
+ * Environment:
+ *   RT_AUDIT_ABORT=1   abort() on the first violation, for a core dump.
+ *
+ * Without RT_AUDIT the macros compile to nothing.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ */
+
+#ifndef RT_AUDIT_H
+#define RT_AUDIT_H
+
+#ifdef RT_AUDIT
+
+/**
+ * @brief Mark the calling thread as running realtime code. Calls nest.
+ */
+void rt_audit_enter(void);
+
+/**
+ * @brief End the section started by rt_audit_enter().
+ */
+void rt_audit_leave(void);
+
+/**
+ * @brief Number of calls flagged so far, on all threads.
+ */
+unsigned long rt_audit_violations(void);
+
+#define RT_AUDIT_ENTER() rt_audit_enter()
+#define RT_AUDIT_LEAVE() rt_audit_leave()
+
+#else
+
+#define RT_AUDIT_ENTER() ((void)0)
+#define RT_AUDIT_LEAVE() ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,243 @@
+/**
+ * @file
+ * @brief Runs the realtime processing path headless, under the rt_audit checker.
+ *
+ * A thread stands in for the audio device and calls a callback shaped like
+ * audio_denoiser's: stereo to mono, denoise_core, a parameter snapshot
+ * from param_rcu, and the VU level stored in an atomic. Meanwhile the main
+ * thread plays the UI, publishing new parameters and polling the level.
+ * Each callback runs between RT_AUDIT_ENTER() and RT_AUDIT_LEAVE(), so any
+ * allocation, lock or system call on that path is reported (see
+ * rt_audit.h), and the run fails.
+ *
+ * No sound card is needed, which makes this usable as a build check
+ * ("make rt-check").
+ *
+ * The callback also records trace events (rt_trace.h), which checks
+ * those too; -t writes the trace at the end.
+ *
+ * Usage: rt_sim [-b blocks] [-p frames] [-r] [-m] [-t trace.json]
+ *   -b  callbacks to run (default 3000)
+ *   -p  frames per callback (default 480)
+ *   -r  random callback sizes from 1 to 4 * the -p size
+ *   -m  allocate in the callback, to check that the auditor notices
+ *   -t  write the trace of the run to this file
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "denoise_core.h"
+#include "param_rcu.h"
+#include "rt_audit.h"
+#include "rt_trace.h"
+
+#ifndef RT_AUDIT
+#error "rt_sim must be built with -DRT_AUDIT and rt_audit.c"
+#endif
+
+#define FRAME_SIZE DENOISE_CORE_FRAME
+#define WARM_UP_FRAMES 50
+
+/**
+ * @brief Parameters the "UI" publishes, as in audio_denoiser.
+ */
+typedef struct {
+    int denoise;
+    float gain;
+} SimParams;
+
+/**
+ * @brief What the audio callback sees, as AppState does in the GUI tools.
+ */
+typedef struct {
+    DenoiseCore *denoiser;
+    ParamRcu *params;
+    _Atomic float vu_level;
+    atomic_int done;
+
+    int blocks;
+    int period;
+    int random_periods;
+    int allocate;                 // -m: misbehave on purpose.
+
+    int16_t *input;               // Stereo, 4 * period frames.
+    int16_t *output;
+    long frames;
+} Sim;
+
+/**
+ * @brief One audio callback: the same steps as audio_denoiser's duplex_callback.
+ */
+static void callback(Sim *sim, int16_t *out, const int16_t *in, int frame_count) {
+    RT_AUDIT_ENTER();
+    rt_trace_begin("callback");
+    const SimParams *params = param_rcu_read(sim->params);
+    int16_t mono[FRAME_SIZE];
+    int16_t clean[FRAME_SIZE];
+    float energy = 0.0f;
+
+    for (int i = 0; i < frame_count; i += FRAME_SIZE) {
+        int count = frame_count - i > FRAME_SIZE ? FRAME_SIZE : frame_count - i;
+        for (int j = 0; j < count; j++) {
+            int32_t l = in[(i + j) * 2];
+            int32_t r = in[(i + j) * 2 + 1];
+            mono[j] = (int16_t)((l + r) / 2);
+            energy += (float)mono[j] * mono[j];
+        }
+        rt_trace_begin("denoise");
+        denoise_core_process_s16(sim->denoiser, mono, clean, (size_t)count);
+        rt_trace_end("denoise");
+        const int16_t *src = params->denoise ? clean : mono;
+        for (int j = 0; j < count; j++) {
+            float v = src[j] * params->gain;
+            int16_t s = (int16_t)fmaxf(-32768.0f, fminf(32767.0f, v));
+            out[(i + j) * 2] = s;
+            out[(i + j) * 2 + 1] = s;
+        }
+    }
+    if (sim->allocate) {
+        void *volatile p = malloc(64);   // volatile: the compiler may drop an unused malloc.
+        free(p);
+    }
+
+    float level = frame_count > 0 ? sqrtf(energy / frame_count) / 32768.0f : 0.0f;
+    atomic_store_explicit(&sim->vu_level, level, memory_order_relaxed);
+    rt_trace_counter("input level", 0, (long long)(level * 1000.0f));
+    rt_trace_end("callback");
+    RT_AUDIT_LEAVE();
+}
+
+/**
+ * @brief The "audio device" thread.
+ */
+static void *audio_thread(void *arg) {
+    Sim *sim = arg;
+    unsigned int seed = 1;
+    rt_trace_thread_name("audio");
+    for (int b = 0; b < sim->blocks; b++) {
+        int frames = sim->random_periods ? 1 + (int)(rand_r(&seed) % (unsigned)(4 * sim->period)) : sim->period;
+        callback(sim, sim->output, sim->input, frames);
+        sim->frames += frames;
+    }
+    atomic_store_explicit(&sim->done, 1, memory_order_release);
+    return NULL;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-b blocks] [-p frames] [-r] [-m] [-t trace.json]\n"
+            "  -b  callbacks to run (default 3000)\n"
+            "  -p  frames per callback (default 480)\n"
+            "  -r  random callback sizes, 1 to 4 * frames\n"
+            "  -m  allocate in the callback (checks the checker)\n"
+            "  -t  write the trace of the run to this file\n",
+            prog);
+}
+
+/**
+ * @brief Main entry point.
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return 0 if the callback made no forbidden calls, 1 otherwise.
+ */
+int main(int argc, char *argv[]) {
+    Sim sim = {0};
+    sim.blocks = 3000;
+    sim.period = 480;
+    const char *trace_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:p:rmt:h")) != -1) {
+        switch (opt) {
+            case 'b': sim.blocks = atoi(optarg); break;
+            case 'p': sim.period = atoi(optarg); break;
+            case 'r': sim.random_periods = 1; break;
+            case 'm': sim.allocate = 1; break;
+            case 't': trace_path = optarg; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (sim.blocks < 1 || sim.period < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Everything is allocated and warmed up before the audio thread starts,
+    // as prepare_pipeline() does in the GUI tools.
+    size_t samples = (size_t)4 * sim.period * 2;
+    sim.input = malloc(samples * sizeof(int16_t));
+    sim.output = malloc(samples * sizeof(int16_t));
+    sim.denoiser = denoise_core_create(NULL);
+    SimParams ui = {1, 1.0f};
+    sim.params = param_rcu_create(&ui, sizeof(ui));
+    if (!sim.input || !sim.output || !sim.denoiser || !sim.params) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    denoise_core_warm_up(sim.denoiser, WARM_UP_FRAMES);
+
+    // Speech-level noise with a 440 Hz tone, the same on both channels.
+    srand(1);
+    for (size_t i = 0; i < samples / 2; i++) {
+        float v = 4000.0f * sinf(2.0f * (float)M_PI * 440.0f * i / 48000.0f) + (float)(rand() % 4096 - 2048);
+        sim.input[i * 2] = sim.input[i * 2 + 1] = (int16_t)v;
+    }
+
+    rt_trace_thread_name("ui");
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, audio_thread, &sim) != 0) {
+        fprintf(stderr, "Cannot start the audio thread\n");
+        return 1;
+    }
+
+    // The "UI": toggle the denoiser and move the gain while audio runs.
+    int updates = 0;
+    float level = 0.0f;
+    while (!atomic_load_explicit(&sim.done, memory_order_acquire)) {
+        ui.denoise = !ui.denoise;
+        ui.gain = 0.5f + (updates % 10) / 10.0f;
+        if (param_rcu_publish(sim.params, &ui)) updates++;
+        rt_trace_instant("parameters", updates);
+        level = atomic_load_explicit(&sim.vu_level, memory_order_relaxed);
+        struct timespec pause = {0, 1000000};
+        nanosleep(&pause, NULL);
+    }
+    pthread_join(thread, NULL);
+    param_rcu_offline(sim.params);
+
+    unsigned long violations = rt_audit_violations();
+    printf("rt_sim: %d callbacks, %ld frames, %d parameter updates, last level %.3f\n",
+           sim.blocks, sim.frames, updates, level);
+    if (trace_path && !rt_trace_dump(trace_path, "rt_sim")) fprintf(stderr, "Cannot write %s\n", trace_path);
+    printf("rt_sim: %s\n", violations ? "FAILED: forbidden calls on the audio thread" : "OK");
+
+    param_rcu_destroy(sim.params);
+    denoise_core_destroy(sim.denoiser);
+    free(sim.input);
+    free(sim.output);
+    return violations ? 1 : 0;
+}
@@ -0,0 +1,285 @@
+/**
+ * @file
+ * @brief Per-thread event trace for the real-time paths, dumped as Chrome JSON.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include "rt_trace.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define EVENT_MASK (RT_TRACE_EVENTS - 1)
+#define DUMP_INTERVAL_NS 1000000000LL   // At most one dump per second.
+
+/**
+ * @brief One event. Fields are relaxed atomics so a dump may read a ring
+ * while its thread writes it; torn events are dropped (see copy_ring()).
+ */
+typedef struct {
+    atomic_ullong ts_ns;
+    _Atomic(const char *) name;
+    atomic_llong value;
+    atomic_ullong meta;           // Phase in the low byte, id above it.
+} Event;
+
+enum { RING_FREE, RING_OWNED, RING_RELEASED };
+
+/**
+ * @brief A thread's ring. Only the owning thread writes it.
+ */
+typedef struct {
+    atomic_ullong head;           // Events recorded so far.
+    atomic_ullong first;          // Events before it belong to an earlier owner.
+    atomic_int owner;             // RING_FREE, RING_OWNED or RING_RELEASED.
+    atomic_int named;
+    char name[32];
+    Event events[RT_TRACE_EVENTS];
+} Ring;
+
+/**
+ * @brief A plain copy of an event, taken by the dumping thread.
+ */
+typedef struct {
+    unsigned long long ts_ns;
+    const char *name;
+    long long value;
+    unsigned long long meta;
+} Snapshot;
+
+static Ring rings[RT_TRACE_THREADS];   // Untouched pages cost no memory.
+static atomic_int ring_count;
+static __thread Ring *own_ring;
+static __thread int untraced;          // No ring was left for this thread.
+static pthread_key_t ring_key;         // Releases a thread's ring when it exits.
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+
+static _Atomic(const char *) pending_reason;
+static long long last_dump_ns;         // Dumping thread only.
+static int dump_count;
+
+static void release_ring(void *ring) {
+    Ring *r = ring;
+    atomic_store_explicit(&r->owner, RING_RELEASED, memory_order_release);
+}
+
+static void create_ring_key(void) {
+    pthread_key_create(&ring_key, release_ring);
+}
+
+/**
+ * @brief Take a ring for the calling thread: one released by a thread that
+ * has exited, or the next unused one. Lock-free.
+ */
+static Ring *claim_ring(void) {
+    if (untraced) return NULL;
+    pthread_once(&ring_key_once, create_ring_key);
+    Ring *r = NULL;
+    int count = atomic_load_explicit(&ring_count, memory_order_relaxed);
+    if (count > RT_TRACE_THREADS) count = RT_TRACE_THREADS;
+    for (int i = 0; i < count && !r; i++) {
+        int released = RING_RELEASED;
+        if (atomic_compare_exchange_strong_explicit(&rings[i].owner, &released, RING_OWNED, memory_order_acquire,
+                                                    memory_order_relaxed)) {
+            r = &rings[i];
+            // Hide the earlier owner's events and name from dumps.
+            atomic_store_explicit(&r->named, 0, memory_order_relaxed);
+            atomic_store_explicit(&r->first, atomic_load_explicit(&r->head, memory_order_relaxed),
+                                  memory_order_release);
+        }
+    }
+    if (!r) {
+        int index = atomic_fetch_add_explicit(&ring_count, 1, memory_order_relaxed);
+        if (index >= RT_TRACE_THREADS) {
+            untraced = 1;
+            return NULL;
+        }
+        r = &rings[index];
+        atomic_store_explicit(&r->owner, RING_OWNED, memory_order_relaxed);
+    }
+    pthread_setspecific(ring_key, r);
+    own_ring = r;
+    return r;
+}
+
+long long rt_trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void rt_trace_event(char phase, const char *name, unsigned id, long long value) {
+    Ring *r = own_ring ? own_ring : claim_ring();
+    if (!r) return;
+    unsigned long long head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    Event *e = &r->events[head & EVENT_MASK];
+    atomic_store_explicit(&e->ts_ns, (unsigned long long)rt_trace_now_ns(), memory_order_relaxed);
+    atomic_store_explicit(&e->name, name, memory_order_relaxed);
+    atomic_store_explicit(&e->value, value, memory_order_relaxed);
+    atomic_store_explicit(&e->meta, (unsigned char)phase | (unsigned long long)id << 8, memory_order_relaxed);
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+void rt_trace_thread_name(const char *name) {
+    Ring *r = own_ring ? own_ring : claim_ring();
+    if (!r || atomic_load_explicit(&r->named, memory_order_relaxed)) return;
+    strncpy(r->name, name, sizeof(r->name) - 1);
+    atomic_store_explicit(&r->named, 1, memory_order_release);
+}
+
+void rt_trace_request_dump(const char *reason) {
+    atomic_store_explicit(&pending_reason, reason, memory_order_relaxed);
+}
+
+static void on_dump_signal(int sig) {
+    (void)sig;
+    rt_trace_request_dump("signal");
+}
+
+void rt_trace_dump_on_signal(int sig) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_dump_signal;
+    sa.sa_flags = SA_RESTART;
+    sigaction(sig, &sa, NULL);
+}
+
+/**
+ * @brief Write a JSON string.
+ */
+static void write_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if (c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+/**
+ * @brief Copy the events of a ring that are still intact, oldest first.
+ *
+ * The owner may be recording meanwhile: events it could have overwritten
+ * during the copy (those more than RT_TRACE_EVENTS behind its head
+ * afterwards) are dropped.
+ *
+ * @return Number of events copied to out.
+ */
+static size_t copy_ring(Ring *r, Snapshot *out) {
+    unsigned long long first = atomic_load_explicit(&r->first, memory_order_acquire);
+    unsigned long long end = atomic_load_explicit(&r->head, memory_order_acquire);
+    unsigned long long start = end > RT_TRACE_EVENTS ? end - RT_TRACE_EVENTS : 0;
+    if (start < first) start = first;
+    if (start >= end) return 0;
+    for (unsigned long long i = start; i < end; i++) {
+        Event *e = &r->events[i & EVENT_MASK];
+        Snapshot *s = &out[i - start];
+        s->ts_ns = atomic_load_explicit(&e->ts_ns, memory_order_relaxed);
+        s->name = atomic_load_explicit(&e->name, memory_order_relaxed);
+        s->value = atomic_load_explicit(&e->value, memory_order_relaxed);
+        s->meta = atomic_load_explicit(&e->meta, memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_acquire);
+    unsigned long long after = atomic_load_explicit(&r->head, memory_order_relaxed);
+    unsigned long long intact = after > RT_TRACE_EVENTS ? after - RT_TRACE_EVENTS : 0;
+    if (intact >= end) return 0;
+    if (intact > start) {
+        memmove(out, out + (intact - start), (size_t)(end - intact) * sizeof(Snapshot));
+        start = intact;
+    }
+    return (size_t)(end - start);
+}
+
+int rt_trace_dump(const char *path, const char *reason) {
+    Snapshot *events = malloc(RT_TRACE_EVENTS * sizeof(Snapshot));
+    FILE *f = events ? fopen(path, "w") : NULL;
+    if (!f) {
+        free(events);
+        return 0;
+    }
+    int pid = (int)getpid();
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"otherData\":{\"reason\":", f);
+    write_string(f, reason ? reason : "request");
+    fprintf(f, "},\"traceEvents\":[\n{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":", pid);
+    write_string(f, program_invocation_short_name);
+    fputs("}}", f);
+
+    int count = atomic_load_explicit(&ring_count, memory_order_relaxed);
+    if (count > RT_TRACE_THREADS) count = RT_TRACE_THREADS;
+    for (int t = 0; t < count; t++) {
+        Ring *r = &rings[t];
+        int tid = t + 1;
+        if (atomic_load_explicit(&r->named, memory_order_acquire)) {
+            fprintf(f, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", pid, tid);
+            write_string(f, r->name);
+            fputs("}}", f);
+        }
+        size_t n = copy_ring(r, events);
+        for (size_t i = 0; i < n; i++) {
+            const Snapshot *e = &events[i];
+            char phase = (char)(e->meta & 0xff);
+            unsigned id = (unsigned)(e->meta >> 8);
+            fprintf(f, ",\n{\"ph\":\"%c\",\"name\":", phase);
+            write_string(f, e->name ? e->name : "?");
+            fprintf(f, ",\"pid\":%d,\"tid\":%d,\"ts\":%.3f", pid, tid, e->ts_ns / 1000.0);
+            if (phase == RT_TRACE_INSTANT) fputs(",\"s\":\"t\"", f);
+            if (phase == RT_TRACE_COUNTER && id) fprintf(f, ",\"id\":\"%u\"", id);
+            if (phase == RT_TRACE_INSTANT || phase == RT_TRACE_COUNTER) {
+                fprintf(f, ",\"args\":{\"value\":%lld}", e->value);
+            }
+            fputc('}', f);
+        }
+    }
+    fputs("\n]}\n", f);
+    free(events);
+    int ok = !ferror(f);
+    return fclose(f) == 0 && ok;
+}
+
+int rt_trace_dump_pending(char *path, size_t size) {
+    if (!atomic_load_explicit(&pending_reason, memory_order_relaxed)) return 0;
+    long long now = rt_trace_now_ns();
+    if (last_dump_ns && now - last_dump_ns < DUMP_INTERVAL_NS) return 0;
+    const char *reason = atomic_exchange_explicit(&pending_reason, NULL, memory_order_relaxed);
+    if (!reason) return 0;
+
+    const char *dir = getenv("RT_TRACE_DIR");
+    if (!dir || !*dir) dir = getenv("TMPDIR");
+    if (!dir || !*dir) dir = "/tmp";
+    char file[4096];
+    snprintf(file, sizeof(file), "%s/%s-trace-%d-%d.json", dir, program_invocation_short_name, (int)getpid(),
+             ++dump_count);
+    last_dump_ns = now;
+    if (!rt_trace_dump(file, reason)) {
+        fprintf(stderr, "Cannot write trace %s: %s\n", file, strerror(errno));
+        return 0;
+    }
+    if (path && size > 0) snprintf(path, size, "%s", file);
+    return 1;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file
+ * @brief Per-thread event trace for the real-time paths, dumped as Chrome JSON.
+ *
+ * Each thread that records an event gets its own ring of the last
+ * RT_TRACE_EVENTS events, taken from a static table: recording never
+ * allocates, locks or makes a system call, only a clock read (vDSO) and a
+ * few stores, so it is safe in audio callbacks and always on. The rings are
+ * a flight recorder: when something goes wrong (a dropout, a signal), the
+ * last few seconds of every thread are written out with rt_trace_dump() and
+ * can be opened in chrome://tracing or ui.perfetto.dev.
+ *
+ * A thread's ring is released when the thread exits and handed to the next
+ * thread that starts recording; until then, dumps still show the exited
+ * thread's events.
+ *
+ * The audio thread must not write files, so it calls rt_trace_request_dump()
+ * and a normal thread (the UI, a main loop) writes the file from
+ * rt_trace_dump_pending().
+ *
+ * Event names must be string literals (or otherwise live forever): only
+ * the pointer is stored.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ */
+
+#ifndef RT_TRACE_H
+#define RT_TRACE_H
+
+#include <stddef.h>
+
+#define RT_TRACE_THREADS 80       // Threads that can record at once; later ones are not traced.
+#define RT_TRACE_EVENTS 4096      // Events kept per thread (power of two).
+
+#define RT_TRACE_BEGIN 'B'        // Start of a span on this thread.
+#define RT_TRACE_END 'E'          // End of the innermost span.
+#define RT_TRACE_INSTANT 'i'      // A point event, with a value.
+#define RT_TRACE_COUNTER 'C'      // A level (buffer fill, delay), drawn as a graph.
+
+/**
+ * @brief Record one event on the calling thread's ring.
+ * @param phase RT_TRACE_BEGIN, RT_TRACE_END, RT_TRACE_INSTANT or RT_TRACE_COUNTER.
+ * @param name Event name; a string literal.
+ * @param id Separates counters of the same name, e.g. one per stream; 0 for none.
+ * @param value Counter value or instant argument.
+ */
+void rt_trace_event(char phase, const char *name, unsigned id, long long value);
+
+static inline void rt_trace_begin(const char *name) {
+    rt_trace_event(RT_TRACE_BEGIN, name, 0, 0);
+}
+
+static inline void rt_trace_end(const char *name) {
+    rt_trace_event(RT_TRACE_END, name, 0, 0);
+}
+
+static inline void rt_trace_instant(const char *name, long long value) {
+    rt_trace_event(RT_TRACE_INSTANT, name, 0, value);
+}
+
+static inline void rt_trace_counter(const char *name, unsigned id, long long value) {
+    rt_trace_event(RT_TRACE_COUNTER, name, id, value);
+}
+
+/**
+ * @brief Name the calling thread in dumps ("audio", "ui", ...). Copies the name.
+ */
+void rt_trace_thread_name(const char *name);
+
+/**
+ * @brief The trace clock (CLOCK_MONOTONIC) in nanoseconds.
+ */
+long long rt_trace_now_ns(void);
+
+/**
+ * @brief Ask for a dump (any thread, also audio callbacks and signal handlers).
+ * @param reason Why, recorded in the file; a string literal.
+ */
+void rt_trace_request_dump(const char *reason);
+
+/**
+ * @brief Call rt_trace_request_dump("signal") on this signal, e.g. SIGUSR2.
+ */
+void rt_trace_dump_on_signal(int sig);
+
+/**
+ * @brief Write the requested dump, if any (not from the audio thread).
+ *
+ * Dumps are spaced at least a second apart, so a burst of dropouts gives
+ * one file. The file is $RT_TRACE_DIR (or $TMPDIR, or /tmp) /
+ * <program>-trace-<pid>-<n>.json.
+ *
+ * @param path Receives the file name, may be NULL.
+ * @param size Size of path.
+ * @return 1 if a file was written, 0 if none was due or writing failed.
+ */
+int rt_trace_dump_pending(char *path, size_t size);
+
+/**
+ * @brief Write every thread's events to a Chrome trace JSON file now.
+ * @param path Output file.
+ * @param reason Recorded in the file, may be NULL.
+ * @return 1 on success, 0 if the file could not be written.
+ */
+int rt_trace_dump(const char *path, const char *reason);
+
+#endif
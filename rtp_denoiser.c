@@ -0,0 +1,1000 @@
+/**
+ * @file
+ * @brief Denoise live RTP streams (L16, 48kHz mono) received over UDP.
+ *
+ * Each RTP stream (one SSRC from one address) gets its own jitter buffer and
+ * RNNoise state. Packets of any size are written into the jitter buffer by
+ * timestamp; a 10ms clock plays it out in 480-sample frames, which are
+ * denoised and sent on as RTP with the same SSRC and payload type.
+ * Outgoing timestamps follow the incoming ones, shifted by any frames the
+ * jitter buffer inserted or skipped. Frames that never arrived are concealed by repeating the last
+ * good frame at a decaying gain.
+ *
+ * The playout delay adapts to the measured interarrival jitter (RFC 3550):
+ * when the buffer runs dry a concealed frame is inserted without advancing
+ * (the delay grows); when it holds much more than needed a quiet frame is
+ * skipped (the delay shrinks).
+ *
+ * Streams are spread over -t threads, each with its own SO_REUSEPORT socket
+ * and epoll loop, so the kernel keeps every stream on one thread. Per-stream
+ * loss, jitter, latency and processing time are printed every -s seconds,
+ * on SIGUSR1 and when a stream ends. Each thread keeps its streams'
+ * denoisers side by side in its own arena (denoise_arena.h), and reports the
+ * arena's memory use alongside them.
+ *
+ * Every thread records its ticks, frames and jitter buffer levels in a
+ * trace (rt_trace.h). SIGUSR2, or a thread stalling for more than 100ms,
+ * writes the recent events as a Chrome trace to $RT_TRACE_DIR or /tmp.
+ *
+ * The same program can also act as a test sender (-S) and receiver (-R):
+ *   rtp_denoiser -R 5006 -o out            writes out.<ssrc>.wav per stream
+ *   rtp_denoiser -l 5004 -d 127.0.0.1:5006
+ *   rtp_denoiser -S input.wav -d 127.0.0.1:5004 -n 8 -L 2 -J 30
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "denoise_arena.h"
+#include "denoise_core.h"
+#include "rnnoise_probes.h"
+#include "rt_trace.h"
+
+#define FRAME_SIZE 480     // RNNoise frame size (10ms at 48kHz).
+#define SAMPLE_RATE 48000  // Expected sample rate for RNNoise.
+
+#define MAX_THREADS 64
+#define RTP_HEADER 12
+#define MAX_PACKET 4096           // Largest datagram handled (40ms of L16).
+#define MAX_PACKET_FRAMES 4       // Outgoing packet size limit, in 10ms frames.
+#define RECV_BATCH 32             // Datagrams per recvmmsg call.
+#define JB_SAMPLES 32768          // Jitter buffer size (680ms, a power of two).
+#define JB_MASK (JB_SAMPLES - 1)
+#define JITTER_FACTOR 3.0         // Target delay in multiples of the jitter estimate.
+#define MAX_CONCEALED 10          // Frames concealed in a row before playout pauses.
+#define PLC_DECAY 0.7f            // Gain applied per concealed frame.
+#define QUIET_LEVEL 300.0f        // RMS below which a frame may be skipped to cut delay.
+#define STREAM_BUCKETS 256
+#define STREAM_IDLE_SECONDS 5.0   // Streams silent this long are closed.
+
+/**
+ * @brief Struct representing the WAV file header.
+ */
+typedef struct {
+    char riff[4];                  // "RIFF"
+    uint32_t file_size;            // Total file size minus 8 bytes
+    char wave[4];                  // "WAVE"
+    char fmt[4];                   // "fmt "
+    uint32_t fmt_size;             // Format chunk size (usually 16)
+    uint16_t format;               // Audio format (1 = PCM)
+    uint16_t channels;             // Number of audio channels
+    uint32_t sample_rate;          // Sampling rate (Hz)
+    uint32_t byte_rate;            // Bytes per second
+    uint16_t block_align;          // Block alignment (bytes per sample frame)
+    uint16_t bits_per_sample;      // Bits per sample (usually 16)
+    char data[4];                  // "data"
+    uint32_t data_size;            // Size of audio data in bytes
+} WavHeader;
+
+/**
+ * @brief The fields of an RTP packet the program uses.
+ */
+typedef struct {
+    int marker;
+    uint8_t payload_type;
+    uint16_t seq;
+    uint32_t ts;
+    uint32_t ssrc;
+    const uint8_t *payload;
+    size_t payload_len;
+} RtpPacket;
+
+/**
+ * @brief One incoming stream and its denoised counterpart.
+ */
+typedef struct Stream {
+    struct Stream *next;           // Hash bucket chain.
+    uint32_t ssrc;
+    struct sockaddr_in from;
+    uint8_t payload_type;
+    DenoiseCore *core;
+
+    // Jitter buffer, indexed by RTP timestamp.
+    int16_t pcm[JB_SAMPLES];
+    uint8_t have[JB_SAMPLES];
+    uint32_t cursor;               // Timestamp of the next sample to play.
+    uint32_t newest;               // Timestamp just past the newest sample received.
+    int playing;
+    double play_start;             // When the current playout run started.
+    uint64_t run_frames;           // Frames played in the current run.
+    int target;                    // Playout delay aimed for, in samples.
+    int32_t ts_offset;             // Outgoing minus incoming timestamps; moves when frames are
+                                   // stretched or skipped so outgoing timestamps stay continuous.
+
+    // Interarrival jitter (RFC 3550 section 6.4.1), in samples.
+    double jitter;
+    double last_transit;
+    int have_transit;
+
+    // Sequence numbers for the loss count (RFC 3550 appendix A.1).
+    uint16_t max_seq;
+    uint32_t cycles;
+    uint32_t base_seq;
+
+    // Concealment.
+    int16_t last_frame[FRAME_SIZE];
+    int concealed_run;
+
+    // Outgoing packet being filled.
+    uint8_t out[RTP_HEADER + MAX_PACKET_FRAMES * FRAME_SIZE * 2];
+    int out_frames;
+    uint32_t out_ts;
+    uint16_t out_seq;
+    int out_marker;
+
+    // Stats.
+    uint64_t received;
+    uint64_t late;
+    uint64_t concealed;            // Frames made up (lost or buffer empty).
+    uint64_t stretched;            // Concealed frames that grew the delay.
+    uint64_t skipped;              // Frames dropped to cut the delay.
+    uint64_t sent;
+    uint64_t processed;
+    double process_seconds;
+    double process_max;
+    double first_seen;
+    double last_seen;
+} Stream;
+
+/**
+ * @brief A processing thread: one socket, one epoll loop, its own streams.
+ */
+typedef struct {
+    int index;
+    int sock;
+    int timer;
+    int epoll;
+    Stream *buckets[STREAM_BUCKETS];
+    int stream_count;
+    DenoiseArena *arena;       // This thread's denoisers.
+    unsigned long stats_seen;
+    double next_stats;
+} Worker;
+
+static int listen_port = 5004;
+static struct sockaddr_in destination;   // Where denoised streams go; port 0 replies to the sender.
+static int frames_per_packet = 1;        // 10ms (972 bytes) fits an Ethernet MTU; 20ms does not.
+static int min_delay = 2 * FRAME_SIZE;   // Playout delay bounds, in samples.
+static int max_delay = 20 * FRAME_SIZE;
+static double stats_seconds = 10.0;
+
+static volatile sig_atomic_t stop_requested = 0;
+static volatile sig_atomic_t stats_requests = 0;
+
+static void on_stop_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static void on_stats_signal(int sig) {
+    (void)sig;
+    stats_requests++;
+}
+
+/**
+ * @brief Monotonic clock in seconds.
+ */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Parse "host:port" into an IPv4 address.
+ * @return 1 on success, 0 otherwise.
+ */
+static int parse_address(const char *text, struct sockaddr_in *addr) {
+    char host[256];
+    const char *colon = strrchr(text, ':');
+    if (!colon || (size_t)(colon - text) >= sizeof(host)) return 0;
+    memcpy(host, text, (size_t)(colon - text));
+    host[colon - text] = '\0';
+
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host, colon + 1, &hints, &res) != 0) return 0;
+    memcpy(addr, res->ai_addr, sizeof(*addr));
+    freeaddrinfo(res);
+    return 1;
+}
+
+/**
+ * @brief Parse an RTP packet.
+ * @return 1 if it is a usable RTP packet, 0 otherwise.
+ */
+static int parse_rtp(const uint8_t *data, size_t len, RtpPacket *p) {
+    if (len < RTP_HEADER || (data[0] >> 6) != 2) return 0;
+    size_t offset = RTP_HEADER + 4 * (size_t)(data[0] & 0x0f);
+    if (data[0] & 0x10) {
+        // Header extension: 16-bit profile, 16-bit length in words.
+        if (len < offset + 4) return 0;
+        offset += 4 + 4 * (size_t)((data[offset + 2] << 8) | data[offset + 3]);
+    }
+    size_t padding = (data[0] & 0x20) ? data[len - 1] : 0;
+    if (len < offset + padding) return 0;
+
+    p->marker = data[1] >> 7;
+    p->payload_type = data[1] & 0x7f;
+    p->seq = (uint16_t)((data[2] << 8) | data[3]);
+    p->ts = ((uint32_t)data[4] << 24) | ((uint32_t)data[5] << 16) | ((uint32_t)data[6] << 8) | data[7];
+    p->ssrc = ((uint32_t)data[8] << 24) | ((uint32_t)data[9] << 16) | ((uint32_t)data[10] << 8) | data[11];
+    p->payload = data + offset;
+    p->payload_len = (len - offset - padding) & ~(size_t)1;
+    return 1;
+}
+
+static void write_rtp_header(uint8_t *out, int marker, uint8_t payload_type, uint16_t seq, uint32_t ts,
+                             uint32_t ssrc) {
+    out[0] = 0x80;
+    out[1] = (uint8_t)((marker ? 0x80 : 0) | (payload_type & 0x7f));
+    out[2] = (uint8_t)(seq >> 8);
+    out[3] = (uint8_t)seq;
+    out[4] = (uint8_t)(ts >> 24);
+    out[5] = (uint8_t)(ts >> 16);
+    out[6] = (uint8_t)(ts >> 8);
+    out[7] = (uint8_t)ts;
+    out[8] = (uint8_t)(ssrc >> 24);
+    out[9] = (uint8_t)(ssrc >> 16);
+    out[10] = (uint8_t)(ssrc >> 8);
+    out[11] = (uint8_t)ssrc;
+}
+
+/*
+ * Denoiser.
+ */
+
+static int stream_bucket(uint32_t ssrc) {
+    return (int)((ssrc * 2654435761u) >> 24) & (STREAM_BUCKETS - 1);
+}
+
+static Stream *find_stream(Worker *w, const RtpPacket *p, const struct sockaddr_in *from) {
+    for (Stream *s = w->buckets[stream_bucket(p->ssrc)]; s; s = s->next) {
+        if (s->ssrc == p->ssrc && s->from.sin_addr.s_addr == from->sin_addr.s_addr &&
+            s->from.sin_port == from->sin_port) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+static Stream *new_stream(Worker *w, const RtpPacket *p, const struct sockaddr_in *from, double now) {
+    Stream *s = calloc(1, sizeof(Stream));
+    if (!s) return NULL;
+    s->core = denoise_arena_get(w->arena);
+    if (!s->core) {
+        free(s);
+        return NULL;
+    }
+    s->ssrc = p->ssrc;
+    s->from = *from;
+    s->payload_type = p->payload_type;
+    s->target = min_delay;
+    s->max_seq = p->seq;
+    s->base_seq = p->seq;
+    s->out_seq = (uint16_t)rand();
+    s->out_marker = 1;
+    s->first_seen = now;
+
+    int b = stream_bucket(p->ssrc);
+    s->next = w->buckets[b];
+    w->buckets[b] = s;
+    w->stream_count++;
+    return s;
+}
+
+/**
+ * @brief Format a stream's counters on one line.
+ */
+static void print_stream(const Worker *w, const Stream *s, const char *what) {
+    uint32_t extended = s->cycles + s->max_seq;
+    long long expected = (long long)extended - s->base_seq + 1;
+    long long lost = expected - (long long)s->received;
+    if (lost < 0) lost = 0;
+    int buffered = s->playing ? (int32_t)(s->newest - s->cursor) : 0;
+    if (buffered < 0) buffered = 0;
+    // Buffer delay, RNNoise's one-frame delay, and packetization.
+    double latency_ms = (buffered + FRAME_SIZE + frames_per_packet * FRAME_SIZE) * 1000.0 / SAMPLE_RATE;
+    char from[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &s->from.sin_addr, from, sizeof(from));
+    fprintf(stderr,
+            "[%d] %s ssrc %08x from %s:%d: %llu packets, %lld lost (%.2f%%), %llu late, jitter %.1f ms, "
+            "delay %.0f ms (target %.0f ms), latency %.0f ms, %llu concealed (%llu stretched), %llu skipped, "
+            "%llu sent, %.1f us/frame (max %.1f)\n",
+            w->index, what, s->ssrc, from, ntohs(s->from.sin_port), (unsigned long long)s->received, lost,
+            expected > 0 ? 100.0 * lost / expected : 0.0, (unsigned long long)s->late,
+            s->jitter * 1000.0 / SAMPLE_RATE, buffered * 1000.0 / SAMPLE_RATE, s->target * 1000.0 / SAMPLE_RATE,
+            latency_ms, (unsigned long long)s->concealed, (unsigned long long)s->stretched,
+            (unsigned long long)s->skipped, (unsigned long long)s->sent,
+            s->processed ? s->process_seconds * 1e6 / s->processed : 0.0, s->process_max * 1e6);
+}
+
+/**
+ * @brief Print the memory held by a thread's denoisers.
+ */
+static void print_arena(const Worker *w) {
+    DenoiseArenaStats stats;
+    denoise_arena_stats(w->arena, &stats);
+    fprintf(stderr, "[%d] Arena: %zu streams, %zu bytes/stream, %zu slots in %zu chunks (%.1f MiB reserved)\n",
+            w->index, stats.in_use, stats.slot_bytes, stats.capacity, stats.chunks,
+            stats.reserved_bytes / (1024.0 * 1024.0));
+}
+
+static void free_stream(Worker *w, Stream *s) {
+    int b = stream_bucket(s->ssrc);
+    for (Stream **link = &w->buckets[b]; *link; link = &(*link)->next) {
+        if (*link == s) {
+            *link = s->next;
+            break;
+        }
+    }
+    w->stream_count--;
+    denoise_arena_put(w->arena, s->core);
+    free(s);
+}
+
+/**
+ * @brief Update the sequence number and jitter statistics for a packet.
+ */
+static void track_packet(Stream *s, const RtpPacket *p, double now) {
+    s->received++;
+    uint16_t delta = (uint16_t)(p->seq - s->max_seq);
+    if (delta < 0x8000) {
+        if (p->seq < s->max_seq) s->cycles += 0x10000;
+        s->max_seq = p->seq;
+    }
+
+    double transit = now * SAMPLE_RATE - p->ts;
+    if (s->have_transit) {
+        double d = fabs(transit - s->last_transit);
+        // Ignore timestamp jumps (a new talk spurt or a sender restart).
+        if (d < SAMPLE_RATE) s->jitter += (d - s->jitter) / 16.0;
+    }
+    s->last_transit = transit;
+    s->have_transit = 1;
+
+    int target = (int)(JITTER_FACTOR * s->jitter) + FRAME_SIZE;
+    if (target < min_delay) target = min_delay;
+    if (target > max_delay) target = max_delay;
+    s->target = target;
+}
+
+/**
+ * @brief Store a packet's samples in the jitter buffer.
+ */
+static void buffer_packet(Stream *s, const RtpPacket *p, double now) {
+    size_t n = p->payload_len / 2;
+    if (n == 0 || n > JB_SAMPLES / 2) return;
+
+    if (!s->playing && s->newest == s->cursor) {
+        // First packet of a playout run: play from here once the target delay is buffered.
+        s->cursor = p->ts;
+        s->newest = p->ts;
+    }
+    int32_t offset = (int32_t)(p->ts - s->cursor);
+    if (offset + (int32_t)n <= 0) {
+        s->late++;
+        return;
+    }
+    if (offset >= JB_SAMPLES - (int32_t)n) {
+        // Far ahead of playout (a sender restart or a long gap): start over.
+        memset(s->have, 0, sizeof(s->have));
+        s->cursor = p->ts;
+        s->newest = p->ts;
+        s->playing = 0;
+        offset = 0;
+    }
+
+    for (size_t i = offset < 0 ? (size_t)-offset : 0; i < n; i++) {
+        uint32_t index = (p->ts + (uint32_t)i) & JB_MASK;
+        s->pcm[index] = (int16_t)((p->payload[2 * i] << 8) | p->payload[2 * i + 1]);
+        s->have[index] = 1;
+    }
+    uint32_t end = p->ts + (uint32_t)n;
+    if ((int32_t)(end - s->newest) > 0) s->newest = end;
+
+    if (!s->playing && (int32_t)(s->newest - s->cursor) >= s->target) {
+        s->playing = 1;
+        s->play_start = now;
+        s->run_frames = 0;
+        s->concealed_run = 0;
+    }
+}
+
+/**
+ * @brief Send the outgoing packet once it holds frames_per_packet frames.
+ */
+static void queue_output(Worker *w, Stream *s, const float *x, uint32_t ts) {
+    if (s->out_frames == 0) s->out_ts = ts;
+    uint8_t *payload = s->out + RTP_HEADER + (size_t)s->out_frames * FRAME_SIZE * 2;
+    for (int i = 0; i < FRAME_SIZE; i++) {
+        float v = x[i];
+        if (v > 32767.0f) v = 32767.0f;
+        if (v < -32768.0f) v = -32768.0f;
+        int16_t sample = (int16_t)v;
+        payload[2 * i] = (uint8_t)((uint16_t)sample >> 8);
+        payload[2 * i + 1] = (uint8_t)sample;
+    }
+    if (++s->out_frames < frames_per_packet) return;
+
+    write_rtp_header(s->out, s->out_marker, s->payload_type, s->out_seq++, s->out_ts, s->ssrc);
+    const struct sockaddr_in *to = destination.sin_port ? &destination : &s->from;
+    size_t len = RTP_HEADER + (size_t)s->out_frames * FRAME_SIZE * 2;
+    if (sendto(w->sock, s->out, len, MSG_DONTWAIT, (const struct sockaddr *)to, sizeof(*to)) == (ssize_t)len) {
+        s->sent++;
+    }
+    s->out_marker = 0;
+    s->out_frames = 0;
+}
+
+/**
+ * @brief Play out, conceal, denoise and send one frame.
+ */
+static void play_frame(Worker *w, Stream *s) {
+    int16_t frame[FRAME_SIZE];
+    uint8_t got[FRAME_SIZE];
+    int missing = 0;
+    for (int i = 0; i < FRAME_SIZE; i++) {
+        uint32_t index = (s->cursor + (uint32_t)i) & JB_MASK;
+        got[i] = s->have[index];
+        frame[i] = got[i] ? s->pcm[index] : 0;
+        s->have[index] = 0;
+        missing += !got[i];
+    }
+
+    uint32_t ts = s->cursor + (uint32_t)s->ts_offset;
+    int32_t ahead = (int32_t)(s->newest - s->cursor);
+    rt_trace_counter("jitter buffer", s->ssrc, ahead);
+    if (missing == FRAME_SIZE && ahead <= 0) {
+        // Buffer empty: make up a frame but keep the cursor, so the delay grows.
+        rt_trace_instant("buffer empty", s->ssrc);
+        RNNOISE_PROBE2(underrun, s->ssrc, 0);
+        s->stretched++;
+        s->ts_offset += FRAME_SIZE;
+    } else {
+        s->cursor += FRAME_SIZE;
+    }
+
+    if (missing > 0) {
+        // Repeat the last good frame, fading out over consecutive losses.
+        float gain = powf(PLC_DECAY, (float)(s->concealed_run + 1));
+        for (int i = 0; i < FRAME_SIZE; i++) {
+            if (!got[i]) frame[i] = (int16_t)(s->last_frame[i] * gain);
+        }
+        if (missing == FRAME_SIZE) {
+            rt_trace_instant("concealed", s->ssrc);
+            s->concealed++;
+            s->concealed_run++;
+        }
+    }
+    if (missing < FRAME_SIZE) {
+        s->concealed_run = 0;
+        memcpy(s->last_frame, frame, sizeof(frame));
+    }
+
+    float x[FRAME_SIZE];
+    float energy = 0.0f;
+    for (int i = 0; i < FRAME_SIZE; i++) {
+        x[i] = frame[i];
+        energy += x[i] * x[i];
+    }
+    double t0 = now_seconds();
+    rt_trace_begin("denoise");
+    denoise_core_process_frame(s->core, x);
+    rt_trace_end("denoise");
+    double spent = now_seconds() - t0;
+    s->process_seconds += spent;
+    if (spent > s->process_max) s->process_max = spent;
+    s->processed++;
+    queue_output(w, s, x, ts);
+
+    // Too much buffered: skip a quiet frame to bring the delay down.
+    ahead = (int32_t)(s->newest - s->cursor);
+    float rms = sqrtf(energy / FRAME_SIZE);
+    if ((ahead > s->target + 2 * FRAME_SIZE && rms < QUIET_LEVEL) || ahead > s->target + 8 * FRAME_SIZE) {
+        for (int i = 0; i < FRAME_SIZE; i++) s->have[(s->cursor + (uint32_t)i) & JB_MASK] = 0;
+        s->cursor += FRAME_SIZE;
+        s->ts_offset -= FRAME_SIZE;
+        s->skipped++;
+        rt_trace_instant("skipped", s->ssrc);
+    }
+
+    // Nothing has arrived for a while: pause until the next talk spurt.
+    if (s->concealed_run >= MAX_CONCEALED) {
+        s->playing = 0;
+        memset(s->have, 0, sizeof(s->have));
+        s->newest = s->cursor;
+    }
+}
+
+/**
+ * @brief Play out every frame that is due on the 10ms clock.
+ */
+static void tick_stream(Worker *w, Stream *s, double now) {
+    if (!s->playing) return;
+    uint64_t due = (uint64_t)((now - s->play_start) * SAMPLE_RATE / FRAME_SIZE) + 1;
+    // After a long stall, catch up without sending a burst.
+    if (due > s->run_frames + 10) {
+        rt_trace_instant("stall", (long long)(due - s->run_frames));
+        rt_trace_request_dump("stall");
+        s->run_frames = due - 10;
+    }
+    while (s->playing && s->run_frames < due) {
+        play_frame(w, s);
+        s->run_frames++;
+    }
+}
+
+static void receive_packets(Worker *w) {
+    uint8_t buffers[RECV_BATCH][MAX_PACKET];
+    struct sockaddr_in from[RECV_BATCH];
+    struct iovec iov[RECV_BATCH];
+    struct mmsghdr msgs[RECV_BATCH];
+    for (int i = 0; i < RECV_BATCH; i++) {
+        iov[i].iov_base = buffers[i];
+        iov[i].iov_len = MAX_PACKET;
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &from[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+    }
+
+    int n;
+    while ((n = recvmmsg(w->sock, msgs, RECV_BATCH, MSG_DONTWAIT, NULL)) > 0) {
+        double now = now_seconds();
+        rt_trace_instant("packets", n);
+        for (int i = 0; i < n; i++) {
+            RtpPacket p;
+            if (!parse_rtp(buffers[i], msgs[i].msg_len, &p)) continue;
+            Stream *s = find_stream(w, &p, &from[i]);
+            if (!s) {
+                s = new_stream(w, &p, &from[i], now);
+                if (!s) continue;
+                char addr[INET_ADDRSTRLEN];
+                inet_ntop(AF_INET, &from[i].sin_addr, addr, sizeof(addr));
+                fprintf(stderr, "[%d] New stream ssrc %08x from %s:%d (%d on this thread)\n", w->index, p.ssrc,
+                        addr, ntohs(from[i].sin_port), w->stream_count);
+            }
+            s->last_seen = now;
+            track_packet(s, &p, now);
+            buffer_packet(s, &p, now);
+            msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+        }
+        if (n < RECV_BATCH) break;
+    }
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    struct epoll_event events[2];
+    w->next_stats = now_seconds() + stats_seconds;
+    char name[32];
+    snprintf(name, sizeof(name), "worker %d", w->index);
+    rt_trace_thread_name(name);
+
+    while (!stop_requested) {
+        int n = epoll_wait(w->epoll, events, 2, 200);
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == w->sock) {
+                receive_packets(w);
+            } else {
+                uint64_t expirations;
+                if (read(w->timer, &expirations, sizeof(expirations)) < 0) continue;
+            }
+        }
+
+        double now = now_seconds();
+        rt_trace_begin("tick");
+        int print = stats_seconds > 0 && now >= w->next_stats && w->stream_count > 0;
+        if (w->stats_seen != (unsigned long)stats_requests) {
+            w->stats_seen = (unsigned long)stats_requests;
+            print = 1;
+        }
+        if (stats_seconds > 0 && now >= w->next_stats) w->next_stats = now + stats_seconds;
+
+        for (int b = 0; b < STREAM_BUCKETS; b++) {
+            Stream *s = w->buckets[b];
+            while (s) {
+                Stream *next = s->next;
+                tick_stream(w, s, now);
+                if (now - s->last_seen > STREAM_IDLE_SECONDS) {
+                    print_stream(w, s, "Ended");
+                    free_stream(w, s);
+                } else if (print) {
+                    print_stream(w, s, "Stream");
+                }
+                s = next;
+            }
+        }
+        rt_trace_end("tick");
+        if (print) print_arena(w);
+    }
+
+    for (int b = 0; b < STREAM_BUCKETS; b++) {
+        while (w->buckets[b]) {
+            print_stream(w, w->buckets[b], "Ended");
+            free_stream(w, w->buckets[b]);
+        }
+    }
+    print_arena(w);
+    denoise_arena_destroy(w->arena);
+    return NULL;
+}
+
+static int open_worker(Worker *w, int index) {
+    memset(w, 0, sizeof(*w));
+    w->index = index;
+    w->arena = denoise_arena_create(NULL, 0);
+    if (!w->arena) return 0;
+    w->sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (w->sock < 0) return 0;
+    int one = 1;
+    int rcvbuf = 4 << 20;
+    setsockopt(w->sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    setsockopt(w->sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)listen_port);
+    if (bind(w->sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) return 0;
+
+    w->timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    struct itimerspec period = {{0, 10000000}, {0, 10000000}};
+    if (w->timer < 0 || timerfd_settime(w->timer, 0, &period, NULL) != 0) return 0;
+
+    w->epoll = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = {.events = EPOLLIN};
+    ev.data.fd = w->sock;
+    if (w->epoll < 0 || epoll_ctl(w->epoll, EPOLL_CTL_ADD, w->sock, &ev) != 0) return 0;
+    ev.data.fd = w->timer;
+    return epoll_ctl(w->epoll, EPOLL_CTL_ADD, w->timer, &ev) == 0;
+}
+
+static int run_denoiser(int threads) {
+    static Worker workers[MAX_THREADS];
+    pthread_t ids[MAX_THREADS];
+    int started = 0;
+    for (; started < threads; started++) {
+        if (!open_worker(&workers[started], started)) {
+            fprintf(stderr, "Cannot listen on UDP port %d: %s\n", listen_port, strerror(errno));
+            break;
+        }
+        if (pthread_create(&ids[started], NULL, worker_main, &workers[started]) != 0) break;
+    }
+    if (started == 0) return 1;
+    fprintf(stderr, "Denoising RTP on UDP port %d with %d threads\n", listen_port, started);
+
+    // Write trace dumps here, off the workers: after a stall, or on SIGUSR2.
+    while (!stop_requested) {
+        char path[4096];
+        if (rt_trace_dump_pending(path, sizeof(path))) fprintf(stderr, "Trace written to %s\n", path);
+        struct timespec pause = {0, 200000000};
+        nanosleep(&pause, NULL);
+    }
+    for (int i = 0; i < started; i++) pthread_join(ids[i], NULL);
+    return 0;
+}
+
+/*
+ * Test sender.
+ */
+
+typedef struct {
+    double when;
+    int stream;
+    int packet;
+} Send;
+
+static int compare_sends(const void *a, const void *b) {
+    double d = ((const Send *)a)->when - ((const Send *)b)->when;
+    return d < 0 ? -1 : d > 0;
+}
+
+/**
+ * @brief Send a WAV file as RTP in real time on several streams, with
+ *        optional loss and jitter.
+ */
+static int run_sender(const char *path, int streams, double loss_percent, double jitter_ms) {
+    FILE *f = fopen(path, "rb");
+    WavHeader header;
+    if (!f || fread(&header, sizeof(header), 1, f) != 1 || header.channels != 1 || header.sample_rate != SAMPLE_RATE ||
+        header.bits_per_sample != 16) {
+        fprintf(stderr, "%s: expected a mono 16-bit 48kHz WAV file\n", path);
+        if (f) fclose(f);
+        return 1;
+    }
+    struct stat st;
+    fstat(fileno(f), &st);
+    size_t samples = ((size_t)st.st_size - sizeof(header)) / 2;
+    int16_t *pcm = malloc((samples + 1) * sizeof(int16_t));
+    if (!pcm || fread(pcm, sizeof(int16_t), samples, f) != samples) {
+        fclose(f);
+        free(pcm);
+        return 1;
+    }
+    fclose(f);
+
+    size_t per_packet = (size_t)frames_per_packet * FRAME_SIZE;
+    int packets = (int)((samples + per_packet - 1) / per_packet);
+    Send *plan = malloc((size_t)streams * packets * sizeof(Send));
+    int *socks = malloc((size_t)streams * sizeof(int));
+    if (!plan || !socks) return 1;
+
+    // One socket per stream, so streams have their own source ports.
+    srand(1);
+    int planned = 0, dropped = 0;
+    for (int s = 0; s < streams; s++) {
+        socks[s] = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        for (int p = 0; p < packets; p++) {
+            if (rand() < loss_percent / 100.0 * RAND_MAX) {
+                dropped++;
+                continue;
+            }
+            double nominal = (double)p * per_packet / SAMPLE_RATE;
+            plan[planned++] = (Send){nominal + jitter_ms / 1000.0 * rand() / RAND_MAX, s, p};
+        }
+    }
+    qsort(plan, (size_t)planned, sizeof(Send), compare_sends);
+
+    uint8_t packet[RTP_HEADER + MAX_PACKET_FRAMES * FRAME_SIZE * 2];
+    double start = now_seconds();
+    for (int i = 0; i < planned && !stop_requested; i++) {
+        double wait = start + plan[i].when - now_seconds();
+        if (wait > 0) usleep((useconds_t)(wait * 1e6));
+
+        int s = plan[i].stream, p = plan[i].packet;
+        size_t first = (size_t)p * per_packet;
+        size_t n = first + per_packet <= samples ? per_packet : samples - first;
+        write_rtp_header(packet, p == 0, 96, (uint16_t)(1000 * s + p), 90000u * (uint32_t)s + (uint32_t)first,
+                         0x1000u + (uint32_t)s);
+        for (size_t k = 0; k < n; k++) {
+            packet[RTP_HEADER + 2 * k] = (uint8_t)((uint16_t)pcm[first + k] >> 8);
+            packet[RTP_HEADER + 2 * k + 1] = (uint8_t)pcm[first + k];
+        }
+        sendto(socks[s], packet, RTP_HEADER + 2 * n, 0, (struct sockaddr *)&destination, sizeof(destination));
+    }
+    fprintf(stderr, "Sent %d packets on %d streams (%d dropped on purpose)\n", planned, streams, dropped);
+    for (int s = 0; s < streams; s++) close(socks[s]);
+    free(plan);
+    free(socks);
+    free(pcm);
+    return 0;
+}
+
+/*
+ * Test receiver.
+ */
+
+typedef struct {
+    uint32_t ssrc;
+    uint32_t first_ts;
+    int fd;
+    uint64_t packets;
+    uint64_t samples;              // Highest sample position written.
+    uint16_t last_seq;
+    uint64_t gaps;                 // Missing sequence numbers seen in order.
+} Recording;
+
+/**
+ * @brief Write every received stream to <prefix>.<ssrc>.wav, placing samples by timestamp.
+ */
+static int run_receiver(int port, const char *prefix) {
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    int rcvbuf = 4 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Cannot listen on UDP port %d: %s\n", port, strerror(errno));
+        return 1;
+    }
+    struct timeval timeout = {0, 200000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    Recording recordings[256];
+    int count = 0;
+    double last_packet = 0.0;
+    uint8_t buffer[MAX_PACKET];
+    while (!stop_requested) {
+        ssize_t len = recv(sock, buffer, sizeof(buffer), 0);
+        double now = now_seconds();
+        if (len < 0) {
+            // Stop once the streams have been quiet for a while.
+            if (last_packet > 0.0 && now - last_packet > 2.0) break;
+            continue;
+        }
+        RtpPacket p;
+        if (!parse_rtp(buffer, (size_t)len, &p)) continue;
+        last_packet = now;
+
+        Recording *r = NULL;
+        for (int i = 0; i < count; i++) {
+            if (recordings[i].ssrc == p.ssrc) r = &recordings[i];
+        }
+        if (!r) {
+            if (count == 256) continue;
+            r = &recordings[count++];
+            memset(r, 0, sizeof(*r));
+            r->ssrc = p.ssrc;
+            r->first_ts = p.ts;
+            r->last_seq = (uint16_t)(p.seq - 1);
+            char path[1024];
+            snprintf(path, sizeof(path), "%s.%08x.wav", prefix, p.ssrc);
+            r->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        }
+        r->packets++;
+        uint16_t step = (uint16_t)(p.seq - r->last_seq);
+        if (step < 0x8000) {
+            r->gaps += step - 1u;
+            r->last_seq = p.seq;
+        }
+
+        int32_t position = (int32_t)(p.ts - r->first_ts);
+        if (position < 0 || r->fd < 0) continue;
+        size_t n = p.payload_len / 2;
+        int16_t samples[MAX_PACKET / 2];
+        for (size_t i = 0; i < n; i++) samples[i] = (int16_t)((p.payload[2 * i] << 8) | p.payload[2 * i + 1]);
+        if (pwrite(r->fd, samples, n * 2, (off_t)(sizeof(WavHeader) + (uint64_t)position * 2)) == (ssize_t)(n * 2) &&
+            position + n > r->samples) {
+            r->samples = position + n;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        Recording *r = &recordings[i];
+        WavHeader header = {
+            {'R', 'I', 'F', 'F'}, (uint32_t)(36 + r->samples * 2), {'W', 'A', 'V', 'E'}, {'f', 'm', 't', ' '}, 16, 1, 1,
+            SAMPLE_RATE, SAMPLE_RATE * 2, 2, 16, {'d', 'a', 't', 'a'}, (uint32_t)(r->samples * 2),
+        };
+        if (r->fd >= 0) {
+            if (pwrite(r->fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) perror("write");
+            close(r->fd);
+        }
+        fprintf(stderr, "Received ssrc %08x: %llu packets, %llu missing, %.2f s\n", r->ssrc,
+                (unsigned long long)r->packets, (unsigned long long)r->gaps, (double)r->samples / SAMPLE_RATE);
+    }
+    close(sock);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-l port] [-d host:port] [-t threads] [-P frames] [-m min_ms] [-M max_ms] [-s stats_s]\n"
+            "       %s -S input.wav -d host:port [-n streams] [-P frames] [-L loss_percent] [-J jitter_ms]\n"
+            "       %s -R port -o prefix\n"
+            "  -l  UDP port to receive RTP on (default 5004)\n"
+            "  -d  send denoised RTP here (default: back to each sender)\n"
+            "  -t  threads (default: number of CPUs)\n"
+            "  -P  10ms frames per outgoing packet, 1 to %d (default 1)\n"
+            "  -m  minimum playout delay in ms (default 20)\n"
+            "  -M  maximum playout delay in ms (default 200)\n"
+            "  -s  print stream statistics every this many seconds (default 10, 0 disables)\n"
+            "  -S  test sender: send a mono 48kHz WAV file in real time\n"
+            "  -R  test receiver: write each received stream to <prefix>.<ssrc>.wav\n",
+            prog, prog, prog, MAX_PACKET_FRAMES);
+}
+
+/**
+ * @brief Main entry point.
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return 0 on success, 1 on error.
+ */
+int main(int argc, char *argv[]) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus > 0 ? (int)cpus : 1;
+    const char *send_file = NULL;
+    const char *prefix = NULL;
+    int receive_port = 0;
+    int streams = 1;
+    double loss = 0.0, jitter = 0.0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "l:d:t:P:m:M:s:S:R:o:n:L:J:h")) != -1) {
+        switch (opt) {
+            case 'l': listen_port = atoi(optarg); break;
+            case 'd':
+                if (!parse_address(optarg, &destination)) {
+                    fprintf(stderr, "Cannot resolve %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 't': threads = atoi(optarg); break;
+            case 'P': frames_per_packet = atoi(optarg); break;
+            case 'm': min_delay = atoi(optarg) * SAMPLE_RATE / 1000; break;
+            case 'M': max_delay = atoi(optarg) * SAMPLE_RATE / 1000; break;
+            case 's': stats_seconds = atof(optarg); break;
+            case 'S': send_file = optarg; break;
+            case 'R': receive_port = atoi(optarg); break;
+            case 'o': prefix = optarg; break;
+            case 'n': streams = atoi(optarg); break;
+            case 'L': loss = atof(optarg); break;
+            case 'J': jitter = atof(optarg); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (frames_per_packet < 1 || frames_per_packet > MAX_PACKET_FRAMES || min_delay < 0 || max_delay < min_delay ||
+        max_delay > JB_SAMPLES / 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    sa.sa_handler = on_stats_signal;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, NULL);
+    rt_trace_dump_on_signal(SIGUSR2);
+
+    if (send_file) {
+        if (!destination.sin_port || streams < 1) {
+            usage(argv[0]);
+            return 1;
+        }
+        return run_sender(send_file, streams, loss, jitter);
+    }
+    if (receive_port) {
+        if (!prefix) {
+            usage(argv[0]);
+            return 1;
+        }
+        return run_receiver(receive_port, prefix);
+    }
+    return run_denoiser(threads);
+}
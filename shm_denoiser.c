@@ -0,0 +1,315 @@
+/**
+ * @file
+ * @brief Denoise audio for other processes through shared-memory rings.
+ *
+ * Replaces the PulseAudio null-sink round trip for programs that can link
+ * the small shm_ring client library: the program writes 480-sample frames
+ * into a shared ring, this server denoises them in place and the program
+ * reads them back from the same memory. See shm_ring.h for the protocol.
+ *
+ * Server:  shm_denoiser [-s slots] /name...     one ring and thread per name
+ * Client:  shm_denoiser -c /name -i in.wav -o out.wav [-b frames]
+ *
+ * The client mode streams a WAV file through a running server and reports
+ * the round-trip time per frame; it doubles as an example of the library.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "denoise_core.h"
+#include "shm_ring.h"
+
+#define FRAME_SIZE 480     // RNNoise frame size (10ms at 48kHz).
+#define SAMPLE_RATE 48000  // Expected sample rate for RNNoise.
+
+#define MAX_RINGS 64
+
+/**
+ * @brief Struct representing the WAV file header.
+ */
+typedef struct {
+    char riff[4];                  // "RIFF"
+    uint32_t file_size;            // Total file size minus 8 bytes
+    char wave[4];                  // "WAVE"
+    char fmt[4];                   // "fmt "
+    uint32_t fmt_size;             // Format chunk size (usually 16)
+    uint16_t format;               // Audio format (1 = PCM)
+    uint16_t channels;             // Number of audio channels
+    uint32_t sample_rate;          // Sampling rate (Hz)
+    uint32_t byte_rate;            // Bytes per second
+    uint16_t block_align;          // Block alignment (bytes per sample frame)
+    uint16_t bits_per_sample;      // Bits per sample (usually 16)
+    char data[4];                  // "data"
+    uint32_t data_size;            // Size of audio data in bytes
+} WavHeader;
+
+/**
+ * @brief A ring served by one thread.
+ */
+typedef struct {
+    const char *name;
+    unsigned slots;
+    unsigned long long frames;
+    unsigned long sessions;
+    double busy_seconds;
+} Served;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+/**
+ * @brief Monotonic clock in seconds.
+ */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *serve_main(void *arg) {
+    Served *served = arg;
+    ShmRing ring;
+    if (!shm_ring_create(&ring, served->name, served->slots)) {
+        perror(served->name);
+        return NULL;
+    }
+    fprintf(stderr, "Serving %s (%u slots)\n", served->name, ring.shared->slots);
+
+    DenoiseCore *core = denoise_core_create(NULL);
+    if (!core) {
+        shm_ring_close(&ring);
+        return NULL;
+    }
+    while (!stop_requested) {
+        int new_session;
+        float *frame = shm_ring_next(&ring, 200, &new_session);
+        if (new_session) {
+            // Each client starts from a fresh RNNoise state, reset in place.
+            denoise_core_reset(core);
+            served->sessions++;
+            fprintf(stderr, "%s: client %u attached\n", served->name, (unsigned)ring.shared->client_pid);
+        }
+        if (!frame) continue;
+
+        double t0 = now_seconds();
+        denoise_core_process_frame(core, frame);
+        served->busy_seconds += now_seconds() - t0;
+        served->frames++;
+        shm_ring_done(&ring);
+    }
+
+    denoise_core_destroy(core);
+    shm_ring_close(&ring);
+    fprintf(stderr, "%s: %lu clients, %llu frames, %.1f us per frame\n", served->name, served->sessions,
+            served->frames, served->frames ? served->busy_seconds * 1e6 / served->frames : 0.0);
+    return NULL;
+}
+
+static int run_server(char **names, int count, unsigned slots) {
+    static Served served[MAX_RINGS];
+    pthread_t threads[MAX_RINGS];
+    if (count > MAX_RINGS) count = MAX_RINGS;
+    for (int i = 0; i < count; i++) {
+        served[i].name = names[i];
+        served[i].slots = slots;
+        if (pthread_create(&threads[i], NULL, serve_main, &served[i]) != 0) return 1;
+    }
+    for (int i = 0; i < count; i++) pthread_join(threads[i], NULL);
+    return 0;
+}
+
+/**
+ * @brief Client-side progress.
+ */
+typedef struct {
+    unsigned long long sent;
+    unsigned long long received;
+    uint64_t written;            // Output bytes.
+    double total_rtt;
+    double max_rtt;
+    size_t *lengths;             // Samples in each frame in flight, by slot.
+    double *sent_at;             // Commit time of each frame in flight, by slot.
+} ClientRun;
+
+/**
+ * @brief Wait for the oldest frame in flight and write it, skipping the first
+ *        frame like the other tools do.
+ */
+static int collect_result(ShmRing *ring, FILE *out, ClientRun *run) {
+    const float *result = shm_ring_result(ring, 1000);
+    if (!result) return 0;
+    unsigned index = (unsigned)(run->received & (ring->shared->slots - 1));
+    double rtt = now_seconds() - run->sent_at[index];
+    run->total_rtt += rtt;
+    if (rtt > run->max_rtt) run->max_rtt = rtt;
+    size_t samples = run->lengths[index];
+    if (run->received++ > 0) {
+        int16_t pcm[FRAME_SIZE];
+        for (size_t i = 0; i < samples; i++) {
+            float v = result[i];
+            if (v > 32767.0f) v = 32767.0f;
+            if (v < -32768.0f) v = -32768.0f;
+            pcm[i] = (int16_t)v;
+        }
+        if (fwrite(pcm, sizeof(int16_t), samples, out) != samples) return 0;
+        run->written += samples * sizeof(int16_t);
+    }
+    shm_ring_release(ring);
+    return 1;
+}
+
+/**
+ * @brief Stream a WAV file through a server's ring, keeping up to depth frames in flight.
+ */
+static int run_client(const char *name, const char *in_path, const char *out_path, int depth) {
+    FILE *in = fopen(in_path, "rb");
+    WavHeader header;
+    if (!in || fread(&header, sizeof(header), 1, in) != 1 || header.channels != 1 ||
+        header.sample_rate != SAMPLE_RATE || header.bits_per_sample != 16) {
+        fprintf(stderr, "%s: expected a mono 16-bit 48kHz WAV file\n", in_path);
+        if (in) fclose(in);
+        return 1;
+    }
+    FILE *out = fopen(out_path, "wb");
+    if (!out || fwrite(&header, sizeof(header), 1, out) != 1) {
+        fprintf(stderr, "Cannot write %s\n", out_path);
+        fclose(in);
+        if (out) fclose(out);
+        return 1;
+    }
+
+    ShmRing ring;
+    if (!shm_ring_open(&ring, name)) {
+        fprintf(stderr, "Cannot attach to %s: is shm_denoiser running, and is no other client attached?\n", name);
+        fclose(in);
+        fclose(out);
+        return 1;
+    }
+    if (depth < 1) depth = 1;
+    if ((unsigned)depth > ring.shared->slots) depth = (int)ring.shared->slots;
+
+    ClientRun run = {
+        .lengths = calloc((size_t)ring.shared->slots, sizeof(size_t)),
+        .sent_at = calloc((size_t)ring.shared->slots, sizeof(double)),
+    };
+    double start = now_seconds();
+    int ok = run.lengths && run.sent_at;
+    unsigned mask = ring.shared->slots - 1;
+
+    int16_t pcm[FRAME_SIZE];
+    size_t got;
+    while (ok && !stop_requested && (got = fread(pcm, sizeof(int16_t), FRAME_SIZE, in)) > 0) {
+        if (run.sent - run.received == (unsigned long long)depth) ok = collect_result(&ring, out, &run);
+        float *frame = ok ? shm_ring_acquire(&ring) : NULL;
+        if (!frame) {
+            ok = 0;
+            break;
+        }
+        // Written straight into shared memory: the server reads it from here.
+        for (size_t i = 0; i < FRAME_SIZE; i++) frame[i] = i < got ? pcm[i] : 0.0f;
+        run.lengths[run.sent & mask] = got;
+        run.sent_at[run.sent & mask] = now_seconds();
+        shm_ring_commit(&ring);
+        run.sent++;
+    }
+    while (ok && run.received < run.sent) ok = collect_result(&ring, out, &run);
+    double elapsed = now_seconds() - start;
+    shm_ring_close(&ring);
+    free(run.lengths);
+    free(run.sent_at);
+    fclose(in);
+
+    // Record the size actually written: the warm-up frame is not in the output.
+    header.data_size = (uint32_t)run.written;
+    header.file_size = (uint32_t)(run.written + sizeof(WavHeader) - 8);
+    if (fseek(out, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, out) != 1) ok = 0;
+    if (fclose(out) != 0) ok = 0;
+    if (!ok) {
+        fprintf(stderr, "Failed after %llu frames: the server stopped or did not answer\n", run.received);
+        return 1;
+    }
+    fprintf(stderr, "%llu frames in %.2f s (%.1fx real time), round trip %.1f us mean, %.1f us max\n",
+            run.received, elapsed, elapsed > 0 ? run.received * (double)FRAME_SIZE / SAMPLE_RATE / elapsed : 0.0,
+            run.received ? run.total_rtt * 1e6 / run.received : 0.0, run.max_rtt * 1e6);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-s slots] /name...\n"
+            "       %s -c /name -i input.wav -o output.wav [-b frames]\n"
+            "  -s  ring size in frames (default %d)\n"
+            "  -c  client: stream a WAV file through the server's ring\n"
+            "  -b  frames in flight in client mode (default 1)\n",
+            prog, prog, SHM_RING_SLOTS);
+}
+
+/**
+ * @brief Main entry point.
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return 0 on success, 1 on error.
+ */
+int main(int argc, char *argv[]) {
+    const char *client = NULL, *in_path = NULL, *out_path = NULL;
+    unsigned slots = SHM_RING_SLOTS;
+    int depth = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:c:i:o:b:h")) != -1) {
+        switch (opt) {
+            case 's': slots = (unsigned)atoi(optarg); break;
+            case 'c': client = optarg; break;
+            case 'i': in_path = optarg; break;
+            case 'o': out_path = optarg; break;
+            case 'b': depth = atoi(optarg); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+
+    if (client) {
+        if (!in_path || !out_path) {
+            usage(argv[0]);
+            return 1;
+        }
+        return run_client(client, in_path, out_path, depth);
+    }
+    if (optind >= argc || slots < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    return run_server(argv + optind, argc - optind, slots);
+}
@@ -0,0 +1,310 @@
+/**
+ * @file
+ * @brief Shared-memory frame ring between an audio process and shm_denoiser.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "shm_ring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#define SPINS 200            // Checks before going to sleep.
+#define ATTACH_TIMEOUT_MS 2000
+
+/**
+ * @brief Sleep while *word still equals expected, for at most timeout_ms (-1: no limit).
+ *
+ * The futex is shared between processes, so FUTEX_PRIVATE_FLAG must not be used.
+ */
+static void wait_on(_Atomic uint32_t *word, uint32_t expected, int timeout_ms) {
+#ifdef __linux__
+    struct timespec ts = {timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L};
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, expected, timeout_ms >= 0 ? &ts : NULL, NULL, 0);
+#else
+    // No futex: poll.
+    (void)expected;
+    usleep(timeout_ms >= 0 && timeout_ms < 1 ? 0 : 200);
+#endif
+}
+
+static void wake(_Atomic uint32_t *word) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+    (void)word;
+#endif
+}
+
+/**
+ * @brief Bump a signal word and wake its sleeper, if there is one.
+ */
+static void notify(_Atomic uint32_t *signal_word, _Atomic uint32_t *sleeping) {
+    atomic_fetch_add(signal_word, 1);
+    // Sequentially consistent on both sides: either the sleeper sees the new
+    // signal value before it sleeps, or this sees its flag and wakes it.
+    if (atomic_load(sleeping)) wake(signal_word);
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/**
+ * @brief Wait until ready(ring) holds, spinning first and then sleeping on signal_word.
+ * @return 1 when ready, 0 on timeout or when the peer has gone.
+ */
+static int wait_until(ShmRing *ring, int (*ready)(ShmRing *), _Atomic uint32_t *signal_word,
+                      _Atomic uint32_t *sleeping, int timeout_ms) {
+    for (int i = 0; i < SPINS; i++) {
+        if (ready(ring)) return 1;
+        if (timeout_ms == 0) return 0;
+        sched_yield();
+    }
+    double deadline = now_ms() + timeout_ms;
+    while (1) {
+        uint32_t seen = atomic_load(signal_word);
+        atomic_store(sleeping, 1);
+        if (ready(ring)) {
+            atomic_store(sleeping, 0);
+            return 1;
+        }
+        // Wake up now and then to notice a peer that died.
+        int slice = 100;
+        if (timeout_ms >= 0) {
+            double left = deadline - now_ms();
+            if (left <= 0) {
+                atomic_store(sleeping, 0);
+                return 0;
+            }
+            if (left < slice) slice = (int)left + 1;
+        }
+        wait_on(signal_word, seen, slice);
+        atomic_store(sleeping, 0);
+        if (ready(ring)) return 1;
+        if (!shm_ring_peer_alive(ring)) return 0;
+    }
+}
+
+static int process_alive(uint32_t pid) {
+    if (pid == 0 || (kill((pid_t)pid, 0) != 0 && errno != EPERM)) return 0;
+#ifdef __linux__
+    // A killed process nobody has reaped yet still answers kill(); it is a zombie.
+    char path[32], buf[256];
+    snprintf(path, sizeof(path), "/proc/%u/stat", (unsigned)pid);
+    FILE *f = fopen(path, "r");
+    if (f) {
+        size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+        fclose(f);
+        buf[n] = '\0';
+        char *state = strrchr(buf, ')');
+        if (state && state[1] == ' ' && state[2] == 'Z') return 0;
+    }
+#endif
+    return 1;
+}
+
+int shm_ring_peer_alive(const ShmRing *ring) {
+    const ShmRingShared *s = ring->shared;
+    return process_alive(atomic_load(ring->server ? &s->client_pid : &s->server_pid));
+}
+
+static float *slot(ShmRing *ring, uint32_t index) {
+    ShmRingShared *s = ring->shared;
+    return s->frames + (size_t)(index & (s->slots - 1)) * s->frame_size;
+}
+
+int shm_ring_create(ShmRing *ring, const char *name, unsigned slots) {
+    memset(ring, 0, sizeof(*ring));
+    unsigned n = 1;
+    while (n < slots) n <<= 1;
+    ring->size = sizeof(ShmRingShared) + (size_t)n * SHM_RING_FRAME * sizeof(float);
+    ring->server = 1;
+    snprintf(ring->name, sizeof(ring->name), "%s", name);
+
+    // A segment left by a crashed server is replaced; clients still mapping it see the old one.
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) return 0;
+    if (ftruncate(fd, (off_t)ring->size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return 0;
+    }
+    void *map = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        shm_unlink(name);
+        return 0;
+    }
+    ring->shared = map;
+
+    ShmRingShared *s = ring->shared;
+    s->frame_size = SHM_RING_FRAME;
+    s->slots = n;
+    s->version = SHM_RING_VERSION;
+    atomic_store(&s->server_pid, (uint32_t)getpid());
+    // The magic goes last: a client that sees it sees a complete header.
+    atomic_thread_fence(memory_order_release);
+    s->magic = SHM_RING_MAGIC;
+    return 1;
+}
+
+static int session_ready(ShmRing *ring) {
+    return atomic_load(&ring->shared->ready) == atomic_load(&ring->shared->session);
+}
+
+int shm_ring_open(ShmRing *ring, const char *name) {
+    memset(ring, 0, sizeof(*ring));
+    snprintf(ring->name, sizeof(ring->name), "%s", name);
+    int fd = shm_open(name, O_RDWR, 0);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmRingShared)) {
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    ring->size = (size_t)st.st_size;
+    void *map = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+    ring->shared = map;
+
+    ShmRingShared *s = ring->shared;
+    atomic_thread_fence(memory_order_acquire);
+    if (s->magic != SHM_RING_MAGIC || s->version != SHM_RING_VERSION || s->frame_size != SHM_RING_FRAME ||
+        sizeof(ShmRingShared) + (size_t)s->slots * s->frame_size * sizeof(float) > ring->size ||
+        !process_alive(atomic_load(&s->server_pid))) {
+        shm_ring_close(ring);
+        return 0;
+    }
+
+    // Claim the ring, taking it over from a client that died.
+    uint32_t pid = (uint32_t)getpid();
+    uint32_t current = 0;
+    if (!atomic_compare_exchange_strong(&s->client_pid, &current, pid) &&
+        (process_alive(current) || !atomic_compare_exchange_strong(&s->client_pid, &current, pid))) {
+        munmap(ring->shared, ring->size);
+        ring->shared = NULL;
+        return 0;
+    }
+
+    // The server resets the indices and its state for the new session.
+    atomic_fetch_add(&s->session, 1);
+    notify(&s->server_signal, &s->server_sleeping);
+    if (!wait_until(ring, session_ready, &s->client_signal, &s->client_sleeping, ATTACH_TIMEOUT_MS)) {
+        shm_ring_close(ring);
+        return 0;
+    }
+    return 1;
+}
+
+void shm_ring_close(ShmRing *ring) {
+    ShmRingShared *s = ring->shared;
+    if (!s) return;
+    if (ring->server) {
+        atomic_store(&s->server_pid, 0);
+        notify(&s->client_signal, &s->client_sleeping);
+        munmap(s, ring->size);
+        shm_unlink(ring->name);
+    } else {
+        uint32_t pid = (uint32_t)getpid();
+        atomic_compare_exchange_strong(&s->client_pid, &pid, 0);
+        notify(&s->server_signal, &s->server_sleeping);
+        munmap(s, ring->size);
+    }
+    ring->shared = NULL;
+}
+
+float *shm_ring_acquire(ShmRing *ring) {
+    ShmRingShared *s = ring->shared;
+    uint32_t head = atomic_load_explicit(&s->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&s->tail, memory_order_relaxed) >= s->slots) return NULL;
+    return slot(ring, head);
+}
+
+void shm_ring_commit(ShmRing *ring) {
+    ShmRingShared *s = ring->shared;
+    atomic_store_explicit(&s->head, atomic_load_explicit(&s->head, memory_order_relaxed) + 1,
+                          memory_order_release);
+    notify(&s->server_signal, &s->server_sleeping);
+}
+
+static int result_ready(ShmRing *ring) {
+    ShmRingShared *s = ring->shared;
+    return atomic_load_explicit(&s->done, memory_order_acquire) != atomic_load_explicit(&s->tail, memory_order_relaxed);
+}
+
+const float *shm_ring_result(ShmRing *ring, int timeout_ms) {
+    ShmRingShared *s = ring->shared;
+    if (!wait_until(ring, result_ready, &s->client_signal, &s->client_sleeping, timeout_ms)) return NULL;
+    return slot(ring, atomic_load_explicit(&s->tail, memory_order_relaxed));
+}
+
+void shm_ring_release(ShmRing *ring) {
+    ShmRingShared *s = ring->shared;
+    atomic_store_explicit(&s->tail, atomic_load_explicit(&s->tail, memory_order_relaxed) + 1,
+                          memory_order_release);
+}
+
+static int work_ready(ShmRing *ring) {
+    ShmRingShared *s = ring->shared;
+    return !session_ready(ring) ||
+           atomic_load_explicit(&s->head, memory_order_acquire) != atomic_load_explicit(&s->done, memory_order_relaxed);
+}
+
+float *shm_ring_next(ShmRing *ring, int timeout_ms, int *new_session) {
+    ShmRingShared *s = ring->shared;
+    *new_session = 0;
+    if (!wait_until(ring, work_ready, &s->server_signal, &s->server_sleeping, timeout_ms)) return NULL;
+
+    uint32_t session = atomic_load(&s->session);
+    if (atomic_load(&s->ready) != session) {
+        // The new client waits for this before touching the ring.
+        atomic_store(&s->head, 0);
+        atomic_store(&s->done, 0);
+        atomic_store(&s->tail, 0);
+        atomic_store(&s->ready, session);
+        notify(&s->client_signal, &s->client_sleeping);
+        *new_session = 1;
+        if (!work_ready(ring)) return NULL;
+    }
+    return slot(ring, atomic_load_explicit(&s->done, memory_order_relaxed));
+}
+
+void shm_ring_done(ShmRing *ring) {
+    ShmRingShared *s = ring->shared;
+    atomic_store_explicit(&s->done, atomic_load_explicit(&s->done, memory_order_relaxed) + 1,
+                          memory_order_release);
+    notify(&s->client_signal, &s->client_sleeping);
+}
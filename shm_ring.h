@@ -0,0 +1,132 @@
+/**
+ * @file
+ * @brief Shared-memory frame ring between an audio process and shm_denoiser.
+ *
+ * A producer process (the client) and shm_denoiser (the server) share one
+ * POSIX shared memory segment holding a ring of 480-sample float frames.
+ * The client writes a frame straight into a ring slot and commits it; the
+ * server denoises it in place; the client reads the result from the same
+ * slot and releases it. No audio is copied between the two processes.
+ *
+ * Each side owns its own index (head and tail belong to the client, done
+ * to the server), so the ring needs no locks. A side with nothing to do
+ * spins briefly and then sleeps on a futex, which the other side wakes only
+ * when it knows someone is sleeping.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ */
+
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHM_RING_MAGIC 0x524e4e52u  // "RNNR"
+#define SHM_RING_VERSION 1
+#define SHM_RING_FRAME 480          // Samples per frame (10ms at 48kHz).
+#define SHM_RING_SLOTS 64           // Default ring size, in frames.
+
+/**
+ * @brief Layout of the shared segment. Both processes must agree on it.
+ *
+ * Samples are floats in the 16-bit range, as RNNoise takes them.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t frame_size;
+    uint32_t slots;                          // A power of two.
+    _Atomic uint32_t server_pid;             // 0 once the server has gone.
+    _Atomic uint32_t client_pid;             // 0 while no client is attached.
+    _Atomic uint32_t session;                // Bumped by each client that attaches.
+    _Atomic uint32_t ready;                  // Session the server has reset the ring for.
+    _Alignas(64) _Atomic uint32_t head;      // Frames committed by the client.
+    _Alignas(64) _Atomic uint32_t done;      // Frames denoised by the server.
+    _Alignas(64) _Atomic uint32_t tail;      // Frames released by the client.
+    _Alignas(64) _Atomic uint32_t server_signal;   // Futex word the server sleeps on.
+    _Atomic uint32_t server_sleeping;
+    _Alignas(64) _Atomic uint32_t client_signal;   // Futex word the client sleeps on.
+    _Atomic uint32_t client_sleeping;
+    _Alignas(64) float frames[];             // slots * frame_size samples.
+} ShmRingShared;
+
+/**
+ * @brief One process's handle on a ring.
+ */
+typedef struct {
+    ShmRingShared *shared;
+    size_t size;
+    int server;                  // This process created the segment.
+    char name[64];
+} ShmRing;
+
+/**
+ * @brief Create a ring (server side), replacing any stale segment of that name.
+ * @param name Segment name, e.g. "/rnnoise".
+ * @param slots Ring size in frames, rounded up to a power of two.
+ * @return 1 on success, 0 on failure.
+ */
+int shm_ring_create(ShmRing *ring, const char *name, unsigned slots);
+
+/**
+ * @brief Attach to a server's ring (client side).
+ *
+ * Waits until the server has reset the ring for this client. Fails if the
+ * server is not running or another live client is attached.
+ *
+ * @return 1 on success, 0 on failure.
+ */
+int shm_ring_open(ShmRing *ring, const char *name);
+
+/**
+ * @brief Detach (client) or shut down and remove the ring (server).
+ */
+void shm_ring_close(ShmRing *ring);
+
+/**
+ * @brief Get the next free slot to write a frame into (client).
+ * @return The slot, or NULL while every slot holds a frame not yet released.
+ */
+float *shm_ring_acquire(ShmRing *ring);
+
+/**
+ * @brief Hand the acquired frame to the server (client).
+ */
+void shm_ring_commit(ShmRing *ring);
+
+/**
+ * @brief Get the oldest denoised frame (client).
+ * @param timeout_ms How long to wait for it; 0 does not wait, -1 waits for ever.
+ * @return The frame, or NULL if none is ready in time or the server has gone.
+ */
+const float *shm_ring_result(ShmRing *ring, int timeout_ms);
+
+/**
+ * @brief Free the slot of the frame returned by shm_ring_result (client).
+ */
+void shm_ring_release(ShmRing *ring);
+
+/**
+ * @brief Get the next frame to denoise in place (server).
+ * @param timeout_ms How long to wait for one; -1 waits for ever.
+ * @param new_session Set to 1 when a new client has attached since the
+ *        last call, so per-client state (the RNNoise state) must be reset.
+ * @return The frame, or NULL on timeout.
+ */
+float *shm_ring_next(ShmRing *ring, int timeout_ms, int *new_session);
+
+/**
+ * @brief Mark the frame from shm_ring_next as denoised (server).
+ */
+void shm_ring_done(ShmRing *ring);
+
+/**
+ * @brief Whether the process on the other side is still there.
+ */
+int shm_ring_peer_alive(const ShmRing *ring);
+
+#endif
@@ -0,0 +1,41 @@
+/**
+ * @file
+ * @brief fopen()/fclose() wrappers that fire the file_open and file_close
+ *        probes (see rnnoise_probes.h), shared by the converters and recorders.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ */
+
+#ifndef TRACED_FILE_H
+#define TRACED_FILE_H
+
+#include <stdio.h>
+
+#include "rnnoise_probes.h"
+
+/**
+ * @brief Open a file, announcing it to tracers.
+ */
+static inline FILE *traced_fopen(const char *path, const char *mode) {
+    FILE *file = fopen(path, mode);
+    if (file) RNNOISE_PROBE2(file_open, path, mode[0] == 'w');
+    return file;
+}
+
+/**
+ * @brief Close a file opened with traced_fopen().
+ *
+ * The probe's byte count is the file position at close, which is what was
+ * read or written by callers that go through the file once.
+ */
+static inline int traced_fclose(FILE *file, const char *path) {
+    long bytes = ftell(file);
+    RNNOISE_PROBE2(file_close, path, bytes);
+    (void)bytes;
+    (void)path;
+    return fclose(file);
+}
+
+#endif
@@ -0,0 +1,237 @@
+/**
+ * @file
+ * @brief Minimal io_uring wrapper for file reads and writes.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "uring.h"
+
+#include <string.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+int uring_init(Uring *ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        ring->fd = -1;
+        return 0;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                         IORING_OFF_SQ_RING);
+    ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                         IORING_OFF_CQ_RING);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                      IORING_OFF_SQES);
+    if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        uring_exit(ring);
+        return 0;
+    }
+
+    char *sq = ring->sq_ring;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    char *cq = ring->cq_ring;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = cq + params.cq_off.cqes;
+    return 1;
+}
+
+void uring_exit(Uring *ring) {
+    if (ring->sq_ring && ring->sq_ring != MAP_FAILED) munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->cq_ring && ring->cq_ring != MAP_FAILED) munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sqes && ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+    if (ring->fd >= 0) close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+int uring_register_buffers(Uring *ring, void *const *bufs, size_t len, unsigned count) {
+    struct iovec iov[64];
+    if (count > 64) return 0;
+    for (unsigned i = 0; i < count; i++) {
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len = len;
+    }
+    ring->fixed = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, iov, count) == 0;
+    return ring->fixed;
+}
+
+static int queue_rw(Uring *ring, int op, int fixed_op, int fd, const void *buf, unsigned len, uint64_t offset,
+                    int buf_index, uint64_t user_data) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *ring->sq_tail + ring->queued;
+    if (tail - head > ring->sq_mask) return 0;
+
+    unsigned index = tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *)ring->sqes + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (ring->fixed && buf_index >= 0) ? fixed_op : op;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = len;
+    sqe->off = offset;
+    if (sqe->opcode == fixed_op) sqe->buf_index = (uint16_t)buf_index;
+    sqe->user_data = user_data;
+    ring->sq_array[index] = index;
+    ring->queued++;
+    return 1;
+}
+
+int uring_queue_read(Uring *ring, int fd, void *buf, unsigned len, uint64_t offset, int buf_index,
+                     uint64_t user_data) {
+    return queue_rw(ring, IORING_OP_READ, IORING_OP_READ_FIXED, fd, buf, len, offset, buf_index, user_data);
+}
+
+int uring_queue_write(Uring *ring, int fd, const void *buf, unsigned len, uint64_t offset, int buf_index,
+                      uint64_t user_data) {
+    return queue_rw(ring, IORING_OP_WRITE, IORING_OP_WRITE_FIXED, fd, buf, len, offset, buf_index, user_data);
+}
+
+/**
+ * @brief Publish queued entries to the kernel.
+ * @return Entries published but not yet consumed by the kernel.
+ */
+static unsigned publish(Uring *ring) {
+    if (ring->queued) {
+        __atomic_store_n(ring->sq_tail, *ring->sq_tail + ring->queued, __ATOMIC_RELEASE);
+        ring->queued = 0;
+    }
+    return *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+}
+
+static int cq_ready(const Uring *ring) {
+    return *ring->cq_head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+}
+
+int uring_submit(Uring *ring) {
+    unsigned submit = publish(ring);
+    while (submit) {
+        long ret = syscall(__NR_io_uring_enter, ring->fd, submit, 0, 0, NULL, 0);
+        if (ret < 0 && errno == EINTR) continue;
+        // EBUSY and EAGAIN: the entries stay queued for the next call.
+        return ret >= 0 || errno == EBUSY || errno == EAGAIN;
+    }
+    return 1;
+}
+
+int uring_complete(Uring *ring, UringCompletion *out, int wait) {
+    while (1) {
+        unsigned submit = publish(ring);
+        int block = wait && !cq_ready(ring);
+        if (submit || block) {
+            long ret = syscall(__NR_io_uring_enter, ring->fd, submit, block ? 1 : 0,
+                               block ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+            // EBUSY and EAGAIN mean completions must be reaped first.
+            if (ret < 0 && errno == EINTR) continue;
+            if (ret < 0 && errno != EBUSY && errno != EAGAIN) return 0;
+        }
+
+        if (cq_ready(ring)) {
+            unsigned head = *ring->cq_head;
+            const struct io_uring_cqe *cqe = (const struct io_uring_cqe *)ring->cqes + (head & ring->cq_mask);
+            out->user_data = cqe->user_data;
+            out->res = cqe->res;
+            __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+            return 1;
+        }
+        if (!wait) return 0;
+    }
+}
+
+#else
+
+int uring_init(Uring *ring, unsigned entries) {
+    (void)entries;
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+    return 0;
+}
+
+void uring_exit(Uring *ring) {
+    (void)ring;
+}
+
+int uring_register_buffers(Uring *ring, void *const *bufs, size_t len, unsigned count) {
+    (void)ring;
+    (void)bufs;
+    (void)len;
+    (void)count;
+    return 0;
+}
+
+int uring_queue_read(Uring *ring, int fd, void *buf, unsigned len, uint64_t offset, int buf_index,
+                     uint64_t user_data) {
+    (void)ring;
+    (void)fd;
+    (void)buf;
+    (void)len;
+    (void)offset;
+    (void)buf_index;
+    (void)user_data;
+    return 0;
+}
+
+int uring_queue_write(Uring *ring, int fd, const void *buf, unsigned len, uint64_t offset, int buf_index,
+                      uint64_t user_data) {
+    (void)ring;
+    (void)fd;
+    (void)buf;
+    (void)len;
+    (void)offset;
+    (void)buf_index;
+    (void)user_data;
+    return 0;
+}
+
+int uring_submit(Uring *ring) {
+    (void)ring;
+    return 0;
+}
+
+int uring_complete(Uring *ring, UringCompletion *out, int wait) {
+    (void)ring;
+    (void)out;
+    (void)wait;
+    return 0;
+}
+
+#endif
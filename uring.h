@@ -0,0 +1,107 @@
+/**
+ * @file
+ * @brief Minimal io_uring wrapper for file reads and writes.
+ *
+ * Talks to the kernel with the raw io_uring system calls, so there is no
+ * liburing dependency. Only what the offline engine needs is covered:
+ * reads and writes at explicit offsets, optionally on registered buffers,
+ * submitted in batches. On systems without io_uring (non-Linux, old
+ * kernels, or where it is blocked) uring_init() fails and callers fall back
+ * to stdio.
+ *
+ * @author Roberto Luiz Souza Monteiro
+ * @copyright Copyright (c) 2025 Roberto Luiz Souza Monteiro
+ * @license BSD 3-Clause License
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief An io_uring instance. Not thread-safe: use one per thread.
+ */
+typedef struct {
+    int fd;                  // Ring descriptor, or -1.
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned *sq_array;
+    void *sqes;              // Submission queue entries.
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    void *cqes;              // Completion queue entries.
+    void *sq_ring;
+    void *cq_ring;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned queued;         // Entries prepared but not submitted yet.
+    int fixed;               // Buffers are registered.
+} Uring;
+
+/**
+ * @brief A completed request.
+ */
+typedef struct {
+    uint64_t user_data;      // Value given when the request was queued.
+    int res;                 // Bytes transferred, or -errno.
+} UringCompletion;
+
+/**
+ * @brief Set up a ring.
+ * @param entries Submission queue size (a power of two).
+ * @return 1 on success, 0 if io_uring is not available.
+ */
+int uring_init(Uring *ring, unsigned entries);
+
+/**
+ * @brief Tear down a ring. Safe on a ring whose setup failed.
+ */
+void uring_exit(Uring *ring);
+
+/**
+ * @brief Register buffers for fixed reads and writes.
+ *
+ * Registered buffers are pinned once instead of on every request.
+ *
+ * @param bufs Buffer addresses.
+ * @param len Size of each buffer.
+ * @param count Number of buffers.
+ * @return 1 on success, 0 on failure (plain reads and writes still work).
+ */
+int uring_register_buffers(Uring *ring, void *const *bufs, size_t len, unsigned count);
+
+/**
+ * @brief Queue a read of len bytes at offset into buf.
+ * @param buf_index Index of the registered buffer holding buf, or -1.
+ * @return 1 on success, 0 if the submission queue is full.
+ */
+int uring_queue_read(Uring *ring, int fd, void *buf, unsigned len, uint64_t offset, int buf_index,
+                     uint64_t user_data);
+
+/**
+ * @brief Queue a write of len bytes at offset from buf.
+ * @param buf_index Index of the registered buffer holding buf, or -1.
+ * @return 1 on success, 0 if the submission queue is full.
+ */
+int uring_queue_write(Uring *ring, int fd, const void *buf, unsigned len, uint64_t offset, int buf_index,
+                      uint64_t user_data);
+
+/**
+ * @brief Submit all queued requests without waiting.
+ * @return 1 on success, 0 on failure.
+ */
+int uring_submit(Uring *ring);
+
+/**
+ * @brief Submit all queued requests and get one completion.
+ * @param wait Block until a completion is available.
+ * @return 1 if a completion was stored in out, 0 if none (or on error when waiting).
+ */
+int uring_complete(Uring *ring, UringCompletion *out, int wait);
+
+#endif
@@ -0,0 +1,41 @@
+#!/bin/sh
+#
+# Checks that denoise_watch waits for a writer that pauses with the file
+# still open: the file is written in two bursts with a pause longer than the
+# debounce period, and must be denoised once, in full.
+#
+# Usage: watch_check.sh [input.wav]   (default audio_02.wav, 48kHz mono)
+
+INPUT=${1:-audio_02.wav}
+DIR=$(mktemp -d)
+trap 'kill $WATCH 2>/dev/null; rm -rf "$DIR"' EXIT
+mkdir "$DIR/in" "$DIR/out"
+
+./denoise_watch -j 1 -d 1 -s 0 -o "$DIR/out" "$DIR/in" 2>"$DIR/log" &
+WATCH=$!
+sleep 1
+
+# Header and 2 seconds of audio, a 3 second pause, then the rest.
+exec 3>"$DIR/in/slow.wav"
+head -c 192044 "$INPUT" >&3
+sleep 3
+tail -c +192045 "$INPUT" >&3
+exec 3>&-
+
+# Debounce, the job itself, and time for a second (wrong) job to show up.
+sleep 6
+kill $WATCH
+wait $WATCH 2>/dev/null
+
+cat "$DIR/log"
+SECONDS_IN=$(( ($(wc -c <"$INPUT") - 44) / 96000 ))
+DONE=$(grep -c 'slow.wav: done' "$DIR/log")
+if [ "$DONE" -ne 1 ]; then
+    echo "watch_check: FAILED: slow.wav processed $DONE times, expected once"
+    exit 1
+fi
+if ! grep -q "slow.wav: done ($SECONDS_IN\." "$DIR/log"; then
+    echo "watch_check: FAILED: slow.wav was not processed in full"
+    exit 1
+fi
+echo "watch_check: OK"
@@ -4,6 +4,8 @@
 #include <string.h>
 #include <gtk/gtk.h>
 
+#include "traced_file.h"
+
 // Structure representing the WAV file header.
 typedef struct {
     char riff[4];             // "RIFF"
@@ -53,7 +55,7 @@ static int read_wav_header(FILE *file, WavHeader *header) {
 
 // Convert a WAV file to raw PCM.
 static void convert_wav_to_pcm(const char *input_path, const char *output_path) {
-    FILE *fin = fopen(input_path, "rb");
+    FILE *fin = traced_fopen(input_path, "rb");
     if (!fin) {
         show_error_dialog("Unable to open input WAV file.");
         return;
@@ -61,7 +63,7 @@ static void convert_wav_to_pcm(const char *input_path, const char *output_path)
 
     WavHeader header;
     if (!read_wav_header(fin, &header)) {
-        fclose(fin);
+        traced_fclose(fin, input_path);
         show_error_dialog("Failed to read WAV file header.");
         return;
     }
@@ -69,32 +71,32 @@ static void convert_wav_to_pcm(const char *input_path, const char *output_path)
     // Validate WAV format.
     if (memcmp(header.riff, "RIFF", 4) != 0 || memcmp(header.wave, "WAVE", 4) != 0 ||
         memcmp(header.fmt, "fmt ", 4) != 0 || memcmp(header.data, "data", 4) != 0) {
-        fclose(fin);
+        traced_fclose(fin, input_path);
         show_error_dialog("Invalid WAV file format.");
         return;
     }
 
     if (header.channels != 1) {
-        fclose(fin);
+        traced_fclose(fin, input_path);
         show_error_dialog("Only mono (1 channel) files are supported.");
         return;
     }
 
     if (header.sample_rate != 48000) {
-        fclose(fin);
+        traced_fclose(fin, input_path);
         show_error_dialog("Only 48kHz sample rate is supported.");
         return;
     }
 
     if (header.bits_per_sample != 16) {
-        fclose(fin);
+        traced_fclose(fin, input_path);
         show_error_dialog("Only 16-bit samples are supported.");
         return;
     }
 
-    FILE *fout = fopen(output_path, "wb");
+    FILE *fout = traced_fopen(output_path, "wb");
     if (!fout) {
-        fclose(fin);
+        traced_fclose(fin, input_path);
         show_error_dialog("Unable to create output PCM file.");
         return;
     }
@@ -102,8 +104,8 @@ static void convert_wav_to_pcm(const char *input_path, const char *output_path)
     // Allocate buffer and read audio data.
     uint8_t *buffer = malloc(header.data_size);
     if (!buffer) {
-        fclose(fin);
-        fclose(fout);
+        traced_fclose(fin, input_path);
+        traced_fclose(fout, output_path);
         show_error_dialog("Memory allocation failed.");
         return;
     }
@@ -120,8 +122,8 @@ static void convert_wav_to_pcm(const char *input_path, const char *output_path)
     }
 
     free(buffer);
-    fclose(fin);
-    fclose(fout);
+    traced_fclose(fin, input_path);
+    traced_fclose(fout, output_path);
 }
 
 // Handler for the "Convert" button click.